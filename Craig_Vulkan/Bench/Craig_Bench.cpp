@@ -0,0 +1,406 @@
+// Headless benchmark runner.
+// Renders the normal scene offscreen for a set number of frames at a given resolution and MSAA level, then writes
+// the CPU and GPU frame time distributions out as JSON. There's no window or surface, so it runs on CI and render
+// farm boxes, including ones with no GPU at all through lavapipe (point VK_DRIVER_FILES at lvp_icd.*.json).
+//
+// Usage: Craig_Bench [config.json]
+// Run it from the Craig_Vulkan folder like the engine itself, everything gets loaded out of data/.
+// The config is optional, anything left out of it keeps the default below. Without a "stressScene" block it measures
+// the normal scene, with one it generates a stress scene for each entry in "counts" and measures each in turn.
+// With "replay" set to a camera recording (F5 in the editor) each run plays that back on its fixed timestep instead
+// of sitting still for "frames" frames.
+
+// Tell SDL not to mess with main()
+#define SDL_MAIN_HANDLED
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "External/json.hpp"
+
+#include "Craig/Craig_Counters.hpp"
+#include "Craig/Craig_Renderer.hpp"
+#include "Craig/Craig_ResourceManager.hpp"
+#include "Craig/Craig_SceneManager.hpp"
+#include "Craig/Craig_Replay.hpp"
+#include "Craig/Craig_StressScene.hpp"
+
+constexpr char kDefaultConfigPath[] = "Bench/bench_config.json";
+constexpr float kMsaaSwitchTimeoutSeconds = 60.0f; // Longest we'll keep warming up waiting for the MSAA pipeline to compile
+
+struct BenchConfig {
+	uint32_t    frames = 1000;
+	uint32_t    warmupFrames = 60;    // Not measured, covers pipeline compiles and the first uploads
+	uint32_t    width = 1920;
+	uint32_t    height = 1080;
+	uint32_t    msaa = 1;             // Clamped to whatever the device can do
+	uint32_t    framesInFlight = kDefaultFramesInFlight;
+	bool        culling = true;
+	bool        occlusionCulling = true;
+	bool        depthPrePass = false;
+	std::string output = "data/bench_results.json";
+	std::string replay;                   // Camera recording to play each run, empty to just sit still
+
+	bool                       stressScene = false;
+	Craig::StressSceneSettings stressSettings;
+	std::vector<uint32_t>      stressCounts; // One measured run per count
+};
+
+struct Distribution {
+	uint32_t samples = 0;
+	float averageMs = 0.0f;
+	float stdDevMs = 0.0f;
+	float minMs = 0.0f;
+	float p50Ms = 0.0f;
+	float p95Ms = 0.0f;
+	float p99Ms = 0.0f;
+	float maxMs = 0.0f;
+};
+
+static bool loadConfig(const std::string& path, bool pathWasGiven, BenchConfig& config) {
+
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		// Only an error if someone asked for that file specifically
+		printf("Couldn't open %s%s\n", path.c_str(), pathWasGiven ? "" : ", using the defaults");
+		return !pathWasGiven;
+	}
+
+	nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+	if (json.is_discarded() || !json.is_object()) {
+		printf("%s isn't a valid bench config\n", path.c_str());
+		return false;
+	}
+
+	config.frames = json.value("frames", config.frames);
+	config.warmupFrames = json.value("warmupFrames", config.warmupFrames);
+	config.width = json.value("width", config.width);
+	config.height = json.value("height", config.height);
+	config.msaa = json.value("msaa", config.msaa);
+	config.framesInFlight = json.value("framesInFlight", config.framesInFlight);
+	config.culling = json.value("culling", config.culling);
+	config.occlusionCulling = json.value("occlusionCulling", config.occlusionCulling);
+	config.depthPrePass = json.value("depthPrePass", config.depthPrePass);
+	config.output = json.value("output", config.output);
+	config.replay = json.value("replay", config.replay);
+
+	if (json.contains("stressScene")) {
+		const nlohmann::json& stress = json["stressScene"];
+		Craig::StressSceneSettings& settings = config.stressSettings;
+
+		std::string layout = stress.value("layout", std::string(Craig::StressScene::getLayoutName(settings.layout)));
+		if (!Craig::StressScene::parseLayout(layout, settings.layout)) {
+			printf("Unknown stress scene layout %s\n", layout.c_str());
+			return false;
+		}
+
+		settings.seed = stress.value("seed", settings.seed);
+		settings.spacing = stress.value("spacing", settings.spacing);
+		settings.objectRadius = stress.value("objectRadius", settings.objectRadius);
+		settings.clusterCount = stress.value("clusters", settings.clusterCount);
+		settings.modelPaths = stress.value("models", settings.modelPaths);
+
+		config.stressCounts = stress.value("counts", std::vector<uint32_t>{ settings.objectCount });
+		for (uint32_t count : config.stressCounts) {
+			if (count == 0 || count > kStressSceneMaxObjects) {
+				printf("Stress scene counts have to be between 1 and %u\n", kStressSceneMaxObjects);
+				return false;
+			}
+		}
+		config.stressScene = true;
+	}
+
+	if (config.frames == 0 || config.width == 0 || config.height == 0) {
+		printf("frames, width and height all have to be at least 1\n");
+		return false;
+	}
+
+	return true;
+}
+
+static nlohmann::json configToJson(const BenchConfig& config) {
+
+	nlohmann::json json;
+	json["frames"] = config.frames;
+	json["warmupFrames"] = config.warmupFrames;
+	json["width"] = config.width;
+	json["height"] = config.height;
+	json["msaa"] = config.msaa;
+	json["framesInFlight"] = config.framesInFlight;
+	json["culling"] = config.culling;
+	json["occlusionCulling"] = config.occlusionCulling;
+	json["depthPrePass"] = config.depthPrePass;
+	json["output"] = config.output;
+	json["replay"] = config.replay;
+
+	if (config.stressScene) {
+		json["stressScene"]["layout"] = Craig::StressScene::getLayoutName(config.stressSettings.layout);
+		json["stressScene"]["counts"] = config.stressCounts;
+		json["stressScene"]["seed"] = config.stressSettings.seed;
+		json["stressScene"]["spacing"] = config.stressSettings.spacing;
+		json["stressScene"]["objectRadius"] = config.stressSettings.objectRadius;
+		json["stressScene"]["clusters"] = config.stressSettings.clusterCount;
+		json["stressScene"]["models"] = config.stressSettings.modelPaths;
+	}
+	return json;
+}
+
+static Distribution summarise(std::vector<float> samples) {
+
+	Distribution result;
+	if (samples.empty()) {
+		return result;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	auto percentile = [&samples](float p) {
+		return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+	};
+
+	double total = 0.0;
+	for (float sample : samples) {
+		total += sample;
+	}
+	double mean = total / samples.size();
+
+	double squaredDifferences = 0.0;
+	for (float sample : samples) {
+		squaredDifferences += (sample - mean) * (sample - mean);
+	}
+
+	result.samples = static_cast<uint32_t>(samples.size());
+	result.averageMs = static_cast<float>(mean);
+	result.stdDevMs = static_cast<float>(std::sqrt(squaredDifferences / samples.size()));
+	result.minMs = samples.front();
+	result.p50Ms = percentile(0.50f);
+	result.p95Ms = percentile(0.95f);
+	result.p99Ms = percentile(0.99f);
+	result.maxMs = samples.back();
+	return result;
+}
+
+static nlohmann::json distributionToJson(const Distribution& distribution) {
+
+	nlohmann::json json;
+	json["samples"] = distribution.samples;
+	json["averageMs"] = distribution.averageMs;
+	json["stdDevMs"] = distribution.stdDevMs;
+	json["minMs"] = distribution.minMs;
+	json["p50Ms"] = distribution.p50Ms;
+	json["p95Ms"] = distribution.p95Ms;
+	json["p99Ms"] = distribution.p99Ms;
+	json["maxMs"] = distribution.maxMs;
+	return json;
+}
+
+static nlohmann::json profileToJson(const Craig::StressSceneProfile& profile) {
+
+	nlohmann::json json;
+	json["instances"] = profile.instanceCount;
+	json["distinctModels"] = profile.distinctModelCount;
+	json["subMeshDraws"] = profile.subMeshInstanceCount;
+	json["generateMs"] = profile.generateMs;
+	for (const std::pair<std::string, uint32_t>& modelCount : profile.instancesPerModel) {
+		json["instancesPerModel"][modelCount.first] = modelCount.second;
+	}
+	return json;
+}
+
+// Per-frame averages of every render counter over the measured frames, under the same names the CSV stream uses
+static nlohmann::json countersToJson(const Craig::Counters::Values& startTotals, uint64_t startFrame) {
+
+	Craig::Counters& counters = Craig::Counters::getInstance();
+	uint64_t frames = counters.getFrameIndex() - startFrame;
+
+	nlohmann::json json;
+	for (uint32_t i = 0; i < Craig::Counters::kNumCounters; i++) {
+		uint64_t total = counters.getTotals()[i] - startTotals[i];
+		json[Craig::Counters::getName(static_cast<Craig::Counter>(i))] = frames > 0 ? static_cast<double>(total) / static_cast<double>(frames) : 0.0;
+	}
+	return json;
+}
+
+int main(int argc, char** argv) {
+
+	BenchConfig config;
+	bool pathWasGiven = argc > 1;
+	std::string configPath = pathWasGiven ? argv[1] : kDefaultConfigPath;
+	if (!loadConfig(configPath, pathWasGiven, config)) {
+		return 1;
+	}
+
+	// Same order the framework does it in, the resource manager has to know about the renderer before the scene loads
+	Craig::SceneManager sceneManager;
+	Craig::Renderer renderer;
+	Craig::ResourceManager::getInstance().init(&renderer);
+
+	Craig::Renderer::HeadlessInitInfo headlessInfo;
+	headlessInfo.extent = vk::Extent2D(config.width, config.height);
+	if (renderer.initHeadless(&sceneManager, headlessInfo) != CRAIG_SUCCESS) {
+		return 1;
+	}
+
+	renderer.setFramesInFlight(config.framesInFlight);
+	renderer.getCullingEnabled() = config.culling;
+	renderer.getOcclusionCullingEnabled() = config.occlusionCulling;
+	renderer.getDepthPrePassEnabled() = config.depthPrePass;
+
+	uint32_t msaa = std::clamp(config.msaa, 1u, renderer.getRenderingAttachments().getMaxSamplingLevel());
+	renderer.updateSamplingLevel(static_cast<int>(msaa));
+
+	std::chrono::steady_clock::time_point lastFrame = std::chrono::steady_clock::now();
+	auto nextDeltaTime = [&]() {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		float deltaTime = std::chrono::duration<float>(now - lastFrame).count();
+		lastFrame = now;
+		return deltaTime;
+	};
+	auto runFrame = [&]() {
+		float deltaTime = nextDeltaTime();
+		sceneManager.update(deltaTime);
+		renderer.update(deltaTime);
+		return deltaTime;
+	};
+
+	printf("Bench: %u x %u, %ux MSAA, %u frames in flight, %u warm up + %u measured frames per run\n",
+		config.width, config.height, msaa, renderer.getFramesInFlight(), config.warmupFrames, config.frames);
+
+	bool gpuTimed = renderer.getTimestampsSupported();
+	nlohmann::json runs = nlohmann::json::array();
+
+	// The normal scene is the one run if there's no stress scene asked for
+	size_t runCount = config.stressScene ? config.stressCounts.size() : 1;
+	bool failed = false;
+	for (size_t run = 0; run < runCount && !failed; run++) {
+		nlohmann::json runResults;
+
+		if (config.stressScene) {
+			Craig::StressSceneSettings settings = config.stressSettings;
+			settings.objectCount = config.stressCounts[run];
+
+			Craig::StressSceneProfile profile;
+			if (renderer.generateStressScene(settings, &profile) != CRAIG_SUCCESS) {
+				printf("Couldn't generate a stress scene with %u objects\n", settings.objectCount);
+				failed = true;
+				break;
+			}
+			runResults["scene"] = profileToJson(profile);
+		}
+
+		// Keeps going past the warm up until the MSAA level's actually switched over, it waits on a background compile
+		std::chrono::steady_clock::time_point warmupStart = std::chrono::steady_clock::now();
+		uint32_t warmupFrames = 0;
+		while (warmupFrames < config.warmupFrames || renderer.isSamplingLevelPending()) {
+			runFrame();
+			warmupFrames++;
+
+			if (std::chrono::duration<float>(std::chrono::steady_clock::now() - warmupStart).count() > kMsaaSwitchTimeoutSeconds) {
+				printf("Gave up waiting for the %ux MSAA pipeline\n", msaa);
+				failed = true;
+				break;
+			}
+		}
+		if (failed) {
+			break;
+		}
+
+		std::vector<float> cpuFrameMs;
+		std::vector<float> gpuFrameMs;
+
+		const Craig::Counters::Values startCounters = Craig::Counters::getInstance().getTotals();
+		const uint64_t startCounterFrame = Craig::Counters::getInstance().getFrameIndex();
+
+		if (!config.replay.empty()) {
+			// The replay does its own timing, and sets the timestep, so the frames are the same on every run
+			Craig::Replay& replay = Craig::Replay::getInstance();
+			if (replay.startPlayback(config.replay, "") != CRAIG_SUCCESS) {
+				failed = true;
+				break;
+			}
+
+			Craig::Camera& camera = sceneManager.getCurrentScene()->getCamera();
+			while (true) {
+				float deltaTime = replay.beginFrame(nextDeltaTime(), renderer, camera);
+				if (replay.hasFinished()) {
+					break;
+				}
+				sceneManager.update(deltaTime);
+				renderer.update(deltaTime);
+				replay.endFrame(camera);
+			}
+
+			for (const Craig::Replay::FrameTiming& timing : replay.getFrameTimings()) {
+				cpuFrameMs.push_back(timing.cpuMs);
+				gpuFrameMs.push_back(timing.gpuMs);
+			}
+			if (!gpuTimed) {
+				gpuFrameMs.clear();
+			}
+		}
+		else {
+			cpuFrameMs.reserve(config.frames);
+			gpuFrameMs.reserve(config.frames);
+
+			runFrame(); // Its delta covers the warm up's last frame
+			for (uint32_t i = 0; i < config.frames; i++) {
+				cpuFrameMs.push_back(runFrame() * 1000.0f);
+
+				// Lags a few frames behind since it's read once the frame slot comes back round, which is fine for a distribution
+				if (gpuTimed) {
+					gpuFrameMs.push_back(renderer.getGpuProfiler().getLastMs("Frame"));
+				}
+			}
+		}
+
+		Distribution cpu = summarise(cpuFrameMs);
+		Distribution gpu = summarise(gpuFrameMs);
+
+		runResults["objects"] = sceneManager.getCurrentScene()->getGameObjects().size();
+		runResults["warmupFrames"] = warmupFrames;
+		runResults["cpuFrame"] = distributionToJson(cpu);
+		if (gpuTimed) {
+			runResults["gpuFrame"] = distributionToJson(gpu);
+		}
+		runResults["counters"] = countersToJson(startCounters, startCounterFrame);
+		runResults["frameTimesMs"] = cpuFrameMs;
+		runs.push_back(runResults);
+
+		printf("%zu objects\n", sceneManager.getCurrentScene()->getGameObjects().size());
+		printf("    CPU frame: avg %.3f ms, std dev %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+			cpu.averageMs, cpu.stdDevMs, cpu.p50Ms, cpu.p95Ms, cpu.p99Ms, cpu.maxMs);
+		if (gpuTimed) {
+			printf("    GPU frame: avg %.3f ms, std dev %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+				gpu.averageMs, gpu.stdDevMs, gpu.p50Ms, gpu.p95Ms, gpu.p99Ms, gpu.maxMs);
+		}
+	}
+
+	nlohmann::json results;
+	results["config"] = configToJson(config);
+	results["device"] = renderer.getDeviceName();
+	results["msaa"] = static_cast<uint32_t>(renderer.getRenderingAttachments().m_VK_msaaSamples);
+	results["framesInFlight"] = renderer.getFramesInFlight();
+	results["timeToFirstFrameMs"] = renderer.getTimeToFirstFrameMs();
+	results["pipelineCacheWarm"] = renderer.getPipelineCacheWarm();
+	results["runs"] = runs;
+
+	sceneManager.terminate();
+	renderer.terminate();
+	Craig::ResourceManager::getInstance().terminate();
+
+	std::ofstream file(config.output, std::ios::trunc);
+	if (!file.is_open()) {
+		printf("Couldn't open %s to write the results\n", config.output.c_str());
+		return 1;
+	}
+
+	file << results.dump(2);
+	printf("Wrote bench results to %s\n", config.output.c_str());
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+// Microbenchmark for the CPU culling stage.
+// Fills 1M random bounding spheres around the camera and times Culling::cull single threaded and
+// across the worker threads, with and without the small-object contribution test.
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Craig/Craig_Culling.hpp"
+
+constexpr size_t kNumObjects = 1000000;
+constexpr int kWarmupIterations = 5;
+constexpr int kIterations = 50;
+
+struct BenchResult {
+	double minMs = 0.0;
+	double avgMs = 0.0;
+	Craig::Culling::CullingStats stats;
+};
+
+static BenchResult runBench(Craig::Culling& culling, const Craig::Culling::CullingView& view) {
+
+	for (int i = 0; i < kWarmupIterations; i++) {
+		culling.cull(view);
+	}
+
+	BenchResult result;
+	result.minMs = 1e30;
+	double totalMs = 0.0;
+	for (int i = 0; i < kIterations; i++) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		culling.cull(view);
+		const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		double ms = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000.0;
+		result.minMs = std::min(result.minMs, ms);
+		totalMs += ms;
+	}
+	result.avgMs = totalMs / kIterations;
+	result.stats = culling.getStats();
+
+	return result;
+}
+
+static void printResult(const char* name, const BenchResult& result) {
+	printf("%-36s min %8.3f ms  avg %8.3f ms  %6.2f ns/object  visible %7u  frustum culled %7u  too small %7u\n",
+		name, result.minMs, result.avgMs, result.minMs * 1000000.0 / kNumObjects,
+		result.stats.numVisible, result.stats.numFrustumCulled, result.stats.numContributionCulled);
+}
+
+int main() {
+
+	// Same kind of camera the engine builds, sitting at the origin looking down -z
+	Craig::Culling::CullingView view;
+	view.view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	view.proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	view.proj[1][1] *= -1.0f;
+	view.cameraPosition = glm::vec3(0.0f);
+	view.viewportHeight = 1080.0f;
+
+	// Fixed seed so every run tests exactly the same spheres
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> radius(0.05f, 2.0f);
+
+	std::vector<glm::vec4> spheres(kNumObjects);
+	for (glm::vec4& sphere : spheres) {
+		sphere = glm::vec4(position(rng), position(rng), position(rng), radius(rng));
+	}
+
+	Craig::Culling::CullingInitInfo singleInfo;
+	singleInfo.useWorkerThreads = false;
+	Craig::Culling singleThreaded;
+	singleThreaded.init(singleInfo);
+
+	Craig::Culling::CullingInitInfo wideInfo;
+	Craig::Culling multiThreaded;
+	multiThreaded.init(wideInfo);
+
+	for (Craig::Culling* culling : { &singleThreaded, &multiThreaded }) {
+		culling->resize(kNumObjects);
+		for (size_t i = 0; i < kNumObjects; i++) {
+			culling->setSphere(i, spheres[i]);
+		}
+	}
+
+	printf("Culling %zu objects, SIMD path: %s, worker threads: %u\n\n", kNumObjects, Craig::Culling::getSimdPathName(), multiThreaded.getThreadCount() - 1);
+
+	view.minPixelSize = 0.0f;
+	printResult("frustum only, 1 thread", runBench(singleThreaded, view));
+	printResult("frustum only, all threads", runBench(multiThreaded, view));
+
+	view.minPixelSize = kDefaultMinPixelSize;
+	printResult("frustum + contribution, 1 thread", runBench(singleThreaded, view));
+	printResult("frustum + contribution, all threads", runBench(multiThreaded, view));
+
+	// Sanity check, the threaded path has to agree with the single threaded one
+	if (singleThreaded.getVisibility() != multiThreaded.getVisibility()) {
+		printf("\nERROR: single and multi threaded visibility don't match!\n");
+		return 1;
+	}
+
+	singleThreaded.terminate();
+	multiThreaded.terminate();
+
+	return 0;
+}
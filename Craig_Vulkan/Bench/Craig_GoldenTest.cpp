@@ -0,0 +1,363 @@
+// Golden image regression runner.
+// Renders a set of canonical scenes headless, once for every combination of performance features in the config, and
+// checks each one against a stored golden image for that scene. The features (culling, occlusion culling, the depth
+// pre-pass, frames in flight) are all meant to be invisible, so every variant has to come out the same as the golden
+// to within the tolerance. MSAA really does change the picture, so each MSAA level gets its own golden.
+//
+// Usage: Craig_GoldenTest [config.json] [--update]
+// Run it from the Craig_Vulkan folder like the engine itself. --update renders the first variant of each scene as the
+// new golden before checking the rest against it, do that on a known good build and commit the PNGs.
+// Every capture and, for anything that failed, an image with the differing pixels in red go to the output folder,
+// along with results.json. Exits with 1 if anything failed.
+
+// Tell SDL not to mess with main()
+#define SDL_MAIN_HANDLED
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "External/json.hpp"
+
+#include "Craig/Craig_Renderer.hpp"
+#include "Craig/Craig_ResourceManager.hpp"
+#include "Craig/Craig_SceneManager.hpp"
+#include "Craig/Craig_StressScene.hpp"
+
+constexpr char kDefaultConfigPath[] = "Bench/golden_config.json";
+constexpr float kMsaaSwitchTimeoutSeconds = 60.0f; // Longest we'll wait for an MSAA pipeline variant to compile
+constexpr uint32_t kCaptureTimeoutFrames = 16;     // A capture shows up once its frame slot comes round, this is plenty
+
+struct GoldenScene {
+	std::string                name;
+	bool                       stressScene = false; // Otherwise it's the scene the engine starts with
+	Craig::StressSceneSettings stressSettings;
+};
+
+struct GoldenVariant {
+	std::string name;
+	bool        culling = true;
+	bool        occlusionCulling = true;
+	bool        depthPrePass = false;
+	uint32_t    framesInFlight = kDefaultFramesInFlight;
+};
+
+struct GoldenConfig {
+	uint32_t    width = 640;
+	uint32_t    height = 360;
+	uint32_t    warmupFrames = 10;
+	uint32_t    tolerance = 8;              // Per channel, out of 255
+	float       maxDifferingPercent = 0.1f; // Of the pixels, anything more and the variant fails
+	uint32_t    overheadFrames = 300;       // Frames timed with and without periodic capture, 0 to skip it
+	uint32_t    overheadInterval = 10;
+	std::string goldens = "Bench/goldens";
+	std::string output = "data/golden_results";
+
+	std::vector<uint32_t>      msaa = { 1 };
+	std::vector<GoldenScene>   scenes;
+	std::vector<GoldenVariant> variants;
+};
+
+static bool loadConfig(const std::string& path, GoldenConfig& config) {
+
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		printf("Couldn't open %s\n", path.c_str());
+		return false;
+	}
+
+	nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+	if (json.is_discarded() || !json.is_object()) {
+		printf("%s isn't a valid golden test config\n", path.c_str());
+		return false;
+	}
+
+	config.width = json.value("width", config.width);
+	config.height = json.value("height", config.height);
+	config.warmupFrames = json.value("warmupFrames", config.warmupFrames);
+	config.tolerance = json.value("tolerance", config.tolerance);
+	config.maxDifferingPercent = json.value("maxDifferingPercent", config.maxDifferingPercent);
+	config.overheadFrames = json.value("overheadFrames", config.overheadFrames);
+	config.overheadInterval = std::max(json.value("overheadInterval", config.overheadInterval), 1u);
+	config.goldens = json.value("goldens", config.goldens);
+	config.output = json.value("output", config.output);
+	config.msaa = json.value("msaa", config.msaa);
+
+	for (const nlohmann::json& sceneJson : json.value("scenes", nlohmann::json::array())) {
+		GoldenScene scene;
+		scene.name = sceneJson.value("name", std::string());
+
+		if (sceneJson.contains("stressScene")) {
+			const nlohmann::json& stress = sceneJson["stressScene"];
+			Craig::StressSceneSettings& settings = scene.stressSettings;
+
+			std::string layout = stress.value("layout", std::string(Craig::StressScene::getLayoutName(settings.layout)));
+			if (!Craig::StressScene::parseLayout(layout, settings.layout)) {
+				printf("Unknown stress scene layout %s\n", layout.c_str());
+				return false;
+			}
+
+			settings.objectCount = stress.value("count", settings.objectCount);
+			settings.seed = stress.value("seed", settings.seed);
+			settings.spacing = stress.value("spacing", settings.spacing);
+			settings.objectRadius = stress.value("objectRadius", settings.objectRadius);
+			settings.clusterCount = stress.value("clusters", settings.clusterCount);
+			settings.modelPaths = stress.value("models", settings.modelPaths);
+			scene.stressScene = true;
+		}
+		else if (!config.scenes.empty()) {
+			// Once a stress scene's replaced it there's no getting the starting scene back
+			printf("The starting scene (%s) has to be the first one in the list\n", scene.name.c_str());
+			return false;
+		}
+
+		if (scene.name.empty()) {
+			printf("Every scene needs a name, it's what the golden's called\n");
+			return false;
+		}
+		config.scenes.push_back(scene);
+	}
+
+	for (const nlohmann::json& variantJson : json.value("variants", nlohmann::json::array())) {
+		GoldenVariant variant;
+		variant.name = variantJson.value("name", std::string("variant") + std::to_string(config.variants.size()));
+		variant.culling = variantJson.value("culling", variant.culling);
+		variant.occlusionCulling = variantJson.value("occlusionCulling", variant.occlusionCulling);
+		variant.depthPrePass = variantJson.value("depthPrePass", variant.depthPrePass);
+		variant.framesInFlight = variantJson.value("framesInFlight", variant.framesInFlight);
+		config.variants.push_back(variant);
+	}
+
+	if (config.scenes.empty() || config.variants.empty() || config.msaa.empty()) {
+		printf("The config needs at least one scene, variant and MSAA level\n");
+		return false;
+	}
+
+	if (config.width == 0 || config.height == 0) {
+		printf("width and height both have to be at least 1\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+
+	std::string configPath = kDefaultConfigPath;
+	bool update = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--update") == 0) {
+			update = true;
+		}
+		else {
+			configPath = argv[i];
+		}
+	}
+
+	GoldenConfig config;
+	if (!loadConfig(configPath, config)) {
+		return 1;
+	}
+
+	std::filesystem::create_directories(config.output);
+	if (update) {
+		std::filesystem::create_directories(config.goldens);
+	}
+
+	// Same order the framework does it in, the resource manager has to know about the renderer before the scene loads
+	Craig::SceneManager sceneManager;
+	Craig::Renderer renderer;
+	Craig::ResourceManager::getInstance().init(&renderer);
+
+	Craig::Renderer::HeadlessInitInfo headlessInfo;
+	headlessInfo.extent = vk::Extent2D(config.width, config.height);
+	if (renderer.initHeadless(&sceneManager, headlessInfo) != CRAIG_SUCCESS) {
+		return 1;
+	}
+
+	// Fixed timestep so nothing that moves depends on how fast this machine is
+	auto runFrame = [&]() {
+		sceneManager.update(kReplayTimestep);
+		renderer.update(kReplayTimestep);
+	};
+
+	nlohmann::json results;
+	results["build"] = __DATE__ " " __TIME__;
+	results["device"] = renderer.getDeviceName();
+	results["width"] = config.width;
+	results["height"] = config.height;
+	results["tolerance"] = config.tolerance;
+	results["maxDifferingPercent"] = config.maxDifferingPercent;
+	results["checks"] = nlohmann::json::array();
+
+	uint32_t maxMsaa = renderer.getRenderingAttachments().getMaxSamplingLevel();
+	uint32_t failures = 0;
+	bool aborted = false;
+
+	for (const GoldenScene& scene : config.scenes) {
+		if (aborted) {
+			break;
+		}
+
+		if (scene.stressScene && renderer.generateStressScene(scene.stressSettings) != CRAIG_SUCCESS) {
+			printf("Couldn't generate the %s scene\n", scene.name.c_str());
+			aborted = true;
+			break;
+		}
+
+		for (uint32_t requestedMsaa : config.msaa) {
+			uint32_t msaa = std::clamp(requestedMsaa, 1u, maxMsaa);
+			if (msaa != requestedMsaa) {
+				printf("Skipping %ux MSAA, this device tops out at %ux\n", requestedMsaa, maxMsaa);
+				continue;
+			}
+			renderer.updateSamplingLevel(static_cast<int>(msaa));
+
+			std::string goldenName = scene.name + "_msaa" + std::to_string(msaa);
+			std::string goldenPath = config.goldens + "/" + goldenName + ".png";
+
+			Craig::FrameCapture::Image golden;
+			bool haveGolden = !update && Craig::FrameCapture::readPng(goldenPath, golden);
+			if (!update && !haveGolden) {
+				printf("FAIL %s: no golden at %s, run with --update on a known good build\n", goldenName.c_str(), goldenPath.c_str());
+				failures++;
+				continue;
+			}
+
+			for (size_t variantIndex = 0; variantIndex < config.variants.size() && !aborted; variantIndex++) {
+				const GoldenVariant& variant = config.variants[variantIndex];
+				std::string checkName = goldenName + "_" + variant.name;
+
+				renderer.setFramesInFlight(variant.framesInFlight);
+				renderer.getCullingEnabled() = variant.culling;
+				renderer.getOcclusionCullingEnabled() = variant.occlusionCulling;
+				renderer.getDepthPrePassEnabled() = variant.depthPrePass;
+
+				// Occlusion culling draws from last frame's visibility, so it needs a few frames to settle like everything else
+				std::chrono::steady_clock::time_point warmupStart = std::chrono::steady_clock::now();
+				uint32_t warmupFrames = 0;
+				while (warmupFrames < config.warmupFrames || renderer.isSamplingLevelPending()) {
+					runFrame();
+					warmupFrames++;
+
+					if (std::chrono::duration<float>(std::chrono::steady_clock::now() - warmupStart).count() > kMsaaSwitchTimeoutSeconds) {
+						printf("Gave up waiting for the %ux MSAA pipeline\n", msaa);
+						aborted = true;
+						break;
+					}
+				}
+				if (aborted) {
+					break;
+				}
+
+				Craig::FrameCapture::Image capture;
+				bool captured = renderer.requestFrameCapture();
+				for (uint32_t frame = 0; captured && frame < kCaptureTimeoutFrames && !renderer.hasFrameCapture(); frame++) {
+					runFrame();
+				}
+				if (!captured || !renderer.takeFrameCapture(capture)) {
+					printf("Couldn't capture %s\n", checkName.c_str());
+					aborted = true;
+					break;
+				}
+
+				Craig::FrameCapture::writePng(capture, config.output + "/" + checkName + ".png");
+
+				if (update && variantIndex == 0) {
+					if (!Craig::FrameCapture::writePng(capture, goldenPath)) {
+						aborted = true;
+						break;
+					}
+					printf("Updated golden %s from %s\n", goldenPath.c_str(), variant.name.c_str());
+					golden = capture;
+					continue;
+				}
+
+				Craig::FrameCapture::Image diffImage;
+				Craig::FrameCapture::ImageDiff diff = Craig::FrameCapture::compare(golden, capture, config.tolerance, &diffImage);
+				bool passed = !diff.sizeMismatch && diff.differingPercent <= config.maxDifferingPercent;
+
+				if (diff.sizeMismatch) {
+					printf("FAIL %s: %u x %u against a %u x %u golden\n", checkName.c_str(), capture.width, capture.height, golden.width, golden.height);
+				}
+				else {
+					printf("%s %s: %.3f%% of pixels differ, worst channel %u, mean error %.3f\n", passed ? "pass" : "FAIL",
+						checkName.c_str(), diff.differingPercent, diff.maxChannelDifference, diff.meanAbsoluteError);
+				}
+
+				if (!passed) {
+					failures++;
+					if (!diff.sizeMismatch) {
+						Craig::FrameCapture::writePng(diffImage, config.output + "/" + checkName + "_diff.png");
+					}
+				}
+
+				nlohmann::json check;
+				check["name"] = checkName;
+				check["scene"] = scene.name;
+				check["msaa"] = msaa;
+				check["variant"] = variant.name;
+				check["passed"] = passed;
+				check["sizeMismatch"] = diff.sizeMismatch;
+				check["differingPixels"] = diff.differingPixels;
+				check["differingPercent"] = diff.differingPercent;
+				check["maxChannelDifference"] = diff.maxChannelDifference;
+				check["meanAbsoluteError"] = diff.meanAbsoluteError;
+				results["checks"].push_back(check);
+			}
+		}
+	}
+
+	// Periodic capture shouldn't show up in the frame time, the copy's a few hundred microseconds of GPU and the
+	// conversion and PNG encoding happen on the writer thread. Timed on whatever scene and settings were left over.
+	if (!aborted && config.overheadFrames > 0) {
+		auto averageFrameMs = [&]() {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < config.overheadFrames; i++) {
+				runFrame();
+			}
+			return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() / config.overheadFrames;
+		};
+
+		float withoutMs = averageFrameMs();
+		renderer.setCaptureInterval(config.overheadInterval);
+		float withMs = averageFrameMs();
+		renderer.setCaptureInterval(0);
+		renderer.getFrameCapture().flushWrites();
+
+		printf("Frame time %.3f ms without capture, %.3f ms capturing every %u frames (%u saved, %u dropped)\n",
+			withoutMs, withMs, config.overheadInterval, renderer.getCapturesSaved(), renderer.getCapturesDropped());
+
+		results["captureOverhead"]["interval"] = config.overheadInterval;
+		results["captureOverhead"]["withoutCaptureMs"] = withoutMs;
+		results["captureOverhead"]["withCaptureMs"] = withMs;
+		results["captureOverhead"]["saved"] = renderer.getCapturesSaved();
+		results["captureOverhead"]["dropped"] = renderer.getCapturesDropped();
+	}
+
+	results["failures"] = failures;
+	results["aborted"] = aborted;
+
+	sceneManager.terminate();
+	renderer.terminate();
+	Craig::ResourceManager::getInstance().terminate();
+
+	std::string resultsPath = config.output + "/results.json";
+	std::ofstream file(resultsPath, std::ios::trunc);
+	if (file.is_open()) {
+		file << results.dump(2);
+		printf("Wrote golden test results to %s\n", resultsPath.c_str());
+	}
+
+	if (aborted) {
+		return 1;
+	}
+
+	printf("%u failure%s\n", failures, failures == 1 ? "" : "s");
+	return failures > 0 ? 1 : 0;
+}
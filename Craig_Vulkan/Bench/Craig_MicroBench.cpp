@@ -0,0 +1,404 @@
+// Microbenchmarks for the engine's CPU hot paths.
+// Each one runs the real engine code on its own, with no window, no Vulkan device and no renderer: model parsing,
+// geometry packing for the shared vertex/index buffers, transform updates, the name sort, object lookup and the
+// per-object SSBO writes, plus what a CPU profiling zone costs. Every benchmark is run in batches sized to take at
+// least kMinSampleMs, and the spread of the batches gives the confidence interval, so two runs can be told apart
+// from noise.
+//
+// Usage: Craig_MicroBench [output.json]
+// Run it from the Craig_Vulkan folder like the engine itself, the models get loaded out of data/.
+// Keep the output from each release around and diff the nsPerOp of each benchmark between them.
+
+// Tell SDL not to mess with main()
+#define SDL_MAIN_HANDLED
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "External/json.hpp"
+
+#include "Craig/Craig_GameObject.hpp"
+#include "Craig/Craig_Profiler.hpp"
+#include "Craig/Craig_ResourceManager.hpp"
+#include "Craig/Craig_Scene.hpp"
+#include "Craig/Craig_Utilities.hpp"
+
+constexpr char kDefaultOutputPath[] = "data/microbench_results.json";
+constexpr uint32_t kObjectCounts[] = { 1000, 10000, 100000 };
+constexpr uint32_t kSamples = 20;             // Timed batches per benchmark
+constexpr double kStudentT95 = 2.093;         // Two sided 95% Student-t for kSamples - 1 = 19 degrees of freedom
+static_assert(kSamples == 20, "kStudentT95 needs looking up again for the new number of samples");
+constexpr double kMinSampleMs = 10.0;         // Batches get made bigger until one takes at least this long
+constexpr uint32_t kMaxIterations = 1u << 24; // Stops calibration running away if something turns out to be free
+constexpr double kNoisyIntervalPercent = 5.0; // Flagged in the printout when the 95% interval is wider than this
+
+const std::vector<std::string> kModelPaths = { "data/models/Duck.glb", "data/models/AlphaBlendModeTest.glb" };
+
+// Written to after every batch so the compiler can't throw the work away
+static volatile uintptr_t g_sink = 0;
+
+struct MicroBench {
+	std::string name;
+	std::string opUnit = "call"; // What one op is, so ns/op means something in the output
+	uint64_t    opsPerIteration = 1;
+	uint32_t    objectCount = 0;  // 0 when it doesn't depend on the scene size
+
+	std::function<void(uint32_t iterations)> prepare; // Optional, untimed, runs before every batch
+	std::function<void(uint32_t iterations)> run;
+};
+
+struct MicroBenchResult {
+	uint32_t iterationsPerSample = 0;
+	double   meanNs = 0.0; // All per op
+	double   medianNs = 0.0;
+	double   stdDevNs = 0.0;
+	double   minNs = 0.0;
+	double   maxNs = 0.0;
+	double   ci95Ns = 0.0; // Half width of the 95% confidence interval on the mean
+};
+
+// Same copy of the engine's PerObjectData, that one's private to the renderer
+struct PerObjectData {
+	glm::mat4 model;
+};
+
+static double timeBatch(const MicroBench& bench, uint32_t iterations) {
+
+	if (bench.prepare) {
+		bench.prepare(iterations);
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bench.run(iterations);
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static MicroBenchResult runMicroBench(const MicroBench& bench) {
+
+	// Double the batch until it's long enough that the clock's resolution and the call overhead don't matter
+	uint32_t iterations = 1;
+	while (iterations < kMaxIterations && timeBatch(bench, iterations) < kMinSampleMs * 1000000.0) {
+		iterations *= 2;
+	}
+
+	// One more untimed batch at full size so the caches and branch predictors are in the state the samples will see
+	timeBatch(bench, iterations);
+
+	std::vector<double> samples(kSamples);
+	for (double& sample : samples) {
+		sample = timeBatch(bench, iterations) / (static_cast<double>(iterations) * bench.opsPerIteration);
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	double total = 0.0;
+	for (double sample : samples) {
+		total += sample;
+	}
+	double mean = total / samples.size();
+
+	double squaredDifferences = 0.0;
+	for (double sample : samples) {
+		squaredDifferences += (sample - mean) * (sample - mean);
+	}
+
+	// Sample standard deviation, the batches are a sample of every batch we could have run
+	double stdDev = std::sqrt(squaredDifferences / (samples.size() - 1));
+
+	MicroBenchResult result;
+	result.iterationsPerSample = iterations;
+	result.meanNs = mean;
+	result.medianNs = (samples[(samples.size() - 1) / 2] + samples[samples.size() / 2]) * 0.5;
+	result.stdDevNs = stdDev;
+	result.minNs = samples.front();
+	result.maxNs = samples.back();
+	result.ci95Ns = kStudentT95 * stdDev / std::sqrt(static_cast<double>(samples.size()));
+	return result;
+}
+
+static void freeModel(Craig::Model& model) {
+
+	for (Craig::SubMesh* subMesh : model.subMeshes) {
+		delete subMesh;
+	}
+	model.subMeshes.clear();
+}
+
+static std::string objectName(uint32_t index) {
+
+	char name[32];
+	snprintf(name, sizeof(name), "bench_%06u", index);
+	return name;
+}
+
+int main(int argc, char** argv) {
+
+	std::string outputPath = argc > 1 ? argv[1] : kDefaultOutputPath;
+	Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+
+	// Parse every model once up front. Putting them in the resource manager's map means GameObject::init finds them
+	// already loaded and never goes near the renderer.
+	std::vector<Craig::Model*> models;
+	for (const std::string& modelPath : kModelPaths) {
+		Craig::Model& model = resources.getModel(modelPath);
+		if (!Craig::ResourceManager::parseModel(modelPath, model, nullptr)) {
+			printf("Couldn't load %s, run this from the Craig_Vulkan folder\n", modelPath.c_str());
+			return 1;
+		}
+		model.modelPath = modelPath;
+		models.push_back(&model);
+	}
+
+	uint32_t modelVertexCount = 0;
+	uint32_t modelIndexCount = 0;
+	for (Craig::Model* model : models) {
+		for (size_t i = 0; i < model->subMeshesCount; i++) {
+			modelVertexCount += static_cast<uint32_t>(model->subMeshes[i]->m_vertices.size());
+			modelIndexCount += static_cast<uint32_t>(model->subMeshes[i]->m_indices.size());
+		}
+	}
+
+	std::vector<MicroBench> benches;
+
+	// Model parsing, on its own since it doesn't care how big the scene is
+	for (const std::string& modelPath : kModelPaths) {
+		MicroBench bench;
+		bench.name = "ResourceManager::parseModel " + modelPath;
+		bench.opUnit = "model";
+		bench.run = [modelPath](uint32_t iterations) {
+			for (uint32_t i = 0; i < iterations; i++) {
+				Craig::Model model;
+				Craig::ResourceManager::parseModel(modelPath, model, nullptr);
+				g_sink = g_sink + model.subMeshesCount;
+				freeModel(model);
+			}
+		};
+		benches.push_back(bench);
+	}
+
+#if defined(CRAIG_PROFILING_ENABLED)
+	// An empty zone, so this is the whole cost of one CRAIG_PROFILE_ZONE: two timestamps and the write into this thread's ring
+	{
+		MicroBench bench;
+		bench.name = "Profiler zone begin/end";
+		bench.opUnit = "zone";
+		bench.run = [](uint32_t iterations) {
+			for (uint32_t i = 0; i < iterations; i++) {
+				CRAIG_PROFILE_ZONE("MicroBench zone");
+			}
+			g_sink = g_sink + static_cast<uintptr_t>(Craig::Profiler::now());
+		};
+		benches.push_back(bench);
+	}
+#endif
+
+	// Packing every model's geometry into the staging memory, same work createVertexBuffer and createIndexBuffer do
+	std::vector<Craig::Vertex> packedVertices(modelVertexCount);
+	std::vector<float> packedPositions(static_cast<size_t>(modelVertexCount) * 3);
+	std::vector<uint32_t> packedIndices(modelIndexCount);
+	{
+		MicroBench bench;
+		bench.name = "ResourceManager pack vertices and indices";
+		bench.opUnit = "vertex";
+		bench.opsPerIteration = modelVertexCount;
+		bench.run = [&](uint32_t iterations) {
+			for (uint32_t i = 0; i < iterations; i++) {
+				Craig::ResourceManager::assignVertexOffsets(models);
+				Craig::ResourceManager::assignIndexOffsets(models);
+				Craig::ResourceManager::packVertices(models, packedVertices.data(), packedPositions.data());
+				Craig::ResourceManager::packIndices(models, packedIndices.data());
+			}
+			g_sink = g_sink + packedIndices.back();
+		};
+		benches.push_back(bench);
+	}
+
+	// Everything that scales with the scene gets its own scene at each size. They're kept alive until the end
+	// since the benchmarks hold on to them.
+	std::vector<Craig::Scene*> scenes;
+	std::vector<std::vector<PerObjectData>> ssbos;
+	ssbos.reserve(std::size(kObjectCounts));
+	std::mt19937 rng(1234);
+
+	for (uint32_t objectCount : kObjectCounts) {
+
+		Craig::Scene* scene = new Craig::Scene;
+		scenes.push_back(scene);
+
+		std::vector<Craig::GameObject*>& gameObjects = scene->getGameObjects();
+		gameObjects.reserve(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			Craig::GameObject* gameObject = new Craig::GameObject;
+			gameObject->init(objectName(i), kModelPaths[i % kModelPaths.size()], scene);
+			gameObject->setPosition(glm::vec3(static_cast<float>(i % 100), static_cast<float>(i / 100 % 100), static_cast<float>(i / 10000)));
+			gameObject->setRotation(glm::vec3(0.0f, static_cast<float>(i % 360), 0.0f));
+			gameObjects.push_back(gameObject);
+		}
+		scene->sortGameObjects();
+		scene->update(0.0f);
+
+		{
+			MicroBench bench;
+			bench.name = "ResourceManager::getModelsUsedBy";
+			bench.opUnit = "object";
+			bench.opsPerIteration = objectCount;
+			bench.objectCount = objectCount;
+			bench.run = [scene](uint32_t iterations) {
+				for (uint32_t i = 0; i < iterations; i++) {
+					g_sink = g_sink + Craig::ResourceManager::getInstance().getModelsUsedBy(scene->getGameObjects()).size();
+				}
+			};
+			benches.push_back(bench);
+		}
+
+		// Moves every object then lets the scene rebuild them, which is GameObject::updateModelMatrix plus the dirty queue
+		{
+			MicroBench bench;
+			bench.name = "GameObject::updateModelMatrix via Scene::update";
+			bench.opUnit = "object";
+			bench.opsPerIteration = objectCount;
+			bench.objectCount = objectCount;
+			bench.run = [scene](uint32_t iterations) {
+				std::vector<Craig::GameObject*>& gameObjects = scene->getGameObjects();
+				for (uint32_t i = 0; i < iterations; i++) {
+					float offset = static_cast<float>(i & 1) * 0.5f;
+					for (Craig::GameObject* gameObject : gameObjects) {
+						glm::vec3 position = gameObject->getPosition();
+						position.x += offset - 0.25f;
+						gameObject->setPosition(position);
+					}
+					scene->update(0.0f);
+				}
+				g_sink = g_sink + static_cast<uintptr_t>(gameObjects.front()->getWorldBoundingSphere().w);
+			};
+			benches.push_back(bench);
+		}
+
+		// Sorting a shuffled list, each iteration gets its own shuffle made outside the timed part
+		{
+			std::shared_ptr<std::vector<std::vector<Craig::GameObject*>>> shuffled = std::make_shared<std::vector<std::vector<Craig::GameObject*>>>();
+
+			MicroBench bench;
+			bench.name = "Utilities::sortGameObjectsByName";
+			bench.opUnit = "object";
+			bench.opsPerIteration = objectCount;
+			bench.objectCount = objectCount;
+			bench.prepare = [scene, shuffled, &rng](uint32_t iterations) {
+				shuffled->resize(iterations);
+				for (std::vector<Craig::GameObject*>& list : *shuffled) {
+					list = scene->getGameObjects();
+					std::shuffle(list.begin(), list.end(), rng);
+				}
+			};
+			bench.run = [shuffled](uint32_t iterations) {
+				for (uint32_t i = 0; i < iterations; i++) {
+					Craig::Utilities::sortGameObjectsByName((*shuffled)[i]);
+				}
+				g_sink = g_sink + reinterpret_cast<uintptr_t>(shuffled->front().front());
+			};
+			benches.push_back(bench);
+		}
+
+		// Looking up names spread evenly over the list, so on average it's half a linear walk
+		{
+			std::vector<std::string> lookups(256);
+			for (std::string& name : lookups) {
+				name = objectName(rng() % objectCount);
+			}
+
+			MicroBench bench;
+			bench.name = "Scene::findObject";
+			bench.opUnit = "lookup";
+			bench.objectCount = objectCount;
+			bench.run = [scene, lookups](uint32_t iterations) {
+				for (uint32_t i = 0; i < iterations; i++) {
+					g_sink = g_sink + reinterpret_cast<uintptr_t>(scene->findObject(lookups[i % lookups.size()]));
+				}
+			};
+			benches.push_back(bench);
+		}
+
+		// Rewriting every object's slot, what the renderer does when the scene's structure changes. This writes to normal
+		// memory rather than the mapped buffer, so it's the CPU side's best case.
+		{
+			ssbos.emplace_back(objectCount);
+			std::vector<PerObjectData>* ssbo = &ssbos.back();
+
+			MicroBench bench;
+			bench.name = "Per-object SSBO write";
+			bench.opUnit = "object";
+			bench.opsPerIteration = objectCount;
+			bench.objectCount = objectCount;
+			bench.run = [scene, ssbo](uint32_t iterations) {
+				std::vector<Craig::GameObject*>& gameObjects = scene->getGameObjects();
+				PerObjectData* dst = ssbo->data();
+				for (uint32_t i = 0; i < iterations; i++) {
+					for (size_t gObj = 0; gObj < gameObjects.size(); gObj++) {
+						dst[gObj].model = gameObjects[gObj]->GetModelMatrix();
+					}
+				}
+				g_sink = g_sink + static_cast<uintptr_t>(dst[gameObjects.size() - 1].model[3][0]);
+			};
+			benches.push_back(bench);
+		}
+	}
+
+	printf("%-56s %9s %14s %14s %14s %9s\n", "benchmark", "objects", "median ns/op", "mean ns/op", "95% CI", "CI %");
+
+	nlohmann::json results;
+	results["build"] = __DATE__ " " __TIME__;
+	results["samples"] = kSamples;
+	results["minSampleMs"] = kMinSampleMs;
+
+	for (const MicroBench& bench : benches) {
+
+		MicroBenchResult result = runMicroBench(bench);
+		double intervalPercent = result.meanNs > 0.0 ? 100.0 * result.ci95Ns / result.meanNs : 0.0;
+
+		printf("%-56s %9u %14.2f %14.2f %14.2f %8.2f%%%s\n", bench.name.c_str(), bench.objectCount,
+			result.medianNs, result.meanNs, result.ci95Ns, intervalPercent, intervalPercent > kNoisyIntervalPercent ? "  (noisy)" : "");
+
+		nlohmann::json json;
+		json["name"] = bench.name;
+		json["objects"] = bench.objectCount;
+		json["opUnit"] = bench.opUnit;
+		json["opsPerIteration"] = bench.opsPerIteration;
+		json["iterationsPerSample"] = result.iterationsPerSample;
+		json["nsPerOp"] = result.medianNs;
+		json["meanNs"] = result.meanNs;
+		json["stdDevNs"] = result.stdDevNs;
+		json["minNs"] = result.minNs;
+		json["maxNs"] = result.maxNs;
+		json["ci95Ns"] = result.ci95Ns;
+		results["benchmarks"].push_back(json);
+	}
+
+	for (Craig::Scene* scene : scenes) {
+		scene->terminate();
+		delete scene;
+	}
+	for (Craig::Model* model : models) {
+		freeModel(*model);
+	}
+
+	std::ofstream file(outputPath, std::ios::trunc);
+	if (!file.is_open()) {
+		printf("Couldn't open %s to write the results\n", outputPath.c_str());
+		return 1;
+	}
+
+	file << results.dump(2);
+	printf("Wrote microbench results to %s\n", outputPath.c_str());
+
+	return 0;
+}
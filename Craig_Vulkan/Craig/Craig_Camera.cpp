@@ -2,6 +2,7 @@
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #define GLM_ENABLE_EXPERIMENTAL
 
+#include <algorithm>
 #include <cmath>
 
 #include "Craig_Camera.hpp"
@@ -21,16 +22,27 @@ void Craig::Camera::update(const float& deltaTime)
     updateProj();
 }
 
+void Craig::Camera::latch()
+{
+    // Position's already been moved on for this frame, only the look direction can have changed since
+    rebuildView();
+}
+
 void Craig::Camera::updateView(const float& deltaTime)
 {
     
     m_position += ((forward() * m_velocity.z) * m_movementSpeed) * deltaTime;
     m_position += ((right() * m_velocity.x) * m_movementSpeed) * deltaTime;
 
+    rebuildView();
+
+}
+
+void Craig::Camera::rebuildView()
+{
     glm::mat4 cameraTranslation = glm::translate(glm::mat4(1.f), m_position);
     glm::mat4 cameraRotation = getRotationMatrix();
     m_view = glm::inverse(cameraTranslation * cameraRotation);
-
 }
 
 void Craig::Camera::updateProj()
@@ -39,6 +51,13 @@ void Craig::Camera::updateProj()
     m_proj[1][1] *= -1.0f; // Vulkan flip
 }
 
+glm::mat4 Craig::Camera::getPaddedProj(float extraFovDegrees) const
+{
+    glm::mat4 proj = glm::perspective(glm::radians(std::min(m_fov + extraFovDegrees, 170.0f)), m_aspect, m_nearPlane, m_farPlane);
+    proj[1][1] *= -1.0f; // Vulkan flip
+    return proj;
+}
+
 void Craig::Camera::panTilt(float pan, float tilt)
 {
     m_pitchYaw.x -= tilt;
@@ -101,6 +120,9 @@ glm::mat4 Craig::Camera::getRotationMatrix()
 
 void Craig::Camera::processSDLEvent(SDL_Event& e) {
 
+    if (!m_inputEnabled) {
+        return;
+    }
 
     if (SDL_GetRelativeMouseMode() == SDL_TRUE) {
         if (e.type == SDL_KEYDOWN) {
@@ -15,6 +15,10 @@ namespace Craig {
         Camera(glm::vec3 pos = glm::vec3(0.0f));
 
         void update(const float& deltaTime);
+        void latch(); // Rebuilds the view from wherever the camera's pointing right now without moving it again
+
+        // Wider field of view than the real one, so culling done before a late latch still covers a bit of extra turn
+        glm::mat4 getPaddedProj(float extraFovDegrees) const;
         void processSDLEvent(SDL_Event& e);
 
         void panTilt(float pan, float tilt);
@@ -38,10 +42,12 @@ namespace Craig {
 
         void setPosition(const glm::vec3& p) { m_position = p; }
         void setPitchYaw(const glm::vec2& py) { m_pitchYaw = py; }
+        void setInputEnabled(bool enabled) { m_inputEnabled = enabled; m_velocity = glm::vec3(0.0f); } // Off while something else is flying it
 
     private:
         void updateView(const float& deltaTime);
         void updateProj();
+        void rebuildView();
 
         glm::vec3 forward() const;
         glm::vec3 right() const;
@@ -50,6 +56,7 @@ namespace Craig {
         glm::vec3 m_position{};
         glm::vec3 m_velocity{};
         glm::vec2 m_pitchYaw{ 0.0f, 0.0f }; // x = pitch, y = yaw
+        bool m_inputEnabled = true;
 
         glm::mat4 m_view;
         glm::mat4 m_proj;
@@ -13,10 +13,91 @@ constexpr char kVK_EngineName[] = "Craig";
 constexpr uint32_t kVK_EngineVersion = 1;
 
 constexpr float kClearColour[4] = { 1.0f, 0.5f, 0.0f, 1.0f }; // Clear colour for the render target
-constexpr int kMaxFramesInFlight = 2; //How many frames the GPU should deal with at a time
+constexpr int kMaxFramesInFlight = 4; //Most frames the GPU can ever deal with at a time, per-frame resources get made for this many
+constexpr uint32_t kDefaultFramesInFlight = 2; //How many it actually deals with unless told otherwise (CRAIG_FRAMES_IN_FLIGHT or the editor)
 
 constexpr uint32_t kMaxLODForDebugging = 16;
-constexpr uint32_t kMaxNumObjects = 4096;
+constexpr uint32_t kInitialObjectCapacity = 1024; // Per-object SSBO starts this big and doubles as the scene grows
+constexpr uint64_t kTransientRingInitialSize = 64 * 1024; // Per-frame transient ring, grows if a frame ever needs more
+constexpr uint32_t kModelDescriptorPoolSize = 64; // Texture sets per pool, another pool gets added when one fills up
+
+constexpr float kDefaultMinPixelSize = 1.0f; // Objects smaller than this on screen get culled
+constexpr uint32_t kCullingParallelThreshold = 16384; // Below this many objects it's not worth waking the culling threads
+
+constexpr uint32_t kMaxDepthPyramidLevels = 16; // 32k x 32k, plenty
+constexpr uint32_t kOcclusionInitialCapacity = 256; // Objects/draws the occlusion buffers start with, they double when we run out
+
+constexpr char kPipelineCachePath[] = "data/pipeline_cache.bin";
+constexpr float kPipelineCacheSaveInterval = 30.0f; // Seconds between pipeline cache saves, on top of the one at shutdown
+
+constexpr uint32_t kResizeSweepFrames = 300; // Frames the scripted resize sweep runs for
+constexpr uint32_t kResizeSweepPeriodFrames = 60; // Frames for one shrink and grow back
+constexpr float kResizeSweepMinScale = 0.5f; // Smallest the window gets during the sweep, relative to where it started
+
+constexpr float kDefaultFrameLimitFps = 144.0f; // Frame limiter target until someone picks another one
+constexpr double kFrameLimiterSleepChunkMs = 1.0; // Frame limiter sleeps in steps this long before spinning the rest
+constexpr uint64_t kFrameLimiterSleepSamples = 1000; // How many sleeps the frame limiter's overshoot estimate averages over
+constexpr uint64_t kPresentWaitTimeoutNs = 100'000'000; // Longest we'll block on vkWaitForPresentKHR before giving up on a frame
+constexpr uint32_t kFrameTimeStatsFrames = 600; // Frames in each frame time variance window
+
+constexpr float kLateLatchCullFovPadding = 5.0f; // Extra degrees of field of view culled for, covers the camera turning between the cull and the late latch
+constexpr uint32_t kInputLatencyWindowFrames = 120; // Frames with input averaged into each input latency report
+
+constexpr uint32_t kGpuProfilerMaxQueries = 64; // Timestamps per frame in flight, two per scope
+constexpr uint32_t kGpuProfilerImmediateQueries = 32; // Timestamps for one-off command buffers (uploads, mip generation)
+constexpr uint32_t kGpuProfilerHistoryFrames = 240; // Samples each GPU scope keeps for its graph and stats
+constexpr char kGpuProfileExportPath[] = "data/gpu_profile.json";
+
+constexpr uint64_t kProfilerEventsPerThread = 1 << 15; // CPU zones each thread keeps before the oldest get overwritten, has to be a power of two
+constexpr char kCpuTracePath[] = "data/cpu_trace.json";
+
+constexpr float kStressSceneDefaultSpacing = 2.0f; // Gap between stress scene objects in the grid layout
+constexpr float kStressSceneDefaultObjectRadius = 0.75f; // Bounding sphere radius every stress scene model gets scaled to
+constexpr uint32_t kStressSceneDefaultClusters = 16; // Clumps in the clustered stress layout
+constexpr float kStressSceneStartDistance = 5.0f; // How far in front of the camera the stress layouts start
+constexpr uint32_t kStressSceneMaxObjects = 1'000'000; // Biggest stress scene the editor and the bench will make
+constexpr uint32_t kEditorMaxListedObjects = 1000; // Scene details only lists this many objects, ImGui can't cope with a stress scene's worth
+
+constexpr char kReplayPath[] = "data/camera_path.crp"; // Where F5 saves a recording and F6 plays it back from
+constexpr char kReplayResultsPath[] = "data/replay_results.json";
+constexpr float kReplayTimestep = 1.0f / 60.0f; // Simulated seconds per frame during playback, whatever the real frame time is
+constexpr uint32_t kReplayFileVersion = 1;
+constexpr uint32_t kReplayMaxFrames = 60 * 60 * 60; // An hour at kReplayTimestep, a replay that says it's longer than that is treated as corrupt
+
+constexpr char kFrameCaptureDirectory[] = "data/captures"; // Where the editor's captures get written
+constexpr uint32_t kFrameCaptureDefaultInterval = 60; // Frames between periodic captures unless the editor says otherwise
+constexpr uint32_t kFrameCaptureMaxQueuedWrites = 4; // PNGs waiting on the writer thread before new captures get dropped
+
+constexpr uint32_t kCounterHistoryFrames = 240; // Frames of render counters kept for the editor's min/avg/max
+constexpr char kCounterStreamPath[] = "data/counters.csv"; // Where the editor streams the render counters to
+
+constexpr char kLogPath[] = "data/craig.log"; // Everything the logger writes to the console goes here too
+constexpr uint32_t kLogRecordBytes = 1024; // Each queued log message, the format arguments and any strings have to fit
+constexpr uint32_t kLogQueueRecords = 1024; // Messages waiting on the logger thread before new ones get dropped, has to be a power of two
+constexpr uint32_t kLogRateLimitPerSecond = 20; // Messages a single log line can print each second, the rest get counted and skipped
+constexpr uint32_t kLogWriterIntervalMs = 2; // How long the logger thread sleeps when there's nothing to write
+
+constexpr char kMemoryReportPath[] = "data/memory.json"; // Where the editor dumps the CPU memory categories to
+
+constexpr uint32_t kFlightRecorderFrames = 4096; // Frames the hitch recorder keeps, about 30 seconds at 144fps
+constexpr uint32_t kFlightRecorderEvents = 1024; // Swapchain rebuilds and allocations it keeps before the oldest get overwritten
+constexpr uint32_t kFlightRecorderGpuScopes = 16; // GPU scopes each recorded frame has room for, any past this don't get kept
+constexpr float kFlightRecorderDefaultHitchMs = 50.0f; // Frames slower than this get dumped, CRAIG_HITCH_MS overrides it
+constexpr float kFlightRecorderWindowSeconds = 5.0f; // How far back from the hitch a dump goes
+constexpr uint32_t kFlightRecorderFramesAfter = 30; // Frames after the hitch that make it into the dump, the GPU times for it land a few frames late
+constexpr uint32_t kFlightRecorderMaxDumps = 32; // Dumps per run, so something that hitches every frame doesn't fill the disk
+constexpr char kFlightRecorderDirectory[] = "data/hitches";
+
+constexpr uint32_t kGpuMemoryStatsIntervalFrames = 30; // Frames between full VMA statistics walks, the budgets get read every frame
+constexpr char kVmaStatsPath[] = "data/vma_stats.json"; // Where the editor dumps vmaBuildStatsString to
+
+constexpr uint32_t kDefragmentBytesPerPass = 16 * 1024 * 1024; // Most VMA will copy in a single pass, there's at most one pass recorded a frame
+constexpr uint32_t kDefragmentAllocationsPerPass = 8; // Most allocations VMA will move in a single pass
+constexpr float kDefragmentAutoFragmentation = 0.5f; // Auto defragmentation kicks in once the free space is this split up (0 to 1)
+constexpr uint32_t kDefragmentAutoMinFreeBytes = 32 * 1024 * 1024; // And only when there's at least this much free inside the blocks
+constexpr uint32_t kDefragmentAutoCooldownFrames = 600; // Frames after a run before auto defragmentation can start another one
+
+constexpr float kGpuTimeSmoothing = 0.05f; // How much each new GPU timestamp sample moves the displayed average
 
 enum CraigError {
 	CRAIG_SUCCESS = 0,
@@ -25,4 +106,5 @@ enum CraigError {
 	CRAIG_FILE_NOT_FOUND = 3,
 	CRAIG_NO_NAME = 4,
 	CRAIG_DUPLICATE_NAME = 5,
+	CRAIG_INVALID_FILE = 6,
 };
@@ -0,0 +1,151 @@
+#include "Craig_Counters.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Craig_Log.hpp"
+
+// Has to be kept in step with the enum. These are what the CSV columns and JSON keys are called, don't rename them.
+static const char* const kCounterNames[] = {
+	"draw_calls",
+	"indirect_draws",
+	"triangles",
+	"pipeline_binds",
+	"descriptor_set_binds",
+	"push_constants",
+	"push_constant_bytes",
+	"vertex_buffer_binds",
+	"index_buffer_binds",
+	"dispatches",
+	"upload_bytes",
+	"transient_bytes",
+	"objects_uploaded",
+	"objects_updated",
+	"objects_cull_tested",
+	"objects_visible",
+	"cpu_allocations",
+	"cpu_allocated_bytes",
+};
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == Craig::Counters::kNumCounters, "Every counter needs a name");
+
+Craig::Counters::ThreadCounters* Craig::Counters::registerThread() {
+
+	std::unique_ptr<ThreadCounters> counters = std::make_unique<ThreadCounters>();
+	ThreadCounters* rawCounters = counters.get();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	mv_threadCounters.push_back(std::move(counters));
+
+	tp_counters = rawCounters;
+	return rawCounters;
+}
+
+const char* Craig::Counters::getName(Counter counter) {
+
+	uint32_t index = static_cast<uint32_t>(counter);
+	return index < kNumCounters ? kCounterNames[index] : "unknown";
+}
+
+void Craig::Counters::endFrame() {
+
+	Values totals{};
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const std::unique_ptr<ThreadCounters>& counters : mv_threadCounters) {
+			for (uint32_t i = 0; i < kNumCounters; i++) {
+				totals[i] += counters->totals[i].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < kNumCounters; i++) {
+		m_lastFrame[i] = totals[i] - m_lastTotals[i];
+	}
+	m_lastTotals = totals;
+
+	mv_history[m_frameIndex % kCounterHistoryFrames] = m_lastFrame;
+	m_frameIndex++;
+
+	if (m_stream.is_open()) {
+		writeStreamRow();
+	}
+}
+
+Craig::Counters::CounterStats Craig::Counters::getStats(Counter counter) const {
+
+	CounterStats stats;
+	uint32_t index = static_cast<uint32_t>(counter);
+	if (m_frameIndex == 0 || index >= kNumCounters) {
+		return stats;
+	}
+
+	size_t frames = static_cast<size_t>(std::min<uint64_t>(m_frameIndex, kCounterHistoryFrames));
+	stats.last = m_lastFrame[index];
+	stats.min = UINT64_MAX;
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < frames; i++) {
+		uint64_t value = mv_history[i][index];
+		stats.min = std::min(stats.min, value);
+		stats.max = std::max(stats.max, value);
+		sum += value;
+	}
+	stats.average = static_cast<double>(sum) / static_cast<double>(frames);
+
+	return stats;
+}
+
+bool Craig::Counters::startStream(const std::string& path) {
+
+	stopStream();
+
+	m_stream.open(path, std::ios::trunc);
+	if (!m_stream.is_open()) {
+		CRAIG_LOG_WARN(eProfiling, "Couldn't open %s to stream the render counters into\n", path.c_str());
+		return false;
+	}
+
+	m_streamPath = path;
+	m_streamFormat = (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) ? StreamFormat::eCsv : StreamFormat::eJsonLines;
+
+	if (m_streamFormat == StreamFormat::eCsv) {
+		m_stream << "frame";
+		for (uint32_t i = 0; i < kNumCounters; i++) {
+			m_stream << ',' << kCounterNames[i];
+		}
+		m_stream << '\n';
+	}
+
+	CRAIG_LOG_INFO(eProfiling, "Streaming render counters to %s\n", path.c_str());
+	return true;
+}
+
+void Craig::Counters::stopStream() {
+
+	if (m_stream.is_open()) {
+		m_stream.close();
+		CRAIG_LOG_INFO(eProfiling, "Stopped streaming render counters to %s\n", m_streamPath.c_str());
+	}
+}
+
+// Goes through the ofstream's own buffer, so most frames don't touch the disk at all
+void Craig::Counters::writeStreamRow() {
+
+	// m_frameIndex has already moved on to the next one
+	uint64_t frame = m_frameIndex - 1;
+
+	if (m_streamFormat == StreamFormat::eCsv) {
+		m_stream << frame;
+		for (uint32_t i = 0; i < kNumCounters; i++) {
+			m_stream << ',' << m_lastFrame[i];
+		}
+		m_stream << '\n';
+	}
+	else {
+		m_stream << "{\"frame\":" << frame;
+		for (uint32_t i = 0; i < kNumCounters; i++) {
+			m_stream << ",\"" << kCounterNames[i] << "\":" << m_lastFrame[i];
+		}
+		m_stream << "}\n";
+	}
+}
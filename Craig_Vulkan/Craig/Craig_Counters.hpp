@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Craig_Constants.hpp"
+
+// Per-frame render statistics. CRAIG_COUNT(eDrawCalls, n) adds n to this frame's draw calls, from any thread.
+// Counting is a thread local lookup and a relaxed store, but in a tight loop it's still worth adding up locally and
+// counting once at the end.
+#define CRAIG_COUNT(counter, amount) Craig::Counters::add(Craig::Counter::counter, static_cast<uint64_t>(amount))
+
+namespace Craig {
+
+	// Append only. The names in Counters::getName end up as CSV columns and JSON keys that dashboards read,
+	// so they never get renamed or reused, a counter that stops meaning anything just stays at 0.
+	enum class Counter : uint32_t {
+		eDrawCalls = 0,         // Direct and indirect
+		eIndirectDraws,         // Whether they draw anything is up to the GPU, so their triangles aren't in eTriangles
+		eTriangles,             // From direct draws
+		ePipelineBinds,
+		eDescriptorSetBinds,
+		ePushConstants,
+		ePushConstantBytes,
+		eVertexBufferBinds,
+		eIndexBufferBinds,
+		eDispatches,
+		eUploadBytes,           // Staging copies into device local memory (model buffers, textures)
+		eTransientBytes,        // Handed out by the per-frame transient ring
+		eObjectsUploaded,       // Transforms written into this frame's SSBO
+		eObjectsUpdated,        // Objects the scene update touched
+		eObjectsCullTested,
+		eObjectsVisible,        // Passed the CPU cull
+		eCpuAllocations,        // Global new on any thread, 0 without memory tracking
+		eCpuAllocatedBytes,
+
+		eCount
+	};
+
+	// Every thread that counts gets its own block of running totals, so counting never takes a lock or shares a
+	// cache line with another thread. endFrame() adds them all up on the main thread and diffs against the last frame's
+	// sums, which gives the frame's numbers without anyone having to reset anything.
+	class Counters {
+
+	public:
+		static constexpr uint32_t kNumCounters = static_cast<uint32_t>(Counter::eCount);
+		using Values = std::array<uint64_t, kNumCounters>;
+
+		struct CounterStats
+		{
+			uint64_t last = 0;
+			uint64_t min = 0;
+			uint64_t max = 0;
+			double   average = 0.0; // Over the frames in the history
+		};
+
+		enum class StreamFormat {
+			eCsv,       // Header row with the names, then a row per frame
+			eJsonLines, // A JSON object per frame, one per line
+		};
+
+		static Counters& getInstance()
+		{
+			static Counters instance; // Guaranteed to be destroyed.
+			return instance;
+		}
+		Counters(Counters const&) = delete;
+		void operator=(Counters const&) = delete;
+
+		static void add(Counter counter, uint64_t amount) {
+			ThreadCounters* counters = tp_counters;
+			if (counters == nullptr) {
+				counters = getInstance().registerThread();
+			}
+
+			// Only the owning thread ever writes these, no need for an atomic add
+			std::atomic<uint64_t>& total = counters->totals[static_cast<uint32_t>(counter)];
+			total.store(total.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		// Called once a frame, after everything that counts towards it is done (worker threads included).
+		// Closes the frame off, adds it to the history and writes it to the stream if there's one open.
+		void endFrame();
+
+		static const char* getName(Counter counter);
+
+		uint64_t getFrameIndex() const { return m_frameIndex; } // Frames ended so far
+		const Values& getLastFrame() const { return m_lastFrame; }
+		const Values& getTotals() const { return m_lastTotals; } // Since startup, as of the last endFrame
+		CounterStats getStats(Counter counter) const; // Over the last kCounterHistoryFrames frames
+
+		// Format's picked from the extension, .csv or anything else for JSON lines. Restarts it if one's already open.
+		bool startStream(const std::string& path);
+		void stopStream();
+		bool isStreaming() const { return m_stream.is_open(); }
+		const std::string& getStreamPath() const { return m_streamPath; }
+
+	private:
+		Counters() {}
+
+		struct alignas(64) ThreadCounters
+		{
+			std::array<std::atomic<uint64_t>, kNumCounters> totals{};
+		};
+
+		ThreadCounters* registerThread();
+		void writeStreamRow();
+
+		static inline thread_local ThreadCounters* tp_counters = nullptr;
+
+		std::mutex                                   m_mutex;
+		std::vector<std::unique_ptr<ThreadCounters>> mv_threadCounters; // Never freed, a thread's counts outlive it
+
+		uint64_t m_frameIndex = 0;
+		Values   m_lastTotals{};
+		Values   m_lastFrame{};
+
+		std::vector<Values> mv_history = std::vector<Values>(kCounterHistoryFrames); // Ring, m_frameIndex % kCounterHistoryFrames is next
+
+		std::ofstream m_stream;
+		std::string   m_streamPath;
+		StreamFormat  m_streamFormat = StreamFormat::eCsv;
+	};
+
+}
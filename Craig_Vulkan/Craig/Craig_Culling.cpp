@@ -0,0 +1,444 @@
+#include "Craig_Culling.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Counters.hpp"
+#include "Craig_Log.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+// The AVX2 kernel is built with the target attribute rather than -mavx2 on the whole file, so nothing else in here
+// (glm's inlines especially, which the linker can share with other files) gets AVX2 in it. Whether it actually runs
+// gets decided once from cpuid, anything older than Haswell takes the scalar path.
+#if defined(CRAIG_CULLING_ENABLE_AVX2) && (defined(__x86_64__) || defined(_M_X64))
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CRAIG_CULLING_AVX2_TARGET
+#else
+#define CRAIG_CULLING_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#define CRAIG_CULLING_AVX2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define CRAIG_CULLING_NEON
+#endif
+
+#if defined(CRAIG_CULLING_AVX2)
+constexpr size_t kCullingSimdWidth = 8; // Scalar fallback uses the same padding, it doesn't care how wide a block is
+#elif defined(CRAIG_CULLING_NEON)
+constexpr size_t kCullingSimdWidth = 4;
+#else
+constexpr size_t kCullingSimdWidth = 4; // Scalar path, but keep the same padding so the layout doesn't change
+#endif
+
+namespace {
+
+#if defined(CRAIG_CULLING_AVX2)
+	bool detectAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+		// AVX2 bit in leaf 7, plus the OS saving the ymm registers (OSXSAVE and XCR0 bits 1 and 2)
+		int info[4] = {};
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		__cpuidex(info, 7, 0);
+		const bool avx2 = (info[1] & (1 << 5)) != 0;
+		return osxsave && avx2 && (_xgetbv(0) & 0x6) == 0x6;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	bool hasAvx2() {
+		static const bool avx2 = detectAvx2();
+		return avx2;
+	}
+#endif
+
+}
+
+CraigError Craig::Culling::init(const CullingInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	if (info.useWorkerThreads) {
+		uint32_t workerCount = info.workerCount;
+		if (workerCount == 0) {
+			// hardware_concurrency can return 0 if it doesn't know, in which case we just stay single threaded
+			uint32_t hwThreads = std::thread::hardware_concurrency();
+			workerCount = hwThreads > 1 ? hwThreads - 1 : 0;
+		}
+
+		mv_workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++) {
+			mv_workers.emplace_back(&Craig::Culling::workerMain, this, i);
+		}
+	}
+
+	mv_chunkStats.resize(mv_workers.size() + 1);
+
+	CRAIG_LOG_INFO(eRenderer, "Culling with the %s path\n", getSimdPathName());
+
+	return ret;
+}
+
+CraigError Craig::Culling::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_shutdown = true;
+	}
+	m_jobCv.notify_all();
+
+	for (std::thread& worker : mv_workers) {
+		worker.join();
+	}
+	mv_workers.clear();
+
+	return ret;
+}
+
+const char* Craig::Culling::getSimdPathName() {
+#if defined(CRAIG_CULLING_AVX2)
+	return hasAvx2() ? "AVX2" : "Scalar (no AVX2)";
+#elif defined(CRAIG_CULLING_NEON)
+	return "NEON";
+#else
+	return "Scalar";
+#endif
+}
+
+// Gribb/Hartmann plane extraction, each plane is a sum/difference of rows of the view-projection matrix.
+// Our camera builds its projection with glm's default -1..1 depth range, so the near plane is row3 + row2.
+// That's also a superset of the 0..1 near plane, so it stays conservative either way.
+Craig::Culling::Frustum Craig::Culling::extractFrustum(const glm::mat4& viewProj) {
+
+	// glm is column major, so m[col][row]
+	auto row = [&viewProj](int r) {
+		return glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+	};
+
+	Frustum frustum;
+	frustum.planes[0] = row(3) + row(0); // Left
+	frustum.planes[1] = row(3) - row(0); // Right
+	frustum.planes[2] = row(3) + row(1); // Bottom (top after the vulkan flip, doesn't matter, we test both)
+	frustum.planes[3] = row(3) - row(1); // Top
+	frustum.planes[4] = row(3) + row(2); // Near
+	frustum.planes[5] = row(3) - row(2); // Far
+
+	for (glm::vec4& plane : frustum.planes) {
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) {
+			plane /= length;
+		}
+	}
+
+	return frustum;
+}
+
+void Craig::Culling::resize(size_t numObjects) {
+
+	m_numObjects = numObjects;
+
+	size_t paddedCount = (numObjects + kCullingSimdWidth - 1) / kCullingSimdWidth * kCullingSimdWidth;
+
+	// Padding lanes are a zero radius sphere at the origin, their results get masked out of the stats
+	mv_centreX.resize(paddedCount, 0.0f);
+	mv_centreY.resize(paddedCount, 0.0f);
+	mv_centreZ.resize(paddedCount, 0.0f);
+	mv_radius.resize(paddedCount, 0.0f);
+	mv_visibility.resize(paddedCount, 1);
+}
+
+void Craig::Culling::setSphere(size_t index, const glm::vec4& sphere) {
+	mv_centreX[index] = sphere.x;
+	mv_centreY[index] = sphere.y;
+	mv_centreZ[index] = sphere.z;
+	mv_radius[index] = sphere.w;
+}
+
+void Craig::Culling::cull(const CullingView& view) {
+
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	m_params.frustum = extractFrustum(view.proj * view.view);
+	m_params.cameraPosition = view.cameraPosition;
+	m_params.pixelScale = std::abs(view.proj[1][1]) * view.viewportHeight; // 2 * (proj[1][1] * height / 2)
+	m_params.minPixelSizeSq = view.minPixelSize * view.minPixelSize;
+
+	// Small scenes aren't worth the wake up cost of the workers
+	const bool goWide = !mv_workers.empty() && m_numObjects >= kCullingParallelThreshold;
+	m_numChunks = goWide ? static_cast<uint32_t>(mv_workers.size()) + 1 : 1;
+
+	if (goWide) {
+		m_chunksRemaining.store(m_numChunks - 1);
+		{
+			std::lock_guard<std::mutex> lock(m_jobMutex);
+			m_jobGeneration++;
+		}
+		m_jobCv.notify_all();
+
+		runChunk(0);
+
+		std::unique_lock<std::mutex> lock(m_jobMutex);
+		m_doneCv.wait(lock, [this] { return m_chunksRemaining.load() == 0; });
+	}
+	else {
+		runChunk(0);
+	}
+
+	m_stats = CullingStats{};
+	m_stats.numTested = static_cast<uint32_t>(m_numObjects);
+	for (uint32_t i = 0; i < m_numChunks; i++) {
+		m_stats.numVisible += mv_chunkStats[i].numVisible;
+		m_stats.numFrustumCulled += mv_chunkStats[i].numFrustumCulled;
+		m_stats.numContributionCulled += mv_chunkStats[i].numContributionCulled;
+	}
+
+	const std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+	m_stats.cullTimeMs = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count() / 1000000.0f;
+}
+
+void Craig::Culling::runChunk(uint32_t chunkIndex) {
+
+	CRAIG_PROFILE_ZONE("Culling::runChunk");
+
+	// Split on SIMD block boundaries so two chunks never write into the same block
+	const size_t numBlocks = mv_radius.size() / kCullingSimdWidth;
+	const size_t firstBlock = numBlocks * chunkIndex / m_numChunks;
+	const size_t lastBlock = numBlocks * (chunkIndex + 1) / m_numChunks;
+
+	mv_chunkStats[chunkIndex] = ChunkStats{};
+	cullRange(firstBlock * kCullingSimdWidth, lastBlock * kCullingSimdWidth, mv_chunkStats[chunkIndex]);
+
+	// Counted from whichever thread ran the chunk, they all get added up at the end of the frame
+	const size_t firstObject = std::min(firstBlock * kCullingSimdWidth, m_numObjects);
+	const size_t lastObject = std::min(lastBlock * kCullingSimdWidth, m_numObjects);
+	CRAIG_COUNT(eObjectsCullTested, lastObject - firstObject);
+	CRAIG_COUNT(eObjectsVisible, mv_chunkStats[chunkIndex].numVisible);
+}
+
+void Craig::Culling::workerMain(uint32_t workerIndex) {
+
+	CRAIG_PROFILE_THREAD_NAME(("Culling worker " + std::to_string(workerIndex)).c_str());
+
+	uint64_t seenGeneration = 0;
+
+	while (true) {
+		std::unique_lock<std::mutex> lock(m_jobMutex);
+		m_jobCv.wait(lock, [this, seenGeneration] { return m_shutdown || m_jobGeneration != seenGeneration; });
+		if (m_shutdown) {
+			return;
+		}
+		seenGeneration = m_jobGeneration;
+		lock.unlock();
+
+		runChunk(workerIndex + 1);
+
+		// Last one out wakes the calling thread. Take the lock so the notify can't slip in before it starts waiting.
+		if (m_chunksRemaining.fetch_sub(1) == 1) {
+			std::lock_guard<std::mutex> doneLock(m_jobMutex);
+			m_doneCv.notify_one();
+		}
+	}
+}
+
+// The actual tests, per object:
+//  - Frustum: the sphere is outside if it's further than its radius behind any of the 6 planes.
+//  - Contribution: projected diameter ~= r * pixelScale / distance. Squared on both sides so there's no sqrt or divide.
+//    If the camera is inside the sphere we always keep it.
+void Craig::Culling::cullRange(size_t begin, size_t end, ChunkStats& outStats) {
+
+#if defined(CRAIG_CULLING_AVX2)
+	if (hasAvx2()) {
+		cullRangeSimd(begin, end, outStats);
+	}
+	else {
+		cullRangeScalar(begin, end, outStats);
+	}
+#elif defined(CRAIG_CULLING_NEON)
+	cullRangeSimd(begin, end, outStats);
+#else
+	cullRangeScalar(begin, end, outStats);
+#endif
+}
+
+// Which lanes of the block starting at i are real objects rather than padding
+uint32_t Craig::Culling::getLaneMask(size_t i) const {
+
+	if (i + kCullingSimdWidth <= m_numObjects) return (1u << kCullingSimdWidth) - 1;
+	if (i >= m_numObjects) return 0;
+	return (1u << (m_numObjects - i)) - 1;
+}
+
+void Craig::Culling::accumulate(ChunkStats& outStats, uint32_t laneMask, uint32_t frustumMask, uint32_t contributionMask) {
+
+	outStats.numVisible += std::popcount(laneMask & frustumMask & contributionMask);
+	outStats.numFrustumCulled += std::popcount(laneMask & ~frustumMask);
+	outStats.numContributionCulled += std::popcount(laneMask & frustumMask & ~contributionMask);
+}
+
+#if defined(CRAIG_CULLING_AVX2)
+CRAIG_CULLING_AVX2_TARGET void Craig::Culling::cullRangeSimd(size_t begin, size_t end, ChunkStats& outStats) {
+
+	const float* centreX = mv_centreX.data();
+	const float* centreY = mv_centreY.data();
+	const float* centreZ = mv_centreZ.data();
+	const float* radius = mv_radius.data();
+	uint8_t* visibility = mv_visibility.data();
+
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(m_params.frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(m_params.frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(m_params.frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(m_params.frustum.planes[p].w);
+	}
+	const __m256 camX = _mm256_set1_ps(m_params.cameraPosition.x);
+	const __m256 camY = _mm256_set1_ps(m_params.cameraPosition.y);
+	const __m256 camZ = _mm256_set1_ps(m_params.cameraPosition.z);
+	const __m256 pixelScale = _mm256_set1_ps(m_params.pixelScale);
+	const __m256 minPixelSizeSq = _mm256_set1_ps(m_params.minPixelSizeSq);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 allOnes = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+	for (size_t i = begin; i < end; i += kCullingSimdWidth) {
+		const __m256 cx = _mm256_loadu_ps(centreX + i);
+		const __m256 cy = _mm256_loadu_ps(centreY + i);
+		const __m256 cz = _mm256_loadu_ps(centreZ + i);
+		const __m256 r = _mm256_loadu_ps(radius + i);
+		const __m256 negR = _mm256_sub_ps(zero, r);
+
+		__m256 inside = allOnes;
+		for (int p = 0; p < 6; p++) {
+			__m256 dist = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negR, _CMP_GE_OQ));
+		}
+
+		const __m256 dx = _mm256_sub_ps(cx, camX);
+		const __m256 dy = _mm256_sub_ps(cy, camY);
+		const __m256 dz = _mm256_sub_ps(cz, camZ);
+		const __m256 distSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		const __m256 projected = _mm256_mul_ps(r, pixelScale);
+		const __m256 bigEnough = _mm256_or_ps(
+			_mm256_cmp_ps(_mm256_mul_ps(projected, projected), _mm256_mul_ps(distSq, minPixelSizeSq), _CMP_GE_OQ),
+			_mm256_cmp_ps(distSq, _mm256_mul_ps(r, r), _CMP_LE_OQ));
+
+		const uint32_t frustumMask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+		const uint32_t contributionMask = static_cast<uint32_t>(_mm256_movemask_ps(bigEnough));
+		const uint32_t visibleMask = frustumMask & contributionMask;
+
+		for (size_t lane = 0; lane < kCullingSimdWidth; lane++) {
+			visibility[i + lane] = static_cast<uint8_t>((visibleMask >> lane) & 1u);
+		}
+		accumulate(outStats, getLaneMask(i), frustumMask, contributionMask);
+	}
+}
+
+#elif defined(CRAIG_CULLING_NEON)
+void Craig::Culling::cullRangeSimd(size_t begin, size_t end, ChunkStats& outStats) {
+
+	const float* centreX = mv_centreX.data();
+	const float* centreY = mv_centreY.data();
+	const float* centreZ = mv_centreZ.data();
+	const float* radius = mv_radius.data();
+	uint8_t* visibility = mv_visibility.data();
+
+	float32x4_t planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = vdupq_n_f32(m_params.frustum.planes[p].x);
+		planeY[p] = vdupq_n_f32(m_params.frustum.planes[p].y);
+		planeZ[p] = vdupq_n_f32(m_params.frustum.planes[p].z);
+		planeW[p] = vdupq_n_f32(m_params.frustum.planes[p].w);
+	}
+	const float32x4_t camX = vdupq_n_f32(m_params.cameraPosition.x);
+	const float32x4_t camY = vdupq_n_f32(m_params.cameraPosition.y);
+	const float32x4_t camZ = vdupq_n_f32(m_params.cameraPosition.z);
+	const float32x4_t pixelScale = vdupq_n_f32(m_params.pixelScale);
+	const float32x4_t minPixelSizeSq = vdupq_n_f32(m_params.minPixelSizeSq);
+
+	// NEON has no movemask, so AND each lane with its bit and add them up
+	const uint32_t laneBitsArray[4] = { 1, 2, 4, 8 };
+	const uint32x4_t laneBits = vld1q_u32(laneBitsArray);
+	auto moveMask = [&laneBits](uint32x4_t mask) -> uint32_t {
+		return vaddvq_u32(vandq_u32(mask, laneBits));
+	};
+
+	for (size_t i = begin; i < end; i += kCullingSimdWidth) {
+		const float32x4_t cx = vld1q_f32(centreX + i);
+		const float32x4_t cy = vld1q_f32(centreY + i);
+		const float32x4_t cz = vld1q_f32(centreZ + i);
+		const float32x4_t r = vld1q_f32(radius + i);
+		const float32x4_t negR = vnegq_f32(r);
+
+		uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+		for (int p = 0; p < 6; p++) {
+			float32x4_t dist = vmlaq_f32(vmlaq_f32(vmlaq_f32(planeW[p], planeX[p], cx), planeY[p], cy), planeZ[p], cz);
+			inside = vandq_u32(inside, vcgeq_f32(dist, negR));
+		}
+
+		const float32x4_t dx = vsubq_f32(cx, camX);
+		const float32x4_t dy = vsubq_f32(cy, camY);
+		const float32x4_t dz = vsubq_f32(cz, camZ);
+		const float32x4_t distSq = vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz);
+		const float32x4_t projected = vmulq_f32(r, pixelScale);
+		const uint32x4_t bigEnough = vorrq_u32(
+			vcgeq_f32(vmulq_f32(projected, projected), vmulq_f32(distSq, minPixelSizeSq)),
+			vcleq_f32(distSq, vmulq_f32(r, r)));
+
+		const uint32_t frustumMask = moveMask(inside);
+		const uint32_t contributionMask = moveMask(bigEnough);
+		const uint32_t visibleMask = frustumMask & contributionMask;
+
+		for (size_t lane = 0; lane < kCullingSimdWidth; lane++) {
+			visibility[i + lane] = static_cast<uint8_t>((visibleMask >> lane) & 1u);
+		}
+		accumulate(outStats, getLaneMask(i), frustumMask, contributionMask);
+	}
+}
+#endif
+
+void Craig::Culling::cullRangeScalar(size_t begin, size_t end, ChunkStats& outStats) {
+
+	const float* centreX = mv_centreX.data();
+	const float* centreY = mv_centreY.data();
+	const float* centreZ = mv_centreZ.data();
+	const float* radius = mv_radius.data();
+	uint8_t* visibility = mv_visibility.data();
+
+	for (size_t i = begin; i < end; i += kCullingSimdWidth) {
+		uint32_t frustumMask = 0;
+		uint32_t contributionMask = 0;
+
+		for (size_t lane = 0; lane < kCullingSimdWidth; lane++) {
+			const size_t idx = i + lane;
+			const glm::vec3 centre(centreX[idx], centreY[idx], centreZ[idx]);
+			const float r = radius[idx];
+
+			bool inside = true;
+			for (const glm::vec4& plane : m_params.frustum.planes) {
+				inside &= glm::dot(glm::vec3(plane), centre) + plane.w >= -r;
+			}
+
+			const glm::vec3 d = centre - m_params.cameraPosition;
+			const float distSq = glm::dot(d, d);
+			const float projected = r * m_params.pixelScale;
+			const bool bigEnough = projected * projected >= distSq * m_params.minPixelSizeSq || distSq <= r * r;
+
+			frustumMask |= (inside ? 1u : 0u) << lane;
+			contributionMask |= (bigEnough ? 1u : 0u) << lane;
+			visibility[idx] = static_cast<uint8_t>(inside && bigEnough);
+		}
+		accumulate(outStats, getLaneMask(i), frustumMask, contributionMask);
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Craig_Constants.hpp"
+
+namespace Craig {
+
+	// CPU side culling. Bounding spheres are stored as structure-of-arrays so we can test
+	// 8 (AVX2) or 4 (NEON) objects at once, and big scenes get split across worker threads. AVX2 gets checked for at
+	// runtime, CPUs without it use the scalar kernel.
+	class Culling {
+
+	public:
+		struct CullingInitInfo
+		{
+			bool     useWorkerThreads = true;
+			uint32_t workerCount = 0; // 0 = one per spare hardware thread
+		};
+
+		// Everything the cull needs to know about the camera this frame
+		struct CullingView
+		{
+			glm::mat4 view;
+			glm::mat4 proj;
+			glm::vec3 cameraPosition;
+			float     viewportHeight = 1.0f;
+			float     minPixelSize = 0.0f; // Objects covering fewer pixels than this get dropped, 0 turns it off
+		};
+
+		struct CullingStats
+		{
+			uint32_t numTested = 0;
+			uint32_t numVisible = 0;
+			uint32_t numFrustumCulled = 0;
+			uint32_t numContributionCulled = 0; // Inside the frustum but too small to bother drawing
+			float    cullTimeMs = 0.0f;
+		};
+
+		// xyz = plane normal (pointing into the frustum), w = distance. Normalised so we can compare against radii.
+		struct Frustum
+		{
+			glm::vec4 planes[6];
+		};
+
+		CraigError init(const CullingInitInfo& info);
+		CraigError terminate();
+
+		static Frustum extractFrustum(const glm::mat4& viewProj);
+		static const char* getSimdPathName(); // The one that actually runs on this CPU
+
+		void resize(size_t numObjects);
+		void setSphere(size_t index, const glm::vec4& sphere); // xyz = centre, w = radius (world space)
+		void cull(const CullingView& view);
+
+		bool isVisible(size_t index) const { return mv_visibility[index] != 0; }
+		const std::vector<uint8_t>& getVisibility() const { return mv_visibility; }
+		const CullingStats& getStats() const { return m_stats; }
+		size_t getNumObjects() const { return m_numObjects; }
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(mv_workers.size()) + 1; }
+
+	private:
+		// Per frame constants, broadcast into SIMD registers by the kernel
+		struct CullParams
+		{
+			Frustum   frustum;
+			glm::vec3 cameraPosition;
+			float     pixelScale;     // radius * pixelScale / distance = projected diameter in pixels
+			float     minPixelSizeSq;
+		};
+
+		struct ChunkStats
+		{
+			uint32_t numVisible = 0;
+			uint32_t numFrustumCulled = 0;
+			uint32_t numContributionCulled = 0;
+		};
+
+		void cullRange(size_t begin, size_t end, ChunkStats& outStats); // Picks the kernel
+		void cullRangeSimd(size_t begin, size_t end, ChunkStats& outStats); // Only exists when there's an AVX2 or NEON build of it
+		void cullRangeScalar(size_t begin, size_t end, ChunkStats& outStats);
+		uint32_t getLaneMask(size_t i) const;
+		static void accumulate(ChunkStats& outStats, uint32_t laneMask, uint32_t frustumMask, uint32_t contributionMask);
+		void runChunk(uint32_t chunkIndex);
+		void workerMain(uint32_t workerIndex);
+
+		// SoA sphere data, padded up to a multiple of the SIMD width so the kernel never needs a scalar tail
+		std::vector<float>   mv_centreX;
+		std::vector<float>   mv_centreY;
+		std::vector<float>   mv_centreZ;
+		std::vector<float>   mv_radius;
+		std::vector<uint8_t> mv_visibility;
+		size_t               m_numObjects = 0;
+
+		CullParams   m_params{};
+		CullingStats m_stats{};
+
+		// Worker threads. Chunk 0 always runs on the calling thread, worker n runs chunk n + 1.
+		std::vector<std::thread> mv_workers;
+		std::vector<ChunkStats>  mv_chunkStats;
+		uint32_t                 m_numChunks = 1;
+
+		std::mutex              m_jobMutex;
+		std::condition_variable m_jobCv;
+		std::condition_variable m_doneCv;
+		uint64_t                m_jobGeneration = 0;
+		std::atomic<uint32_t>   m_chunksRemaining{ 0 };
+		bool                    m_shutdown = false;
+	};
+
+}
@@ -8,6 +8,8 @@
 #include "../External/Imgui/imgui_internal.h"
 #include "../External/Imgui/ImGuizmo/ImGuizmo.h"
 
+#include <algorithm>
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include <glm/glm.hpp>
@@ -17,6 +19,12 @@
 #include "Craig_SceneManager.hpp"
 #include "Craig_GameObject.hpp"
 #include "Craig_Scene.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Counters.hpp"
+#include "Craig_FlightRecorder.hpp"
+#include "Craig_MemoryTracker.hpp"
+#include "Craig_Log.hpp"
+#include "Craig_Replay.hpp"
 
 CraigError Craig::ImguiEditor::editorInit() {
 
@@ -61,6 +69,8 @@ CraigError Craig::ImguiEditor::editorMain(const float& deltaTime) {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_MEMORY_SCOPE(eEditor);
+
 	editorInit();
 
 	showRenderProperties(deltaTime);
@@ -93,10 +103,81 @@ void Craig::ImguiEditor::showRenderProperties(const float& deltaTime) {
 		//ImGui::Text("Frame Time: %f", ImGui::GetIO().Framerate);
 		ImGui::Text("FPS: % .2f", ImGui::GetIO().Framerate);
 		ImGui::Text("Delta Time: %f", deltaTime);
+		if (mp_renderer->getTimeToFirstFrameMs() >= 0.0f) {
+			ImGui::Text("Time to first frame: %.1f ms (%s pipeline cache)", mp_renderer->getTimeToFirstFrameMs(), mp_renderer->getPipelineCacheWarm() ? "warm" : "cold");
+		}
 
 		ImGui::SeparatorText("Video Settings");
-		if (ImGui::Checkbox("VSYNC", &mp_renderer->getVSyncState())) {
-			mp_renderer->refreshSwapChain();
+		const vk::PresentModeKHR currentPresentMode = mp_renderer->getPresentMode();
+		if (ImGui::BeginCombo("Present mode", vk::to_string(currentPresentMode).c_str())) {
+			for (vk::PresentModeKHR presentMode : { vk::PresentModeKHR::eFifo, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate }) {
+				const std::vector<vk::PresentModeKHR>& supported = mp_renderer->getSupportedPresentModes();
+				if (std::find(supported.begin(), supported.end(), presentMode) == supported.end()) {
+					continue;
+				}
+				if (ImGui::Selectable(vk::to_string(presentMode).c_str(), presentMode == currentPresentMode) && presentMode != currentPresentMode) {
+					mp_renderer->setPresentMode(presentMode);
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		int framePacing = static_cast<int>(mp_renderer->getFramePacing());
+		const char* framePacingOptions[] = { "None", "Frame limiter", "Present wait" };
+		if (ImGui::Combo("Frame pacing", &framePacing, framePacingOptions, mp_renderer->isPresentWaitSupported() ? 3 : 2)) {
+			mp_renderer->setFramePacing(static_cast<Renderer::FramePacing>(framePacing));
+		}
+		if (mp_renderer->getFramePacing() == Renderer::FramePacing::eLimiter) {
+			float targetFps = mp_renderer->getFrameLimitFps();
+			if (ImGui::DragFloat("Target FPS", &targetFps, 1.0f, 10.0f, 1000.0f, "%.0f", ImGuiSliderFlags_AlwaysClamp)) {
+				mp_renderer->setFrameLimitFps(targetFps);
+			}
+			ImGui::Text("Sleep overshoot estimate: %.3f ms, last spin: %.3f ms", mp_renderer->getFrameLimiter().getSleepOvershootEstimateMs(), mp_renderer->getFrameLimiter().getLastSpinMs());
+		}
+		if (!mp_renderer->isPresentWaitSupported()) {
+			ImGui::Text("Present wait not supported on this device");
+		}
+
+		const Renderer::FrameTimeStats& frameTimeStats = mp_renderer->getFrameTimeStats();
+		if (frameTimeStats.frames > 0) {
+			ImGui::Text("Frame time avg %.3f / std dev %.3f / p99 %.3f / max %.3f ms", frameTimeStats.averageMs, frameTimeStats.stdDevMs, frameTimeStats.p99Ms, frameTimeStats.maxMs);
+			ImGui::Text("Frame time variance: %.4f ms^2 over %u frames", frameTimeStats.varianceMs, frameTimeStats.frames);
+		}
+		else {
+			ImGui::Text("Measuring frame time variance... %u / %u", mp_renderer->getFrameTimeStatsProgress(), kFrameTimeStatsFrames);
+		}
+
+		ImGui::SeparatorText("Input Latency");
+		ImGui::Checkbox("Late latch camera", &mp_renderer->getLateLatchEnabled());
+		if (mp_renderer->getLateLatchEnabled() && !mp_renderer->isLateLatchActive()) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("(off while occlusion culling is on)");
+		}
+		const Renderer::InputLatencyStats& inputLatency = mp_renderer->getInputLatencyStats();
+		ImGui::Text("Last frame: acquire %.2f / latch %.2f / submit %.2f / present %.2f ms", inputLatency.last.toAcquireMs, inputLatency.last.toLatchMs, inputLatency.last.toSubmitMs, inputLatency.last.toPresentMs);
+		if (inputLatency.samples > 0) {
+			ImGui::Text("Average: acquire %.2f / latch %.2f / submit %.2f / present %.2f ms", inputLatency.average.toAcquireMs, inputLatency.average.toLatchMs, inputLatency.average.toSubmitMs, inputLatency.average.toPresentMs);
+			ImGui::Text("Worst input to present: %.2f ms (over %u frames)", inputLatency.maxToPresentMs, inputLatency.samples);
+		}
+
+		ImGui::SeparatorText("Swapchain");
+		int framesInFlight = static_cast<int>(mp_renderer->getFramesInFlight());
+		if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, kMaxFramesInFlight)) {
+			mp_renderer->setFramesInFlight(static_cast<uint32_t>(framesInFlight));
+		}
+		ImGui::Text("Swapchain images: %u", mp_renderer->getSwapchainImageCount());
+		ImGui::Text("Swapchain rebuilds: %u", mp_renderer->getSwapchainRebuildCount());
+		ImGui::Text("Resize events coalesced: %u", mp_renderer->getResizeEventsCoalesced());
+		if (mp_renderer->isResizeSweepRunning()) {
+			ImGui::Text("Resize sweep running...");
+		}
+		else if (ImGui::Button("Run resize sweep")) {
+			mp_renderer->startResizeSweep();
+		}
+		const Renderer::ResizeSweepResults& sweepResults = mp_renderer->getResizeSweepResults();
+		if (sweepResults.frames > 0) {
+			ImGui::Text("Last sweep: %u frames, %u rebuilds, %u events coalesced", sweepResults.frames, sweepResults.swapchainRebuilds, sweepResults.resizeEventsCoalesced);
+			ImGui::Text("Frame time avg %.2f / p50 %.2f / p95 %.2f / p99 %.2f / max %.2f ms", sweepResults.averageMs, sweepResults.p50Ms, sweepResults.p95Ms, sweepResults.p99Ms, sweepResults.maxMs);
 		}
 		ImGui::SeparatorText("Camera");
 		ImGui::DragFloat3("Cam Pos", glm::value_ptr(mp_camera->getPosition()));
@@ -112,12 +193,417 @@ void Craig::ImguiEditor::showRenderProperties(const float& deltaTime) {
 			mp_renderer->updateMinLOD(m_currentMipLevel);
 		}
 
+		ImGui::SeparatorText("Culling");
+		ImGui::Checkbox("Enable culling", &mp_renderer->getCullingEnabled());
+		ImGui::DragFloat("Min pixel size", &mp_renderer->getMinPixelSize(), 0.1f, 0.0f, 64.0f);
+		const Culling::CullingStats& cullingStats = mp_renderer->getCulling().getStats();
+		ImGui::Text("Visible: %u / %u", cullingStats.numVisible, cullingStats.numTested);
+		ImGui::Text("Frustum culled: %u", cullingStats.numFrustumCulled);
+		ImGui::Text("Too small: %u", cullingStats.numContributionCulled);
+		ImGui::Text("Cull time: %.3f ms (%s, %u threads)", cullingStats.cullTimeMs, Culling::getSimdPathName(), mp_renderer->getCulling().getThreadCount());
+
+		ImGui::Text("Transforms uploaded: %u", mp_renderer->getObjectsUploadedLastFrame());
+
+		ImGui::SeparatorText("Occlusion Culling");
+		const OcclusionCulling& occlusionCulling = mp_renderer->getOcclusionCulling();
+		if (occlusionCulling.isSupported()) {
+			ImGui::Checkbox("Enable occlusion culling", &mp_renderer->getOcclusionCullingEnabled());
+			const OcclusionCulling::OcclusionStats& occlusionStats = occlusionCulling.getStats();
+			ImGui::Text("Tested: %u", occlusionStats.numTested);
+			ImGui::Text("Drawn in phase one: %u", occlusionStats.numDrawnPhaseOne);
+			ImGui::Text("Drawn in phase two: %u", occlusionStats.numDrawnPhaseTwo);
+			ImGui::Text("Occluded: %u", occlusionStats.numOccluded);
+			ImGui::Text("Depth pyramid: %ux%u, %u levels", occlusionCulling.getPyramidExtent().width, occlusionCulling.getPyramidExtent().height, occlusionCulling.getPyramidLevels());
+		}
+		else {
+			ImGui::Text("Not supported on this device");
+		}
+
+		ImGui::SeparatorText("Depth Pre-Pass");
+		ImGui::Checkbox("Enable depth pre-pass", &mp_renderer->getDepthPrePassEnabled());
+		if (mp_renderer->getTimestampsSupported()) {
+			const Renderer::SceneGpuTimes& sceneGpuTimes = mp_renderer->getSceneGpuTimes();
+			ImGui::Text("Scene GPU time with pre-pass: %.3f ms", sceneGpuTimes.withPrePassMs);
+			ImGui::Text("Scene GPU time without pre-pass: %.3f ms", sceneGpuTimes.withoutPrePassMs);
+		}
+		else {
+			ImGui::Text("GPU timestamps not supported on this device");
+		}
+
+		ImGui::SeparatorText("GPU Profiler");
+		const GpuProfiler& gpuProfiler = mp_renderer->getGpuProfiler();
+		if (gpuProfiler.isSupported()) {
+			for (const GpuProfiler::ScopeStats& scope : gpuProfiler.getScopes()) {
+				if (scope.samples == 0) {
+					continue;
+				}
+
+				ImGui::PushID(scope.name.c_str());
+				ImGui::Indent(scope.depth * 10.0f + 1.0f);
+				ImGui::Text("%s: %.3f ms (min %.3f / avg %.3f / p99 %.3f)", scope.name.c_str(), scope.lastMs, scope.minMs, scope.avgMs, scope.p99Ms);
+
+				// Once the ring's full the oldest sample is at the head, before that it's just the first few
+				int count = static_cast<int>(std::min<size_t>(scope.samples, scope.historyMs.size()));
+				int offset = (scope.samples > scope.historyMs.size()) ? static_cast<int>(scope.historyHead) : 0;
+				ImGui::PlotLines("##history", scope.historyMs.data(), count, offset, nullptr, 0.0f, scope.p99Ms * 1.5f + 0.001f, ImVec2(0.0f, 40.0f));
+
+				ImGui::Unindent(scope.depth * 10.0f + 1.0f);
+				ImGui::PopID();
+			}
+
+			if (ImGui::Button("Export GPU profile")) {
+				mp_renderer->exportGpuProfile();
+			}
+			ImGui::SameLine();
+			ImGui::Text("%s", kGpuProfileExportPath);
+		}
+		else {
+			ImGui::Text("GPU timestamps not supported on this device");
+		}
+
+		ImGui::SeparatorText("Pipeline Statistics");
+		const PipelineStatistics& pipelineStatistics = mp_renderer->getPipelineStatistics();
+		if (pipelineStatistics.isSupported()) {
+			// Covers every scene pass in the frame, compute included, but not the editor
+			if (ImGui::BeginTable("##pipelineStatistics", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+				ImGui::TableSetupColumn("Statistic");
+				ImGui::TableSetupColumn("Last");
+				ImGui::TableSetupColumn("Avg");
+				ImGui::TableHeadersRow();
+
+				for (uint32_t i = 0; i < PipelineStatistics::kNumStatistics; i++) {
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", PipelineStatistics::getName(static_cast<PipelineStatistics::Statistic>(i)));
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", static_cast<unsigned long long>(pipelineStatistics.getLast()[i]));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.0f", pipelineStatistics.getAverage()[i]);
+				}
+				ImGui::EndTable();
+			}
+
+			const PipelineStatistics::Values& last = pipelineStatistics.getLast();
+			uint64_t inputVertices = last[static_cast<uint32_t>(PipelineStatistics::Statistic::eInputVertices)];
+			uint64_t vertexInvocations = last[static_cast<uint32_t>(PipelineStatistics::Statistic::eVertexInvocations)];
+			ImGui::Text("Fragments per pixel: %.2f", pipelineStatistics.getFragmentsPerPixel());
+			ImGui::Text("Vertex shader runs per input vertex: %.2f", inputVertices > 0 ? static_cast<double>(vertexInvocations) / static_cast<double>(inputVertices) : 0.0);
+		}
+		else {
+			ImGui::Text("Pipeline statistics queries not supported on this device");
+		}
+
+		ImGui::Checkbox("Overdraw view", &mp_renderer->getOverdrawViewEnabled());
+		if (mp_renderer->getOverdrawViewEnabled()) {
+			ImGui::Text("Layers per pixel, hidden ones included: dark red 1, red 4, yellow 16, white 64+");
+		}
+
+#if defined(CRAIG_PROFILING_ENABLED)
+		ImGui::SeparatorText("CPU Profiler");
+		if (ImGui::Button("Write CPU trace")) {
+			Craig::Profiler::getInstance().writeChromeTrace(kCpuTracePath);
+		}
+		ImGui::SameLine();
+		ImGui::Text("%s (F9)", kCpuTracePath);
+		ImGui::Text("Open it in ui.perfetto.dev or chrome://tracing");
+#endif
+
+		ImGui::SeparatorText("Render Counters");
+		Craig::Counters& counters = Craig::Counters::getInstance();
+		bool streaming = counters.isStreaming();
+		if (ImGui::Checkbox("Stream to", &streaming)) {
+			if (streaming) {
+				counters.startStream(kCounterStreamPath);
+			}
+			else {
+				counters.stopStream();
+			}
+		}
+		ImGui::SameLine();
+		ImGui::Text("%s", kCounterStreamPath);
+
+		// Last frame, then min/avg/max over the last kCounterHistoryFrames
+		if (ImGui::BeginTable("##counters", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+			ImGui::TableSetupColumn("Counter");
+			ImGui::TableSetupColumn("Last");
+			ImGui::TableSetupColumn("Min");
+			ImGui::TableSetupColumn("Avg");
+			ImGui::TableSetupColumn("Max");
+			ImGui::TableHeadersRow();
+
+			for (uint32_t i = 0; i < Craig::Counters::kNumCounters; i++) {
+				Craig::Counter counter = static_cast<Craig::Counter>(i);
+				Craig::Counters::CounterStats stats = counters.getStats(counter);
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", Craig::Counters::getName(counter));
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", static_cast<unsigned long long>(stats.last));
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", static_cast<unsigned long long>(stats.min));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", stats.average);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", static_cast<unsigned long long>(stats.max));
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::SeparatorText("CPU Memory");
+		Craig::MemoryTracker& memoryTracker = Craig::MemoryTracker::getInstance();
+		if (!memoryTracker.isEnabled()) {
+			ImGui::Text("Built without ENABLE_MEMORY_TRACKING");
+		}
+		else {
+			if (ImGui::BeginTable("##memory", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+				ImGui::TableSetupColumn("Category");
+				ImGui::TableSetupColumn("Current (KB)");
+				ImGui::TableSetupColumn("Peak (KB)");
+				ImGui::TableSetupColumn("Live");
+				ImGui::TableSetupColumn("Allocs/frame");
+				ImGui::TableHeadersRow();
+
+				// Every category, then the lot of them added up
+				for (uint32_t i = 0; i <= Craig::MemoryTracker::kNumCategories; i++) {
+					bool total = i == Craig::MemoryTracker::kNumCategories;
+					Craig::MemoryCategory category = static_cast<Craig::MemoryCategory>(i);
+					Craig::MemoryTracker::CategoryStats stats = total ? memoryTracker.getTotals() : memoryTracker.getStats(category);
+
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", total ? "total" : Craig::MemoryTracker::getName(category));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.1f", static_cast<double>(stats.currentBytes) / 1024.0);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.1f", static_cast<double>(stats.peakBytes) / 1024.0);
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", static_cast<unsigned long long>(stats.liveAllocations));
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", static_cast<unsigned long long>(stats.frameAllocations));
+				}
+				ImGui::EndTable();
+			}
+
+			if (ImGui::Button("Reset peaks")) {
+				memoryTracker.resetPeaks();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Write memory report")) {
+				memoryTracker.writeJson(kMemoryReportPath);
+			}
+			ImGui::SameLine();
+			ImGui::Text("%s", kMemoryReportPath);
+		}
+
+		ImGui::SeparatorText("GPU Memory");
+		Craig::GpuMemoryStats& gpuMemoryStats = mp_renderer->getGpuMemoryStats();
+		if (ImGui::BeginTable("##gpuMemory", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+			ImGui::TableSetupColumn("Heap");
+			ImGui::TableSetupColumn("Usage / budget (MB)");
+			ImGui::TableSetupColumn("Blocks (MB)");
+			ImGui::TableSetupColumn("Allocs");
+			ImGui::TableSetupColumn("Largest free (KB)");
+			ImGui::TableSetupColumn("Fragmentation");
+			ImGui::TableHeadersRow();
+
+			// Every heap, then the lot of them added up
+			const std::vector<Craig::GpuMemoryStats::HeapStats>& heaps = gpuMemoryStats.getHeaps();
+			for (size_t i = 0; i <= heaps.size(); i++) {
+				bool total = i == heaps.size();
+				const Craig::GpuMemoryStats::HeapStats& heap = total ? gpuMemoryStats.getTotal() : heaps[i];
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				if (total) {
+					ImGui::Text("total");
+				}
+				else {
+					ImGui::Text("%zu%s", i, heap.deviceLocal ? " (device)" : " (host)");
+				}
+				ImGui::TableNextColumn();
+				double usageMb = static_cast<double>(heap.usageBytes) / (1024.0 * 1024.0);
+				double budgetMb = static_cast<double>(heap.budgetBytes) / (1024.0 * 1024.0);
+				// Red once we're over budget, the driver's allowed to start paging things out at that point
+				if (heap.budgetBytes > 0 && heap.usageBytes > heap.budgetBytes) {
+					ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%.1f / %.1f", usageMb, budgetMb);
+				}
+				else {
+					ImGui::Text("%.1f / %.1f", usageMb, budgetMb);
+				}
+				ImGui::TableNextColumn();
+				ImGui::Text("%u, %.1f", heap.blockCount, static_cast<double>(heap.blockBytes) / (1024.0 * 1024.0));
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", heap.allocationCount);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", static_cast<double>(heap.largestUnusedRange) / 1024.0);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.0f%%", heap.getFragmentation() * 100.0f);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::Text("Budgets %s", gpuMemoryStats.isBudgetFromDriver() ? "from VK_EXT_memory_budget" : "estimated by VMA");
+
+		if (ImGui::Button("Refresh")) {
+			gpuMemoryStats.refresh();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Write VMA stats")) {
+			gpuMemoryStats.writeStatsString(kVmaStatsPath, m_vmaStatsDetailed);
+		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Every allocation", &m_vmaStatsDetailed);
+		ImGui::Text("%s", kVmaStatsPath);
+
+		ImGui::SeparatorText("GPU Defragmentation");
+		Craig::Defragmenter& defragmenter = mp_renderer->getDefragmenter();
+		ImGui::Checkbox("Defragment automatically", &defragmenter.getAutoEnabled());
+		if (defragmenter.isRunning()) {
+			if (ImGui::Button("Stop")) {
+				defragmenter.cancel();
+			}
+			ImGui::SameLine();
+			ImGui::Text("Running, %u passes so far", defragmenter.getReport().passes);
+		}
+		else if (ImGui::Button("Defragment now")) {
+			defragmenter.start();
+		}
+
+		if (defragmenter.hasReport()) {
+			const Craig::Defragmenter::Report& report = defragmenter.getReport();
+			if (ImGui::BeginTable("##defragment", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+				ImGui::TableSetupColumn("##metric");
+				ImGui::TableSetupColumn("Before");
+				ImGui::TableSetupColumn("After");
+				ImGui::TableHeadersRow();
+
+				// The after column stays empty until it's finished
+				auto row = [&](const char* label, const char* format, auto before, auto after) {
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", label);
+					ImGui::TableNextColumn();
+					ImGui::Text(format, before);
+					ImGui::TableNextColumn();
+					if (!defragmenter.isRunning()) {
+						ImGui::Text(format, after);
+					}
+				};
+				row("Blocks", "%u", report.before.blockCount, report.after.blockCount);
+				row("Block MB", "%.1f", static_cast<double>(report.before.blockBytes) / (1024.0 * 1024.0), static_cast<double>(report.after.blockBytes) / (1024.0 * 1024.0));
+				row("Free ranges", "%u", report.before.unusedRangeCount, report.after.unusedRangeCount);
+				row("Largest free (KB)", "%.1f", static_cast<double>(report.before.largestUnusedRange) / 1024.0, static_cast<double>(report.after.largestUnusedRange) / 1024.0);
+				row("Fragmentation", "%.0f%%", report.before.fragmentation * 100.0f, report.after.fragmentation * 100.0f);
+				ImGui::EndTable();
+			}
+			if (!defragmenter.isRunning()) {
+				ImGui::Text("Moved %u allocations (%.1fMB), freed %u blocks (%.1fMB)", report.allocationsMoved, static_cast<double>(report.bytesMoved) / (1024.0 * 1024.0),
+					report.blocksFreed, static_cast<double>(report.bytesFreed) / (1024.0 * 1024.0));
+			}
+			ImGui::Text("%u passes over %u frames, %.2fms recording", report.passes, report.frames, report.totalMs);
+		}
+
+		ImGui::SeparatorText("Hitch Recorder");
+		Craig::FlightRecorder& flightRecorder = Craig::FlightRecorder::getInstance();
+		bool recorderEnabled = flightRecorder.isEnabled();
+		if (ImGui::Checkbox("Record hitches", &recorderEnabled)) {
+			flightRecorder.setEnabled(recorderEnabled);
+		}
+		float hitchThresholdMs = flightRecorder.getHitchThresholdMs();
+		if (ImGui::DragFloat("Hitch threshold (ms)", &hitchThresholdMs, 0.5f, 1.0f, 1000.0f, "%.1f")) {
+			flightRecorder.setHitchThresholdMs(hitchThresholdMs);
+		}
+		ImGui::Text("%u hitches, %u dumps written, %u dropped", flightRecorder.getHitchCount(), flightRecorder.getDumpsWritten(), flightRecorder.getDumpsDropped());
+		if (!flightRecorder.getLastDumpPath().empty()) {
+			ImGui::Text("Last dump: %s", flightRecorder.getLastDumpPath().c_str());
+		}
+		if (ImGui::Button("Dump last few seconds")) {
+			flightRecorder.requestDump();
+		}
+
+		ImGui::SeparatorText("Log");
+		Craig::Log& log = Craig::Log::getInstance();
+		if (ImGui::BeginTable("LogLevels", 2, ImGuiTableFlags_SizingStretchProp)) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(Craig::LogCategory::eCount); i++) {
+				Craig::LogCategory category = static_cast<Craig::LogCategory>(i);
+				ImGui::TableNextRow();
+				ImGui::TableSetColumnIndex(0);
+				ImGui::Text("%s", Craig::Log::getName(category));
+				ImGui::TableSetColumnIndex(1);
+				ImGui::PushID(static_cast<int>(i));
+				ImGui::SetNextItemWidth(-FLT_MIN);
+				if (ImGui::BeginCombo("##Level", Craig::Log::getName(log.getLevel(category)))) {
+					for (uint32_t j = 0; j < static_cast<uint32_t>(Craig::LogLevel::eCount); j++) {
+						Craig::LogLevel level = static_cast<Craig::LogLevel>(j);
+						if (ImGui::Selectable(Craig::Log::getName(level), level == log.getLevel(category))) {
+							log.setLevel(category, level);
+						}
+					}
+					ImGui::EndCombo();
+				}
+				ImGui::PopID();
+			}
+			ImGui::EndTable();
+		}
+		ImGui::Text("%llu messages dropped with the queue full", (unsigned long long)log.getDroppedCount());
+		ImGui::Text("Writing to %s", kLogPath);
+
+		ImGui::SeparatorText("Replay");
+		Craig::Replay& replay = Craig::Replay::getInstance();
+		if (replay.isRecording()) {
+			ImGui::Text("Recording, %zu camera samples", replay.getRecordedSampleCount());
+			if (ImGui::Button("Stop recording")) {
+				replay.stopRecording(kReplayPath);
+			}
+		}
+		else if (replay.isPlaying()) {
+			ImGui::Text("Playing frame %u of %u", replay.getPlaybackFrame(), replay.getPlaybackFrameCount());
+			if (ImGui::Button("Stop playback")) {
+				replay.stopPlayback();
+			}
+		}
+		else {
+			if (ImGui::Button("Record (F5)")) {
+				replay.startRecording();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Play (F6)")) {
+				replay.startPlayback(kReplayPath);
+			}
+		}
+		ImGui::Text("%s", kReplayPath);
+		if (replay.hasFinished()) {
+			ImGui::Text("Last playback: %zu frames, timings in %s", replay.getFrameTimings().size(), kReplayResultsPath);
+		}
+
+		ImGui::SeparatorText("Frame capture");
+		if (ImGui::Button("Capture frame")) {
+			mp_renderer->captureFrameToPng();
+		}
+		ImGui::SameLine();
+		if (ImGui::Checkbox("Every", &m_periodicCapture)) {
+			mp_renderer->setCaptureInterval(m_periodicCapture ? static_cast<uint32_t>(m_captureInterval) : 0);
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(120.0f);
+		if (ImGui::InputInt("frames", &m_captureInterval)) {
+			m_captureInterval = std::max(m_captureInterval, 1);
+			if (m_periodicCapture) {
+				mp_renderer->setCaptureInterval(static_cast<uint32_t>(m_captureInterval));
+			}
+		}
+		ImGui::Text("Saved %u, dropped %u, into %s", mp_renderer->getCapturesSaved(), mp_renderer->getCapturesDropped(), kFrameCaptureDirectory);
+
 		ImGui::SeparatorText("MSAA");
 		if (ImGui::Combo("MSAA level", &m_MSAADropdownIndex, mv_MSAADropdownOptions.data(), mv_MSAADropdownOptions.size())) {
 			ImGui::End();
 			mp_renderer->updateSamplingLevel(m_MSAAEquivalents[m_MSAADropdownIndex]);
 			return;
 		}
+		if (mp_renderer->isSamplingLevelPending()) {
+			ImGui::Text("Compiling pipeline variant...");
+		}
+		ImGui::Text("Pipeline variants compiled: %zu", mp_renderer->getCompiledPipelineVariantCount());
 
 		ImGui::End();
 		
@@ -131,6 +617,11 @@ void Craig::ImguiEditor::showSceneDetails(const float& deltaTime)
 	 	// The ### is for a unique ID, otherwsise the window doesn't stay docked on the right since the name/id changes
 	 	ImGui::Begin("Scene Details###SceneDetails", &m_ShowRendererProperties);
 
+	 	if (ImGui::CollapsingHeader("Stress Scene"))
+	 	{
+	 		showStressSceneGenerator();
+	 	}
+
 	 	if (ImGui::CollapsingHeader("Game Objects", ImGuiTreeNodeFlags_DefaultOpen))
 	 	{
 
@@ -140,8 +631,11 @@ void Craig::ImguiEditor::showSceneDetails(const float& deltaTime)
 
 	 		// Display all properties of game objects in the scene.
 	 		const std::vector<Craig::GameObject*>& gameOjects = mp_sceneManager->getCurrentScene()->getGameObjects();
-	 		for (Craig::GameObject* pGameObject : gameOjects)
+	 		size_t listedObjects = std::min<size_t>(gameOjects.size(), kEditorMaxListedObjects);
+	 		for (size_t objectIndex = 0; objectIndex < listedObjects; objectIndex++)
 	 		{
+	 			Craig::GameObject* pGameObject = gameOjects[objectIndex];
+
 	 			// Separate the list a little for visibility
 	 			ImGui::SeparatorEx(ImGuiSeparatorFlags_Horizontal, 4.0f);
 
@@ -200,6 +694,27 @@ void Craig::ImguiEditor::showSceneDetails(const float& deltaTime)
 	 					break;
 	 				}
 
+	 				// What the Hi-Z cull made of it. Only asked for while a node's open, the rest of the time the GPU doesn't write
+	 				// anything per object and nothing gets read back.
+	 				if (mp_renderer->isOcclusionCullingActive())
+	 				{
+	 					OcclusionCulling& occlusionCulling = mp_renderer->getOcclusionCulling();
+	 					occlusionCulling.requestObjectVisibility();
+	 					const std::vector<uint32_t>& objectVisibility = occlusionCulling.getObjectVisibility();
+	 					const char* visibilityName = "Waiting on the GPU";
+	 					if (objectIndex < objectVisibility.size())
+	 					{
+	 						switch (objectVisibility[objectIndex])
+	 						{
+	 						case OcclusionCulling::eVisible: visibilityName = "Visible"; break;
+	 						case OcclusionCulling::eOccluded: visibilityName = "Occluded"; break;
+	 						case OcclusionCulling::eFrustumCulled: visibilityName = "Frustum culled"; break;
+	 						default: visibilityName = "Unknown"; break;
+	 						}
+	 					}
+	 					ImGui::Text("Occlusion: %s", visibilityName);
+	 				}
+
 	 				// Display the objects attributes
 	 				pGameObject->displayImGuiAttributes();
 
@@ -208,12 +723,82 @@ void Craig::ImguiEditor::showSceneDetails(const float& deltaTime)
 
 	 			ImGui::PopID();
 			}
+
+			if (gameOjects.size() > listedObjects)
+			{
+				ImGui::Text("...and %zu more", gameOjects.size() - listedObjects);
+			}
 		}
 
 		ImGui::End();
 	}
 }
 
+void Craig::ImguiEditor::showStressSceneGenerator()
+{
+	const char* layoutName = Craig::StressScene::getLayoutName(m_stressSettings.layout);
+	if (ImGui::BeginCombo("Layout", layoutName))
+	{
+		for (Craig::StressLayout layout : Craig::StressScene::kLayouts)
+		{
+			if (ImGui::Selectable(Craig::StressScene::getLayoutName(layout), layout == m_stressSettings.layout))
+			{
+				m_stressSettings.layout = layout;
+			}
+		}
+		ImGui::EndCombo();
+	}
+
+	int objectCount = static_cast<int>(m_stressSettings.objectCount);
+	if (ImGui::InputInt("Objects", &objectCount, 100, 10000))
+	{
+		m_stressSettings.objectCount = static_cast<uint32_t>(std::clamp(objectCount, 1, static_cast<int>(kStressSceneMaxObjects)));
+	}
+
+	int seed = static_cast<int>(m_stressSettings.seed);
+	if (ImGui::InputInt("Seed", &seed))
+	{
+		m_stressSettings.seed = static_cast<uint32_t>(seed);
+	}
+
+	ImGui::DragFloat("Spacing", &m_stressSettings.spacing, 0.05f, 0.1f, 100.0f);
+	ImGui::DragFloat("Object Radius", &m_stressSettings.objectRadius, 0.05f, 0.05f, 50.0f);
+
+	if (m_stressSettings.layout == Craig::StressLayout::Clustered)
+	{
+		int clusterCount = static_cast<int>(m_stressSettings.clusterCount);
+		if (ImGui::InputInt("Clusters", &clusterCount))
+		{
+			m_stressSettings.clusterCount = static_cast<uint32_t>(std::max(clusterCount, 1));
+		}
+	}
+
+	for (const std::string& modelPath : m_stressSettings.modelPaths)
+	{
+		ImGui::BulletText("%s", modelPath.c_str());
+	}
+
+	// Swaps out the whole scene, so the selection's about to point at a deleted object
+	if (ImGui::Button("Generate"))
+	{
+		CraigError err = mp_renderer->generateStressScene(m_stressSettings, &m_stressProfile);
+		mp_selectedGameObject = nullptr;
+		m_stressSceneError = (err == CRAIG_SUCCESS) ? "" : (err == CRAIG_FILE_NOT_FOUND ? "Model file not found" : "Couldn't generate the scene");
+	}
+
+	if (!m_stressSceneError.empty())
+	{
+		ImGui::TextColored({ 1.0f, 0.f, 0.f, 1.0f }, "%s", m_stressSceneError.c_str());
+	}
+
+	if (m_stressProfile.instanceCount > 0)
+	{
+		ImGui::Text("%u instances of %u distinct models", m_stressProfile.instanceCount, m_stressProfile.distinctModelCount);
+		ImGui::Text("Submesh draws before culling: %u", m_stressProfile.subMeshInstanceCount);
+		ImGui::Text("Generated in %.1f ms", m_stressProfile.generateMs);
+	}
+}
+
 void Craig::ImguiEditor::renderNewGameObjectWindow()
 {
 	if (m_ShowNewGameObjectWindow)
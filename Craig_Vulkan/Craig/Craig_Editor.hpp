@@ -4,6 +4,8 @@
 #include <vector>
 #include <string>
 
+#include "Craig_StressScene.hpp"
+
 #include "../External/Imgui/imgui.h"
 #include "../External/Imgui/imfilebrowser.h"
 #include "../External/Imgui/ImGuizmo/ImGuizmo.h"
@@ -54,6 +56,11 @@ namespace Craig {
 		std::string m_NewGameObjectError;
 		ImGui::FileBrowser m_modelBrowser;
 
+		void showStressSceneGenerator();
+		Craig::StressSceneSettings m_stressSettings;
+		Craig::StressSceneProfile m_stressProfile; // From the last one generated
+		std::string m_stressSceneError;
+
 		Craig::Renderer* mp_renderer;
 		Craig::SceneManager* mp_sceneManager;
 		Craig::Camera* mp_camera;
@@ -67,6 +74,11 @@ namespace Craig {
 		int m_currentMSAALevel = 0;
 		int m_MSAADropdownIndex = 0;
 
+		bool m_periodicCapture = false;
+
+		bool m_vmaStatsDetailed = true; // Every allocation with its name, not just the totals
+		int  m_captureInterval = kFrameCaptureDefaultInterval;
+
 		std::vector<const char*> mv_MSAADropdownOptions = { "Off", "x2", "x4", "x8", "x16", "x32", "x64" };
 		std::unordered_map<int, int> m_MSAAEquivalents = { {0, 1}, {1, 2}, {2, 4}, {3, 8}, {4, 16}, {5, 32}, {6, 64} };
 		std::unordered_map<int, int> m_MSAAIndexes = { {1, 0}, {2, 1}, {4, 2}, {8, 3}, {16, 4}, {32, 5}, {64, 6} };
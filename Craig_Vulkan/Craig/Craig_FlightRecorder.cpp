@@ -0,0 +1,337 @@
+#include "Craig_FlightRecorder.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "../External/json.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Log.hpp"
+
+// Has to be kept in step with the enum, these end up in the dumps
+static const char* const kFlightEventNames[] = {
+	"swapchain_recreated",
+	"buffer_allocated",
+	"image_allocated",
+	"transient_ring_grown",
+};
+
+Craig::FlightRecorder::FlightRecorder() {
+
+	mv_frames.resize(kFlightRecorderFrames);
+	mv_events.resize(kFlightRecorderEvents);
+	m_current.gpuMs.fill(-1.0f);
+	m_startTime = std::chrono::steady_clock::now();
+
+	// The writer thread logs and uses the profiler, so they have to be made first to be destroyed after us
+	Craig::Log::getInstance();
+#if defined(CRAIG_PROFILING_ENABLED)
+	Craig::Profiler::getInstance();
+#endif
+
+	for (Dump& dump : m_dumps) {
+		dump.frames.reserve(kFlightRecorderFrames);
+		dump.events.reserve(kFlightRecorderEvents);
+		dump.gpuScopeNames.reserve(kFlightRecorderGpuScopes);
+	}
+
+	m_writerThread = std::thread(&FlightRecorder::writerMain, this);
+}
+
+Craig::FlightRecorder::~FlightRecorder() {
+
+	// A dump that's halfway through or queued still gets finished
+	{
+		std::lock_guard<std::mutex> lock(m_writerMutex);
+		m_shutdown = true;
+	}
+	m_writerCv.notify_one();
+
+	if (m_writerThread.joinable()) {
+		m_writerThread.join();
+	}
+}
+
+void Craig::FlightRecorder::recordGpuScope(uint32_t scopeIndex, const std::string& name, float ms, uint32_t framesAgo) {
+
+	if (scopeIndex >= kFlightRecorderGpuScopes) {
+		return;
+	}
+
+	if (scopeIndex >= mv_gpuScopeNames.size()) {
+		mv_gpuScopeNames.resize(scopeIndex + 1);
+	}
+	if (mv_gpuScopeNames[scopeIndex].empty()) {
+		mv_gpuScopeNames[scopeIndex] = name;
+	}
+
+	m_current.gpuMs[scopeIndex] = ms;
+	m_current.gpuFrameLag = framesAgo;
+	m_current.gpuValid = true;
+}
+
+void Craig::FlightRecorder::addEvent(FlightEvent type, const char* what, uint64_t value) {
+
+	// Only we write the count, so there's nothing to race. The release store is what makes the slot visible to
+	// anything that reads the ring after loading the count with acquire.
+	uint64_t index = m_eventCount.load(std::memory_order_relaxed);
+
+	Event& event = mv_events[index % kFlightRecorderEvents];
+	event.frame = m_frameIndex.load(std::memory_order_relaxed);
+	event.type = type;
+	event.what = what;
+	event.value = value;
+	m_eventCount.store(index + 1, std::memory_order_release);
+}
+
+void Craig::FlightRecorder::requestDump() {
+
+	m_dumpPending = true;
+	m_framesUntilDump = 0;
+	m_pendingHitchFrame = m_frameIndex.load(std::memory_order_relaxed);
+	m_pendingHitchMs = 0.0f;
+}
+
+void Craig::FlightRecorder::endFrame() {
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	uint64_t nowTicks = Craig::Profiler::now();
+
+	// Switching it back on shouldn't count the time it was off as one long frame
+	if (!m_enabled || m_firstFrame) {
+		m_firstFrame = !m_enabled;
+		m_lastFrameEnd = now;
+		m_lastFrameTicks = nowTicks;
+		return;
+	}
+
+	uint64_t frame = m_frameIndex.load(std::memory_order_relaxed);
+
+	FrameRecord& record = mv_frames[frame % kFlightRecorderFrames];
+	record = m_current;
+	record.frame = frame;
+	record.timeSeconds = std::chrono::duration<double>(now - m_startTime).count();
+	record.cpuMs = std::chrono::duration<float, std::milli>(now - m_lastFrameEnd).count();
+	record.startTicks = m_lastFrameTicks;
+	record.endTicks = nowTicks;
+	record.counters = Craig::Counters::getInstance().getLastFrame();
+
+	m_current.gpuMs.fill(-1.0f);
+	m_current.gpuValid = false;
+	m_lastFrameEnd = now;
+	m_lastFrameTicks = nowTicks;
+
+	m_frameIndex.store(frame + 1, std::memory_order_relaxed);
+
+	if (record.cpuMs > m_hitchThresholdMs) {
+		m_hitchCount++;
+
+		// Another hitch inside the after frames just ends up in the same dump
+		if (!m_dumpPending) {
+			m_dumpPending = true;
+			m_framesUntilDump = kFlightRecorderFramesAfter;
+			m_pendingHitchFrame = frame;
+			m_pendingHitchMs = record.cpuMs;
+			return;
+		}
+	}
+
+	if (m_dumpPending) {
+		if (m_framesUntilDump == 0) {
+			m_dumpPending = false;
+			startDump();
+		}
+		else {
+			m_framesUntilDump--;
+		}
+	}
+}
+
+// Copies the window out on the main thread into a snapshot that's already got the room for it, everything slow
+// happens on the writer thread
+void Craig::FlightRecorder::startDump() {
+
+	if (m_dumpsStarted >= kFlightRecorderMaxDumps) {
+		m_dumpsDropped++;
+		return;
+	}
+
+	// Whichever snapshot isn't being written or waiting to be. The writer never touches a free one, so it's ours
+	// until we queue it.
+	size_t dumpIndex = m_dumps.size();
+	{
+		std::lock_guard<std::mutex> lock(m_writerMutex);
+		for (size_t i = 0; i < m_dumps.size(); i++) {
+			if (m_dumpStates[i] == DumpState::eFree) {
+				dumpIndex = i;
+				break;
+			}
+		}
+	}
+	if (dumpIndex == m_dumps.size()) {
+		m_dumpsDropped++;
+		return;
+	}
+
+	uint64_t frameCount = m_frameIndex.load(std::memory_order_relaxed);
+	if (frameCount == 0) {
+		return;
+	}
+
+	// The hitch itself could only have been lapped if someone's made the window longer than the ring
+	uint64_t oldestKept = frameCount > kFlightRecorderFrames ? frameCount - kFlightRecorderFrames : 0;
+	uint64_t hitchFrame = std::max(m_pendingHitchFrame, oldestKept);
+	if (hitchFrame >= frameCount) {
+		hitchFrame = frameCount - 1;
+	}
+
+	double windowStart = mv_frames[hitchFrame % kFlightRecorderFrames].timeSeconds - kFlightRecorderWindowSeconds;
+	uint64_t firstFrame = hitchFrame;
+	while (firstFrame > oldestKept && mv_frames[(firstFrame - 1) % kFlightRecorderFrames].timeSeconds >= windowStart) {
+		firstFrame--;
+	}
+
+	Dump& dump = m_dumps[dumpIndex];
+	dump.hitchFrame = hitchFrame;
+	dump.hitchMs = m_pendingHitchMs;
+	dump.thresholdMs = m_hitchThresholdMs;
+	dump.gpuScopeNames = mv_gpuScopeNames;
+
+	dump.frames.clear();
+	for (uint64_t i = firstFrame; i < frameCount; i++) {
+		dump.frames.push_back(mv_frames[i % kFlightRecorderFrames]);
+	}
+
+	dump.events.clear();
+	uint64_t eventCount = m_eventCount.load(std::memory_order_acquire);
+	uint64_t firstEvent = eventCount > kFlightRecorderEvents ? eventCount - kFlightRecorderEvents : 0;
+	for (uint64_t i = firstEvent; i < eventCount; i++) {
+		const Event& event = mv_events[i % kFlightRecorderEvents];
+		if (event.frame >= firstFrame) {
+			dump.events.push_back(event);
+		}
+	}
+
+	snprintf(dump.path, sizeof(dump.path), "%s/hitch_%03u.json", kFlightRecorderDirectory, m_dumpsStarted);
+	dump.tracePath[0] = '\0';
+#if defined(CRAIG_PROFILING_ENABLED)
+	snprintf(dump.tracePath, sizeof(dump.tracePath), "%s/hitch_%03u_cpu_trace.json", kFlightRecorderDirectory, m_dumpsStarted);
+#endif
+
+	m_lastDumpPath = dump.path;
+	m_dumpsStarted++;
+
+	{
+		std::lock_guard<std::mutex> lock(m_writerMutex);
+		m_dumpStates[dumpIndex] = DumpState::eQueued;
+	}
+	m_writerCv.notify_one();
+}
+
+void Craig::FlightRecorder::writerMain() {
+
+	CRAIG_PROFILE_THREAD_NAME("Flight recorder writer");
+
+	// Oldest queued one first, so they get written in the order they happened
+	auto nextQueued = [this]() -> size_t {
+		size_t next = m_dumps.size();
+		for (size_t i = 0; i < m_dumps.size(); i++) {
+			if (m_dumpStates[i] == DumpState::eQueued && (next == m_dumps.size() || m_dumps[i].hitchFrame < m_dumps[next].hitchFrame)) {
+				next = i;
+			}
+		}
+		return next;
+	};
+
+	std::unique_lock<std::mutex> lock(m_writerMutex);
+	while (true) {
+		size_t dumpIndex = m_dumps.size();
+		m_writerCv.wait(lock, [&] {
+			dumpIndex = nextQueued();
+			return m_shutdown || dumpIndex < m_dumps.size();
+		});
+		if (dumpIndex == m_dumps.size()) {
+			return;
+		}
+
+		m_dumpStates[dumpIndex] = DumpState::eWriting;
+		lock.unlock();
+
+		writeDump(m_dumps[dumpIndex]);
+
+		lock.lock();
+		m_dumpStates[dumpIndex] = DumpState::eFree;
+	}
+}
+
+void Craig::FlightRecorder::writeDump(const Dump& dump) {
+
+	std::error_code error;
+	std::filesystem::create_directories(kFlightRecorderDirectory, error);
+
+	nlohmann::json root;
+	root["hitch_frame"] = dump.hitchFrame;
+	root["hitch_ms"] = dump.hitchMs; // 0 when the dump was asked for rather than caused by a hitch
+	root["threshold_ms"] = dump.thresholdMs;
+	root["window_seconds"] = kFlightRecorderWindowSeconds;
+	root["gpu_scopes"] = dump.gpuScopeNames;
+
+	nlohmann::json frames = nlohmann::json::array();
+	for (const FrameRecord& record : dump.frames) {
+		nlohmann::json frame;
+		frame["frame"] = record.frame;
+		frame["time"] = record.timeSeconds;
+		frame["cpu_ms"] = record.cpuMs;
+
+		if (record.gpuValid) {
+			nlohmann::json gpu = nlohmann::json::object();
+			for (size_t i = 0; i < dump.gpuScopeNames.size() && i < kFlightRecorderGpuScopes; i++) {
+				if (record.gpuMs[i] >= 0.0f) {
+					gpu[dump.gpuScopeNames[i]] = record.gpuMs[i];
+				}
+			}
+			frame["gpu_ms"] = std::move(gpu);
+			frame["gpu_frame_lag"] = record.gpuFrameLag;
+		}
+
+		nlohmann::json counters = nlohmann::json::object();
+		for (uint32_t i = 0; i < Craig::Counters::kNumCounters; i++) {
+			counters[Craig::Counters::getName(static_cast<Craig::Counter>(i))] = record.counters[i];
+		}
+		frame["counters"] = std::move(counters);
+
+		frames.push_back(std::move(frame));
+	}
+	root["frames"] = std::move(frames);
+
+	nlohmann::json events = nlohmann::json::array();
+	for (const Event& event : dump.events) {
+		uint32_t type = static_cast<uint32_t>(event.type);
+
+		nlohmann::json entry;
+		entry["frame"] = event.frame;
+		entry["type"] = type < sizeof(kFlightEventNames) / sizeof(kFlightEventNames[0]) ? kFlightEventNames[type] : "unknown";
+		entry["what"] = event.what != nullptr ? event.what : "";
+		entry["value"] = event.value;
+		events.push_back(std::move(entry));
+	}
+	root["events"] = std::move(events);
+
+#if defined(CRAIG_PROFILING_ENABLED)
+	// Just the zones from the frames in the dump, if the profiler's rings still go back that far
+	if (!dump.frames.empty() && Craig::Profiler::getInstance().writeChromeTrace(dump.tracePath, dump.frames.front().startTicks, dump.frames.back().endTicks)) {
+		root["cpu_trace"] = dump.tracePath;
+	}
+#endif
+
+	std::ofstream file(dump.path, std::ios::trunc);
+	if (file.is_open()) {
+		file << root.dump(1, '\t');
+		CRAIG_LOG_INFO(eProfiling, "Wrote %zu frames around frame %llu (%.2fms) to %s\n", dump.frames.size(), (unsigned long long)dump.hitchFrame, dump.hitchMs, dump.path);
+		m_dumpsWritten.fetch_add(1, std::memory_order_relaxed);
+	}
+	else {
+		CRAIG_LOG_WARN(eProfiling, "Couldn't open %s to write the hitch dump\n", dump.path);
+	}
+}
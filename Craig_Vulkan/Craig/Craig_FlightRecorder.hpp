@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Craig_Constants.hpp"
+#include "Craig_Counters.hpp"
+
+namespace Craig {
+
+	// Things worth knowing about when a frame hitches that aren't per-frame numbers
+	enum class FlightEvent : uint32_t {
+		eSwapchainRecreated = 0, // value is width << 32 | height
+		eBufferAllocated,        // value is bytes
+		eImageAllocated,         // value is width << 32 | height
+		eTransientRingGrown,     // value is the new size in bytes
+	};
+
+	// Always on. Every frame drops its CPU time, the GPU scope times and the render counters into a fixed ring, and
+	// anything noteworthy (swapchain rebuilds, allocations) goes into a second ring as it happens. When a frame takes
+	// longer than the hitch threshold we wait kFlightRecorderFramesAfter more frames, then the last
+	// kFlightRecorderWindowSeconds get copied out and written to kFlightRecorderDirectory on a thread of its own.
+	// The per-frame cost is a clock read and copying a couple of hundred bytes, nothing allocates or locks. Events are
+	// the same, only the main thread adds them so the ring's just a slot write and a release store.
+	// Dumps are double buffered: both snapshots get their memory up front, the main thread copies the window into
+	// whichever one the writer thread isn't using and hands it over, so a hitch inside a dump that's still being
+	// written still gets kept.
+	class FlightRecorder {
+
+	public:
+		struct FrameRecord
+		{
+			uint64_t frame = 0;
+			double   timeSeconds = 0.0; // Since the recorder started, at the end of the frame
+			float    cpuMs = 0.0f;      // Wall clock between this frame's endFrame and the last one's
+			uint64_t startTicks = 0;    // Profiler::now(), so the dump can pull out the CPU zones for the same frames
+			uint64_t endTicks = 0;
+			std::array<float, kFlightRecorderGpuScopes> gpuMs{}; // Indexed like the recorder's scope names, negative if it didn't run
+			uint32_t gpuFrameLag = 0;   // How many frames ago the GPU times were recorded, they only come back once the fence has
+			bool     gpuValid = false;
+			Counters::Values counters{};
+		};
+
+		struct Event
+		{
+			uint64_t    frame = 0; // The frame that was in progress when it happened
+			FlightEvent type = FlightEvent::eSwapchainRecreated;
+			const char* what = nullptr; // String literal, only the pointer gets kept
+			uint64_t    value = 0;
+		};
+
+		static FlightRecorder& getInstance()
+		{
+			static FlightRecorder instance; // Guaranteed to be destroyed.
+			return instance;
+		}
+		FlightRecorder(FlightRecorder const&) = delete;
+		void operator=(FlightRecorder const&) = delete;
+
+		// The renderer hands these over once a frame's timestamps come back. scopeIndex has to stay the same for a scope
+		// for the whole run, the GPU profiler's scope indices do.
+		void recordGpuScope(uint32_t scopeIndex, const std::string& name, float ms, uint32_t framesAgo);
+
+		// Main thread only, it's a single producer ring. Everything that calls it (allocations, swapchain rebuilds) is.
+		void addEvent(FlightEvent type, const char* what, uint64_t value);
+
+		// Once a frame on the main thread, after the counters have ended theirs
+		void endFrame();
+
+		void setEnabled(bool enabled) { m_enabled = enabled; }
+		bool isEnabled() const { return m_enabled; }
+		void setHitchThresholdMs(float thresholdMs) { m_hitchThresholdMs = thresholdMs; }
+		float getHitchThresholdMs() const { return m_hitchThresholdMs; }
+
+		void requestDump(); // Dumps the last window at the end of this frame, whether there was a hitch or not
+
+		uint32_t getHitchCount() const { return m_hitchCount; }
+		uint32_t getDumpsWritten() const { return m_dumpsWritten.load(std::memory_order_relaxed); }
+		uint32_t getDumpsDropped() const { return m_dumpsDropped; } // Both snapshots were still busy, or we hit kFlightRecorderMaxDumps
+		const std::string& getLastDumpPath() const { return m_lastDumpPath; } // Empty until the first dump
+
+	private:
+		FlightRecorder();
+		~FlightRecorder();
+
+		enum class DumpState : uint8_t {
+			eFree,
+			eQueued,  // Filled in, waiting for the writer
+			eWriting,
+		};
+
+		// Kept around and reused, the vectors get reserved to the size of the rings so filling one never allocates
+		struct Dump
+		{
+			char                     path[256] = {};
+			char                     tracePath[256] = {};
+			uint64_t                 hitchFrame = 0;
+			float                    hitchMs = 0.0f;
+			float                    thresholdMs = 0.0f;
+			std::vector<FrameRecord> frames;
+			std::vector<Event>       events;
+			std::vector<std::string> gpuScopeNames;
+		};
+
+		void startDump();
+		void writerMain();
+		void writeDump(const Dump& dump); // On the writer thread
+
+		bool  m_enabled = true;
+		float m_hitchThresholdMs = kFlightRecorderDefaultHitchMs;
+
+		std::vector<FrameRecord> mv_frames; // Ring, frame n lives at n % kFlightRecorderFrames
+		std::atomic<uint64_t>    m_frameIndex{ 0 };
+		FrameRecord              m_current; // GPU times collect in here until endFrame
+
+		std::vector<std::string> mv_gpuScopeNames;
+
+		std::vector<Event>    mv_events; // Ring, event n lives at n % kFlightRecorderEvents
+		std::atomic<uint64_t> m_eventCount{ 0 };
+
+		std::chrono::steady_clock::time_point m_startTime;
+		std::chrono::steady_clock::time_point m_lastFrameEnd;
+		uint64_t m_lastFrameTicks = 0;
+		bool     m_firstFrame = true;
+
+		// Hitch waiting for its after frames
+		bool     m_dumpPending = false;
+		uint32_t m_framesUntilDump = 0;
+		uint64_t m_pendingHitchFrame = 0;
+		float    m_pendingHitchMs = 0.0f;
+
+		uint32_t              m_hitchCount = 0;
+		uint32_t              m_dumpsStarted = 0;
+		uint32_t              m_dumpsDropped = 0;
+		std::atomic<uint32_t> m_dumpsWritten{ 0 };
+		std::string           m_lastDumpPath;
+
+		// The writer thread sleeps until a snapshot gets queued. The states are behind the mutex, which only gets taken
+		// around a dump.
+		std::array<Dump, 2>      m_dumps;
+		std::array<DumpState, 2> m_dumpStates{ DumpState::eFree, DumpState::eFree };
+		std::mutex               m_writerMutex;
+		std::condition_variable  m_writerCv;
+		bool                     m_shutdown = false;
+		std::thread             m_writerThread;
+	};
+
+}
@@ -0,0 +1,99 @@
+#include "Craig_FrameLimiter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+CraigError Craig::FrameLimiter::init(const FrameLimiterInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+#if defined(_WIN32)
+	// Windows rounds sleeps up to the timer tick, 15.6ms by default, which would leave the spin doing all the work
+	timeBeginPeriod(1);
+#endif
+
+	setTargetFps(info.targetFps);
+
+	return ret;
+}
+
+void Craig::FrameLimiter::setTargetFps(float targetFps) {
+
+	m_targetFps = std::max(targetFps, 1.0f);
+	m_frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFps));
+	reset();
+}
+
+void Craig::FrameLimiter::wait() {
+
+	Clock::time_point now = Clock::now();
+
+	if (!m_hasDeadline) {
+		m_deadline = now + m_frameDuration;
+		m_hasDeadline = true;
+		return;
+	}
+
+	if (now < m_deadline) {
+		sleepUntil(m_deadline);
+	}
+
+	// Frames go on a fixed schedule so the odd long sleep doesn't push every frame after it back.
+	// If we've fallen more than a frame behind though, start the schedule again from now rather than rushing to catch up.
+	m_deadline += m_frameDuration;
+	now = Clock::now();
+	if (now > m_deadline) {
+		m_deadline = now + m_frameDuration;
+	}
+}
+
+void Craig::FrameLimiter::sleepUntil(Clock::time_point deadline) {
+
+	const std::chrono::duration<double, std::milli> sleepChunk(kFrameLimiterSleepChunkMs);
+
+	while (std::chrono::duration<double>(deadline - Clock::now()).count() > m_sleepEstimateSeconds) {
+
+		Clock::time_point start = Clock::now();
+		std::this_thread::sleep_for(sleepChunk);
+		double observed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		// Capping the count (and decaying the variance to match) turns it into a slow moving average,
+		// so it keeps up if the scheduler changes its mind
+		if (m_sleepCount < kFrameLimiterSleepSamples) {
+			m_sleepCount++;
+		}
+		else {
+			m_sleepM2 *= static_cast<double>(m_sleepCount - 1) / m_sleepCount;
+		}
+		double delta = observed - m_sleepMean;
+		m_sleepMean += delta / m_sleepCount;
+		m_sleepM2 += delta * (observed - m_sleepMean);
+		double stdDev = std::sqrt(std::max(m_sleepM2, 0.0) / std::max<uint64_t>(m_sleepCount - 1, 1));
+		m_sleepEstimateSeconds = m_sleepMean + stdDev;
+	}
+
+	Clock::time_point spinStart = Clock::now();
+	while (Clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+	m_lastSpinMs = std::chrono::duration<float, std::milli>(Clock::now() - spinStart).count();
+}
+
+CraigError Craig::FrameLimiter::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+#if defined(_WIN32)
+	timeEndPeriod(1);
+#endif
+
+	return ret;
+}
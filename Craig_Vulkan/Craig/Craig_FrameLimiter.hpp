@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "Craig_Constants.hpp"
+
+namespace Craig {
+
+	// Caps the frame rate without burning a core. Sleeps in small chunks while there's plenty of time left,
+	// then spins for the last bit, which is about the only way to land within a fraction of a millisecond
+	// since sleep_for can overshoot by a whole scheduler tick.
+	class FrameLimiter {
+
+	public:
+		struct FrameLimiterInitInfo
+		{
+			float targetFps = kDefaultFrameLimitFps;
+		};
+
+		CraigError init(const FrameLimiterInitInfo& info);
+		CraigError terminate();
+
+		// Blocks until a whole frame's worth of time has gone by since the last call
+		void wait();
+
+		// Next wait() doesn't wait, for when we've been doing something else and the schedule's meaningless
+		void reset() { m_hasDeadline = false; }
+
+		void setTargetFps(float targetFps);
+		float getTargetFps() const { return m_targetFps; }
+
+		float getSleepOvershootEstimateMs() const { return static_cast<float>(m_sleepEstimateSeconds * 1000.0); }
+		float getLastSpinMs() const { return m_lastSpinMs; }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		void sleepUntil(Clock::time_point deadline);
+
+		float           m_targetFps = kDefaultFrameLimitFps;
+		Clock::duration m_frameDuration{};
+		Clock::time_point m_deadline;
+		bool            m_hasDeadline = false;
+
+		// Running mean and variance (Welford) of how long a kFrameLimiterSleepChunkMs sleep really takes.
+		// We only sleep while there's more than mean + std dev left, the spin covers the rest.
+		double   m_sleepEstimateSeconds = 5e-3;
+		double   m_sleepMean = 5e-3;
+		double   m_sleepM2 = 0.0;
+		uint64_t m_sleepCount = 1;
+
+		float    m_lastSpinMs = 0.0f;
+	};
+
+}
@@ -9,13 +9,21 @@
 #include "Craig_ResourceManager.hpp"
 #include "Craig_Editor.hpp"
 #include "Craig_SceneManager.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_FlightRecorder.hpp"
+#include "Craig_Log.hpp"
+#include "Craig_Replay.hpp"
+#include "Craig_Scene.hpp"
 
 #include <chrono>
+#include <cstdlib>
 
 CraigError Craig::Framework::init() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_PROFILE_THREAD_NAME("Main");
+
 	//Create our objects and get the pointers we need to initialise later
 	mp_Window = new Craig::Window;
 	mp_SceneManager = new Craig::SceneManager;
@@ -41,6 +49,29 @@ CraigError Craig::Framework::init() {
 	
 
 
+	// Turns every category down (or up) to a level, anything compiled out stays out
+	if (const char* logLevelEnv = std::getenv("CRAIG_LOG_LEVEL")) {
+		Craig::LogLevel level;
+		if (Craig::Log::levelFromName(logLevelEnv, level)) {
+			Craig::Log::getInstance().setLevel(level);
+		}
+		else {
+			CRAIG_LOG_WARN(eGeneral, "CRAIG_LOG_LEVEL should be debug, info, warning or error, not %s", logLevelEnv);
+		}
+	}
+
+	// What counts as a hitch depends on what the build's aiming for, 0 or less switches the recorder off
+	if (const char* hitchMsEnv = std::getenv("CRAIG_HITCH_MS")) {
+		float hitchMs = static_cast<float>(std::atof(hitchMsEnv));
+		Craig::FlightRecorder::getInstance().setHitchThresholdMs(hitchMs);
+		Craig::FlightRecorder::getInstance().setEnabled(hitchMs > 0.0f);
+	}
+
+	// Plays a recording straight away and quits once it's done, for comparing builds from a script
+	if (const char* replayPath = std::getenv("CRAIG_REPLAY")) {
+		m_exitAfterReplay = Craig::Replay::getInstance().startPlayback(replayPath) == CRAIG_SUCCESS;
+	}
+
 	m_LastFrameTime = std::chrono::steady_clock::now();
 
 	return ret;
@@ -51,20 +82,35 @@ CraigError Craig::Framework::update() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
-	const float elapsed = getElapsedTime();
+	CRAIG_PROFILE_ZONE("Framework::update");
 
-	ret = mp_Window->update(elapsed);
+	// Any waiting for the display goes before the input's polled, otherwise the input just sits there getting older
+	mp_Renderer->paceFrame();
+
+	const float wallElapsed = getElapsedTime();
+
+	ret = mp_Window->update(wallElapsed);
 	assert((ret == CRAIG_SUCCESS || ret == CRAIG_CLOSED) && "mp_Window failed to update");
 	if(ret == CRAIG_CLOSED) {
 		return CRAIG_CLOSED; // If the window is closed, we return that code
 	}
 
+	// A replay swaps the real frame time for its fixed step, so it renders the same frames however fast this machine is
+	Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
+	const float elapsed = Craig::Replay::getInstance().beginFrame(wallElapsed, *mp_Renderer, camera);
+
+	if (m_exitAfterReplay && Craig::Replay::getInstance().hasFinished()) {
+		return CRAIG_CLOSED;
+	}
+
 	ret = mp_SceneManager->update(elapsed);
 	assert(ret == CRAIG_SUCCESS && "mp_SceneManager failed to update");
 
 	ret = mp_Renderer->update(elapsed);
 	assert(ret == CRAIG_SUCCESS && "mp_Renderer failed to update");
 
+	Craig::Replay::getInstance().endFrame(camera);
+
 
 	return ret;
 }
@@ -32,6 +32,8 @@ namespace Craig {
 		
 		float getElapsedTime();
 		std::chrono::steady_clock::time_point m_LastFrameTime;
+
+		bool m_exitAfterReplay = false; // Started with CRAIG_REPLAY set
 	};
 
 
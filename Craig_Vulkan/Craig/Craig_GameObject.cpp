@@ -3,6 +3,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/euler_angles.hpp>
+#include <algorithm>
+#include <cmath>
 
 #include "Craig_GameObject.hpp"
 #include "Craig_ResourceManager.hpp"
@@ -19,29 +21,50 @@ CraigError Craig::GameObject::init(std::string name, std::string modelPath, Crai
 	m_name = name;
 	mp_scene = scenePtr;
 	Craig::ResourceManager::getInstance().loadModel(m_modelPath);
+	m_localBoundingSphere = Craig::ResourceManager::getInstance().getModel(m_modelPath).m_boundingSphere;
 
 	mv3_position = { 0.0f, 0.0f, 0.0f };
 	mv3_rotation = { 0.0f, 0.0f, 0.0f };
 	m_rotationQuat = glm::quat(glm::radians(mv3_rotation));
 
+	// Brand new, so it needs its matrix built at least once
+	markTransformDirty();
+
 	return ret;
 }
 
 void Craig::GameObject::setRotation(glm::vec3 rotation) {
 	mv3_rotation = rotation;
 	m_rotationQuat = glm::quat(glm::radians(mv3_rotation));
+	markTransformDirty();
 }
 
 void Craig::GameObject::setRotationQuat(const glm::quat& q) {
 	m_rotationQuat = glm::normalize(q);
 	mv3_rotation = glm::degrees(glm::eulerAngles(m_rotationQuat));
+	markTransformDirty();
+}
+
+// Queues the object up with the scene the first time it's touched, setting the same thing twice in a frame only queues it once
+void Craig::GameObject::markTransformDirty() {
+
+	if (m_transformDirty) {
+		return;
+	}
+
+	m_transformDirty = true;
+	mp_scene->markTransformDirty(this);
 }
 
 CraigError Craig::GameObject::update() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
-	updateModelMatrix();
+	if (m_transformDirty) {
+		updateModelMatrix();
+		m_transformDirty = false;
+		m_transformVersion++;
+	}
 
 	return ret;
 }
@@ -53,6 +76,11 @@ void Craig::GameObject::updateModelMatrix()
 		* glm::mat4_cast(m_rotationQuat)
 		* glm::scale(glm::mat4(1), mv3_scale);
 
+	// Move the bounding sphere with the object. Non-uniform scale stretches the sphere into an ellipsoid,
+	// so take the biggest axis to keep it conservative.
+	glm::vec3 centre = glm::vec3(m_modelMatrix * glm::vec4(glm::vec3(m_localBoundingSphere), 1.0f));
+	float maxScale = std::max({ std::abs(mv3_scale.x), std::abs(mv3_scale.y), std::abs(mv3_scale.z) });
+	m_worldBoundingSphere = glm::vec4(centre, m_localBoundingSphere.w * maxScale);
 }
 
 
@@ -92,7 +120,7 @@ void Craig::GameObject::displayImGuiAttributes()
 			{
 				m_name = tempName;
 				// Update the game object list by sorting into alphabetical order.
-				Utilities::sortGameObjectsByName(mp_scene->getGameObjects());
+				mp_scene->sortGameObjects();
 			}
 		}
 	}
@@ -100,11 +128,16 @@ void Craig::GameObject::displayImGuiAttributes()
 	// Display transform details.
 	if (ImGui::TreeNode("Transform"))
 	{
-		Utilities::displayVectorAttribute("Position", mv3_position);
+		if (Utilities::displayVectorAttribute("Position", mv3_position)) {
+			markTransformDirty();
+		}
 		if (Utilities::displayVectorAttribute("Rotation", mv3_rotation)) {
 			m_rotationQuat = glm::quat(glm::radians(mv3_rotation));
+			markTransformDirty();
+		}
+		if (Utilities::displayVectorAttribute("Scale", mv3_scale)) {
+			markTransformDirty();
 		}
-		Utilities::displayVectorAttribute("Scale", mv3_scale);
 		ImGui::TreePop();
 	};
 
@@ -24,23 +24,32 @@ namespace Craig {
 		CraigError terminate();
 
 		glm::mat4 GetModelMatrix() { return m_modelMatrix; }
+		const glm::vec4& getWorldBoundingSphere() const { return m_worldBoundingSphere; } // xyz = centre, w = radius
 
 		const glm::vec3& getPosition() const { return mv3_position; }
 		const glm::vec3& getRotation() const { return mv3_rotation; }
 		const glm::vec3& getScale() const { return mv3_scale; }
 		const glm::quat& getRotationQuat() const { return m_rotationQuat; }
 
-		void setPosition(glm::vec3 position) { mv3_position = position; };
+		void setPosition(glm::vec3 position) { mv3_position = position; markTransformDirty(); };
 		void setRotation(glm::vec3 rotation);
-		void setScale(glm::vec3 scale)		 { mv3_scale = scale; };
+		void setScale(glm::vec3 scale)		 { mv3_scale = scale; markTransformDirty(); };
 		void setRotationQuat(const glm::quat& q);
 
+		// Bumped every time the model matrix actually gets recomputed, the renderer compares it against what it last uploaded
+		uint64_t getTransformVersion() const { return m_transformVersion; }
+
+		// Where this object sits in the scene's object list, which is also its slot in the per-object SSBO
+		uint32_t getSceneIndex() const { return m_sceneIndex; }
+		void setSceneIndex(uint32_t index) { m_sceneIndex = index; }
+
 		const std::string& getModelPath() const { return m_modelPath; }
 		const std::string& getName() const { return m_name; }
 
 		void displayImGuiAttributes();
 	private:
 		void updateModelMatrix();
+		void markTransformDirty();
 
 		glm::vec3 mv3_position{};
 		glm::vec3 mv3_rotation{};
@@ -50,6 +59,14 @@ namespace Craig {
 		glm::mat4 m_modelMatrix = glm::mat4(1);
 		glm::mat4 m_inverseModelMatrix{};
 
+		glm::vec4 m_localBoundingSphere = glm::vec4(0.0f); // Copied from the model when we load it
+		glm::vec4 m_worldBoundingSphere = glm::vec4(0.0f); // Moved along with the model matrix, what the culling uses
+
+		// Only objects that have been moved get their matrices rebuilt, everything else is left alone
+		bool     m_transformDirty = false;
+		uint64_t m_transformVersion = 0;
+		uint32_t m_sceneIndex = 0;
+
 		std::string m_modelPath;
 		std::string m_name;
 
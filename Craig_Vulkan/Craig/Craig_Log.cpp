@@ -0,0 +1,358 @@
+#include "Craig_Log.hpp"
+
+#include <cstdio>
+
+#include "Craig_Profiler.hpp"
+
+static_assert((kLogQueueRecords & (kLogQueueRecords - 1)) == 0, "kLogQueueRecords has to be a power of two");
+
+static const char* const kLogLevelNames[] = {
+	"debug",
+	"info",
+	"warning",
+	"error",
+};
+static_assert(sizeof(kLogLevelNames) / sizeof(kLogLevelNames[0]) == static_cast<uint32_t>(Craig::LogLevel::eCount), "Every log level needs a name");
+
+static const char* const kLogCategoryNames[] = {
+	"general",
+	"renderer",
+	"device",
+	"swapchain",
+	"pipeline",
+	"resources",
+	"scene",
+	"profiling",
+	"capture",
+	"replay",
+};
+static_assert(sizeof(kLogCategoryNames) / sizeof(kLogCategoryNames[0]) == static_cast<uint32_t>(Craig::LogCategory::eCount), "Every log category needs a name");
+
+static constexpr int64_t kNsPerSecond = 1'000'000'000;
+
+Craig::Log::Log() {
+
+	static_assert(sizeof(Record) == kLogRecordBytes, "Log records should come out at exactly kLogRecordBytes");
+
+	m_startTime = std::chrono::steady_clock::now();
+
+	mv_records = std::vector<Record>(kLogQueueRecords);
+	for (uint32_t i = 0; i < kLogQueueRecords; i++) {
+		mv_records[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// Whatever's been compiled in gets printed unless someone turns it down
+	for (std::atomic<uint8_t>& level : m_categoryLevels) {
+		level.store(static_cast<uint8_t>(LogLevel::eDebug), std::memory_order_relaxed);
+	}
+
+	m_file.open(kLogPath, std::ios::trunc);
+	if (!m_file.is_open()) {
+		fprintf(stderr, "Couldn't open %s, only logging to the console\n", kLogPath);
+	}
+
+	m_writerThread = std::thread(&Log::writerLoop, this);
+}
+
+Craig::Log::~Log() {
+
+	// The writer drains whatever's left before it stops
+	m_stopWriter.store(true, std::memory_order_release);
+	if (m_writerThread.joinable()) {
+		m_writerThread.join();
+	}
+}
+
+const char* Craig::Log::getName(LogLevel level) {
+
+	uint32_t index = static_cast<uint32_t>(level);
+	return index < static_cast<uint32_t>(LogLevel::eCount) ? kLogLevelNames[index] : "unknown";
+}
+
+const char* Craig::Log::getName(LogCategory category) {
+
+	uint32_t index = static_cast<uint32_t>(category);
+	return index < static_cast<uint32_t>(LogCategory::eCount) ? kLogCategoryNames[index] : "unknown";
+}
+
+bool Craig::Log::levelFromName(const char* name, LogLevel& outLevel) {
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(LogLevel::eCount); i++) {
+		if (std::strcmp(name, kLogLevelNames[i]) == 0) {
+			outLevel = static_cast<LogLevel>(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Craig::Log::setLevel(LogLevel level) {
+
+	for (std::atomic<uint8_t>& categoryLevel : m_categoryLevels) {
+		categoryLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+	}
+}
+
+void Craig::Log::setLevel(LogCategory category, LogLevel level) {
+
+	m_categoryLevels[static_cast<uint32_t>(category)].store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+// At most kLogRateLimitPerSecond from one call site a second. Whatever gets skipped is owned up to on the next one
+// that gets through.
+bool Craig::Log::passRateLimit(LogSite& site, int64_t timeNs, uint32_t& outSuppressed) {
+
+	int64_t windowStart = site.windowStartNs.load(std::memory_order_relaxed);
+	if (timeNs - windowStart >= kNsPerSecond) {
+		// Whoever gets here first starts the new second, anyone racing it just counts towards it
+		if (site.windowStartNs.compare_exchange_strong(windowStart, timeNs, std::memory_order_relaxed)) {
+			site.count.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	if (site.count.fetch_add(1, std::memory_order_relaxed) >= kLogRateLimitPerSecond) {
+		site.suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	outSuppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+	return true;
+}
+
+uint16_t Craig::Log::getThreadIndex() {
+
+	if (tp_threadIndex < 0) {
+		tp_threadIndex = s_nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return static_cast<uint16_t>(tp_threadIndex);
+}
+
+Craig::Log::Record* Craig::Log::claimRecord(uint64_t& outPosition) {
+
+	uint64_t position = m_writePosition.load(std::memory_order_relaxed);
+	while (true) {
+		Record& record = mv_records[position & (kLogQueueRecords - 1)];
+		uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+		int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+
+		if (difference == 0) {
+			// Free and nobody else has claimed it yet
+			if (m_writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				outPosition = position;
+				return &record;
+			}
+		}
+		else if (difference < 0) {
+			return nullptr; // Still holds a message from a lap ago, the ring's full
+		}
+		else {
+			position = m_writePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void Craig::Log::publishRecord(Record* record, uint64_t position) {
+
+	record->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Craig::Log::flush() {
+
+	uint64_t target = m_writePosition.load(std::memory_order_acquire);
+	while (m_readPosition.load(std::memory_order_acquire) < target && !m_stopWriter.load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+}
+
+void Craig::Log::writerLoop() {
+
+	CRAIG_PROFILE_THREAD_NAME("Logger");
+
+	std::string line;
+	line.reserve(kLogRecordBytes * 2);
+
+	while (true) {
+		// Checked before draining, so anything published before we were told to stop still gets written
+		bool stopping = m_stopWriter.load(std::memory_order_acquire);
+
+		uint64_t readPosition = m_readPosition.load(std::memory_order_relaxed);
+		bool wroteAny = false;
+
+		while (true) {
+			Record& record = mv_records[readPosition & (kLogQueueRecords - 1)];
+			if (record.sequence.load(std::memory_order_acquire) != readPosition + 1) {
+				break;
+			}
+
+			formatRecord(record, line);
+			writeLine(line, record.level);
+
+			// Hands the slot back for the next lap
+			record.sequence.store(readPosition + kLogQueueRecords, std::memory_order_release);
+			readPosition++;
+			m_readPosition.store(readPosition, std::memory_order_release);
+			wroteAny = true;
+		}
+
+		if (wroteAny) {
+			fflush(stdout);
+			if (m_file.is_open()) {
+				m_file.flush();
+			}
+		}
+
+		if (stopping) {
+			break;
+		}
+
+		if (!wroteAny) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(kLogWriterIntervalMs));
+		}
+	}
+}
+
+// printf's own formatting, one conversion at a time. The length modifiers in the format get thrown away and put back
+// to match what was actually stored, so %d with a uint64_t or %u with a size_t both come out right.
+void Craig::Log::formatRecord(const Record& record, std::string& outLine) const {
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "[%10.3f] [%u] [%s] [%s] ", static_cast<double>(record.timeNs) / static_cast<double>(kNsPerSecond),
+		record.thread, getName(record.level), getName(record.category));
+	outLine = buffer;
+
+	size_t offset = 0;
+	uint32_t argsLeft = record.argCount;
+
+	const char* cursor = record.format;
+	while (*cursor != '\0') {
+		if (*cursor != '%') {
+			outLine += *cursor++;
+			continue;
+		}
+		if (cursor[1] == '%') {
+			outLine += '%';
+			cursor += 2;
+			continue;
+		}
+
+		// Flags, width and precision stay, the length modifiers go
+		char spec[32];
+		size_t specLength = 0;
+		spec[specLength++] = *cursor++;
+		while (*cursor != '\0' && std::strchr("-+ #0123456789.", *cursor) != nullptr) {
+			if (specLength < sizeof(spec) - 4) {
+				spec[specLength++] = *cursor;
+			}
+			cursor++;
+		}
+		while (*cursor != '\0' && std::strchr("hljztL", *cursor) != nullptr) {
+			cursor++;
+		}
+
+		char conversion = *cursor;
+		if (conversion == '\0') {
+			break;
+		}
+		cursor++;
+
+		if (argsLeft == 0) {
+			outLine += "<?>";
+			continue;
+		}
+		argsLeft--;
+
+		ArgType type = static_cast<ArgType>(record.payload[offset++]);
+		bool floatConversion = std::strchr("fFeEgGaA", conversion) != nullptr;
+
+		if (type == ArgType::eString) {
+			uint16_t length = 0;
+			std::memcpy(&length, record.payload + offset, sizeof(length));
+			offset += sizeof(length);
+			std::string_view string(record.payload + offset, length);
+			offset += length;
+
+			if (specLength == 1) {
+				outLine.append(string);
+			}
+			else {
+				spec[specLength++] = 's';
+				spec[specLength] = '\0';
+				std::string copy(string);
+				snprintf(buffer, sizeof(buffer), spec, copy.c_str());
+				outLine += buffer;
+			}
+			continue;
+		}
+
+		if (type == ArgType::ePointer) {
+			const void* pointer = nullptr;
+			std::memcpy(&pointer, record.payload + offset, sizeof(pointer));
+			offset += sizeof(pointer);
+			snprintf(buffer, sizeof(buffer), "%p", pointer);
+			outLine += buffer;
+			continue;
+		}
+
+		// Numbers, whichever way round the format and the argument disagree
+		int64_t signedValue = 0;
+		uint64_t unsignedValue = 0;
+		double doubleValue = 0.0;
+		if (type == ArgType::eDouble) {
+			std::memcpy(&doubleValue, record.payload + offset, sizeof(doubleValue));
+			signedValue = static_cast<int64_t>(doubleValue);
+			unsignedValue = static_cast<uint64_t>(signedValue);
+		}
+		else {
+			std::memcpy(&unsignedValue, record.payload + offset, sizeof(unsignedValue));
+			signedValue = static_cast<int64_t>(unsignedValue);
+			doubleValue = type == ArgType::eSigned ? static_cast<double>(signedValue) : static_cast<double>(unsignedValue);
+		}
+		offset += sizeof(uint64_t);
+
+		if (floatConversion) {
+			spec[specLength++] = conversion;
+			spec[specLength] = '\0';
+			snprintf(buffer, sizeof(buffer), spec, doubleValue);
+		}
+		else if (conversion == 'c') {
+			spec[specLength++] = 'c';
+			spec[specLength] = '\0';
+			snprintf(buffer, sizeof(buffer), spec, static_cast<int>(signedValue));
+		}
+		else {
+			bool isSigned = conversion == 'd' || conversion == 'i';
+			spec[specLength++] = 'l';
+			spec[specLength++] = 'l';
+			spec[specLength++] = std::strchr("diouxX", conversion) != nullptr ? conversion : 'd';
+			spec[specLength] = '\0';
+			if (isSigned) {
+				snprintf(buffer, sizeof(buffer), spec, static_cast<long long>(signedValue));
+			}
+			else {
+				snprintf(buffer, sizeof(buffer), spec, static_cast<unsigned long long>(unsignedValue));
+			}
+		}
+		outLine += buffer;
+	}
+
+	// Everything gets its own line, whether or not the format ended in one
+	while (!outLine.empty() && outLine.back() == '\n') {
+		outLine.pop_back();
+	}
+	if (record.suppressed > 0) {
+		snprintf(buffer, sizeof(buffer), " (%u more from here were rate limited)", record.suppressed);
+		outLine += buffer;
+	}
+	outLine += '\n';
+}
+
+void Craig::Log::writeLine(const std::string& line, LogLevel level) {
+
+	fwrite(line.data(), 1, line.size(), level >= LogLevel::eWarning ? stderr : stdout);
+
+	if (m_file.is_open()) {
+		m_file.write(line.data(), static_cast<std::streamsize>(line.size()));
+	}
+}
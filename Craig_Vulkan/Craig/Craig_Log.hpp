@@ -0,0 +1,269 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Craig_Constants.hpp"
+
+// CRAIG_LOG_INFO(eRenderer, "Frames in flight set to %u", framesInFlight), printf style. The format has to be a string
+// literal, only the pointer gets kept. The arguments get copied into a fixed size record and the formatting happens on
+// the logger's own thread, so the caller never touches stdio. Strings are copied too, so c_str() on a temporary is fine.
+//
+// Levels below CRAIG_LOG_MIN_LEVEL compile to nothing, arguments and all. Release builds strip debug by default.
+#if !defined(CRAIG_LOG_MIN_LEVEL)
+#if defined(NDEBUG)
+#define CRAIG_LOG_MIN_LEVEL 1
+#else
+#define CRAIG_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// Every call site gets its own rate limit, so one noisy line can't drown out the rest
+#define CRAIG_LOG_WRITE(level, category, ...) do { static Craig::LogSite craigLogSite_; Craig::Log::write(level, Craig::LogCategory::category, craigLogSite_, __VA_ARGS__); } while (0)
+
+#if CRAIG_LOG_MIN_LEVEL <= 0
+#define CRAIG_LOG_DEBUG(category, ...) CRAIG_LOG_WRITE(Craig::LogLevel::eDebug, category, __VA_ARGS__)
+#else
+#define CRAIG_LOG_DEBUG(category, ...) do {} while (0)
+#endif
+
+#if CRAIG_LOG_MIN_LEVEL <= 1
+#define CRAIG_LOG_INFO(category, ...) CRAIG_LOG_WRITE(Craig::LogLevel::eInfo, category, __VA_ARGS__)
+#else
+#define CRAIG_LOG_INFO(category, ...) do {} while (0)
+#endif
+
+#if CRAIG_LOG_MIN_LEVEL <= 2
+#define CRAIG_LOG_WARN(category, ...) CRAIG_LOG_WRITE(Craig::LogLevel::eWarning, category, __VA_ARGS__)
+#else
+#define CRAIG_LOG_WARN(category, ...) do {} while (0)
+#endif
+
+#define CRAIG_LOG_ERROR(category, ...) CRAIG_LOG_WRITE(Craig::LogLevel::eError, category, __VA_ARGS__)
+
+namespace Craig {
+
+	enum class LogLevel : uint8_t {
+		eDebug = 0,
+		eInfo,
+		eWarning,
+		eError,
+
+		eCount
+	};
+
+	enum class LogCategory : uint8_t {
+		eGeneral = 0,
+		eRenderer,
+		eDevice,     // Device selection, extensions, the instance and validation
+		eSwapchain,
+		ePipeline,   // Pipelines, shaders and the pipeline cache
+		eResources,  // Model and texture loading
+		eScene,
+		eProfiling,  // CPU/GPU profilers, counters, the hitch recorder and memory tracking
+		eCapture,
+		eReplay,
+
+		eCount
+	};
+
+	// Per call site, made by the macros
+	struct LogSite
+	{
+		std::atomic<int64_t>  windowStartNs{ INT64_MIN };
+		std::atomic<uint32_t> count{ 0 };
+		std::atomic<uint32_t> suppressed{ 0 }; // Dropped by the rate limit since the last one that got through
+	};
+
+	// Callers claim a slot in a fixed ring, fill it in and publish it with a release store, the same per-slot sequence
+	// numbers as Dmitry Vyukov's bounded queue. Nothing locks or allocates. If the ring's full the message is dropped and
+	// counted rather than waiting. One thread drains the ring, formats and writes to the console and kLogPath.
+	class Log {
+
+	public:
+		static Log& getInstance()
+		{
+			static Log instance; // Guaranteed to be destroyed.
+			return instance;
+		}
+		Log(Log const&) = delete;
+		void operator=(Log const&) = delete;
+
+		template <typename... Args>
+		static void write(LogLevel level, LogCategory category, LogSite& site, const char* format, const Args&... args) {
+			Log& log = getInstance();
+			if (static_cast<uint8_t>(level) < log.m_categoryLevels[static_cast<uint32_t>(category)].load(std::memory_order_relaxed)) {
+				return;
+			}
+
+			int64_t timeNs = log.nowNs();
+			uint32_t suppressed = 0;
+			if (!passRateLimit(site, timeNs, suppressed)) {
+				return;
+			}
+
+			uint64_t position = 0;
+			Record* record = log.claimRecord(position);
+			if (record == nullptr) {
+				log.m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			record->timeNs = timeNs;
+			record->format = format;
+			record->suppressed = suppressed;
+			record->thread = getThreadIndex();
+			record->level = level;
+			record->category = category;
+			record->argCount = 0;
+			record->payloadSize = 0;
+			(encode(*record, args), ...);
+
+			log.publishRecord(record, position);
+
+			// Errors are usually the last thing before an exit or a throw, make sure they're out first
+			if (level == LogLevel::eError) {
+				log.flush();
+			}
+		}
+
+		void setLevel(LogLevel level); // Every category
+		void setLevel(LogCategory category, LogLevel level);
+		LogLevel getLevel(LogCategory category) const { return static_cast<LogLevel>(m_categoryLevels[static_cast<uint32_t>(category)].load(std::memory_order_relaxed)); }
+
+		void flush(); // Waits until everything logged so far has been written
+
+		uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); } // The ring was full
+
+		static const char* getName(LogLevel level);
+		static const char* getName(LogCategory category);
+		static bool levelFromName(const char* name, LogLevel& outLevel); // "debug", "info", "warning" or "error"
+
+	private:
+		Log();
+		~Log();
+
+		enum class ArgType : uint8_t {
+			eSigned,
+			eUnsigned,
+			eDouble,
+			eString,
+			ePointer,
+		};
+
+		static constexpr size_t kRecordHeaderBytes = 40;
+
+		struct Record
+		{
+			std::atomic<uint64_t> sequence{ 0 };
+			int64_t     timeNs = 0;
+			const char* format = nullptr;
+			uint32_t    suppressed = 0;
+			uint16_t    thread = 0;
+			LogLevel    level = LogLevel::eInfo;
+			LogCategory category = LogCategory::eGeneral;
+			uint16_t    payloadSize = 0;
+			uint8_t     argCount = 0;
+			char        payload[kLogRecordBytes - kRecordHeaderBytes]; // Each argument is a type byte then its value
+		};
+
+		static bool passRateLimit(LogSite& site, int64_t timeNs, uint32_t& outSuppressed);
+		static uint16_t getThreadIndex();
+
+		int64_t nowNs() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count(); }
+
+		Record* claimRecord(uint64_t& outPosition);
+		void publishRecord(Record* record, uint64_t position);
+
+		static void encodeRaw(Record& record, ArgType type, const void* data, size_t size) {
+			if (record.payloadSize + 1 + size > sizeof(record.payload)) {
+				return; // Doesn't fit, the formatter prints what's missing as <?>
+			}
+			record.payload[record.payloadSize] = static_cast<char>(type);
+			std::memcpy(record.payload + record.payloadSize + 1, data, size);
+			record.payloadSize = static_cast<uint16_t>(record.payloadSize + 1 + size);
+			record.argCount++;
+		}
+
+		static void encodeString(Record& record, std::string_view string) {
+			// A length then the characters, cut short to whatever room is left
+			size_t used = static_cast<size_t>(record.payloadSize) + 1 + sizeof(uint16_t);
+			if (used >= sizeof(record.payload)) {
+				return;
+			}
+			uint16_t length = static_cast<uint16_t>(std::min(string.size(), sizeof(record.payload) - used));
+			record.payload[record.payloadSize] = static_cast<char>(ArgType::eString);
+			std::memcpy(record.payload + record.payloadSize + 1, &length, sizeof(length));
+			std::memcpy(record.payload + used, string.data(), length);
+			record.payloadSize = static_cast<uint16_t>(used + length);
+			record.argCount++;
+		}
+
+		template <typename T>
+		static void encode(Record& record, const T& value) {
+			using Type = std::decay_t<T>;
+			if constexpr (std::is_array_v<T> && std::is_same_v<Type, char*>) {
+				encodeString(record, std::string_view(value));
+			}
+			else if constexpr (std::is_same_v<Type, char*> || std::is_same_v<Type, const char*>) {
+				encodeString(record, value != nullptr ? std::string_view(value) : std::string_view("(null)"));
+			}
+			else if constexpr (std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view>) {
+				encodeString(record, value);
+			}
+			else if constexpr (std::is_floating_point_v<Type>) {
+				double converted = static_cast<double>(value);
+				encodeRaw(record, ArgType::eDouble, &converted, sizeof(converted));
+			}
+			else if constexpr (std::is_enum_v<Type>) {
+				int64_t converted = static_cast<int64_t>(value);
+				encodeRaw(record, ArgType::eSigned, &converted, sizeof(converted));
+			}
+			else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>) {
+				int64_t converted = static_cast<int64_t>(value);
+				encodeRaw(record, ArgType::eSigned, &converted, sizeof(converted));
+			}
+			else if constexpr (std::is_integral_v<Type>) {
+				uint64_t converted = static_cast<uint64_t>(value);
+				encodeRaw(record, ArgType::eUnsigned, &converted, sizeof(converted));
+			}
+			else if constexpr (std::is_pointer_v<Type>) {
+				const void* converted = static_cast<const void*>(value);
+				encodeRaw(record, ArgType::ePointer, &converted, sizeof(converted));
+			}
+			else {
+				static_assert(std::is_pointer_v<Type>, "Log arguments have to be numbers, enums, pointers or strings");
+			}
+		}
+
+		void writerLoop();
+		void formatRecord(const Record& record, std::string& outLine) const;
+		void writeLine(const std::string& line, LogLevel level);
+
+		std::vector<Record>   mv_records; // kLogQueueRecords of them, a power of two
+		std::atomic<uint64_t> m_writePosition{ 0 };
+		std::atomic<uint64_t> m_readPosition{ 0 };  // Only the writer thread moves this
+		std::atomic<uint64_t> m_dropped{ 0 };
+
+		std::array<std::atomic<uint8_t>, static_cast<uint32_t>(LogCategory::eCount)> m_categoryLevels;
+
+		std::chrono::steady_clock::time_point m_startTime;
+
+		std::atomic<bool> m_stopWriter{ false };
+		std::thread       m_writerThread;
+		std::ofstream     m_file;
+
+		static inline std::atomic<uint16_t> s_nextThreadIndex{ 0 };
+		static inline thread_local int32_t  tp_threadIndex = -1;
+	};
+
+}
@@ -0,0 +1,271 @@
+#include "Craig_MemoryTracker.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#include "../External/json.hpp"
+#include "Craig_Counters.hpp"
+#include "Craig_Log.hpp"
+
+// Has to be kept in step with the enum, these are the keys in the JSON dump
+static const char* const kMemoryCategoryNames[] = {
+	"other",
+	"resource_manager",
+	"scene",
+	"renderer",
+	"editor",
+	"imgui",
+};
+static_assert(sizeof(kMemoryCategoryNames) / sizeof(kMemoryCategoryNames[0]) == Craig::MemoryTracker::kNumCategories, "Every memory category needs a name");
+
+std::array<Craig::MemoryTracker::AtomicStats, Craig::MemoryTracker::kNumCategories> Craig::MemoryTracker::s_stats{};
+Craig::MemoryTracker::AtomicStats Craig::MemoryTracker::s_totals{};
+
+namespace {
+	// Sits right in front of the pointer we hand out. base is what malloc gave us, which isn't the same place once
+	// an over-aligned new has had to shuffle the block along.
+	struct alignas(16) BlockHeader
+	{
+		void*    base;
+		uint64_t size;
+		uint32_t category;
+	};
+}
+
+void Craig::MemoryTracker::raisePeak(std::atomic<uint64_t>& peak, uint64_t value) {
+
+	uint64_t current = peak.load(std::memory_order_relaxed);
+	while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+void* Craig::MemoryTracker::allocate(size_t size, size_t alignment, MemoryCategory category) {
+
+	if (alignment < alignof(BlockHeader)) {
+		alignment = alignof(BlockHeader);
+	}
+
+	// The header and alignment padding would wrap a huge size round to a tiny block, so fail it like malloc would
+	if (size > SIZE_MAX - sizeof(BlockHeader) - alignment) {
+		return nullptr;
+	}
+
+	// malloc's always at least 16 aligned, so that's the most we could need to skip to reach the alignment
+	void* base = std::malloc(size + sizeof(BlockHeader) + alignment - alignof(BlockHeader));
+	if (base == nullptr) {
+		return nullptr;
+	}
+
+	uintptr_t user = (reinterpret_cast<uintptr_t>(base) + sizeof(BlockHeader) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	BlockHeader* header = reinterpret_cast<BlockHeader*>(user) - 1;
+	header->base = base;
+	header->size = size;
+	header->category = static_cast<uint32_t>(category);
+
+	AtomicStats& stats = s_stats[header->category];
+	raisePeak(stats.peakBytes, stats.currentBytes.fetch_add(size, std::memory_order_relaxed) + size);
+	stats.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+	stats.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+	stats.totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+	raisePeak(s_totals.peakBytes, s_totals.currentBytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+	return reinterpret_cast<void*>(user);
+}
+
+void Craig::MemoryTracker::release(void* pointer) {
+
+	if (pointer == nullptr) {
+		return;
+	}
+
+	BlockHeader* header = static_cast<BlockHeader*>(pointer) - 1;
+
+	AtomicStats& stats = s_stats[header->category];
+	stats.currentBytes.fetch_sub(header->size, std::memory_order_relaxed);
+	stats.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	s_totals.currentBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+	std::free(header->base);
+}
+
+const char* Craig::MemoryTracker::getName(MemoryCategory category) {
+
+	uint32_t index = static_cast<uint32_t>(category);
+	return index < kNumCategories ? kMemoryCategoryNames[index] : "unknown";
+}
+
+bool Craig::MemoryTracker::isEnabled() const {
+
+#if defined(CRAIG_MEMORY_TRACKING_ENABLED)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Craig::MemoryTracker::endFrame() {
+
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+
+	for (uint32_t i = 0; i < kNumCategories; i++) {
+		uint64_t totalAllocations = s_stats[i].totalAllocations.load(std::memory_order_relaxed);
+		uint64_t totalBytes = s_stats[i].totalBytes.load(std::memory_order_relaxed);
+
+		m_frameAllocations[i] = totalAllocations - m_lastAllocations[i];
+		m_frameBytes[i] = totalBytes - m_lastBytes[i];
+		m_lastAllocations[i] = totalAllocations;
+		m_lastBytes[i] = totalBytes;
+
+		allocations += m_frameAllocations[i];
+		bytes += m_frameBytes[i];
+	}
+
+	CRAIG_COUNT(eCpuAllocations, allocations);
+	CRAIG_COUNT(eCpuAllocatedBytes, bytes);
+}
+
+Craig::MemoryTracker::CategoryStats Craig::MemoryTracker::getStats(MemoryCategory category) const {
+
+	CategoryStats stats;
+	uint32_t index = static_cast<uint32_t>(category);
+	if (index >= kNumCategories) {
+		return stats;
+	}
+
+	const AtomicStats& source = s_stats[index];
+	stats.currentBytes = source.currentBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = source.peakBytes.load(std::memory_order_relaxed);
+	stats.liveAllocations = source.liveAllocations.load(std::memory_order_relaxed);
+	stats.totalAllocations = source.totalAllocations.load(std::memory_order_relaxed);
+	stats.frameAllocations = m_frameAllocations[index];
+	stats.frameBytes = m_frameBytes[index];
+
+	return stats;
+}
+
+Craig::MemoryTracker::CategoryStats Craig::MemoryTracker::getTotals() const {
+
+	CategoryStats totals;
+	for (uint32_t i = 0; i < kNumCategories; i++) {
+		CategoryStats stats = getStats(static_cast<MemoryCategory>(i));
+		totals.liveAllocations += stats.liveAllocations;
+		totals.totalAllocations += stats.totalAllocations;
+		totals.frameAllocations += stats.frameAllocations;
+		totals.frameBytes += stats.frameBytes;
+	}
+
+	totals.currentBytes = s_totals.currentBytes.load(std::memory_order_relaxed);
+	totals.peakBytes = s_totals.peakBytes.load(std::memory_order_relaxed);
+
+	return totals;
+}
+
+void Craig::MemoryTracker::resetPeaks() {
+
+	for (AtomicStats& stats : s_stats) {
+		stats.peakBytes.store(stats.currentBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	s_totals.peakBytes.store(s_totals.currentBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+bool Craig::MemoryTracker::writeJson(const std::string& path) const {
+
+	if (!isEnabled()) {
+		CRAIG_LOG_INFO(eProfiling, "Memory tracking is compiled out of this build, nothing to write\n");
+		return false;
+	}
+
+	auto statsToJson = [](const CategoryStats& stats) {
+		nlohmann::json entry;
+		entry["current_bytes"] = stats.currentBytes;
+		entry["peak_bytes"] = stats.peakBytes;
+		entry["live_allocations"] = stats.liveAllocations;
+		entry["total_allocations"] = stats.totalAllocations;
+		entry["frame_allocations"] = stats.frameAllocations;
+		entry["frame_bytes"] = stats.frameBytes;
+		return entry;
+	};
+
+	nlohmann::json root;
+	for (uint32_t i = 0; i < kNumCategories; i++) {
+		MemoryCategory category = static_cast<MemoryCategory>(i);
+		root["categories"][getName(category)] = statsToJson(getStats(category));
+	}
+	root["total"] = statsToJson(getTotals());
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(eProfiling, "Couldn't open %s to write the memory report\n", path.c_str());
+		return false;
+	}
+
+	file << root.dump(1, '\t');
+	CRAIG_LOG_INFO(eProfiling, "Wrote the memory report to %s\n", path.c_str());
+
+	return true;
+}
+
+#if defined(CRAIG_MEMORY_TRACKING_ENABLED)
+
+// Every form of global new and delete, so nothing slips past with a different signature. The sized and aligned deletes
+// don't need what they're told, the header already knows.
+
+void* operator new(size_t size) {
+	void* pointer = Craig::MemoryTracker::allocate(size, alignof(std::max_align_t));
+	if (pointer == nullptr) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	void* pointer = Craig::MemoryTracker::allocate(size, static_cast<size_t>(alignment));
+	if (pointer == nullptr) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return Craig::MemoryTracker::allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return Craig::MemoryTracker::allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return Craig::MemoryTracker::allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return Craig::MemoryTracker::allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete[](void* pointer) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete(void* pointer, size_t) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { Craig::MemoryTracker::release(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { Craig::MemoryTracker::release(pointer); }
+
+#endif
@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Craig_Constants.hpp"
+
+// CPU heap tracking. CRAIG_MEMORY_SCOPE(eScene) puts every new/delete from that line to the end of the enclosing block
+// on this thread into the scene's numbers, nested scopes win until they end. Anything outside a scope counts as eOther.
+// Without CRAIG_MEMORY_TRACKING_ENABLED (the ENABLE_MEMORY_TRACKING cmake option) global new and delete aren't
+// replaced, the macro's empty and every number stays at 0.
+#if defined(CRAIG_MEMORY_TRACKING_ENABLED)
+#define CRAIG_MEMORY_SCOPE_CONCAT_INNER(a, b) a##b
+#define CRAIG_MEMORY_SCOPE_CONCAT(a, b) CRAIG_MEMORY_SCOPE_CONCAT_INNER(a, b)
+#define CRAIG_MEMORY_SCOPE(category) Craig::MemoryScope CRAIG_MEMORY_SCOPE_CONCAT(craigMemoryScope_, __LINE__)(Craig::MemoryCategory::category)
+#else
+#define CRAIG_MEMORY_SCOPE(category)
+#endif
+
+namespace Craig {
+
+	// The names in MemoryTracker::getName are the keys in the JSON dump, so add new ones on the end
+	enum class MemoryCategory : uint32_t {
+		eOther = 0,       // Not inside any scope, static init and the standard library's own bits mostly
+		eResourceManager, // Model loading, tinygltf's buffers and the SubMesh vectors
+		eScene,           // Game objects and whatever the scene update does
+		eRenderer,
+		eEditor,
+		eImGui,           // ImGui's own allocator, wherever it gets called from
+
+		eCount
+	};
+
+	// Global new and delete go through allocate and release here, which put a small header in front of every block
+	// saying how big it was and which category it was charged to. That way a delete always comes off the category
+	// that paid for it, whichever thread or scope it happens in. The totals are relaxed atomics, nothing locks.
+	class MemoryTracker {
+
+	public:
+		static constexpr uint32_t kNumCategories = static_cast<uint32_t>(MemoryCategory::eCount);
+
+		struct CategoryStats
+		{
+			uint64_t currentBytes = 0;
+			uint64_t peakBytes = 0;         // Since startup or the last resetPeaks
+			uint64_t liveAllocations = 0;
+			uint64_t totalAllocations = 0;
+			uint64_t frameAllocations = 0;  // In the last finished frame
+			uint64_t frameBytes = 0;        // Allocated in the last finished frame, frees don't come off it
+		};
+
+		static MemoryTracker& getInstance()
+		{
+			static MemoryTracker instance; // Guaranteed to be destroyed.
+			return instance;
+		}
+		MemoryTracker(MemoryTracker const&) = delete;
+		void operator=(MemoryTracker const&) = delete;
+
+		// Used by the replaced global new/delete and ImGui's allocator hooks
+		static void* allocate(size_t size, size_t alignment, MemoryCategory category);
+		static void* allocate(size_t size, size_t alignment) { return allocate(size, alignment, tp_category); }
+		static void release(void* pointer);
+
+		static MemoryCategory getThreadCategory() { return tp_category; }
+		static void setThreadCategory(MemoryCategory category) { tp_category = category; }
+
+		// Once a frame on the main thread, before the counters end theirs so the allocation counts make it in
+		void endFrame();
+
+		CategoryStats getStats(MemoryCategory category) const;
+		CategoryStats getTotals() const; // Every category added up, the peak is the peak of the total
+		void resetPeaks();
+
+		bool isEnabled() const; // Whether new and delete actually got replaced in this build
+		bool writeJson(const std::string& path) const;
+
+		static const char* getName(MemoryCategory category);
+
+	private:
+		MemoryTracker() = default;
+
+		struct alignas(64) AtomicStats
+		{
+			std::atomic<uint64_t> currentBytes{ 0 };
+			std::atomic<uint64_t> peakBytes{ 0 };
+			std::atomic<uint64_t> liveAllocations{ 0 };
+			std::atomic<uint64_t> totalAllocations{ 0 };
+			std::atomic<uint64_t> totalBytes{ 0 };
+		};
+
+		static void raisePeak(std::atomic<uint64_t>& peak, uint64_t value);
+
+		// Plain statics rather than members, new gets called before main and before getInstance() has made anything.
+		// Everything in them is constexpr constructible, so they're set up before any code runs at all.
+		static std::array<AtomicStats, kNumCategories> s_stats;
+		static AtomicStats s_totals;
+		static inline thread_local MemoryCategory tp_category = MemoryCategory::eOther;
+
+		std::array<uint64_t, kNumCategories> m_lastAllocations{};
+		std::array<uint64_t, kNumCategories> m_lastBytes{};
+		std::array<uint64_t, kNumCategories> m_frameAllocations{};
+		std::array<uint64_t, kNumCategories> m_frameBytes{};
+	};
+
+	// Charges everything allocated on this thread to a category until it goes out of scope. Use CRAIG_MEMORY_SCOPE.
+	class MemoryScope {
+
+	public:
+		explicit MemoryScope(MemoryCategory category) : m_previous(MemoryTracker::getThreadCategory()) { MemoryTracker::setThreadCategory(category); }
+		~MemoryScope() { MemoryTracker::setThreadCategory(m_previous); }
+
+		MemoryScope(const MemoryScope&) = delete;
+		MemoryScope& operator=(const MemoryScope&) = delete;
+
+	private:
+		MemoryCategory m_previous;
+	};
+
+}
@@ -0,0 +1,133 @@
+#include "Craig_Profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include "../External/json.hpp"
+#include "Craig_Log.hpp"
+
+static_assert((kProfilerEventsPerThread & (kProfilerEventsPerThread - 1)) == 0, "kProfilerEventsPerThread has to be a power of two");
+
+Craig::Profiler::Profiler() {
+
+	m_startTicks = now();
+	m_startTime = std::chrono::steady_clock::now();
+}
+
+Craig::Profiler::ThreadBuffer* Craig::Profiler::registerThread() {
+
+	std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+	ThreadBuffer* rawBuffer = buffer.get();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	rawBuffer->threadIndex = static_cast<uint32_t>(mv_threadBuffers.size());
+	rawBuffer->threadName = "Thread " + std::to_string(rawBuffer->threadIndex);
+	mv_threadBuffers.push_back(std::move(buffer));
+
+	tp_buffer = rawBuffer;
+	return rawBuffer;
+}
+
+void Craig::Profiler::setThreadName(const char* name) {
+
+	ThreadBuffer* buffer = tp_buffer;
+	if (buffer == nullptr) {
+		buffer = registerThread();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	buffer->threadName = name;
+}
+
+double Craig::Profiler::getTicksPerNs() {
+
+#if defined(CRAIG_PROFILER_RDTSC)
+	// The TSC ticks at a fixed rate on anything recent, so the longer we measure over the better the estimate.
+	// Give it at least a few milliseconds if someone asks straight after startup.
+	std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - m_startTime;
+	if (elapsed < std::chrono::milliseconds(10)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+	}
+
+	uint64_t ticks = now() - m_startTicks;
+	elapsed = std::chrono::steady_clock::now() - m_startTime;
+	return static_cast<double>(ticks) / static_cast<double>(elapsed.count());
+#else
+	return 1.0;
+#endif
+}
+
+bool Craig::Profiler::writeChromeTrace(const std::string& path, uint64_t fromTicks, uint64_t toTicks) {
+
+	const double ticksPerUs = getTicksPerNs() * 1000.0;
+
+	nlohmann::json events = nlohmann::json::array();
+	std::vector<Event> snapshot;
+	size_t zoneCount = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (const std::unique_ptr<ThreadBuffer>& buffer : mv_threadBuffers) {
+
+			// The owner keeps recording while we copy. Anything it might have lapped by the time we're done gets dropped,
+			// which is everything older than one ring behind where it's got to, plus the slot it could be halfway through.
+			uint64_t end = buffer->written.load(std::memory_order_acquire);
+			uint64_t begin = end > kProfilerEventsPerThread ? end - kProfilerEventsPerThread : 0;
+
+			snapshot.resize(static_cast<size_t>(end - begin));
+			for (uint64_t i = begin; i < end; i++) {
+				snapshot[static_cast<size_t>(i - begin)] = buffer->events[i & (kProfilerEventsPerThread - 1)];
+			}
+
+			uint64_t written = buffer->written.load(std::memory_order_acquire);
+			uint64_t firstSafe = written >= kProfilerEventsPerThread ? written - kProfilerEventsPerThread + 1 : 0;
+
+			nlohmann::json threadName;
+			threadName["name"] = "thread_name";
+			threadName["ph"] = "M";
+			threadName["pid"] = 0;
+			threadName["tid"] = buffer->threadIndex;
+			threadName["args"]["name"] = buffer->threadName;
+			events.push_back(threadName);
+
+			for (uint64_t i = std::max(begin, firstSafe); i < end; i++) {
+				const Event& event = snapshot[static_cast<size_t>(i - begin)];
+				if (event.end < fromTicks || event.start > toTicks) {
+					continue;
+				}
+
+				// Signed, a zone can start before the profiler's been set up
+				int64_t start = static_cast<int64_t>(event.start - m_startTicks);
+				int64_t duration = static_cast<int64_t>(event.end - event.start);
+
+				nlohmann::json zone;
+				zone["name"] = event.name;
+				zone["ph"] = "X";
+				zone["pid"] = 0;
+				zone["tid"] = buffer->threadIndex;
+				zone["ts"] = static_cast<double>(start) / ticksPerUs;
+				zone["dur"] = static_cast<double>(duration) / ticksPerUs;
+				events.push_back(zone);
+				zoneCount++;
+			}
+		}
+	}
+
+	nlohmann::json root;
+	root["traceEvents"] = std::move(events);
+	root["displayTimeUnit"] = "ns";
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(eProfiling, "Couldn't open %s to write the CPU trace\n", path.c_str());
+		return false;
+	}
+
+	file << root.dump();
+	CRAIG_LOG_INFO(eProfiling, "Wrote %zu CPU zones to %s\n", zoneCount, path.c_str());
+
+	return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CRAIG_PROFILER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CRAIG_PROFILER_RDTSC
+#endif
+
+#include "Craig_Constants.hpp"
+
+// CPU zones. CRAIG_PROFILE_ZONE("Name") times from that line to the end of the enclosing block.
+// The name has to be a string literal, only the pointer gets stored.
+// Without CRAIG_PROFILING_ENABLED (the ENABLE_PROFILING cmake option) the macros are empty and nothing here gets touched.
+#if defined(CRAIG_PROFILING_ENABLED)
+#define CRAIG_PROFILE_CONCAT_INNER(a, b) a##b
+#define CRAIG_PROFILE_CONCAT(a, b) CRAIG_PROFILE_CONCAT_INNER(a, b)
+#define CRAIG_PROFILE_ZONE(name) Craig::ProfileZone CRAIG_PROFILE_CONCAT(craigProfileZone_, __LINE__)(name)
+#define CRAIG_PROFILE_THREAD_NAME(name) Craig::Profiler::getInstance().setThreadName(name)
+#else
+#define CRAIG_PROFILE_ZONE(name)
+#define CRAIG_PROFILE_THREAD_NAME(name)
+#endif
+
+namespace Craig {
+
+	// Every thread that records a zone gets its own ring of events, so recording never takes a lock or touches
+	// another thread's memory. The owning thread is the only writer, it fills the slot in and then bumps the
+	// count with a release store. Writing a trace reads the rings from whichever thread asked for it.
+	class Profiler {
+
+	public:
+		struct Event
+		{
+			const char* name = nullptr;
+			uint64_t    start = 0; // Ticks, see now()
+			uint64_t    end = 0;
+		};
+
+		struct ThreadBuffer
+		{
+			std::array<Event, kProfilerEventsPerThread> events;
+			std::atomic<uint64_t> written{ 0 };    // Total events ever recorded, the slot is written % kProfilerEventsPerThread
+			uint32_t              threadIndex = 0;
+			std::string           threadName;      // Guarded by the profiler's mutex
+		};
+
+		static Profiler& getInstance()
+		{
+			static Profiler instance; // Guaranteed to be destroyed.
+			return instance;
+		}
+		Profiler(Profiler const&) = delete;
+		void operator=(Profiler const&) = delete;
+
+		// rdtsc where we've got it, it's a fraction of the cost of going through the OS clock.
+		// Gets turned into nanoseconds when the trace is written.
+		static uint64_t now() {
+#if defined(CRAIG_PROFILER_RDTSC)
+			return __rdtsc();
+#else
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+		}
+
+		static void record(const char* name, uint64_t start, uint64_t end) {
+			ThreadBuffer* buffer = tp_buffer;
+			if (buffer == nullptr) {
+				buffer = getInstance().registerThread();
+			}
+
+			uint64_t index = buffer->written.load(std::memory_order_relaxed);
+			Event& event = buffer->events[index & (kProfilerEventsPerThread - 1)];
+			event.name = name;
+			event.start = start;
+			event.end = end;
+			buffer->written.store(index + 1, std::memory_order_release);
+		}
+
+		// Shows up as the track name in the trace viewer
+		void setThreadName(const char* name);
+
+		// Chrome's trace event JSON, which Perfetto and chrome://tracing both open. Holds whatever's still in the rings,
+		// or just the zones that overlap fromTicks to toTicks.
+		bool writeChromeTrace(const std::string& path, uint64_t fromTicks = 0, uint64_t toTicks = UINT64_MAX);
+
+		double getTicksPerNs(); // Measured against steady_clock since startup, 1 without rdtsc
+
+	private:
+		Profiler();
+
+		ThreadBuffer* registerThread();
+
+		static inline thread_local ThreadBuffer* tp_buffer = nullptr;
+
+		std::mutex                                 m_mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> mv_threadBuffers; // Never freed, a thread can go away and leave its zones behind
+
+		uint64_t                              m_startTicks = 0;
+		std::chrono::steady_clock::time_point m_startTime;
+	};
+
+	// Records a zone from construction to destruction. Use CRAIG_PROFILE_ZONE rather than making these directly.
+	class ProfileZone {
+
+	public:
+		explicit ProfileZone(const char* name) : m_name(name), m_start(Profiler::now()) {}
+		~ProfileZone() { Profiler::record(m_name, m_start, Profiler::now()); }
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	private:
+		const char* m_name;
+		uint64_t    m_start;
+	};
+
+}
@@ -4,9 +4,12 @@
 #include <cassert>
 #include <iostream>
 #include <set>
-#include <unordered_set>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
 #include <glm/gtc/matrix_transform.hpp>
 
 #if defined(IMGUI_ENABLED)
@@ -21,20 +24,32 @@
 #include "Craig_ShaderCompilation.hpp"
 #include "Craig_Editor.hpp"
 #include "Craig_SceneManager.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Log.hpp"
+#include "Craig_Counters.hpp"
+#include "Craig_FlightRecorder.hpp"
+#include "Craig_MemoryTracker.hpp"
+#include "Craig_Replay.hpp"
 
 #include "Renderer/Craig_Swapchain.hpp"
 #include "Renderer/Craig_Device.hpp"
 #include "Renderer/Craig_ImageHelpers.hpp"
 #include "Renderer/Craig_Instance.hpp"
+#include "Renderer/Craig_OcclusionCulling.hpp"
 #include "Renderer/Craig_Pipeline.hpp"
 #include "Renderer/Craig_SyncManager.hpp"
 
+// Transfer source for the mip chain blits, and so the defragmenter can copy them somewhere else
+static const vk::ImageUsageFlags kTextureImageUsage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+static const vk::BufferUsageFlags kVertexBufferUsage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer;
+static const vk::BufferUsageFlags kIndexBufferUsage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer;
+
 #if defined(IMGUI_ENABLED)
 static void check_vk_result(VkResult err)
 {
     if (err == 0)
         return;
-    fprintf(stderr, "[vulkan-imgui] Error: VkResult = %d\n", err);
+    CRAIG_LOG_ERROR(eRenderer, "[vulkan-imgui] Error: VkResult = %d", err);
     if (err < 0)
         abort();
 }
@@ -44,8 +59,12 @@ CraigError Craig::Renderer::init(Window* CurrentWindowPtr, SceneManager* sceneMa
 
 	CraigError ret = CRAIG_SUCCESS;
 
+    CRAIG_MEMORY_SCOPE(eRenderer);
+
+    m_initStartTime = std::chrono::steady_clock::now();
+
 	// Check if the current window pointer is valid
-	assert(CurrentWindowPtr != nullptr && "CurrentWindowPtr is null, cannot initialize Renderer without a valid window pointer.");
+	assert((CurrentWindowPtr != nullptr || m_headless) && "CurrentWindowPtr is null, cannot initialize Renderer without a valid window pointer.");
 	//Pass in the current window pointer (Done in framework)
 	mp_CurrentWindow = CurrentWindowPtr; 
 
@@ -55,16 +74,23 @@ CraigError Craig::Renderer::init(Window* CurrentWindowPtr, SceneManager* sceneMa
     mp_SceneManager = sceneManagerPtr;
 
 	// Ensure that the current window pointer is not null (just to be extra safe)
-	assert(mp_CurrentWindow != nullptr && "mp_CurrentWindow is null, somehow didn't get passed to our member variable");
+	assert((mp_CurrentWindow != nullptr || m_headless) && "mp_CurrentWindow is null, somehow didn't get passed to our member variable");
+
+    Instance::InstanceInitInfo instanceInitInfo;
 
 	// Use validation layers if this is a debug build
 #if defined(_DEBUG)
     mv_VK_Layers.push_back("VK_LAYER_KHRONOS_validation");
-    mp_CurrentWindow->getExtensionsVector().push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    instanceInitInfo.extensionsVector.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
 
+#if defined(__APPLE__)
+    // The window normally asks for this one
+    if (m_headless) {
+        instanceInitInfo.extensionsVector.push_back(vk::KHRPortabilityEnumerationExtensionName);
+    }
+#endif
 
-    Instance::InstanceInitInfo instanceInitInfo;
     instanceInitInfo.validationLayerVector = mv_VK_Layers;
     instanceInitInfo.p_Window = mp_CurrentWindow;
 
@@ -72,6 +98,12 @@ CraigError Craig::Renderer::init(Window* CurrentWindowPtr, SceneManager* sceneMa
 
     InitVulkan();
 
+    Culling::CullingInitInfo cullingInitInfo;
+    m_culling.init(cullingInitInfo);
+
+    FrameLimiter::FrameLimiterInitInfo frameLimiterInitInfo;
+    m_frameLimiter.init(frameLimiterInitInfo);
+
 #if defined(IMGUI_ENABLED)
     InitImgui();
 
@@ -80,6 +112,29 @@ CraigError Craig::Renderer::init(Window* CurrentWindowPtr, SceneManager* sceneMa
 	return ret;
 }
 
+CraigError Craig::Renderer::initHeadless(SceneManager* sceneManagerPtr, const HeadlessInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+#if defined(IMGUI_ENABLED)
+    // ImGui's backend wants an SDL window to hang off, build without ImGui for headless runs
+    CRAIG_LOG_ERROR(eRenderer, "Headless rendering needs ImGui compiled out\n");
+    return CRAIG_FAIL;
+#endif
+
+    if (info.extent.width == 0 || info.extent.height == 0) {
+        CRAIG_LOG_ERROR(eRenderer, "Headless resolution has to be at least 1 x 1\n");
+        return CRAIG_FAIL;
+    }
+
+    m_headless = true;
+    m_headlessExtent = info.extent;
+
+    ret = init(nullptr, sceneManagerPtr);
+
+	return ret;
+}
+
 #if defined(IMGUI_ENABLED)
 
 void Craig::Renderer::InitImgui() {
@@ -87,6 +142,12 @@ void Craig::Renderer::InitImgui() {
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
+#if defined(CRAIG_MEMORY_TRACKING_ENABLED)
+    // ImGui allocates from all over the frame, this keeps it in its own category rather than whoever called it
+    ImGui::SetAllocatorFunctions(
+        [](size_t size, void*) { return Craig::MemoryTracker::allocate(size, alignof(std::max_align_t), Craig::MemoryCategory::eImGui); },
+        [](void* pointer, void*) { Craig::MemoryTracker::release(pointer); });
+#endif
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
@@ -104,8 +165,10 @@ void Craig::Renderer::InitImgui() {
     init_info.QueueFamily = indices.graphicsFamily.value();
     init_info.Queue = m_Devices.getGraphicsQueue();
     init_info.DescriptorPool = m_VK_imguiDescriptorPool;
+    init_info.PipelineCache = m_pipelineCache.getCache();
     init_info.MinImageCount = 2;
-    init_info.ImageCount = kMaxFramesInFlight;
+    // ImGui cycles its own vertex/index buffers by this, so it has to cover the most frames we could ever have in flight
+    init_info.ImageCount = std::max<uint32_t>(static_cast<uint32_t>(m_swapChain.getImages().size()), kMaxFramesInFlight);
     init_info.CheckVkResultFn = check_vk_result;
     init_info.UseDynamicRendering = true;
 
@@ -125,6 +188,13 @@ CraigError Craig::Renderer::update(const float& deltaTime) {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_PROFILE_ZONE("Renderer::update");
+    CRAIG_MEMORY_SCOPE(eRenderer);
+
+    m_swapchainRebuiltThisFrame = false;
+    updateResizeSweep(deltaTime);
+    updateFrameTimeStats(deltaTime);
+
 #if defined(IMGUI_ENABLED)
     if (m_swapChain.getExtent().width > 0 && m_swapChain.getExtent().height > 0) {
         ImGui_ImplVulkan_NewFrame();
@@ -136,8 +206,18 @@ CraigError Craig::Renderer::update(const float& deltaTime) {
 
 #endif
 
+    m_defragmenter.update();
+
     drawFrame(deltaTime);
 
+    m_pipelineCache.update(deltaTime);
+    m_gpuMemoryStats.update();
+
+    // Everything that counts towards this frame has been and gone, culling workers included
+    Craig::MemoryTracker::getInstance().endFrame();
+    Craig::Counters::getInstance().endFrame();
+    Craig::FlightRecorder::getInstance().endFrame();
+
 	return ret;
 }
 
@@ -147,15 +227,31 @@ void Craig::Renderer::InitVulkan() {
     Device::DeviceInitInfo deviceInitInfo;
     deviceInitInfo.surface = m_instance.getVkSurface();
     deviceInitInfo.instance = m_instance.getVkInstance();
-    deviceInitInfo.deviceExtensionsVector = mv_VK_deviceExtensions;
+    deviceInitInfo.deviceExtensionsVector = m_headless ? mv_VK_headlessDeviceExtensions : mv_VK_deviceExtensions;
+    deviceInitInfo.optionalDeviceExtensionsVector = m_headless ? mv_VK_headlessOptionalDeviceExtensions : mv_VK_optionalDeviceExtensions;
 
     m_Devices.init(deviceInitInfo); //Picks physical device, creates logical device
 
+    // Extension function, so it doesn't come from the loader we link against
+    if (m_Devices.isPresentWaitSupported()) {
+        m_pfnWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(m_Devices.getLogicalDevice().getProcAddr("vkWaitForPresentKHR"));
+    }
+
+    // Needs to exist before any pipelines get made, every one of them goes through it
+    PipelineCache::PipelineCacheInitInfo pipelineCacheInitInfo;
+    pipelineCacheInitInfo.device = m_Devices.getLogicalDevice();
+    pipelineCacheInitInfo.physicalDevice = m_Devices.getPhysicalDevice();
+
+    m_pipelineCache.init(pipelineCacheInitInfo);
+
     Swapchain::SwapchainInitInfo swapInitInfo;
     swapInitInfo.surface = m_instance.getVkSurface();
     swapInitInfo.device = m_Devices.getLogicalDevice();
     swapInitInfo.physicalDevice = m_Devices.getPhysicalDevice();
     swapInitInfo.pWindow = mp_CurrentWindow;
+    swapInitInfo.headless = m_headless;
+    swapInitInfo.headlessExtent = m_headlessExtent;
+    swapInitInfo.memoryAllocator = m_Devices.getVmaAllocator();
 
     m_swapChain.init(swapInitInfo);
 
@@ -174,9 +270,11 @@ void Craig::Renderer::InitVulkan() {
     pipelineInitInfo.device = m_Devices.getLogicalDevice();
     pipelineInitInfo.colorFormat = m_swapChain.getImageFormat();
     pipelineInitInfo.depthFormat = m_renderingAttachments.findDepthFormat();
-    pipelineInitInfo.msaaSamples = &m_renderingAttachments.m_VK_msaaSamples;
+    pipelineInitInfo.msaaSamples = m_renderingAttachments.m_VK_msaaSamples;
+    pipelineInitInfo.pipelineCache = m_pipelineCache.getCache();
 
     m_pipeline.init(pipelineInitInfo);
+    precompilePipelineVariants();
 
     CommandManager::CommandManagerInitInfo commandManagerInitInfo;
     commandManagerInitInfo.p_Device = &m_Devices;
@@ -184,6 +282,50 @@ void Craig::Renderer::InitVulkan() {
 
     m_commandManager.init(commandManagerInitInfo);
 
+    // Before anything gets uploaded, so the one-off copies and mip generation get timed too
+    GpuProfiler::GpuProfilerInitInfo gpuProfilerInitInfo;
+    gpuProfilerInitInfo.p_Device = &m_Devices;
+    gpuProfilerInitInfo.surface = m_instance.getVkSurface();
+
+    m_gpuProfiler.init(gpuProfilerInitInfo);
+    m_commandManager.setGpuProfiler(&m_gpuProfiler);
+
+    PipelineStatistics::PipelineStatisticsInitInfo pipelineStatisticsInitInfo;
+    pipelineStatisticsInitInfo.p_Device = &m_Devices;
+
+    m_pipelineStatistics.init(pipelineStatisticsInitInfo);
+
+    GpuMemoryStats::GpuMemoryStatsInitInfo gpuMemoryStatsInitInfo;
+    gpuMemoryStatsInitInfo.p_Device = &m_Devices;
+
+    m_gpuMemoryStats.init(gpuMemoryStatsInitInfo);
+
+    // Before the scene loads, the textures and geometry get registered with it as they're made
+    Defragmenter::DefragmenterInitInfo defragmenterInitInfo;
+    defragmenterInitInfo.p_Device = &m_Devices;
+    defragmenterInitInfo.p_GpuMemoryStats = &m_gpuMemoryStats;
+    defragmenterInitInfo.surface = m_instance.getVkSurface();
+    defragmenterInitInfo.bufferUsage = kVertexBufferUsage | kIndexBufferUsage;
+    defragmenterInitInfo.imageUsage = kTextureImageUsage;
+    defragmenterInitInfo.imageFormat = vk::Format::eR8G8B8A8Srgb;
+
+    m_defragmenter.init(defragmenterInitInfo);
+
+    FrameCapture::FrameCaptureInitInfo frameCaptureInitInfo;
+    frameCaptureInitInfo.p_Device = &m_Devices;
+
+    m_frameCapture.init(frameCaptureInitInfo);
+
+    OcclusionCulling::OcclusionCullingInitInfo occlusionInitInfo;
+    occlusionInitInfo.p_Device = &m_Devices;
+    occlusionInitInfo.p_CommandManager = &m_commandManager;
+    occlusionInitInfo.surface = m_instance.getVkSurface();
+    occlusionInitInfo.depthFormat = m_renderingAttachments.findDepthFormat();
+    occlusionInitInfo.depthSamplingSupported = m_renderingAttachments.m_depthSamplingSupported;
+    occlusionInitInfo.pipelineCache = m_pipelineCache.getCache();
+
+    m_occlusionCulling.init(occlusionInitInfo);
+    m_occlusionCulling.createDepthPyramid(m_swapChain.getExtent(), m_renderingAttachments.getSampledDepthImageView());
 
     mp_SceneManager->init();
 
@@ -197,10 +339,19 @@ void Craig::Renderer::InitVulkan() {
     Craig::SyncManager::SyncManagerInitInfo syncManagerInitInfo;
     syncManagerInitInfo.logicalDevice = m_Devices.getLogicalDevice();
     syncManagerInitInfo.swapChainImageCount = m_swapChain.getImages().size();
+    syncManagerInitInfo.framesInFlight = kDefaultFramesInFlight;
+    syncManagerInitInfo.headless = m_headless;
+
+    // Lets a deployment pick its own latency/throughput trade off without a rebuild
+    if (const char* framesInFlightEnv = std::getenv("CRAIG_FRAMES_IN_FLIGHT")) {
+        syncManagerInitInfo.framesInFlight = static_cast<uint32_t>(std::clamp(std::atoi(framesInFlightEnv), 1, kMaxFramesInFlight));
+    }
 
     m_syncManager.init(syncManagerInitInfo);
 
-    mp_CurrentWindow->setCameraRef(&mp_SceneManager->getCurrentScene()->getCamera());
+    if (mp_CurrentWindow != nullptr) {
+        mp_CurrentWindow->setCameraRef(&mp_SceneManager->getCurrentScene()->getCamera());
+    }
 
 #if defined(IMGUI_ENABLED)
     createImguiDescriptorPool();
@@ -217,65 +368,432 @@ void Craig::Renderer::recreateSwapChain() {
         return; // Skip this frame
     }
 
-    m_Devices.getLogicalDevice().waitIdle();
+    // No waitIdle. The frames in flight might still be using any of this, so it all goes to the deletion queue
+    // and the new swapchain gets built off the old one.
+    m_occlusionCulling.retireDepthPyramid(m_deletionQueue);
+    m_renderingAttachments.retireColourAndDepthImages(m_deletionQueue);
 
-    m_renderingAttachments.cleanupColourAndDepthImageViews();
-    m_swapChain.cleanupSwapChain();
+    m_swapChain.recreateSwapChain(m_deletionQueue);
+    m_syncManager.recreateRenderFinishedSemaphores(static_cast<uint32_t>(m_swapChain.getImages().size()), m_deletionQueue);
 
-    m_swapChain.createSwapChain();
-    m_swapChain.createSwapImageViews();
     m_renderingAttachments.createColourResources(m_swapChain.getExtent(), m_swapChain.getImageFormat());
     m_renderingAttachments.createDepthResources(m_swapChain.getExtent());
+    m_occlusionCulling.createDepthPyramid(m_swapChain.getExtent(), m_renderingAttachments.getSampledDepthImageView());
+
+    m_swapchainRebuiltThisFrame = true;
+    m_swapchainRebuildCount++;
+    Craig::FlightRecorder::getInstance().addEvent(Craig::FlightEvent::eSwapchainRecreated, "Renderer::recreateSwapChain",
+        (static_cast<uint64_t>(m_swapChain.getExtent().width) << 32) | m_swapChain.getExtent().height);
+    m_swapchainFirstPresentId = m_presentId + 1;
 }
 
-void Craig::Renderer::recreateSwapChainFull() {
+// Drags the window between its starting size and kResizeSweepMinScale of it for kResizeSweepFrames frames,
+// recording every frame time on the way, then puts the window back and works out the distribution
+void Craig::Renderer::startResizeSweep() {
 
-    m_swapChain.setSwapExtent();
+    if (m_resizeSweepRunning) {
+        return;
+    }
 
-    if (m_swapChain.getExtent().width <= 0 || m_swapChain.getExtent().height <= 0) {
-        return; // Skip this frame
+    if (m_headless) {
+        CRAIG_LOG_WARN(eRenderer, "No window to resize when headless\n");
+        return;
     }
 
+    SDL_GetWindowSize(mp_CurrentWindow->getSDLWindow(), &m_resizeSweepStartWidth, &m_resizeSweepStartHeight);
 
-    m_Devices.getLogicalDevice().waitIdle();
+    mv_resizeSweepFrameTimes.clear();
+    mv_resizeSweepFrameTimes.reserve(kResizeSweepFrames);
+    m_resizeSweepFrame = 0;
+    m_resizeSweepStartRebuilds = m_swapchainRebuildCount;
+    m_resizeSweepStartCoalesced = m_resizeEventsCoalesced;
+    m_resizeSweepRunning = true;
+}
+
+void Craig::Renderer::updateResizeSweep(const float& deltaTime) {
+
+    if (!m_resizeSweepRunning) {
+        return;
+    }
+
+    // deltaTime is how long the previous frame took, so the first one belongs to before the sweep
+    if (m_resizeSweepFrame > 0) {
+        mv_resizeSweepFrameTimes.push_back(deltaTime * 1000.0f);
+    }
+
+    if (m_resizeSweepFrame == kResizeSweepFrames) {
+        SDL_SetWindowSize(mp_CurrentWindow->getSDLWindow(), m_resizeSweepStartWidth, m_resizeSweepStartHeight);
+        m_resizeSweepRunning = false;
+
+        std::vector<float> sorted = mv_resizeSweepFrameTimes;
+        std::sort(sorted.begin(), sorted.end());
+
+        auto percentile = [&sorted](float p) {
+            size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+            return sorted[index];
+        };
+
+        float total = 0.0f;
+        for (float frameTime : sorted) {
+            total += frameTime;
+        }
+
+        m_resizeSweepResults.frames = static_cast<uint32_t>(sorted.size());
+        m_resizeSweepResults.swapchainRebuilds = m_swapchainRebuildCount - m_resizeSweepStartRebuilds;
+        m_resizeSweepResults.resizeEventsCoalesced = m_resizeEventsCoalesced - m_resizeSweepStartCoalesced;
+        m_resizeSweepResults.averageMs = total / sorted.size();
+        m_resizeSweepResults.p50Ms = percentile(0.50f);
+        m_resizeSweepResults.p95Ms = percentile(0.95f);
+        m_resizeSweepResults.p99Ms = percentile(0.99f);
+        m_resizeSweepResults.maxMs = sorted.back();
+
+        CRAIG_LOG_INFO(eRenderer, "Resize sweep: %u frames, %u swapchain rebuilds, %u resize events coalesced\n", m_resizeSweepResults.frames, m_resizeSweepResults.swapchainRebuilds, m_resizeSweepResults.resizeEventsCoalesced);
+        CRAIG_LOG_INFO(eRenderer, "  frame time avg %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            m_resizeSweepResults.averageMs, m_resizeSweepResults.p50Ms, m_resizeSweepResults.p95Ms, m_resizeSweepResults.p99Ms, m_resizeSweepResults.maxMs);
+        return;
+    }
+
+    // Triangle wave between full size and kResizeSweepMinScale, a new size every frame like a drag would give
+    float phase = static_cast<float>(m_resizeSweepFrame % kResizeSweepPeriodFrames) / kResizeSweepPeriodFrames;
+    float wave = 1.0f - std::abs(phase * 2.0f - 1.0f);
+    float scale = 1.0f - wave * (1.0f - kResizeSweepMinScale);
+
+    SDL_SetWindowSize(mp_CurrentWindow->getSDLWindow(),
+        std::max(1, static_cast<int>(m_resizeSweepStartWidth * scale)),
+        std::max(1, static_cast<int>(m_resizeSweepStartHeight * scale)));
+
+    m_resizeSweepFrame++;
+}
+
+void Craig::Renderer::setPresentMode(vk::PresentModeKHR presentMode) {
+
+    m_swapChain.setRequestedPresentMode(presentMode);
+    recreateSwapChain();
+    resetFrameTimeStats();
+}
+
+void Craig::Renderer::setFramePacing(FramePacing pacing) {
 
-    m_pipeline.recreate();
+    if (pacing == FramePacing::ePresentWait && !isPresentWaitSupported()) {
+        CRAIG_LOG_WARN(eRenderer, "VK_KHR_present_wait isn't supported on this device, leaving frame pacing as it was\n");
+        return;
+    }
+
+    m_framePacing = pacing;
+    m_frameLimiter.reset();
+    resetFrameTimeStats();
+}
+
+void Craig::Renderer::setFrameLimitFps(float targetFps) {
+
+    m_frameLimiter.setTargetFps(targetFps);
+    resetFrameTimeStats();
+}
+
+void Craig::Renderer::paceFrame() {
+
+    CRAIG_PROFILE_ZONE("Renderer::paceFrame");
+
+    switch (m_framePacing)
+    {
+    case FramePacing::eLimiter:
+        m_frameLimiter.wait();
+        break;
+
+    case FramePacing::ePresentWait:
+        // Leaves one frame queued up behind the one on screen. Ids from before the last rebuild went to the old
+        // swapchain, so there's nothing to wait for until the new one's had two presents. Timeouts and out of date
+        // just mean we carry on, drawFrame sorts the swapchain out.
+        if (m_pfnWaitForPresent != nullptr && m_presentId > m_swapchainFirstPresentId) {
+            m_pfnWaitForPresent(m_Devices.getLogicalDevice(), m_swapChain.getSwapChain(), m_presentId - 1, kPresentWaitTimeoutNs);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
 
-    m_renderingAttachments.cleanupColourAndDepthImageViews();
-    m_swapChain.cleanupSwapChain();
+std::string Craig::Renderer::describeFramePacing() const {
 
-    //recreate with the new sample number
-    m_swapChain.createSwapChain();
-    m_swapChain.createSwapImageViews();
+    std::string description = m_headless ? "offscreen" : vk::to_string(m_swapChain.getPresentMode());
+
+    switch (m_framePacing)
+    {
+    case FramePacing::eLimiter:
+        description += ", frame limiter at " + std::to_string(static_cast<int>(m_frameLimiter.getTargetFps())) + " fps";
+        break;
+    case FramePacing::ePresentWait:
+        description += ", present wait";
+        break;
+    default:
+        description += ", no pacing";
+        break;
+    }
+
+    return description;
+}
+
+void Craig::Renderer::resetFrameTimeStats() {
+
+    mv_frameTimeHistory.clear();
+    m_frameTimeStats = FrameTimeStats{};
+    m_frameTimeStatsSkipNext = true;
+    m_frameTimeStatsReported = false;
+}
+
+// Fills a window of kFrameTimeStatsFrames frame times and works out the spread once it's full. The first window
+// for each present mode/pacing combination gets printed so they can be compared on a machine without the editor.
+void Craig::Renderer::updateFrameTimeStats(const float& deltaTime) {
+
+    if (m_frameTimeStatsSkipNext) {
+        m_frameTimeStatsSkipNext = false;
+        return;
+    }
+
+    mv_frameTimeHistory.push_back(deltaTime * 1000.0f);
+
+    if (mv_frameTimeHistory.size() < kFrameTimeStatsFrames) {
+        return;
+    }
+
+    std::vector<float> sorted = mv_frameTimeHistory;
+    std::sort(sorted.begin(), sorted.end());
+    mv_frameTimeHistory.clear();
+
+    double total = 0.0;
+    for (float frameTime : sorted) {
+        total += frameTime;
+    }
+    double mean = total / sorted.size();
+
+    double squaredDifferences = 0.0;
+    for (float frameTime : sorted) {
+        squaredDifferences += (frameTime - mean) * (frameTime - mean);
+    }
+    double variance = squaredDifferences / sorted.size();
+
+    m_frameTimeStats.frames = static_cast<uint32_t>(sorted.size());
+    m_frameTimeStats.averageMs = static_cast<float>(mean);
+    m_frameTimeStats.varianceMs = static_cast<float>(variance);
+    m_frameTimeStats.stdDevMs = static_cast<float>(std::sqrt(variance));
+    m_frameTimeStats.p99Ms = sorted[std::min(sorted.size() - 1, static_cast<size_t>(0.99f * sorted.size()))];
+    m_frameTimeStats.minMs = sorted.front();
+    m_frameTimeStats.maxMs = sorted.back();
+
+    if (!m_frameTimeStatsReported) {
+        m_frameTimeStatsReported = true;
+        CRAIG_LOG_INFO(eRenderer, "Frame pacing (%s): avg %.3f ms, std dev %.3f ms, variance %.4f ms^2, p99 %.3f ms, min %.3f ms, max %.3f ms\n",
+            describeFramePacing().c_str(), m_frameTimeStats.averageMs, m_frameTimeStats.stdDevMs, m_frameTimeStats.varianceMs,
+            m_frameTimeStats.p99Ms, m_frameTimeStats.minMs, m_frameTimeStats.maxMs);
+    }
+}
+
+// Every sample count the device can do gets built on the compile thread straight away, so by the time
+// someone goes for the MSAA dropdown the pipeline's most likely already sitting there
+void Craig::Renderer::precompilePipelineVariants() {
+
+    uint32_t maxSamples = static_cast<uint32_t>(m_renderingAttachments.m_VK_msaaSamples);
+
+    for (uint32_t samples = 1; samples <= maxSamples; samples *= 2) {
+        m_pipeline.requestVariant(m_pipeline.makeVariantKey(static_cast<vk::SampleCountFlagBits>(samples)));
+    }
+}
+
+// Switches MSAA once the matching pipeline variant is ready. Only the multisampled attachments get rebuilt,
+// the old ones go to the deletion queue for the frames in flight to finish with.
+void Craig::Renderer::applyPendingSamplingLevel() {
+
+    if (!m_pendingMsaaSamples.has_value()) {
+        return;
+    }
+
+    // Still compiling, carry on with what we've got. If it failed to compile we stay on it for good.
+    PipelineVariantKey pendingKey = m_pipeline.makeVariantKey(m_pendingMsaaSamples.value());
+    if (!m_pipeline.setActiveVariant(pendingKey)) {
+        if (m_pipeline.isVariantFailed(pendingKey)) {
+            CRAIG_LOG_WARN(eRenderer, "Staying on %ux MSAA, the %ux pipelines didn't compile\n", static_cast<uint32_t>(m_renderingAttachments.m_VK_msaaSamples),
+                static_cast<uint32_t>(m_pendingMsaaSamples.value()));
+            m_pendingMsaaSamples.reset();
+        }
+        return;
+    }
+
+    m_renderingAttachments.retireColourAndDepthImages(m_deletionQueue);
+    m_renderingAttachments.m_VK_msaaSamples = m_pendingMsaaSamples.value();
     m_renderingAttachments.createColourResources(m_swapChain.getExtent(), m_swapChain.getImageFormat());
     m_renderingAttachments.createDepthResources(m_swapChain.getExtent());
+    m_occlusionCulling.setDepthSource(m_renderingAttachments.getSampledDepthImageView());
+
+    m_pendingMsaaSamples.reset();
 }
 
 
 void Craig::Renderer::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
 
+    CRAIG_PROFILE_ZONE("Renderer::recordCommandBuffer");
+
     vk::CommandBufferBeginInfo beginInfo{};
 
     if (commandBuffer.begin(&beginInfo) != vk::Result::eSuccess) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    uint32_t currentFrame = m_syncManager.getCurrentFrame();
+    m_gpuProfiler.beginFrame(commandBuffer, currentFrame);
+    m_pipelineStatistics.beginFrame(commandBuffer, currentFrame);
+    m_gpuProfiler.beginScope(commandBuffer, "Frame");
+
+    // Before anything gets drawn, whatever it moves is swapped over by the time the scene's recorded
+    if (m_defragmenter.isRunning()) {
+        m_gpuProfiler.beginScope(commandBuffer, "Defragment");
+        m_defragmenter.recordPass(commandBuffer, m_deletionQueue);
+        m_gpuProfiler.endScope(commandBuffer);
+    }
+
     //We have to transition the swap image manually, render passes used to do this implicitly :(
     Craig::ImageHelpers::transitionSwapImage(commandBuffer, m_swapChain.getImages()[imageIndex], vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
     Craig::ImageHelpers::transitionSwapImage(commandBuffer, m_renderingAttachments.getColourImage(), vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal); //MSAA colour image too
     Craig::ImageHelpers::transitionSwapImage(commandBuffer, m_renderingAttachments.getDepthImage(), vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
+    // With MSAA on, depth gets resolved into its own single sample image for the occlusion culling pyramid
+    if (m_renderingAttachments.getDepthResolveImage()) {
+        Craig::ImageHelpers::transitionSwapImage(commandBuffer, m_renderingAttachments.getDepthResolveImage(), vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    }
+
+    // Scene GPU time, from here until the last scene pass is done
+    m_gpuProfiler.beginScope(commandBuffer, "Scene");
+    m_pipelineStatistics.begin(commandBuffer, m_swapChain.getExtent());
+    m_timestampFrameUsedPrePass[currentFrame] = m_depthPrePassEnabled;
+
+    // With the pre-pass on, depth gets laid down first by the position only pipeline and the colour pass
+    // just shades whatever's left at eEqual, so every pixel only gets shaded once.
+    if (m_overdrawViewEnabled) {
+        recordScenePass(commandBuffer, imageIndex, ScenePass::eSingle, ScenePassMode::eOverdraw);
+    }
+    else if (isOcclusionCullingActive()) {
+        // Draw what was visible last frame, build the depth pyramid from it, test everything against
+        // the pyramid, then draw whatever turned out to be visible that phase one missed.
+        // With the pre-pass the two phases only write depth, and one colour pass goes over both sets of draws at the end.
+        Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
+        ScenePassMode phaseMode = m_depthPrePassEnabled ? ScenePassMode::eDepthPrePass : ScenePassMode::eColour;
+
+        m_gpuProfiler.beginScope(commandBuffer, "Occlusion cull");
+        m_occlusionCulling.recordCull(commandBuffer, currentFrame, OcclusionCulling::CullPhase::eEarly, camera.getView(), camera.getProj(), camera.m_nearPlane);
+        m_gpuProfiler.endScope(commandBuffer);
+        recordScenePass(commandBuffer, imageIndex, ScenePass::eOcclusionPhaseOne, phaseMode);
+
+        m_gpuProfiler.beginScope(commandBuffer, "Depth pyramid");
+        m_occlusionCulling.recordDepthPyramid(commandBuffer, currentFrame, m_renderingAttachments.getSampledDepthImage());
+        m_gpuProfiler.endScope(commandBuffer);
+        m_gpuProfiler.beginScope(commandBuffer, "Occlusion cull");
+        m_occlusionCulling.recordCull(commandBuffer, currentFrame, OcclusionCulling::CullPhase::eLate, camera.getView(), camera.getProj(), camera.m_nearPlane);
+        m_gpuProfiler.endScope(commandBuffer);
+        recordScenePass(commandBuffer, imageIndex, ScenePass::eOcclusionPhaseTwo, phaseMode);
+
+        if (m_depthPrePassEnabled) {
+            recordScenePass(commandBuffer, imageIndex, ScenePass::eOcclusionBothPhases, ScenePassMode::eColourAfterPrePass);
+        }
+    }
+    else if (m_depthPrePassEnabled) {
+        recordScenePass(commandBuffer, imageIndex, ScenePass::eSingle, ScenePassMode::eDepthPrePass);
+        recordScenePass(commandBuffer, imageIndex, ScenePass::eSingle, ScenePassMode::eColourAfterPrePass);
+    }
+    else {
+        recordScenePass(commandBuffer, imageIndex, ScenePass::eSingle, ScenePassMode::eColour);
+    }
+
+    m_pipelineStatistics.end(commandBuffer);
+    m_gpuProfiler.endScope(commandBuffer);
+
+    // Before the editor goes on top, captures are for comparing what the scene looks like
+    if (m_swapChain.isCaptureSupported()) {
+        m_frameCapture.recordCopy(commandBuffer, currentFrame, m_swapChain.getImages()[imageIndex], m_swapChain.getExtent(), m_swapChain.getImageFormat());
+    }
+
+#if defined(IMGUI_ENABLED)
+    //gotta render imgui's UI separately
+    m_gpuProfiler.beginScope(commandBuffer, "ImGui");
+
+    vk::RenderingAttachmentInfo uiColourAtt{};
+    uiColourAtt
+        .setImageView(m_swapChain.getImageViews()[imageIndex])
+        .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+        .setLoadOp(vk::AttachmentLoadOp::eLoad)     // keep what scene wrote
+        .setStoreOp(vk::AttachmentStoreOp::eStore);
+
+    vk::RenderingInfo uiRi{};
+    uiRi
+        .setRenderArea({ {0,0}, m_swapChain.getExtent() })
+        .setLayerCount(1)
+        .setColorAttachmentCount(1)
+        .setPColorAttachments(&uiColourAtt)
+        .setPDepthAttachment(nullptr);
+    commandBuffer.beginRendering(uiRi);
+
+    ImGui::Render();
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+
+    commandBuffer.endRendering();
+    m_gpuProfiler.endScope(commandBuffer);
+#endif
+
+    Craig::ImageHelpers::transitionSwapImage(commandBuffer, m_swapChain.getImages()[imageIndex], vk::ImageLayout::eColorAttachmentOptimal, m_swapChain.getFinalLayout());
 
+    m_gpuProfiler.endScope(commandBuffer);
+
+    try {
+        commandBuffer.end();
+    }
+    catch (const vk::SystemError& err) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+
+}
+
+// One dynamic rendering pass over the scene. eSingle is the plain old everything-in-one-go pass,
+// the occlusion phases draw through the indirect buffers the cull shader filled in.
+// The mode says whether this is a normal colour pass, a depth pre-pass, or the colour pass that follows a pre-pass.
+void Craig::Renderer::recordScenePass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, ScenePass pass, ScenePassMode mode) {
+
+    const char* scopeName = "Colour pass";
+    if (mode == ScenePassMode::eDepthPrePass) {
+        scopeName = "Depth pre-pass";
+    }
+    else if (mode == ScenePassMode::eColourAfterPrePass) {
+        scopeName = "Colour pass (after pre-pass)";
+    }
+    else if (mode == ScenePassMode::eOverdraw) {
+        scopeName = "Overdraw pass";
+    }
+    GpuScope passScope(m_gpuProfiler, commandBuffer, scopeName);
+
+    // The overdraw view counts up from black
     vk::ClearValue clearColour;
-    clearColour.setColor({ kClearColour[0], kClearColour[1], kClearColour[2], kClearColour[3] });
+    if (mode == ScenePassMode::eOverdraw) {
+        clearColour.setColor({ 0.0f, 0.0f, 0.0f, 1.0f });
+    }
+    else {
+        clearColour.setColor({ kClearColour[0], kClearColour[1], kClearColour[2], kClearColour[3] });
+    }
 
     vk::ClearValue clearDepth;
     clearDepth.setDepthStencil({ 1.0f, 0 });
 
-    // Dynamic rendering attachments for colour and depth
+    // Dynamic rendering attachments for colour and depth.
+    // Depth gets cleared by whichever pass touches it first and kept for anything that comes after (phase two, the pyramid, the colour pass).
+    // Colour gets cleared by the first pass that actually has colour, phase two carries on from phase one.
+    bool firstDepthPass = (pass == ScenePass::eSingle || pass == ScenePass::eOcclusionPhaseOne) && mode != ScenePassMode::eColourAfterPrePass;
+    bool keepDepth = (mode == ScenePassMode::eDepthPrePass) || (pass == ScenePass::eOcclusionPhaseOne);
+
+    vk::AttachmentLoadOp colourLoadOp = (pass == ScenePass::eOcclusionPhaseTwo) ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+    vk::AttachmentLoadOp depthLoadOp = firstDepthPass ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
+    vk::AttachmentStoreOp depthStoreOp = keepDepth ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+
     vk::RenderingAttachmentInfo colourAtt{};
     colourAtt
-        .setLoadOp(vk::AttachmentLoadOp::eClear)
+        .setLoadOp(colourLoadOp)
         .setStoreOp(vk::AttachmentStoreOp::eStore)
         .setClearValue(clearColour);
 
@@ -283,8 +801,8 @@ void Craig::Renderer::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint3
     depthAtt
         .setImageView(m_renderingAttachments.getDepthImageView())
         .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
-        .setLoadOp(vk::AttachmentLoadOp::eClear)
-        .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+        .setLoadOp(depthLoadOp)
+        .setStoreOp(depthStoreOp)
         .setClearValue(clearDepth);
 
     bool msaa = (m_renderingAttachments.m_VK_msaaSamples != vk::SampleCountFlagBits::e1);
@@ -297,10 +815,37 @@ void Craig::Renderer::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint3
     else {
         colourAtt
             .setImageView(m_renderingAttachments.getColourImageView())
-            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setResolveImageView(m_swapChain.getImageViews()[imageIndex])
-            .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setResolveMode(vk::ResolveModeFlagBits::eAverage);
+            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal);
+
+        // No point resolving colour twice, phase two does it once everything's drawn
+        if (pass != ScenePass::eOcclusionPhaseOne) {
+            colourAtt
+                .setResolveImageView(m_swapChain.getImageViews()[imageIndex])
+                .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                .setResolveMode(vk::ResolveModeFlagBits::eAverage);
+        }
+        else if (m_renderingAttachments.getDepthResolveImage()) {
+            depthAtt
+                .setResolveImageView(m_renderingAttachments.getDepthResolveImageView())
+                .setResolveImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                .setResolveMode(vk::ResolveModeFlagBits::eSampleZero);
+        }
+    }
+
+    bool depthOnly = (mode == ScenePassMode::eDepthPrePass);
+
+    // Carrying on from an earlier pass' depth, so its writes have to land before this one starts testing against them
+    if (!firstDepthPass) {
+        vk::MemoryBarrier2 depthBarrier{};
+        depthBarrier
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests)
+            .setSrcAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests)
+            .setDstAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite);
+
+        vk::DependencyInfo dependencyInfo{};
+        dependencyInfo.setMemoryBarriers(depthBarrier);
+        commandBuffer.pipelineBarrier2(dependencyInfo);
     }
 
     // vk::RenderingInfo begins a dynamic rendering instance.
@@ -308,18 +853,32 @@ void Craig::Renderer::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint3
     ri
         .setRenderArea({ {0,0}, m_swapChain.getExtent() })
         .setLayerCount(1)
-        .setColorAttachmentCount(1)
-        .setPColorAttachments(&colourAtt)
+        .setColorAttachmentCount(depthOnly ? 0 : 1)
+        .setPColorAttachments(depthOnly ? nullptr : &colourAtt)
         .setPDepthAttachment(&depthAtt);
 
     commandBuffer.beginRendering(ri);
 
-    //Binding the vertex buffer
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline.getGraphicsPipeline());
-    vk::Buffer vertexBuffers[] = { m_VK_vertexBuffer };
+    //Binding the vertex buffer, the pre-pass only needs the positions
+    vk::Pipeline pipeline = m_pipeline.getGraphicsPipeline();
+    if (mode == ScenePassMode::eDepthPrePass) {
+        pipeline = m_pipeline.getDepthPrePassPipeline();
+    }
+    else if (mode == ScenePassMode::eColourAfterPrePass) {
+        pipeline = m_pipeline.getDepthEqualPipeline();
+    }
+    else if (mode == ScenePassMode::eOverdraw) {
+        pipeline = m_pipeline.getOverdrawPipeline();
+    }
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    vk::Buffer vertexBuffers[] = { depthOnly ? m_VK_positionBuffer : m_VK_vertexBuffer };
     vk::DeviceSize offsets[] = { 0 };
     commandBuffer.bindVertexBuffers(0, vertexBuffers, offsets);
     commandBuffer.bindIndexBuffer(m_VK_indexBuffer, 0, vk::IndexType::eUint32);
+    CRAIG_COUNT(ePipelineBinds, 1);
+    CRAIG_COUNT(eVertexBufferBinds, 1);
+    CRAIG_COUNT(eIndexBufferBinds, 1);
 
     // Set the dynamic viewport (covers the whole framebuffer)
     vk::Viewport viewport;
@@ -350,26 +909,58 @@ void Craig::Renderer::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint3
     std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
     Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
 
+    // eOcclusionBothPhases goes through both buffers, only one of each pair of draws has an instance in it
+    vk::Buffer phaseOneDraws;
+    vk::Buffer phaseTwoDraws;
+    if (pass != ScenePass::eSingle) {
+        phaseOneDraws = m_occlusionCulling.getDrawBuffer(m_syncManager.getCurrentFrame(), OcclusionCulling::CullPhase::eEarly);
+        phaseTwoDraws = m_occlusionCulling.getDrawBuffer(m_syncManager.getCurrentFrame(), OcclusionCulling::CullPhase::eLate);
+    }
+    bool drawPhaseOne = (pass == ScenePass::eOcclusionPhaseOne || pass == ScenePass::eOcclusionBothPhases);
+    bool drawPhaseTwo = (pass == ScenePass::eOcclusionPhaseTwo || pass == ScenePass::eOcclusionBothPhases);
+
     // Per-frame set (camera UBO + transforms SSBO) only needs binding once per frame, it stays bound for every draw after.
+    // The camera data's dynamic offset says where in the transient ring this frame's copy landed.
     commandBuffer.bindDescriptorSets(
         vk::PipelineBindPoint::eGraphics,
         m_pipeline.getPipelineLayout(),
         0, // set 0
         mv_VK_perFrameDescriptorSet[m_syncManager.getCurrentFrame()],
-        nullptr);
+        m_cameraDataOffsets[m_syncManager.getCurrentFrame()]);
+
+    vk::DescriptorSet boundModelSet;
+
+    // Added up here and counted once at the end, there can be a lot of objects
+    uint32_t descriptorSetBinds = 1;
+    uint32_t pushConstants = 0;
+    uint32_t directDraws = 0;
+    uint32_t indirectDraws = 0;
+    uint64_t triangles = 0;
 
     for (size_t objectIdx = 0; objectIdx < currentSceneObjects.size(); objectIdx++)
     {
+        // Culled this frame, the SSBO slot still gets written so the indices don't shift
+        if (m_cullingEnabled && !m_culling.isVisible(objectIdx)) {
+            continue;
+        }
+
         Craig::GameObject* gameObject = currentSceneObjects[objectIdx];
 
-        // Per-object set (just the texture) goes into set 1, rebinds each draw since the texture differs.
-        commandBuffer.bindDescriptorSets(
-            vk::PipelineBindPoint::eGraphics,
-            m_pipeline.getPipelineLayout(),
-            1, // set 1
-            //gameObject->getDescriptorSet(),
-            mMap_GameObjectToDescriptorSet[gameObject],
-            nullptr);
+        // Per-model set (just the texture) goes into set 1, only rebinds when the model changes from the last object.
+        // The pre-pass and the overdraw view never sample it so they can skip the rebinds.
+        if (!depthOnly && mode != ScenePassMode::eOverdraw) {
+            vk::DescriptorSet modelSet = mMap_ModelToDescriptorSet[gameObject->getModelPath()];
+            if (modelSet != boundModelSet) {
+                commandBuffer.bindDescriptorSets(
+                    vk::PipelineBindPoint::eGraphics,
+                    m_pipeline.getPipelineLayout(),
+                    1, // set 1
+                    modelSet,
+                    nullptr);
+                boundModelSet = modelSet;
+                descriptorSetBinds++;
+            }
+        }
 
         // Tell the vertex shader which slot of the SSBO to read for this object's model matrix.
         uint32_t objectIndex = static_cast<uint32_t>(objectIdx);
@@ -379,57 +970,46 @@ void Craig::Renderer::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint3
             0,
             sizeof(uint32_t),
             &objectIndex);
+        pushConstants++;
 
         Craig::Model& model = resources.getModel(gameObject->getModelPath());
         for (size_t i = 0; i < model.subMeshesCount; i++)
         {
             Craig::SubMesh* submesh = model.subMeshes[i];
 
-            commandBuffer.drawIndexed(
-                submesh->indexCount,
-                1,
-                submesh->indexOffset,
-                submesh->vertexOffset,
-                0);
+            if (pass == ScenePass::eSingle) {
+                commandBuffer.drawIndexed(
+                    submesh->indexCount,
+                    1,
+                    submesh->indexOffset,
+                    submesh->vertexOffset,
+                    0);
+                directDraws++;
+                triangles += submesh->indexCount / 3;
+            }
+            else {
+                // Same draw, but the occlusion cull pass decides whether instanceCount is 0 or 1
+                vk::DeviceSize drawOffset = (m_occlusionCulling.getFirstDraw(objectIdx) + i) * sizeof(vk::DrawIndexedIndirectCommand);
+                if (drawPhaseOne) {
+                    commandBuffer.drawIndexedIndirect(phaseOneDraws, drawOffset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+                    indirectDraws++;
+                }
+                if (drawPhaseTwo) {
+                    commandBuffer.drawIndexedIndirect(phaseTwoDraws, drawOffset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+                    indirectDraws++;
+                }
+            }
         }
     }
 
     commandBuffer.endRendering();
 
-#if defined(IMGUI_ENABLED)
-    //gotta render imgui's UI separately
-    vk::RenderingAttachmentInfo uiColourAtt{};
-    uiColourAtt
-        .setImageView(m_swapChain.getImageViews()[imageIndex])
-        .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-        .setLoadOp(vk::AttachmentLoadOp::eLoad)     // keep what scene wrote
-        .setStoreOp(vk::AttachmentStoreOp::eStore);
-
-    vk::RenderingInfo uiRi{};
-    uiRi
-        .setRenderArea({ {0,0}, m_swapChain.getExtent() })
-        .setLayerCount(1)
-        .setColorAttachmentCount(1)
-        .setPColorAttachments(&uiColourAtt)
-        .setPDepthAttachment(nullptr);
-    commandBuffer.beginRendering(uiRi);
-
-    ImGui::Render();
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
-
-    commandBuffer.endRendering();
-#endif
-
-    Craig::ImageHelpers::transitionSwapImage(commandBuffer, m_swapChain.getImages()[imageIndex], vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
-
-    try {
-        commandBuffer.end();
-    }
-    catch (const vk::SystemError& err) {
-        throw std::runtime_error("failed to record command buffer!");
-    }
-
-
+    CRAIG_COUNT(eDescriptorSetBinds, descriptorSetBinds);
+    CRAIG_COUNT(ePushConstants, pushConstants);
+    CRAIG_COUNT(ePushConstantBytes, pushConstants * sizeof(uint32_t));
+    CRAIG_COUNT(eDrawCalls, directDraws + indirectDraws);
+    CRAIG_COUNT(eIndirectDraws, indirectDraws);
+    CRAIG_COUNT(eTriangles, triangles);
 }
 
 void Craig::Renderer::createVertexBuffer() {
@@ -439,17 +1019,8 @@ void Craig::Renderer::createVertexBuffer() {
 
     // Pass 1: assign a global vertexOffset to every submesh across every model,
     // so the single shared vertex buffer holds all geometry in sequence.
-    uint32_t totalVertexCount = 0;
-    for (Craig::GameObject* gameObject : currentSceneObjects)
-    {
-        Craig::Model& model = resources.getModel(gameObject->getModelPath());
-        for (size_t i = 0; i < model.subMeshesCount; i++)
-        {
-            Craig::SubMesh* submesh = model.subMeshes[i];
-            submesh->vertexOffset = totalVertexCount;
-            totalVertexCount += static_cast<uint32_t>(submesh->m_vertices.size());
-        }
-    }
+    std::vector<Craig::Model*> models = resources.getModelsUsedBy(currentSceneObjects);
+    uint32_t totalVertexCount = Craig::ResourceManager::assignVertexOffsets(models);
 
     if (totalVertexCount == 0) {
         return;
@@ -457,6 +1028,9 @@ void Craig::Renderer::createVertexBuffer() {
 
     vk::DeviceSize bufferSize = sizeof(Craig::Vertex) * totalVertexCount;
 
+    // The packed position stream for the depth pre-pass rides along in the same staging buffer, straight after the interleaved vertices
+    vk::DeviceSize positionBufferSize = Craig::Vertex::kPositionStride * totalVertexCount;
+
     vk::Buffer stagingBuffer{};
     VmaAllocation stagingAlloc{};
 
@@ -464,331 +1038,647 @@ void Craig::Renderer::createVertexBuffer() {
     stagingAci.usage = VMA_MEMORY_USAGE_AUTO;
     stagingAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
 
-    m_Devices.createBufferVMA(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, stagingAci, stagingBuffer, stagingAlloc);
+    m_Devices.createBufferVMA(bufferSize + positionBufferSize, vk::BufferUsageFlagBits::eTransferSrc, stagingAci, stagingBuffer, stagingAlloc, "Vertex staging");
 
     void* data;
     vmaMapMemory(m_Devices.getVmaAllocator(), stagingAlloc, &data);
 
     auto* dst = static_cast<Craig::Vertex*>(data);
+    auto* dstPositions = reinterpret_cast<float*>(static_cast<uint8_t*>(data) + bufferSize);
 
     // Pass 2: copy each submesh's vertices into the big staging buffer at the
-    // offset we assigned in pass 1. Track which models we've already copied so
-    // shared models don't get written twice.
-    std::unordered_set<std::string> copiedModels;
-    for (Craig::GameObject* gameObject : currentSceneObjects)
-    {
-        const std::string& path = gameObject->getModelPath();
-        if (!copiedModels.insert(path).second) continue;
+    // offset we assigned in pass 1.
+    Craig::ResourceManager::packVertices(models, dst, dstPositions);
 
-        Craig::Model& model = resources.getModel(path);
-        for (size_t i = 0; i < model.subMeshesCount; ++i) {
-            Craig::SubMesh* submesh = model.subMeshes[i];
-            std::vector<Craig::Vertex>& verts = submesh->m_vertices;
-            if (verts.empty()) continue;
+    vmaFlushAllocation(m_Devices.getVmaAllocator(), stagingAlloc, 0, bufferSize + positionBufferSize);
+    vmaUnmapMemory(m_Devices.getVmaAllocator(), stagingAlloc);
 
-            std::memcpy(dst + submesh->vertexOffset,
-                verts.data(),
-                sizeof(Craig::Vertex) * verts.size());
-        }
+    // Out of the defragmenter's pool so it can move them
+    VmaAllocationCreateInfo gpuAci{};
+    gpuAci.usage = VMA_MEMORY_USAGE_AUTO;
+    gpuAci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    gpuAci.pool = m_defragmenter.getBufferPool();
+
+    m_Devices.createBufferVMA(bufferSize, kVertexBufferUsage, gpuAci, m_VK_vertexBuffer, m_VMA_vertexAllocation, "Scene vertices");
+    m_defragmenter.registerBuffer(m_VMA_vertexAllocation, &m_VK_vertexBuffer, bufferSize, kVertexBufferUsage);
+
+    m_Devices.createBufferVMA(positionBufferSize, kVertexBufferUsage, gpuAci, m_VK_positionBuffer, m_VMA_positionAllocation, "Scene positions (depth pre-pass)");
+    m_defragmenter.registerBuffer(m_VMA_positionAllocation, &m_VK_positionBuffer, positionBufferSize, kVertexBufferUsage);
+
+    m_commandManager.copyBuffer(stagingBuffer, m_VK_vertexBuffer, bufferSize);
+    m_commandManager.copyBuffer(stagingBuffer, m_VK_positionBuffer, positionBufferSize, bufferSize);
+    vmaDestroyBuffer(m_Devices.getVmaAllocator(), stagingBuffer, stagingAlloc);
+}
+
+void Craig::Renderer::createIndexBuffer() {
+
+    std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
+    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+
+    // Pass 1: assign a global indexOffset to every submesh across every model.
+    std::vector<Craig::Model*> models = resources.getModelsUsedBy(currentSceneObjects);
+    uint32_t totalIndexCount = Craig::ResourceManager::assignIndexOffsets(models);
+
+    if (totalIndexCount == 0) {
+        return;
     }
 
+    vk::DeviceSize bufferSize = sizeof(uint32_t) * totalIndexCount;
+
+    vk::Buffer stagingBuffer{};
+    VmaAllocation stagingAlloc{};
+
+    VmaAllocationCreateInfo stagingAci{};
+    stagingAci.usage = VMA_MEMORY_USAGE_AUTO;
+    stagingAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+    m_Devices.createBufferVMA(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, stagingAci, stagingBuffer, stagingAlloc, "Index staging");
+
+    void* data;
+    vmaMapMemory(m_Devices.getVmaAllocator(), stagingAlloc, &data);
+
+    auto* dst = static_cast<uint32_t*>(data);
+
+    // Pass 2: copy each submesh's indices into the staging buffer.
+    Craig::ResourceManager::packIndices(models, dst);
+
     vmaFlushAllocation(m_Devices.getVmaAllocator(), stagingAlloc, 0, bufferSize);
     vmaUnmapMemory(m_Devices.getVmaAllocator(), stagingAlloc);
 
     VmaAllocationCreateInfo gpuAci{};
     gpuAci.usage = VMA_MEMORY_USAGE_AUTO;
     gpuAci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    gpuAci.pool = m_defragmenter.getBufferPool();
+
+    m_Devices.createBufferVMA(bufferSize, kIndexBufferUsage, gpuAci, m_VK_indexBuffer, m_VMA_indexAllocation, "Scene indices");
+    m_defragmenter.registerBuffer(m_VMA_indexAllocation, &m_VK_indexBuffer, bufferSize, kIndexBufferUsage);
+
+    m_commandManager.copyBuffer(stagingBuffer, m_VK_indexBuffer, bufferSize);
+    vmaDestroyBuffer(m_Devices.getVmaAllocator(), stagingBuffer, stagingAlloc);
+}
+
+// Nothing can still be drawing with them, and the defragmenter can't be in the middle of moving them
+void Craig::Renderer::destroyGeometryBuffers() {
 
-    m_Devices.createBufferVMA(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, gpuAci, m_VK_vertexBuffer, m_VMA_vertexAllocation);
+    m_defragmenter.unregister(m_VMA_indexAllocation);
+    vmaDestroyBuffer(m_Devices.getVmaAllocator(), m_VK_indexBuffer, m_VMA_indexAllocation);
+
+    m_defragmenter.unregister(m_VMA_vertexAllocation);
+    m_defragmenter.unregister(m_VMA_positionAllocation);
+    vmaDestroyBuffer(m_Devices.getVmaAllocator(), m_VK_vertexBuffer, m_VMA_vertexAllocation);
+    vmaDestroyBuffer(m_Devices.getVmaAllocator(), m_VK_positionBuffer, m_VMA_positionAllocation);
+
+    m_VK_indexBuffer = nullptr;
+    m_VK_vertexBuffer = nullptr;
+    m_VK_positionBuffer = nullptr;
+    m_VMA_indexAllocation = VK_NULL_HANDLE;
+    m_VMA_vertexAllocation = VK_NULL_HANDLE;
+    m_VMA_positionAllocation = VK_NULL_HANDLE;
+}
+
+void Craig::Renderer::createDescriptorPool() {
+
+    // Just the per-frame sets live in here now. The camera UBO is dynamic so it can point anywhere in the
+    // transient ring without the set being rewritten, and the extra sets cover the ring growing while frames are in flight.
+    std::array<vk::DescriptorPoolSize, 2> poolSizes;
+    poolSizes[0]
+        .setType(vk::DescriptorType::eUniformBufferDynamic)
+        .setDescriptorCount(kMaxFramesInFlight);
+    poolSizes[1]
+        .setType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(kMaxFramesInFlight);
+
+
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo
+        .setPoolSizes(poolSizes)
+        .setMaxSets(kMaxFramesInFlight);
+
+    m_VK_descriptorPool = m_Devices.getLogicalDevice().createDescriptorPool(poolInfo);
+
+}
+
+// Texture sets are per model, not per object, so their count has nothing to do with how big the scene is.
+// Pools get chained on as we run out rather than being sized up front.
+void Craig::Renderer::createModelDescriptorPool() {
+
+    vk::DescriptorPoolSize poolSize{};
+    poolSize
+        .setType(vk::DescriptorType::eCombinedImageSampler)
+        .setDescriptorCount(kModelDescriptorPoolSize);
+
+    // Sets only get freed when the defragmenter moves a model's texture and it gets a new one
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo
+        .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+        .setPoolSizes(poolSize)
+        .setMaxSets(kModelDescriptorPoolSize);
+
+    mv_VK_modelDescriptorPools.push_back(m_Devices.getLogicalDevice().createDescriptorPool(poolInfo));
+}
+
+//for my own sanity
+//descriptor sets are basically just the way we pass stuff to the shaders/GPU, so in my case i have 2 descriptor sets, one with the UBO and one with the image sampler
+void Craig::Renderer::createDescriptorSets() {
+
+    std::vector<vk::DescriptorSetLayout> perFramelayouts(kMaxFramesInFlight, m_pipeline.getPerFrameDescriptorSetLayout());
+
+    vk::DescriptorSetAllocateInfo perFrameAllocInfo{};
+    perFrameAllocInfo.setDescriptorPool(m_VK_descriptorPool)
+        .setDescriptorSetCount(kMaxFramesInFlight)
+        .setSetLayouts(perFramelayouts);
+
+    mv_VK_perFrameDescriptorSet = m_Devices.getLogicalDevice().allocateDescriptorSets(perFrameAllocInfo);
+
+    for (uint32_t frame = 0; frame < kMaxFramesInFlight; frame++)
+    {
+        writePerFrameDescriptorSet(frame);
+    }
+
+    std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
+    for (Craig::GameObject* gameObject : currentSceneObjects)
+    {
+        getModelDescriptorSet(gameObject->getModelPath());
+    }
+
+}
+
+// Points a frame's set at the current transient ring buffer and that frame's object SSBO.
+// Only ever called for a frame the GPU has finished with, so the set isn't in use.
+void Craig::Renderer::writePerFrameDescriptorSet(uint32_t frame) {
+
+    std::array<vk::WriteDescriptorSet, 2> perFrameWrites{};
+
+    // Dynamic, the offset into the ring gets passed in when it's bound
+    vk::DescriptorBufferInfo cameraBufferInfo{};
+    cameraBufferInfo.setBuffer(m_transientRing.getBuffer())
+        .setOffset(0)
+        .setRange(sizeof(CameraData));
+
+    vk::DescriptorBufferInfo modelUboBufferInfo{};
+    modelUboBufferInfo.setBuffer(mv_VK_storageBuffers[frame])
+        .setOffset(0)
+        .setRange(VK_WHOLE_SIZE);
+
+    perFrameWrites[0]
+        .setDstSet(mv_VK_perFrameDescriptorSet[frame])
+        .setDstBinding(0)
+        .setDstArrayElement(0)
+        .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+        .setDescriptorCount(1)
+        .setBufferInfo(cameraBufferInfo);
+    perFrameWrites[1]
+        .setDstSet(mv_VK_perFrameDescriptorSet[frame])
+        .setDstBinding(1)
+        .setDstArrayElement(0)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(1)
+        .setBufferInfo(modelUboBufferInfo);
+
+    m_Devices.getLogicalDevice().updateDescriptorSets(perFrameWrites, nullptr);
+
+    m_perFrameSetRingGeneration[frame] = m_transientRing.getGeneration();
+}
+
+// One texture set per model, made the first time something using that model shows up
+vk::DescriptorSet Craig::Renderer::getModelDescriptorSet(const std::string& modelPath) {
+
+    auto it = mMap_ModelToDescriptorSet.find(modelPath);
+    if (it != mMap_ModelToDescriptorSet.end()) {
+        return it->second;
+    }
+
+    vk::DescriptorSet modelSet = allocateModelDescriptorSet(modelPath);
+
+    // The model's settled in the resource manager's map by now, so its texture won't move out from under the pointers
+    Craig::Texture& texture = Craig::ResourceManager::getInstance().getModel(modelPath).m_texture;
+    m_defragmenter.registerImage(texture.m_VMA_textureImageAllocation, &texture.m_VK_textureImage, &texture.m_VK_textureImageView, vk::Format::eR8G8B8A8Srgb,
+        texture.m_extent, texture.m_VK_mipLevels, kTextureImageUsage, vk::ImageLayout::eShaderReadOnlyOptimal, [this, modelPath]() {
+            replaceModelDescriptorSet(modelPath);
+        });
+
+    return modelSet;
+}
+
+vk::DescriptorSet Craig::Renderer::allocateModelDescriptorSet(const std::string& modelPath) {
+
+    if (mv_VK_modelDescriptorPools.empty() || m_modelSetsInCurrentPool == kModelDescriptorPoolSize) {
+        createModelDescriptorPool();
+        m_modelSetsInCurrentPool = 0;
+    }
+
+    vk::DescriptorSetLayout objectLayout = m_pipeline.getPerObjectDescriptorSetLayout();
+
+    vk::DescriptorSetAllocateInfo modelAllocInfo{};
+    modelAllocInfo.setDescriptorPool(mv_VK_modelDescriptorPools.back())
+        .setDescriptorSetCount(1)
+        .setSetLayouts(objectLayout);
+
+    vk::DescriptorSet modelSet = m_Devices.getLogicalDevice().allocateDescriptorSets(modelAllocInfo).front();
+    m_modelSetsInCurrentPool++;
+
+    mMap_ModelToDescriptorSet[modelPath] = modelSet;
+    mMap_ModelToDescriptorPool[modelPath] = mv_VK_modelDescriptorPools.back();
+    writeModelDescriptorSet(modelPath, modelSet);
+
+    return modelSet;
+}
+
+// The defragmenter's moved the model's texture. The old set can still be bound by a frame in flight so it can't be
+// written to, the model gets a new one and the old one goes back to its pool once those frames are done.
+void Craig::Renderer::replaceModelDescriptorSet(const std::string& modelPath) {
+
+    vk::Device device = m_Devices.getLogicalDevice();
+    vk::DescriptorSet oldSet = mMap_ModelToDescriptorSet[modelPath];
+    vk::DescriptorPool oldPool = mMap_ModelToDescriptorPool[modelPath];
+
+    m_deletionQueue.push([=]() {
+        device.freeDescriptorSets(oldPool, oldSet);
+    });
+
+    allocateModelDescriptorSet(modelPath);
+}
+
+void Craig::Renderer::writeModelDescriptorSet(const std::string& modelPath, vk::DescriptorSet modelSet) {
+
+    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+
+    vk::DescriptorImageInfo imageInfo{};
+    imageInfo
+        .setImageView(resources.getModel(modelPath).m_texture.m_VK_textureImageView)
+        .setSampler(m_VK_textureSampler)
+        .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    vk::WriteDescriptorSet descriptorWrite{};
+    descriptorWrite
+        .setDstSet(modelSet)
+        .setDstBinding(0)
+        .setDstArrayElement(0)
+        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+        .setDescriptorCount(1)
+        .setImageInfo(imageInfo);
 
-    m_commandManager.copyBuffer(stagingBuffer, m_VK_vertexBuffer, bufferSize);
-    vmaDestroyBuffer(m_Devices.getVmaAllocator(), stagingBuffer, stagingAlloc);
+    m_Devices.getLogicalDevice().updateDescriptorSets(descriptorWrite, nullptr);
 }
 
-void Craig::Renderer::createIndexBuffer() {
-
-    std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
-    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+void Craig::Renderer::updateDescriptorSets() {
 
-    // Pass 1: assign a global indexOffset to every submesh across every model.
-    uint32_t totalIndexCount = 0;
-    for (Craig::GameObject* gameObject : currentSceneObjects)
+    // Called when the sampler is recreated (e.g. LOD change). Texture sets are per model, so one pass
+    // over the models rewriting their sampler binding is enough.
+    for (auto& [modelPath, modelSet] : mMap_ModelToDescriptorSet)
     {
-        Craig::Model& model = resources.getModel(gameObject->getModelPath());
-        for (size_t i = 0; i < model.subMeshesCount; ++i) {
-            Craig::SubMesh* submesh = model.subMeshes[i];
-            submesh->indexOffset = totalIndexCount;
-            totalIndexCount += static_cast<uint32_t>(submesh->m_indices.size());
-        }
+        writeModelDescriptorSet(modelPath, modelSet);
     }
 
-    if (totalIndexCount == 0) {
-        return;
-    }
+}
 
-    vk::DeviceSize bufferSize = sizeof(uint32_t) * totalIndexCount;
+// Sets up the big SSBO holding every object's model matrix (kMaxFramesInFlight copies so the CPU and GPU aren't
+// fighting over the same memory) and the transient ring the camera's view/proj gets written into each frame.
+void Craig::Renderer::createUniformBuffers() {
 
-    vk::Buffer stagingBuffer{};
-    VmaAllocation stagingAlloc{};
+    // The SSBO: one big array holding per-object data (just model matrix for now). One buffer per frame-in-flight,
+    // they start at kInitialObjectCapacity and double whenever the scene outgrows them.
+    mv_VK_storageBuffers.resize(kMaxFramesInFlight);
+    mv_VK_storageBuffersAllocations.resize(kMaxFramesInFlight);
+    mv_VK_storageBuffersMapped.resize(kMaxFramesInFlight);
+    mv_storageBufferCapacity.resize(kMaxFramesInFlight);
 
-    VmaAllocationCreateInfo stagingAci{};
-    stagingAci.usage = VMA_MEMORY_USAGE_AUTO;
-    stagingAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    size_t initialCapacity = std::max<size_t>(kInitialObjectCapacity, mp_SceneManager->getCurrentScene()->getGameObjects().size());
+    for (uint32_t i = 0; i < kMaxFramesInFlight; i++)
+    {
+        createStorageBuffer(i, initialCapacity);
+    }
 
-    m_Devices.createBufferVMA(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, stagingAci, stagingBuffer, stagingAlloc);
 
-    void* data;
-    vmaMapMemory(m_Devices.getVmaAllocator(), stagingAlloc, &data);
+    // Camera data changes every frame, so it comes out of the transient ring instead of having its own buffers.
+    // Offsets into it have to respect the UBO alignment since they're used as dynamic offsets.
+    m_uniformBufferAlignment = m_Devices.getPhysicalDevice().getProperties().limits.minUniformBufferOffsetAlignment;
 
-    auto* dst = static_cast<uint32_t*>(data);
+    RingAllocator::RingAllocatorInitInfo ringInitInfo;
+    ringInitInfo.p_Device = &m_Devices;
+    ringInitInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
 
-    // Pass 2: copy each submesh's indices into the staging buffer. Indices are
-    // submesh-local; drawIndexed's vertexOffset parameter applies the global
-    // vertex offset at draw time.
-    std::unordered_set<std::string> copiedModels;
-    for (Craig::GameObject* gameObject : currentSceneObjects)
-    {
-        const std::string& path = gameObject->getModelPath();
-        if (!copiedModels.insert(path).second) continue;
+    m_transientRing.init(ringInitInfo);
 
-        Craig::Model& model = resources.getModel(path);
-        for (size_t i = 0; i < model.subMeshesCount; ++i) {
-            Craig::SubMesh* submesh = model.subMeshes[i];
-            std::vector<uint32_t>& indices = submesh->m_indices;
-            if (indices.empty()) continue;
+}
 
-            std::memcpy(dst + submesh->indexOffset,
-                indices.data(),
-                sizeof(uint32_t) * indices.size());
-        }
+// Host visible + mapped so we can just write into it from the CPU every frame, no staging buffer needed.
+// Only called for a frame the GPU is done with, so the old buffer can go straight away.
+void Craig::Renderer::createStorageBuffer(uint32_t frame, size_t objectCapacity) {
+
+    if (mv_VK_storageBuffers[frame]) {
+        vmaDestroyBuffer(m_Devices.getVmaAllocator(), mv_VK_storageBuffers[frame], mv_VK_storageBuffersAllocations[frame]);
     }
 
-    vmaFlushAllocation(m_Devices.getVmaAllocator(), stagingAlloc, 0, bufferSize);
-    vmaUnmapMemory(m_Devices.getVmaAllocator(), stagingAlloc);
+    VmaAllocationCreateInfo stagingAci{};
+    stagingAci.usage = VMA_MEMORY_USAGE_AUTO;
+    stagingAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    stagingAci.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-    VmaAllocationCreateInfo gpuAci{};
-    gpuAci.usage = VMA_MEMORY_USAGE_AUTO;
-    gpuAci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    VmaAllocationInfo info{};
+    m_Devices.createBufferVMA(objectCapacity * sizeof(PerObjectData), vk::BufferUsageFlagBits::eStorageBuffer, stagingAci, mv_VK_storageBuffers[frame], mv_VK_storageBuffersAllocations[frame], "Per-object SSBO", &info);
+
+    mv_VK_storageBuffersMapped[frame] = info.pMappedData;
+    mv_storageBufferCapacity[frame] = objectCapacity;
+}
 
-    m_Devices.createBufferVMA(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, gpuAci, m_VK_indexBuffer, m_VMA_indexAllocation);
+// Moves the camera for this frame. Done before culling and recording, so the frustum we cull
+// against is the same one the GPU ends up rendering with.
+void Craig::Renderer::updateCamera(const float& deltaTime) {
 
-    m_commandManager.copyBuffer(stagingBuffer, m_VK_indexBuffer, bufferSize);
-    vmaDestroyBuffer(m_Devices.getVmaAllocator(), stagingBuffer, stagingAlloc);
+    Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
+
+    camera.m_aspect = m_swapChain.getExtent().width / (float)m_swapChain.getExtent().height;
+    camera.update(deltaTime);
 }
 
-void Craig::Renderer::createDescriptorPool() {
+// Pushes every object's world space bounding sphere into the culler and runs it.
+// recordCommandBuffer then skips anything that came back invisible.
+// Last thing before submit. Any input that's come in since the start of the frame goes to the camera and the
+// camera data gets written again over the slot the command buffer already points at. The ring's host coherent
+// and the submit hasn't happened yet, so the GPU sees this version. The CPU cull still went off the earlier camera,
+// which is why it uses a padded frustum. Skipped while occlusion culling's on, see isLateLatchActive.
+void Craig::Renderer::latchCamera() {
 
-    std::array<vk::DescriptorPoolSize, 3> poolSizes;
-    poolSizes[0]
-        .setType(vk::DescriptorType::eUniformBuffer)
-        .setDescriptorCount(kMaxFramesInFlight);
-    poolSizes[1]
-        .setType(vk::DescriptorType::eStorageBuffer)
-        .setDescriptorCount(kMaxFramesInFlight);
-    poolSizes[2]
-        .setType(vk::DescriptorType::eCombinedImageSampler)
-        .setDescriptorCount(kMaxNumObjects);
+    CRAIG_PROFILE_ZONE("Renderer::latchCamera");
 
+    if (isLateLatchActive()) {
+        if (mp_CurrentWindow != nullptr) {
+            mp_CurrentWindow->latchInput();
+        }
 
-    vk::DescriptorPoolCreateInfo poolInfo{};
-    poolInfo
-        .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
-        .setPoolSizes(poolSizes)
-        .setMaxSets(kMaxFramesInFlight + kMaxNumObjects);
+        Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
+        camera.latch();
 
-    m_VK_descriptorPool = m_Devices.getLogicalDevice().createDescriptorPool(poolInfo);
+        CameraData viewProjUbo;
+        viewProjUbo.view = camera.getView();
+        viewProjUbo.proj = camera.getProj();
+        memcpy(mp_cameraDataMapped, &viewProjUbo, sizeof(viewProjUbo));
+    }
 
+    m_frameLatchTime = isLateLatchActive() ? std::chrono::steady_clock::now() : m_cameraWriteTime;
+    m_frameInputTime = (mp_CurrentWindow != nullptr) ? mp_CurrentWindow->takePendingInputTime() : std::nullopt;
 }
 
-//for my own sanity
-//descriptor sets are basically just the way we pass stuff to the shaders/GPU, so in my case i have 2 descriptor sets, one with the UBO and one with the image sampler
-void Craig::Renderer::createDescriptorSets() {
+void Craig::Renderer::recordInputLatency(std::chrono::steady_clock::time_point submitTime, std::chrono::steady_clock::time_point presentTime) {
 
-    std::vector<vk::DescriptorSetLayout> perFramelayouts(kMaxFramesInFlight, m_pipeline.getPerFrameDescriptorSetLayout());
+    if (!m_frameInputTime.has_value()) {
+        return; // Nothing new in this frame
+    }
 
-    vk::DescriptorSetAllocateInfo perFrameAllocInfo{};
-    perFrameAllocInfo.setDescriptorPool(m_VK_descriptorPool)
-        .setDescriptorSetCount(kMaxFramesInFlight)
-        .setSetLayouts(perFramelayouts);
+    auto sinceInput = [this](std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration<float, std::milli>(time - m_frameInputTime.value()).count();
+    };
 
-    mv_VK_perFrameDescriptorSet = m_Devices.getLogicalDevice().allocateDescriptorSets(perFrameAllocInfo);
-    std::array<vk::WriteDescriptorSet, 2> perFrameWrites{};
+    InputLatency latency;
+    latency.toAcquireMs = sinceInput(m_frameAcquireTime);
+    latency.toLatchMs = sinceInput(m_frameLatchTime);
+    latency.toSubmitMs = sinceInput(submitTime);
+    latency.toPresentMs = sinceInput(presentTime);
+    m_inputLatencyStats.last = latency;
+    m_frameInputTime.reset();
+
+    m_inputLatencySum.toAcquireMs += latency.toAcquireMs;
+    m_inputLatencySum.toLatchMs += latency.toLatchMs;
+    m_inputLatencySum.toSubmitMs += latency.toSubmitMs;
+    m_inputLatencySum.toPresentMs += latency.toPresentMs;
+    m_inputLatencyWindowMax = std::max(m_inputLatencyWindowMax, latency.toPresentMs);
+    m_inputLatencyWindowSamples++;
+
+    if (m_inputLatencyWindowSamples < kInputLatencyWindowFrames) {
+        return;
+    }
 
-    for (size_t frame = 0; frame < kMaxFramesInFlight; frame++)
-    {
-        vk::DescriptorBufferInfo cameraBufferInfo{};
-        cameraBufferInfo.setBuffer(mv_viewProjUboBuffer[frame])
-            .setOffset(0)
-            .setRange(sizeof(CameraData));
-
-        vk::DescriptorBufferInfo modelUboBufferInfo{};
-        modelUboBufferInfo.setBuffer(mv_VK_storageBuffers[frame])
-            .setOffset(0)
-            .setRange(sizeof(PerObjectData) * kMaxNumObjects);
-
-        perFrameWrites[0]
-            .setDstSet(mv_VK_perFrameDescriptorSet[frame])
-            .setDstBinding(0)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-            .setDescriptorCount(1)
-            .setBufferInfo(cameraBufferInfo);
-        perFrameWrites[1]
-            .setDstSet(mv_VK_perFrameDescriptorSet[frame])
-            .setDstBinding(1)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
-            .setDescriptorCount(1)
-            .setBufferInfo(modelUboBufferInfo);
-
-        m_Devices.getLogicalDevice().updateDescriptorSets(perFrameWrites, nullptr);
+    float samples = static_cast<float>(m_inputLatencyWindowSamples);
+    m_inputLatencyStats.average.toAcquireMs = m_inputLatencySum.toAcquireMs / samples;
+    m_inputLatencyStats.average.toLatchMs = m_inputLatencySum.toLatchMs / samples;
+    m_inputLatencyStats.average.toSubmitMs = m_inputLatencySum.toSubmitMs / samples;
+    m_inputLatencyStats.average.toPresentMs = m_inputLatencySum.toPresentMs / samples;
+    m_inputLatencyStats.maxToPresentMs = m_inputLatencyWindowMax;
+    m_inputLatencyStats.samples = m_inputLatencyWindowSamples;
+
+    m_inputLatencySum = InputLatency{};
+    m_inputLatencyWindowMax = 0.0f;
+    m_inputLatencyWindowSamples = 0;
+}
+
+void Craig::Renderer::cullScene() {
+
+    CRAIG_PROFILE_ZONE("Renderer::cullScene");
+
+    if (!m_cullingEnabled) {
+        return;
     }
 
     std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
-    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
-    size_t numObjects = currentSceneObjects.size();
+    Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
+
+    m_culling.resize(currentSceneObjects.size());
+    for (size_t i = 0; i < currentSceneObjects.size(); i++) {
+        m_culling.setSphere(i, currentSceneObjects[i]->getWorldBoundingSphere());
+    }
 
-    std::vector<vk::DescriptorSetLayout> perObjectLayouts(numObjects, m_pipeline.getPerObjectDescriptorSetLayout());
+    Culling::CullingView cullingView;
+    cullingView.view = camera.getView();
+    // The late latch can turn the camera a little after this, so cull for a slightly wider view than we've got
+    cullingView.proj = isLateLatchActive() ? camera.getPaddedProj(kLateLatchCullFovPadding) : camera.getProj();
+    cullingView.cameraPosition = camera.getPosition();
+    cullingView.viewportHeight = static_cast<float>(m_swapChain.getExtent().height);
+    cullingView.minPixelSize = m_minPixelSize;
 
-    vk::DescriptorSetAllocateInfo perObjectAllocInfo{};
-    perObjectAllocInfo.setDescriptorPool(m_VK_descriptorPool)
-        .setDescriptorSetCount(numObjects)
-        .setSetLayouts(perObjectLayouts);
+    m_culling.cull(cullingView);
+}
 
+// Fills this frame's occlusion culling buffers: every object's bounding sphere plus where its draws live,
+// and one indirect draw per submesh. The cull shader switches the draws on and off from there.
+void Craig::Renderer::updateOcclusionData(uint32_t currentFrame) {
 
-    std::array<vk::WriteDescriptorSet, 1> perObjectWrites{};
-    auto perObjectSets = m_Devices.getLogicalDevice().allocateDescriptorSets(perObjectAllocInfo);
-    for (size_t object = 0; object < numObjects; object++)
-    {
-        mMap_GameObjectToDescriptorSet.insert({currentSceneObjects[object], perObjectSets[object]});
-        vk::DescriptorImageInfo imageInfo{};
-        imageInfo
-            .setImageView(resources.getModel(currentSceneObjects[object]->getModelPath()).m_texture.m_VK_textureImageView)
-            .setSampler(m_VK_textureSampler)
-            .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    if (!isOcclusionCullingActive()) {
+        return;
+    }
 
-        perObjectWrites[0]
-            //.setDstSet(currentSceneObjects[object]->getDescriptorSet())
-            .setDstSet(mMap_GameObjectToDescriptorSet[currentSceneObjects[object]])
-            .setDstBinding(0)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-            .setDescriptorCount(1)
-            .setImageInfo(imageInfo);
+    std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
+    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
 
-        m_Devices.getLogicalDevice().updateDescriptorSets(perObjectWrites, nullptr);
+    size_t numDraws = 0;
+    for (Craig::GameObject* gameObject : currentSceneObjects) {
+        numDraws += resources.getModel(gameObject->getModelPath()).subMeshesCount;
     }
 
+    m_occlusionCulling.beginFrame(currentFrame, currentSceneObjects.size(), numDraws);
 
+    uint32_t drawIndex = 0;
+    for (size_t objectIdx = 0; objectIdx < currentSceneObjects.size(); objectIdx++) {
+        Craig::GameObject* gameObject = currentSceneObjects[objectIdx];
+        Craig::Model& model = resources.getModel(gameObject->getModelPath());
 
-}
+        bool frustumVisible = !m_cullingEnabled || m_culling.isVisible(objectIdx);
+        m_occlusionCulling.setObject(currentFrame, objectIdx, gameObject->getWorldBoundingSphere(), drawIndex, static_cast<uint32_t>(model.subMeshesCount), frustumVisible);
 
-void Craig::Renderer::updateDescriptorSets() {
+        for (size_t i = 0; i < model.subMeshesCount; i++) {
+            Craig::SubMesh* submesh = model.subMeshes[i];
+            m_occlusionCulling.setDraw(currentFrame, drawIndex++, submesh->indexCount, submesh->indexOffset, static_cast<int32_t>(submesh->vertexOffset));
+        }
+    }
+}
 
-    // Called when the sampler is recreated (e.g. LOD change). Per-object sets aren't duplicated per
-    // frame, so one pass over the gameobjects rewriting their sampler binding is enough.
-    std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
-    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+// Called once this frame's fence has been waited on, so the results are either there or the frame was never recorded.
+// The profiler keeps its own stats, the scene time also gets split by whether the pre-pass was on.
+// The pipeline statistics come back the same way.
+void Craig::Renderer::readGpuTimings(uint32_t currentFrame) {
 
-    for (Craig::GameObject* gameObject : currentSceneObjects)
-    {
-        vk::DescriptorImageInfo imageInfo{};
-        imageInfo
-            .setImageView(resources.getModel(gameObject->getModelPath()).m_texture.m_VK_textureImageView)
-            .setSampler(m_VK_textureSampler)
-            .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    m_pipelineStatistics.collectFrame(currentFrame);
 
-        vk::WriteDescriptorSet descriptorWrite{};
-        descriptorWrite
-            //.setDstSet(gameObject->getDescriptorSet())
-            .setDstSet(mMap_GameObjectToDescriptorSet[gameObject])
-            .setDstBinding(0)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-            .setDescriptorCount(1)
-            .setImageInfo(imageInfo);
+    if (!m_gpuProfiler.collectFrame(currentFrame)) {
+        return;
+    }
 
-        m_Devices.getLogicalDevice().updateDescriptorSets(descriptorWrite, nullptr);
+    // This slot was last recorded a whole lap of the frames in flight ago
+    const std::vector<Craig::GpuProfiler::ScopeStats>& scopes = m_gpuProfiler.getScopes();
+    const std::vector<float>& frameMs = m_gpuProfiler.getLastFrameMs();
+    for (uint32_t i = 0; i < scopes.size() && i < frameMs.size(); i++) {
+        if (frameMs[i] >= 0.0f) {
+            Craig::FlightRecorder::getInstance().recordGpuScope(i, scopes[i].name, frameMs[i], m_syncManager.getFramesInFlight());
+        }
     }
 
+    float sceneMs = m_gpuProfiler.getLastMs("Scene");
+    float& average = m_timestampFrameUsedPrePass[currentFrame] ? m_sceneGpuTimes.withPrePassMs : m_sceneGpuTimes.withoutPrePassMs;
+    average = (average == 0.0f) ? sceneMs : average + (sceneMs - average) * kGpuTimeSmoothing;
 }
 
-// Sets up our two GPU buffers: the big SSBO holding every object's model matrix, and a tiny UBO for the camera's view/proj.
-// We make kMaxFramesInFlight copies of each so the CPU and GPU aren't fighting over the same memory.
-void Craig::Renderer::createUniformBuffers() {
+// Picks up a capture whose frame has just been waited on. The ones meant for PNGs get passed straight to the writer
+// thread, which does the conversion as well, so the frame itself never touches the pixels.
+void Craig::Renderer::updateFrameCapture(uint32_t currentFrame) {
 
-    // Host visible + mapped so we can just write into it from the CPU every frame, no staging buffer needed.
-    VmaAllocationCreateInfo stagingAci{};
-    stagingAci.usage = VMA_MEMORY_USAGE_AUTO;
-    stagingAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
-    stagingAci.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    m_frameCapture.collectFrame(currentFrame);
 
-    // The SSBO: one big array holding per-object data (just model matrix for now). One buffer per frame-in-flight,
-    // oversized for kMaxNumObjects so adding/removing gameobjects doesn't need a reallocation.
-    mv_VK_storageBuffers.resize(kMaxFramesInFlight);
-    mv_VK_storageBuffersAllocations.resize(kMaxFramesInFlight);
-    mv_VK_storageBuffersMapped.resize(kMaxFramesInFlight);
+    if (m_frameCapture.hasCapture() && (m_saveNextCapture || m_captureInterval > 0)) {
+        m_saveNextCapture = false;
 
-    vk::DeviceSize storageBufferSize = kMaxNumObjects * sizeof(PerObjectData);
-    for (size_t i = 0; i < kMaxFramesInFlight; i++)
-    {
-        VmaAllocationInfo info{};
-        m_Devices.createBufferVMA(storageBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, stagingAci, mv_VK_storageBuffers[i], mv_VK_storageBuffersAllocations[i], &info);
+        char path[256];
+        snprintf(path, sizeof(path), "%s/capture_%06u.png", kFrameCaptureDirectory, m_capturesSaved + m_capturesDropped);
+        if (m_frameCapture.saveCaptureAsync(path)) {
+            m_capturesSaved++;
+        }
+        else {
+            m_capturesDropped++;
+        }
+    }
 
-        mv_VK_storageBuffersMapped[i] = info.pMappedData;
+    if (m_captureInterval > 0 && ++m_framesSinceCapture >= m_captureInterval && requestFrameCapture()) {
+        m_framesSinceCapture = 0;
     }
+}
 
+// Hands whatever the scene moved this frame to every frame in flight's upload queue.
+// Done before anything in drawFrame can bail out, otherwise a skipped frame would lose track of what moved.
+void Craig::Renderer::queueObjectUploads() {
 
-    // The camera UBO: tiny, just view + proj. Still one per frame-in-flight though, the camera moves every frame so
-    // the GPU might still be reading last frame's copy while we write the new one.
-    mv_viewProjUboBuffer.resize(kMaxFramesInFlight);
-    mv_viewProjUboAllocation.resize(kMaxFramesInFlight);
-    mv_viewProjUboMap.resize(kMaxFramesInFlight);
+    Craig::Scene* currentScene = mp_SceneManager->getCurrentScene();
+    size_t numObjects = currentScene->getGameObjects().size();
 
-    vk::DeviceSize viewProjBufferSize = sizeof(CameraData);
-    for (size_t i = 0; i < kMaxFramesInFlight; i++)
-    {
-        VmaAllocationInfo info2{};
-        m_Devices.createBufferVMA(viewProjBufferSize, vk::BufferUsageFlagBits::eUniformBuffer, stagingAci, mv_viewProjUboBuffer[i], mv_viewProjUboAllocation[i], &info2);
-        mv_viewProjUboMap[i] = info2.pMappedData;
-    }
+    for (Craig::GameObject* gameObject : currentScene->getUpdatedObjects()) {
+        uint32_t slot = gameObject->getSceneIndex();
+        if (slot >= numObjects) {
+            continue;
+        }
 
+        for (ObjectUploadState& uploadState : m_objectUploads) {
+            uploadState.pendingSlots.push_back(slot);
+        }
+    }
 
+    // If frames keep getting skipped the queues would grow forever, past a full scene's worth just rewrite the lot
+    for (ObjectUploadState& uploadState : m_objectUploads) {
+        if (uploadState.pendingSlots.size() > numObjects) {
+            uploadState.pendingSlots.clear();
+            uploadState.structureVersion = UINT64_MAX;
+        }
+    }
 }
 
 // UBO deals with where a thing is and how to project it, but the thing itself is held within the vertex buffer.
 // Only writes to currentImage's buffers cos the other frame-in-flight copies might still be in use by the GPU.
-void Craig::Renderer::updateUniformBuffer(uint32_t currentImage, const float& deltaTime) {
-
-    Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
+void Craig::Renderer::updateUniformBuffer(uint32_t currentImage) {
 
-    camera.m_aspect = m_swapChain.getExtent().width / (float)m_swapChain.getExtent().height;
+    CRAIG_PROFILE_ZONE("Renderer::updateUniformBuffer");
 
-    std::vector<Craig::GameObject*>& currentSceneObjects = mp_SceneManager->getCurrentScene()->getGameObjects();
-    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+    Craig::Camera& camera = mp_SceneManager->getCurrentScene()->getCamera();
 
-    camera.update(deltaTime);
+    Craig::Scene* currentScene = mp_SceneManager->getCurrentScene();
+    std::vector<Craig::GameObject*>& currentSceneObjects = currentScene->getGameObjects();
+    ObjectUploadState& uploadState = m_objectUploads[currentImage];
 
     // Write each gameobject's current model matrix into its slot in this frame's SSBO.
     // The shader will index into this array to grab the right transform for the object it's drawing.
+    // Each frame in flight has its own copy, so each one remembers which version of every transform it's holding
+    // and only the ones that moved since this copy was last written get touched.
+    bool rewriteSet = (m_perFrameSetRingGeneration[currentImage] != m_transientRing.getGeneration());
+
+    // Outgrew this frame's copy. The GPU's done with it, so swap it for one twice the size, no waiting needed.
+    if (currentSceneObjects.size() > mv_storageBufferCapacity[currentImage]) {
+        createStorageBuffer(currentImage, std::max(currentSceneObjects.size(), mv_storageBufferCapacity[currentImage] * 2));
+        uploadState.structureVersion = UINT64_MAX;
+        rewriteSet = true;
+    }
+
     auto* dst = static_cast<PerObjectData*>(mv_VK_storageBuffersMapped[currentImage]);
-    for (size_t gObj = 0; gObj < currentSceneObjects.size(); gObj++)
-    {
-        dst[gObj].model = currentSceneObjects[gObj]->GetModelMatrix();
+    m_objectsUploadedLastFrame = 0;
+
+    if (uploadState.structureVersion != currentScene->getStructureVersion()) {
+        // Objects were added, removed or reordered, every slot might be wrong now
+        uploadState.uploadedVersions.resize(currentSceneObjects.size());
+        for (size_t gObj = 0; gObj < currentSceneObjects.size(); gObj++)
+        {
+            dst[gObj].model = currentSceneObjects[gObj]->GetModelMatrix();
+            uploadState.uploadedVersions[gObj] = currentSceneObjects[gObj]->getTransformVersion();
+        }
+
+        uploadState.structureVersion = currentScene->getStructureVersion();
+        m_objectsUploadedLastFrame = static_cast<uint32_t>(currentSceneObjects.size());
+    }
+    else {
+        for (uint32_t slot : uploadState.pendingSlots)
+        {
+            Craig::GameObject* gameObject = currentSceneObjects[slot];
+            if (uploadState.uploadedVersions[slot] == gameObject->getTransformVersion()) {
+                continue; // Already written, it's been queued more than once
+            }
+
+            dst[slot].model = gameObject->GetModelMatrix();
+            uploadState.uploadedVersions[slot] = gameObject->getTransformVersion();
+            m_objectsUploadedLastFrame++;
+        }
     }
 
+    uploadState.pendingSlots.clear();
+    CRAIG_COUNT(eObjectsUploaded, m_objectsUploadedLastFrame);
+
 
     // View and proj are the same for every object this frame, so we write them once into the camera UBO rather than
     // stuffing a copy into every object's slot.
     CameraData viewProjUbo;
     viewProjUbo.view = camera.getView();
     viewProjUbo.proj = camera.getProj();
-    memcpy(mv_viewProjUboMap[currentImage], &viewProjUbo, sizeof(viewProjUbo));
+
+    RingAllocator::Allocation cameraAllocation = m_transientRing.allocate(sizeof(CameraData), m_uniformBufferAlignment);
+    memcpy(cameraAllocation.p_Mapped, &viewProjUbo, sizeof(viewProjUbo));
+    m_cameraDataOffsets[currentImage] = static_cast<uint32_t>(cameraAllocation.offset);
+    mp_cameraDataMapped = cameraAllocation.p_Mapped;
+    m_cameraWriteTime = std::chrono::steady_clock::now();
+
+    // The ring might have just grown into a new buffer, or the SSBO did
+    if (rewriteSet || m_perFrameSetRingGeneration[currentImage] != m_transientRing.getGeneration()) {
+        writePerFrameDescriptorSet(currentImage);
+    }
 
 
 }
 
-void Craig::Renderer::createTextureImage2(const uint8_t* pixels, int texWidth, int texHeight, int texChannels, Craig::Texture* outTexture) { // VmaAllocation* textureMemoryAlloc, vk::Image* outTextureImage, vk::ImageView* outTextureImageView) {
+void Craig::Renderer::createTextureImage2(const uint8_t* pixels, int texWidth, int texHeight, int texChannels, Craig::Texture* outTexture, const std::string& debugName) { // VmaAllocation* textureMemoryAlloc, vk::Image* outTextureImage, vk::ImageView* outTextureImageView) {
+    CRAIG_PROFILE_ZONE("Renderer::createTextureImage2");
+
     vk::DeviceSize imageSize = texWidth * texHeight * 4;
 
     if (!pixels) {
@@ -796,6 +1686,7 @@ void Craig::Renderer::createTextureImage2(const uint8_t* pixels, int texWidth, i
     }
 
     outTexture->m_VK_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    outTexture->m_extent = vk::Extent2D(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
     vk::Buffer stagingBuffer;
     VmaAllocation stagingAlloc{};
@@ -804,7 +1695,7 @@ void Craig::Renderer::createTextureImage2(const uint8_t* pixels, int texWidth, i
     stagingAci.usage = VMA_MEMORY_USAGE_AUTO;
     stagingAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
 
-    m_Devices.createBufferVMA(imageSize, vk::BufferUsageFlagBits::eTransferSrc, stagingAci, stagingBuffer, stagingAlloc);
+    m_Devices.createBufferVMA(imageSize, vk::BufferUsageFlagBits::eTransferSrc, stagingAci, stagingBuffer, stagingAlloc, ("Texture staging: " + debugName).c_str());
 
     void* data;
     vmaMapMemory(m_Devices.getVmaAllocator(), stagingAlloc, &data);
@@ -814,7 +1705,7 @@ void Craig::Renderer::createTextureImage2(const uint8_t* pixels, int texWidth, i
 
     //stbi_image_free(pixels);
 
-    outTexture->m_VK_textureImage = ImageHelpers::createImage(m_Devices.getPhysicalDevice(), m_instance.getVkSurface(), texWidth, texHeight, outTexture->m_VK_mipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Srgb, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, m_Devices.getVmaAllocator(),outTexture->m_VMA_textureImageAllocation);
+    outTexture->m_VK_textureImage = ImageHelpers::createImage(m_Devices.getPhysicalDevice(), m_instance.getVkSurface(), texWidth, texHeight, outTexture->m_VK_mipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Srgb, vk::ImageTiling::eOptimal, kTextureImageUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, m_Devices.getVmaAllocator(), outTexture->m_VMA_textureImageAllocation, debugName.c_str(), m_defragmenter.getImagePool());
 
     Craig::ImageHelpers::transitionImageLayout(m_commandManager ,outTexture->m_VK_textureImage, vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, true, outTexture->m_VK_mipLevels);
     Craig::ImageHelpers::copyBufferToImage(m_commandManager, stagingBuffer, outTexture->m_VK_textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
@@ -866,37 +1757,82 @@ void Craig::Renderer::createTextureSampler() {
 
 }
 
+bool Craig::Renderer::requestFrameCapture() {
+
+    if (!m_swapChain.isCaptureSupported()) {
+        return false;
+    }
+    return m_frameCapture.requestCapture();
+}
+
+void Craig::Renderer::captureFrameToPng() {
+
+    std::filesystem::create_directories(kFrameCaptureDirectory);
+    if (requestFrameCapture()) {
+        m_saveNextCapture = true;
+    }
+}
+
+void Craig::Renderer::setCaptureInterval(uint32_t frames) {
+
+    if (frames > 0) {
+        std::filesystem::create_directories(kFrameCaptureDirectory);
+    }
+    m_captureInterval = frames;
+    m_framesSinceCapture = 0;
+}
+
+void Craig::Renderer::setFramesInFlight(uint32_t framesInFlight) {
+
+    if (framesInFlight == m_syncManager.getFramesInFlight()) {
+        return;
+    }
+
+    // The sync manager waits for everything to finish before switching, so every slot's share of the ring is free
+    m_syncManager.setFramesInFlight(framesInFlight);
+    m_transientRing.releaseAllFrames();
+    m_gpuProfiler.discardPendingFrames();
+    m_pipelineStatistics.discardPendingFrames();
+    m_frameCapture.discardPendingFrames();
+
+    CRAIG_LOG_INFO(eRenderer, "Frames in flight set to %u\n", m_syncManager.getFramesInFlight());
+}
+
 void Craig::Renderer::updateSamplingLevel(int levelToSet) {
 
+    vk::SampleCountFlagBits samples;
 
     switch (levelToSet)
     {
     case(64):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e64;
+        samples = vk::SampleCountFlagBits::e64;
         break;
     case(32):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e32;
+        samples = vk::SampleCountFlagBits::e32;
         break;
     case(16):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e16;
+        samples = vk::SampleCountFlagBits::e16;
         break;
     case(8):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e8;
+        samples = vk::SampleCountFlagBits::e8;
         break;
     case(4):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e4;
+        samples = vk::SampleCountFlagBits::e4;
         break;
     case(2):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e2;
+        samples = vk::SampleCountFlagBits::e2;
         break;
     case(1):
-        m_renderingAttachments.m_VK_msaaSamples = vk::SampleCountFlagBits::e1;
+        samples = vk::SampleCountFlagBits::e1;
         break;
 
     default:
-        break;
+        return;
     }
-    recreateSwapChainFull();
+
+    // Nothing gets torn down here, drawFrame swaps over as soon as the variant's compiled
+    m_pendingMsaaSamples = samples;
+    m_pipeline.requestVariant(m_pipeline.makeVariantKey(samples));
 
 }
 
@@ -912,10 +1848,8 @@ void Craig::Renderer::deleteGameObject(Craig::GameObject* gameObject)
 {
     //gotta wait for the object to leave the command buffer or vulkan cries with validation error
     m_Devices.getLogicalDevice().waitIdle();
-    //free the set from the pool
-    m_Devices.getLogicalDevice().freeDescriptorSets(m_VK_descriptorPool, mMap_GameObjectToDescriptorSet[gameObject]);
-    //remove it from the map
-    mMap_GameObjectToDescriptorSet.erase(mMap_GameObjectToDescriptorSet.find(gameObject));
+    Craig::Replay::getInstance().recordDelete(gameObject->getName());
+    // Texture sets belong to the model, so there's nothing of the object's own to free.
     // Remove from the scene and delete the object itself.
     mp_SceneManager->getCurrentScene()->deleteGameObject(gameObject);
 
@@ -932,35 +1866,40 @@ CraigError Craig::Renderer::newGameObject(std::string objectName, std::string mo
         return ret;
     }
 
-    Craig::GameObject* newObject = mp_SceneManager->getCurrentScene()->getGameObjects().back();
-    Craig::ResourceManager& resources = Craig::ResourceManager::getInstance();
+    // The scene re-sorts by name, so look it up rather than assuming it's at the back
+    Craig::GameObject* newObject = mp_SceneManager->getCurrentScene()->findObject(objectName);
+    getModelDescriptorSet(newObject->getModelPath());
+    Craig::Replay::getInstance().recordSpawn(objectName, modelPath, position);
 
-    std::vector<vk::DescriptorSetLayout> objectLayout(1, m_pipeline.getPerObjectDescriptorSetLayout());
+    return ret;
+}
 
-    vk::DescriptorSetAllocateInfo newObjectAllocInfo{};
-    newObjectAllocInfo.setDescriptorPool(m_VK_descriptorPool)
-        .setDescriptorSetCount(1)
-        .setSetLayouts(objectLayout);
+CraigError Craig::Renderer::generateStressScene(const Craig::StressSceneSettings& settings, Craig::StressSceneProfile* outProfile)
+{
+    CraigError ret = CRAIG_SUCCESS;
 
-    std::array<vk::WriteDescriptorSet, 1> perObjectWrites{};
-    auto perObjectSets = m_Devices.getLogicalDevice().allocateDescriptorSets(newObjectAllocInfo);
+    // Every object the GPU might still be drawing is about to be deleted, same as deleteGameObject
+    m_Devices.getLogicalDevice().waitIdle();
 
-    mMap_GameObjectToDescriptorSet.insert({newObject, perObjectSets.back()});
-    vk::DescriptorImageInfo imageInfo{};
-    imageInfo
-        .setImageView(resources.getModel(newObject->getModelPath()).m_texture.m_VK_textureImageView)
-        .setSampler(m_VK_textureSampler)
-        .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    ret = mp_SceneManager->getCurrentScene()->generateStressScene(settings, outProfile);
 
-    perObjectWrites[0]
-        .setDstSet(mMap_GameObjectToDescriptorSet[newObject])
-        .setDstBinding(0)
-        .setDstArrayElement(0)
-        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-        .setDescriptorCount(1)
-        .setImageInfo(imageInfo);
+    if (ret != CRAIG_SUCCESS)
+    {
+        return ret;
+    }
+
+    // The geometry buffers only had the models the scene was using before in them, pack them again for whatever it
+    // uses now (which can be models nothing's loaded until just now). Still idle from above.
+    m_defragmenter.cancelImmediately();
+    destroyGeometryBuffers();
+    createVertexBuffer();
+    createIndexBuffer();
 
-    m_Devices.getLogicalDevice().updateDescriptorSets(perObjectWrites, nullptr);
+    for (const std::string& modelPath : settings.modelPaths)
+    {
+        getModelDescriptorSet(modelPath);
+    }
+    Craig::Replay::getInstance().recordStressScene(settings);
 
     return ret;
 }
@@ -972,37 +1911,87 @@ void Craig::Renderer::updateMinLOD(int minLOD) {
     createTextureSampler();
     updateDescriptorSets();
 
-    printf("Recreated sampler and updated the descriptor sets to change the LOD \n");
+    CRAIG_LOG_DEBUG(eRenderer, "Recreated sampler and updated the descriptor sets to change the LOD \n");
 }
 
 void Craig::Renderer::drawFrame(const float& deltaTime) {
 
+    CRAIG_PROFILE_ZONE("Renderer::drawFrame");
+
+    queueObjectUploads();
+
     m_syncManager.waitForGpu();
     const uint32_t& currentFrame = m_syncManager.getCurrentFrame();
 
+    // Minimised, keep checking for the window coming back
     if (m_swapChain.getExtent().width <= 0 || m_swapChain.getExtent().height <= 0) {
-        return; // Skip this frame
+        recreateSwapChain();
+        mp_CurrentWindow->finishedResize();
+
+        if (m_swapChain.getExtent().width <= 0 || m_swapChain.getExtent().height <= 0) {
+            return; // Skip this frame
+        }
     }
 
     uint32_t imageIndex = 0;
-    VkResult nextImageResult = vkAcquireNextImageKHR(m_Devices.getLogicalDevice(), m_swapChain.getSwapChain(), UINT64_MAX, m_syncManager.getVK_imageAvailableSemaphores()[currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-    if (nextImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain();
-        return;
+    if (m_headless) {
+        // One offscreen image per frame slot, and waitForGpu's already made sure this slot's finished with
+        imageIndex = currentFrame;
     }
-    else if (nextImageResult != VK_SUCCESS && nextImageResult != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    else {
+        VkResult nextImageResult = vkAcquireNextImageKHR(m_Devices.getLogicalDevice(), m_swapChain.getSwapChain(), UINT64_MAX, m_syncManager.getVK_imageAvailableSemaphores()[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+        if (nextImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain();
+            return;
+        }
+        else if (nextImageResult != VK_SUCCESS && nextImageResult != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
     }
+    m_frameAcquireTime = std::chrono::steady_clock::now();
+
+    readGpuTimings(currentFrame);
+    updateFrameCapture(currentFrame);
+    m_transientRing.beginFrame(currentFrame);
+    m_deletionQueue.beginFrame();
+
+    applyPendingSamplingLevel();
+
+    updateCamera(deltaTime);
+    cullScene();
+    updateOcclusionData(currentFrame);
+
+    // Before recording, the camera data's offset in the transient ring gets baked into the command buffer
+    updateUniformBuffer(currentFrame);
 
     // Record drawing commands into the command buffer
     m_commandManager.getCommandBuffers()[currentFrame].reset();
     recordCommandBuffer(m_commandManager.getCommandBuffers()[currentFrame], imageIndex);
 
-    updateUniformBuffer(currentFrame, deltaTime);
+    // Camera data goes in as late as it possibly can
+    latchCamera();
 
     //Creates the submit info and submits the command buffer to the gfx queue
     m_syncManager.submitFrame(m_commandManager.getCommandBuffers(), imageIndex, m_Devices.getGraphicsQueue());
+    std::chrono::steady_clock::time_point submitTime = std::chrono::steady_clock::now();
+
+    // Headless the image just sits there until the slot comes round again
+    if (!m_headless) {
+        presentFrame(imageIndex, submitTime);
+    }
+
+    // How long from init until something was actually on screen, mostly down to how many pipelines had to be compiled
+    if (m_timeToFirstFrameMs < 0.0f) {
+        m_timeToFirstFrameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_initStartTime).count();
+        CRAIG_LOG_INFO(eRenderer, "Time to first frame: %.1f ms (%s pipeline cache)\n", m_timeToFirstFrameMs, m_pipelineCache.wasLoadedFromDisk() ? "warm" : "cold");
+    }
+
+    m_syncManager.nextFrame();
+
+}
+
+void Craig::Renderer::presentFrame(uint32_t imageIndex, std::chrono::steady_clock::time_point submitTime) {
 
     // Present the rendered image to the screen
     vk::PresentInfoKHR presentInfo;
@@ -1013,20 +2002,41 @@ void Craig::Renderer::drawFrame(const float& deltaTime) {
         .setPSwapchains(&m_swapChain.getSwapChain())
         .setPImageIndices(&imageIndex);
 
+    // Tag every present with an id so paceFrame can wait for it to actually hit the screen
+    m_presentId++;
+    vk::PresentIdKHR presentIdInfo;
+    presentIdInfo
+        .setSwapchainCount(1)
+        .setPPresentIds(&m_presentId);
+    if (m_pfnWaitForPresent != nullptr) {
+        presentInfo.setPNext(&presentIdInfo);
+    }
+
 
     //We have to revert back to the original C code otherwise if it returns ERROR_OUT_OF_DATE, it throws an exception and messes up the code.
     auto presentResult = vkQueuePresentKHR(m_Devices.getPresentationQueue(), presentInfo);
+    recordInputLatency(submitTime, std::chrono::steady_clock::now());
 
     if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || mp_CurrentWindow->isResizeNeeded()) {
-        recreateSwapChain();
+        // However many resize events came in since last frame, they all come down to at most one rebuild here.
+        // Out of date has to be rebuilt no matter what, otherwise skip it if something already rebuilt this frame
+        // (a present mode change) or the window ended up the same size it already was.
+        bool mustRebuild = (presentResult == VK_ERROR_OUT_OF_DATE_KHR);
+        bool sizeChanged = (m_swapChain.querySurfaceExtent() != m_swapChain.getExtent());
+        bool wantRebuild = !m_swapchainRebuiltThisFrame && (sizeChanged || presentResult == VK_SUBOPTIMAL_KHR);
+
+        if (mp_CurrentWindow->getResizeEventsPending() > 1) {
+            m_resizeEventsCoalesced += mp_CurrentWindow->getResizeEventsPending() - 1;
+        }
+
+        if (mustRebuild || wantRebuild) {
+            recreateSwapChain();
+        }
         mp_CurrentWindow->finishedResize();
     }
     else if (presentResult != VK_SUCCESS) {
         throw std::runtime_error("failed to present swap chain image!");
     }
-
-    m_syncManager.nextFrame();
-
 }
 
 
@@ -1055,26 +2065,44 @@ CraigError Craig::Renderer::terminate() {
 
     m_Devices.getLogicalDevice().waitIdle();
 
+    // Ends whatever pass it's got in flight before anything it's moving gets destroyed
+    m_defragmenter.cancelImmediately();
+
+    m_culling.terminate();
+    m_frameLimiter.terminate();
+
 #if defined(IMGUI_ENABLED)
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
     m_Devices.getLogicalDevice().destroyDescriptorPool(m_VK_imguiDescriptorPool);
 #endif
-    vmaDestroyBuffer(m_Devices.getVmaAllocator(), m_VK_indexBuffer, m_VMA_indexAllocation);
-
-    vmaDestroyBuffer(m_Devices.getVmaAllocator(), m_VK_vertexBuffer, m_VMA_vertexAllocation);
+    destroyGeometryBuffers();
 
     m_syncManager.terminate();
 
+    m_occlusionCulling.terminate();
+
+    m_gpuProfiler.terminate();
+
+    m_pipelineStatistics.terminate();
+
+    m_frameCapture.terminate();
+
     m_commandManager.terminate();
 
+    m_deletionQueue.terminate();
     m_renderingAttachments.terminate();
 
     m_Devices.getLogicalDevice().destroySampler(m_VK_textureSampler);
 
+    for (auto& [modelPath, modelSet] : mMap_ModelToDescriptorSet) {
+        m_defragmenter.unregister(Craig::ResourceManager::getInstance().getModel(modelPath).m_texture.m_VMA_textureImageAllocation);
+    }
     Craig::ResourceManager::getInstance().terminateModels(m_Devices.getLogicalDevice(), m_Devices.getVmaAllocator());
 
+    // Its pools have to be empty by now
+    m_defragmenter.terminate();
 
 
     m_swapChain.terminate();
@@ -1083,14 +2111,17 @@ CraigError Craig::Renderer::terminate() {
         vmaDestroyBuffer(m_Devices.getVmaAllocator(), mv_VK_storageBuffers[i], mv_VK_storageBuffersAllocations[i]);
     }
 
-    for (size_t i = 0; i < mv_viewProjUboBuffer.size(); i++) {
-        vmaDestroyBuffer(m_Devices.getVmaAllocator(), mv_viewProjUboBuffer[i], mv_viewProjUboAllocation[i]);
-    }
+    m_transientRing.terminate();
 
     m_Devices.getLogicalDevice().destroyDescriptorPool(m_VK_descriptorPool);
 
+    for (vk::DescriptorPool modelPool : mv_VK_modelDescriptorPools) {
+        m_Devices.getLogicalDevice().destroyDescriptorPool(modelPool);
+    }
+
     m_pipeline.terminate();
 
+    m_pipelineCache.terminate();
 
     m_Devices.terminate();
 
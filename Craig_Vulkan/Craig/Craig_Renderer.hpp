@@ -4,7 +4,9 @@
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
+#include <chrono>
 #include <optional>
+#include <string>
 #include <vector>
 #include <array>
 #include <vulkan/vulkan.hpp>
@@ -16,13 +18,25 @@
 
 #include "Craig_Constants.hpp"
 #include "Craig_Camera.hpp"
+#include "Craig_Culling.hpp"
+#include "Craig_FrameLimiter.hpp"
 #include "Craig_ResourceManager.hpp"
+#include "Craig_StressScene.hpp"
 #include "Renderer/Craig_CommandManager.hpp"
 #include "Renderer/Craig_Swapchain.hpp"
 #include "Renderer/Craig_Device.hpp"
 #include "Renderer/Craig_Instance.hpp"
+#include "Renderer/Craig_OcclusionCulling.hpp"
+#include "Renderer/Craig_DeletionQueue.hpp"
+#include "Renderer/Craig_FrameCapture.hpp"
+#include "Renderer/Craig_GpuProfiler.hpp"
 #include "Renderer/Craig_Pipeline.hpp"
+#include "Renderer/Craig_PipelineStatistics.hpp"
+#include "Renderer/Craig_GpuMemoryStats.hpp"
+#include "Renderer/Craig_Defragmenter.hpp"
+#include "Renderer/Craig_PipelineCache.hpp"
 #include "Renderer/Craig_RenderingAttachments.hpp"
+#include "Renderer/Craig_RingAllocator.hpp"
 #include "Renderer/Craig_SyncManager.hpp"
 
 namespace Craig {
@@ -35,25 +49,165 @@ namespace Craig {
 	class Renderer {
 
 	public:
+		// No window, no surface and no swapchain, frames get drawn into offscreen images with the same attachments and
+		// pipelines. Good for benchmarking and CI on machines without a display (or a GPU, it runs on lavapipe).
+		struct HeadlessInitInfo
+		{
+			vk::Extent2D extent = { kSDL_WindowWidth, kSDL_WindowHeight };
+		};
+
 		CraigError init(Window* CurrentWindowPtr, SceneManager* sceneManagerPtr);
+		CraigError initHeadless(SceneManager* sceneManagerPtr, const HeadlessInitInfo& info);
 		CraigError update(const float& deltaTime);
 		CraigError terminate();
 
-		bool& getVSyncState() { return m_swapChain.m_vsyncEnabled; };
+		bool isHeadless() const { return m_headless; }
+
 		void refreshSwapChain() { recreateSwapChain(); };
-		void createTextureImage2(const uint8_t* pixels, int texWidth, int texHeight, int texChannels, Texture* outTexture);
+		void createTextureImage2(const uint8_t* pixels, int texWidth, int texHeight, int texChannels, Texture* outTexture, const std::string& debugName); // debugName goes on the allocation, the model path
 
 		void updateMinLOD(int minLOD);
 
 		//const uint32_t& getMaxSamplingLevel() const { return m_MaxSamplingLevel; };
 		void updateSamplingLevel(int levelToSet);
 
+		void setFramesInFlight(uint32_t framesInFlight);
+		uint32_t getFramesInFlight() const { return m_syncManager.getFramesInFlight(); }
+		uint32_t getSwapchainImageCount() const { return static_cast<uint32_t>(m_swapChain.getImages().size()); }
+		bool isSamplingLevelPending() const { return m_pendingMsaaSamples.has_value(); } // Waiting on the pipeline variant to compile
+		size_t getCompiledPipelineVariantCount() { return m_pipeline.getCompiledVariantCount(); }
+
 		RenderingAttachments getRenderingAttachments() {return m_renderingAttachments; };
 
 		const glm::vec2 getWindowSize() const;
 
+		bool& getCullingEnabled() { return m_cullingEnabled; }
+		float& getMinPixelSize() { return m_minPixelSize; }
+		const Craig::Culling& getCulling() const { return m_culling; }
+
+		bool& getOcclusionCullingEnabled() { return m_occlusionCullingEnabled; }
+		const Craig::OcclusionCulling& getOcclusionCulling() const { return m_occlusionCulling; }
+		Craig::OcclusionCulling& getOcclusionCulling() { return m_occlusionCulling; } // For the editor to ask for the per-object results
+		bool isOcclusionCullingActive() const { return m_occlusionCullingEnabled && m_occlusionCulling.isSupported() && !m_overdrawViewEnabled; }
+
+		// Smoothed GPU time of all the scene passes, kept separately for with and without the depth pre-pass
+		struct SceneGpuTimes {
+			float withPrePassMs = 0.0f;
+			float withoutPrePassMs = 0.0f;
+		};
+
+		float getTimeToFirstFrameMs() const { return m_timeToFirstFrameMs; } // Negative until the first frame's been presented
+		bool getPipelineCacheWarm() const { return m_pipelineCache.wasLoadedFromDisk(); }
+		std::string getDeviceName() const { return m_Devices.getPhysicalDevice().getProperties().deviceName.data(); }
+
+		uint32_t getObjectsUploadedLastFrame() const { return m_objectsUploadedLastFrame; }
+
+		bool& getDepthPrePassEnabled() { return m_depthPrePassEnabled; }
+		bool getTimestampsSupported() const { return m_gpuProfiler.isSupported(); }
+		const Craig::GpuProfiler& getGpuProfiler() const { return m_gpuProfiler; }
+		bool exportGpuProfile() const { return m_gpuProfiler.exportJson(kGpuProfileExportPath); }
+		const SceneGpuTimes& getSceneGpuTimes() const { return m_sceneGpuTimes; }
+		const Craig::PipelineStatistics& getPipelineStatistics() const { return m_pipelineStatistics; }
+		Craig::GpuMemoryStats& getGpuMemoryStats() { return m_gpuMemoryStats; }
+		Craig::Defragmenter& getDefragmenter() { return m_defragmenter; }
+
+		// Draws the scene as a heatmap of how many times each pixel was covered instead of shading it. Skips the
+		// pre-pass and occlusion culling while it's on, so it shows everything the CPU cull lets through.
+		bool& getOverdrawViewEnabled() { return m_overdrawViewEnabled; }
+
+		// Frame time distribution from the last scripted resize sweep
+		struct ResizeSweepResults {
+			uint32_t frames = 0;
+			uint32_t swapchainRebuilds = 0;
+			uint32_t resizeEventsCoalesced = 0;
+			float averageMs = 0.0f;
+			float p50Ms = 0.0f;
+			float p95Ms = 0.0f;
+			float p99Ms = 0.0f;
+			float maxMs = 0.0f;
+		};
+
+		void startResizeSweep();
+		bool isResizeSweepRunning() const { return m_resizeSweepRunning; }
+		const ResizeSweepResults& getResizeSweepResults() const { return m_resizeSweepResults; }
+		uint32_t getSwapchainRebuildCount() const { return m_swapchainRebuildCount; }
+		uint32_t getResizeEventsCoalesced() const { return m_resizeEventsCoalesced; }
+
+		// What holds the CPU back so it doesn't run ahead of the display
+		enum class FramePacing {
+			eNone,
+			eLimiter,     // Hybrid sleep/spin to a target frame rate
+			ePresentWait, // Waits on VK_KHR_present_wait for the previous frame to reach the screen
+		};
+
+		// Frame time spread over the last complete kFrameTimeStatsFrames window, starts again whenever the present mode or pacing changes
+		struct FrameTimeStats {
+			uint32_t frames = 0;
+			float averageMs = 0.0f;
+			float stdDevMs = 0.0f;
+			float varianceMs = 0.0f; // ms squared
+			float p99Ms = 0.0f;
+			float minMs = 0.0f;
+			float maxMs = 0.0f;
+		};
+
+		// Takes effect straight away, the swapchain gets rebuilt off the old one
+		void setPresentMode(vk::PresentModeKHR presentMode);
+		vk::PresentModeKHR getPresentMode() const { return m_swapChain.getPresentMode(); }
+		const std::vector<vk::PresentModeKHR>& getSupportedPresentModes() const { return m_swapChain.getSupportedPresentModes(); }
+
+		// Called by the framework before input gets polled, so the wait comes before the input's read rather than after
+		void paceFrame();
+		void setFramePacing(FramePacing pacing);
+		FramePacing getFramePacing() const { return m_framePacing; }
+		bool isPresentWaitSupported() const { return m_pfnWaitForPresent != nullptr; }
+		void setFrameLimitFps(float targetFps);
+		float getFrameLimitFps() const { return m_frameLimiter.getTargetFps(); }
+		const Craig::FrameLimiter& getFrameLimiter() const { return m_frameLimiter; }
+
+		const FrameTimeStats& getFrameTimeStats() const { return m_frameTimeStats; }
+		uint32_t getFrameTimeStatsProgress() const { return static_cast<uint32_t>(mv_frameTimeHistory.size()); }
+
+		// How long after the input the frame that used it got to each stage. Acquire can come out negative,
+		// input picked up by the late latch turned up after the image was acquired.
+		struct InputLatency {
+			float toAcquireMs = 0.0f;
+			float toLatchMs = 0.0f;
+			float toSubmitMs = 0.0f;
+			float toPresentMs = 0.0f;
+		};
+
+		struct InputLatencyStats {
+			InputLatency last;                  // The last frame that had any input
+			InputLatency average;               // Over the last complete window of kInputLatencyWindowFrames frames with input
+			float        maxToPresentMs = 0.0f; // Worst in that window
+			uint32_t     samples = 0;
+		};
+
+		bool& getLateLatchEnabled() { return m_lateLatchEnabled; }
+		// The Hi-Z cull gets its view/proj pushed while recording, so with occlusion culling on a latched camera would
+		// draw phase one from a different view than the pyramid gets tested with, and things get wrongly culled
+		bool isLateLatchActive() const { return m_lateLatchEnabled && !isOcclusionCullingActive(); }
+		const InputLatencyStats& getInputLatencyStats() const { return m_inputLatencyStats; }
+
+		// Frame readback. A requested frame turns up a few frames later, once its slot's fence has come back round, so
+		// asking never stalls. Captures are of the scene without the editor on top.
+		bool requestFrameCapture(); // False if there's already one on its way or the swap images can't be copied from
+		bool hasFrameCapture() const { return m_frameCapture.hasCapture(); }
+		bool takeFrameCapture(Craig::FrameCapture::Image& outImage) { return m_frameCapture.takeCapture(outImage); }
+		Craig::FrameCapture& getFrameCapture() { return m_frameCapture; }
+
+		// Captures that get written out as PNGs under kFrameCaptureDirectory on the capture writer thread
+		void captureFrameToPng();
+		void setCaptureInterval(uint32_t frames); // Every this many frames, 0 turns periodic capture off
+		uint32_t getCaptureInterval() const { return m_captureInterval; }
+		uint32_t getCapturesSaved() const { return m_capturesSaved; }
+		uint32_t getCapturesDropped() const { return m_capturesDropped; } // The writer was too far behind
+
+		Craig::SceneManager* getSceneManager() { return mp_SceneManager; }
 		void deleteGameObject(Craig::GameObject* gameObject);
 		CraigError newGameObject(std::string objectName, std::string modelPath, glm::vec3 position);
+		CraigError generateStressScene(const Craig::StressSceneSettings& settings, Craig::StressSceneProfile* outProfile = nullptr); // Replaces the whole scene
 
 	private:
 		struct PerObjectData {
@@ -65,6 +219,29 @@ namespace Craig {
 			glm::mat4 proj;
 		};
 
+		// What one frame in flight's copy of the per-object SSBO is holding
+		struct ObjectUploadState {
+			uint64_t              structureVersion = UINT64_MAX; // Scene structure it was last fully written for
+			std::vector<uint64_t> uploadedVersions;              // Transform version sitting in each slot
+			std::vector<uint32_t> pendingSlots;                  // Slots that moved since this copy was last written
+		};
+
+		// Which draws a scene pass records. eSingle is everything at once, the occlusion phases go through the indirect buffers.
+		enum class ScenePass {
+			eSingle,
+			eOcclusionPhaseOne,
+			eOcclusionPhaseTwo,
+			eOcclusionBothPhases, // Colour pass after the pre-pass has done both phases' depth
+		};
+
+		// What a scene pass writes
+		enum class ScenePassMode {
+			eColour,             // Normal pass, depth test + write and full shading
+			eDepthPrePass,       // Position stream only, depth and nothing else
+			eColourAfterPrePass, // Shades against the pre-pass depth with eEqual, no depth writes
+			eOverdraw,           // Additive fragment counting, no depth test, onto black
+		};
+
 		// struct UniformBufferObject {
 		// 	glm::mat4 model;
 		// 	glm::mat4 view;
@@ -75,27 +252,60 @@ namespace Craig {
 		void InitVulkan();                 // Full Vulkan bring-up
 		
 		// Swapchain + framebuffer resources
-		void recreateSwapChain();          // Swapchain-only recreation
-		void recreateSwapChainFull();      // Swapchain + pipeline + imgui recreation
+		void recreateSwapChain();          // Swapchain-only recreation, no device idle
+		void updateResizeSweep(const float& deltaTime);
+
+		// Frame pacing
+		void updateFrameTimeStats(const float& deltaTime);
+		void resetFrameTimeStats();
+		std::string describeFramePacing() const;
+
+		// MSAA changes, no device idle needed
+		void precompilePipelineVariants();
+		void applyPendingSamplingLevel();
 
 		void createDescriptorPool();
+		void createModelDescriptorPool();
 		void createDescriptorSets();
 		void updateDescriptorSets();
+		void writePerFrameDescriptorSet(uint32_t frame);
+		vk::DescriptorSet getModelDescriptorSet(const std::string& modelPath);
+		vk::DescriptorSet allocateModelDescriptorSet(const std::string& modelPath);
+		void replaceModelDescriptorSet(const std::string& modelPath);
+		void writeModelDescriptorSet(const std::string& modelPath, vk::DescriptorSet modelSet);
 
 		
 		// Buffers / per-frame data
 		void createVertexBuffer();
 		void createIndexBuffer();
+		void destroyGeometryBuffers();
 		//void createUniformBuffers();
 		void createUniformBuffers();
-		void updateUniformBuffer(uint32_t currentImage, const float& deltaTime);
+		void createStorageBuffer(uint32_t frame, size_t objectCapacity);
+		void updateCamera(const float& deltaTime);
+		void latchCamera();
+		void recordInputLatency(std::chrono::steady_clock::time_point submitTime, std::chrono::steady_clock::time_point presentTime);
+		void updateUniformBuffer(uint32_t currentImage);
+		void queueObjectUploads();
+
+		// Culling
+		void cullScene();
+		void updateOcclusionData(uint32_t currentFrame);
+
+		// GPU timing
+		void readGpuTimings(uint32_t currentFrame);
+
+		// Frame capture
+		void updateFrameCapture(uint32_t currentFrame);
 
 		
 		// Command submission + sync
 		//void createSyncObjects();
 
 		void recordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+		void recordScenePass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, ScenePass pass, ScenePassMode mode);
 		void drawFrame(const float& deltaTime);
+		void presentFrame(uint32_t imageIndex, std::chrono::steady_clock::time_point submitTime);
 
 		
 		// Images / textures helpers
@@ -113,12 +323,37 @@ namespace Craig {
 		#endif
 		};
 
+		// Turned on if the device has them
+		const std::vector<const char*> mv_VK_optionalDeviceExtensions = {
+			VK_KHR_PRESENT_ID_EXTENSION_NAME,
+			VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+			VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		};
+
+		// Headless doesn't present, so it only gets the ones that aren't for presenting
+		const std::vector<const char*> mv_VK_headlessOptionalDeviceExtensions = {
+			VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		};
+
+		// Nothing's presented headless, so it doesn't even need the swapchain extension
+		const std::vector<const char*> mv_VK_headlessDeviceExtensions = {
+		#if defined(__APPLE__)
+			VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME
+		#endif
+		};
+
 		std::vector<const char*> mv_VK_Layers; // Validation layers
 
 		
 		// Engine-facing state
 		SceneManager* mp_SceneManager = nullptr;
-		Window* mp_CurrentWindow = nullptr;
+
+		std::chrono::steady_clock::time_point m_initStartTime;
+		float m_timeToFirstFrameMs = -1.0f;
+		Window* mp_CurrentWindow = nullptr; // Null when headless
+
+		bool         m_headless = false;
+		vk::Extent2D m_headlessExtent;
 
 		Craig::Instance m_instance; //Contains vulkan instance and debugging stuff
 		Craig::Device m_Devices; //Contains physical and logical device
@@ -128,6 +363,48 @@ namespace Craig {
 		
 		// Shaders / pipeline
 		Craig::Pipeline m_pipeline;
+		Craig::PipelineCache m_pipelineCache;
+		std::optional<vk::SampleCountFlagBits> m_pendingMsaaSamples; // Applied once its pipeline variant is ready
+
+		// GPU objects swapped out while frames in flight might still be using them
+		Craig::DeletionQueue m_deletionQueue;
+
+		bool     m_swapchainRebuiltThisFrame = false;
+		uint32_t m_swapchainRebuildCount = 0;
+		uint32_t m_resizeEventsCoalesced = 0;
+
+		bool               m_resizeSweepRunning = false;
+		uint32_t           m_resizeSweepFrame = 0;
+		int                m_resizeSweepStartWidth = 0;
+		int                m_resizeSweepStartHeight = 0;
+		uint32_t           m_resizeSweepStartRebuilds = 0;
+		uint32_t           m_resizeSweepStartCoalesced = 0;
+		std::vector<float> mv_resizeSweepFrameTimes;
+		ResizeSweepResults m_resizeSweepResults;
+
+		// Frame pacing
+		Craig::FrameLimiter      m_frameLimiter;
+		FramePacing              m_framePacing = FramePacing::eNone;
+		PFN_vkWaitForPresentKHR  m_pfnWaitForPresent = nullptr; // Null unless present id and present wait are both usable
+		uint64_t                 m_presentId = 0;                // Id of the last frame we presented
+		uint64_t                 m_swapchainFirstPresentId = 1;  // Ids from before the last rebuild belong to a swapchain that's gone
+
+		// Late latching + input latency
+		bool  m_lateLatchEnabled = true;
+		void* mp_cameraDataMapped = nullptr; // This frame's camera slot in the transient ring, the late latch writes straight over it
+		std::chrono::steady_clock::time_point m_cameraWriteTime;
+		std::chrono::steady_clock::time_point m_frameAcquireTime;
+		std::chrono::steady_clock::time_point m_frameLatchTime;
+		std::optional<std::chrono::steady_clock::time_point> m_frameInputTime; // Oldest input this frame is the first to show
+		InputLatency      m_inputLatencySum;
+		float             m_inputLatencyWindowMax = 0.0f;
+		uint32_t          m_inputLatencyWindowSamples = 0;
+		InputLatencyStats m_inputLatencyStats;
+
+		std::vector<float> mv_frameTimeHistory;
+		FrameTimeStats     m_frameTimeStats;
+		bool               m_frameTimeStatsSkipNext = true;  // The frame the change happened in was timed under the old settings
+		bool               m_frameTimeStatsReported = false; // Printed once per set of settings, the editor has the rest
 
 		
 		// Commands
@@ -140,28 +417,76 @@ namespace Craig {
 		
 		// Geometry buffers
 		vk::Buffer     m_VK_vertexBuffer;
-		VmaAllocation  m_VMA_vertexAllocation;
+		VmaAllocation  m_VMA_vertexAllocation = VK_NULL_HANDLE;
+
+		vk::Buffer     m_VK_positionBuffer;      // Same vertices again, positions only, for the depth pre-pass
+		VmaAllocation  m_VMA_positionAllocation = VK_NULL_HANDLE;
 
 		vk::Buffer     m_VK_indexBuffer;
-		VmaAllocation  m_VMA_indexAllocation;
+		VmaAllocation  m_VMA_indexAllocation = VK_NULL_HANDLE;
 
 		
 		// Uniforms / descriptors
 		std::vector<vk::Buffer>    mv_VK_storageBuffers;
 		std::vector<VmaAllocation> mv_VK_storageBuffersAllocations;
 		std::vector<void*>        mv_VK_storageBuffersMapped;
+		std::array<ObjectUploadState, kMaxFramesInFlight> m_objectUploads;
+		uint32_t                  m_objectsUploadedLastFrame = 0;
 
-		std::vector<vk::Buffer> mv_viewProjUboBuffer;
-		std::vector<VmaAllocation> mv_viewProjUboAllocation;
-		std::vector<void*> mv_viewProjUboMap;
+		std::vector<size_t>       mv_storageBufferCapacity; // In objects
+
+		// Per-frame transient data (camera for now) comes out of here
+		Craig::RingAllocator                       m_transientRing;
+		vk::DeviceSize                             m_uniformBufferAlignment = 256;
+		std::array<uint32_t, kMaxFramesInFlight>   m_cameraDataOffsets{};
+		std::array<uint32_t, kMaxFramesInFlight>   m_perFrameSetRingGeneration{}; // Which ring buffer each per-frame set points at
 
 		vk::DescriptorPool              m_VK_descriptorPool;
 		std::vector<vk::DescriptorSet>	mv_VK_perFrameDescriptorSet;
 
-		std::unordered_map<GameObject*, vk::DescriptorSet>  mMap_GameObjectToDescriptorSet;
+		// Texture sets, one per model. Pools get added as they fill up.
+		std::vector<vk::DescriptorPool>                     mv_VK_modelDescriptorPools;
+		uint32_t                                            m_modelSetsInCurrentPool = 0;
+		std::unordered_map<std::string, vk::DescriptorSet>  mMap_ModelToDescriptorSet;
+		std::unordered_map<std::string, vk::DescriptorPool> mMap_ModelToDescriptorPool; // Which pool each set came from, for freeing it
 
 		uint32_t m_minLODLevel = 0;        // User-selected min LOD clamp
 
+		// CPU frustum + small object culling, the visibility it spits out gets checked while recording
+		Craig::Culling m_culling;
+		bool           m_cullingEnabled = true;
+		float          m_minPixelSize = kDefaultMinPixelSize;
+
+		// GPU two phase occlusion culling against a depth pyramid, runs on whatever survived the CPU cull
+		Craig::OcclusionCulling m_occlusionCulling;
+		bool                    m_occlusionCullingEnabled = true;
+
+		// Depth pre-pass, off by default since it only pays off with a lot of overdraw
+		bool m_depthPrePassEnabled = false;
+
+		// GPU timestamps, the scene times with and without the pre-pass come out of the profiler's "Scene" scope
+		Craig::GpuProfiler                       m_gpuProfiler;
+		std::array<bool, kMaxFramesInFlight>     m_timestampFrameUsedPrePass{};
+		SceneGpuTimes                            m_sceneGpuTimes;
+
+		// What the scene passes asked the GPU to do, vertices, fragments and so on
+		Craig::PipelineStatistics m_pipelineStatistics;
+		bool                      m_overdrawViewEnabled = false;
+
+		// VMA's heap usage against the budget, and the named allocation dumps
+		Craig::GpuMemoryStats m_gpuMemoryStats;
+
+		// Moves the textures and scene geometry around to close the gaps left in VMA's blocks
+		Craig::Defragmenter m_defragmenter;
+
+		// Frame readback, periodic or one-off
+		Craig::FrameCapture m_frameCapture;
+		uint32_t            m_captureInterval = 0;
+		uint32_t            m_framesSinceCapture = 0;
+		bool                m_saveNextCapture = false;
+		uint32_t            m_capturesSaved = 0;
+		uint32_t            m_capturesDropped = 0;
+
 		RenderingAttachments m_renderingAttachments; //Contains stuff for MSAA, vsync and mipmap levels
 		
 		// Texture
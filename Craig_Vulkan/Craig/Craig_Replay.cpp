@@ -0,0 +1,484 @@
+#include "Craig_Replay.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "Craig_Camera.hpp"
+#include "Craig_GameObject.hpp"
+#include "Craig_Log.hpp"
+#include "Craig_Renderer.hpp"
+#include "Craig_Scene.hpp"
+#include "Craig_SceneManager.hpp"
+#include "../External/json.hpp"
+
+// File layout, everything little endian as it's laid out in memory:
+//   "CRPL", uint32 version, uint32 sample count, uint32 action count
+//   samples: float time, float position[3], float pitchYaw[2]
+//   actions: uint8 type, float time, then by type
+//     spawn:        string name, string model path, float position[3]
+//     delete:       string name
+//     stress scene: uint8 layout, uint32 count, uint32 seed, float spacing, float radius, uint32 clusters,
+//                   uint32 model count, string per model
+//   strings are a uint32 length and then the bytes
+namespace {
+
+	constexpr char kReplayMagic[4] = { 'C', 'R', 'P', 'L' };
+
+	// What's on disk for each, the smallest an action can be is one with no strings in it
+	constexpr uint64_t kSampleBytes = sizeof(float) * 6;
+	constexpr uint64_t kMinActionBytes = sizeof(uint8_t) + sizeof(float);
+
+	template<typename T>
+	void writeValue(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void writeString(std::ofstream& file, const std::string& string) {
+		writeValue(file, static_cast<uint32_t>(string.size()));
+		file.write(string.data(), string.size());
+	}
+
+	template<typename T>
+	bool readValue(std::ifstream& file, T& value) {
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	bool readString(std::ifstream& file, std::string& string) {
+		uint32_t length = 0;
+		if (!readValue(file, length) || length > (1u << 16)) {
+			return false;
+		}
+		string.resize(length);
+		return static_cast<bool>(file.read(string.data(), length));
+	}
+
+	nlohmann::json summarise(std::vector<float> samples) {
+
+		nlohmann::json json;
+		if (samples.empty()) {
+			return json;
+		}
+
+		std::sort(samples.begin(), samples.end());
+		auto percentile = [&samples](float p) {
+			return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+		};
+
+		double total = 0.0;
+		for (float sample : samples) {
+			total += sample;
+		}
+
+		json["averageMs"] = total / samples.size();
+		json["p50Ms"] = percentile(0.50f);
+		json["p95Ms"] = percentile(0.95f);
+		json["p99Ms"] = percentile(0.99f);
+		json["maxMs"] = samples.back();
+		return json;
+	}
+
+}
+
+float Craig::Replay::recordTime() const {
+	return std::chrono::duration<float>(std::chrono::steady_clock::now() - m_recordStart).count();
+}
+
+void Craig::Replay::startRecording() {
+
+	if (m_playing) {
+		CRAIG_LOG_WARN(eReplay, "Can't record while a replay's playing\n");
+		return;
+	}
+
+	mv_samples.clear();
+	mv_actions.clear();
+	m_recordStart = std::chrono::steady_clock::now();
+	m_recording = true;
+	CRAIG_LOG_INFO(eReplay, "Recording the camera\n");
+}
+
+bool Craig::Replay::stopRecording(const std::string& path) {
+
+	if (!m_recording) {
+		return false;
+	}
+	m_recording = false;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(eReplay, "Couldn't open %s to write the recording\n", path.c_str());
+		return false;
+	}
+
+	file.write(kReplayMagic, sizeof(kReplayMagic));
+	writeValue(file, kReplayFileVersion);
+	writeValue(file, static_cast<uint32_t>(mv_samples.size()));
+	writeValue(file, static_cast<uint32_t>(mv_actions.size()));
+
+	for (const CameraSample& sample : mv_samples) {
+		writeValue(file, sample.time);
+		writeValue(file, sample.position.x);
+		writeValue(file, sample.position.y);
+		writeValue(file, sample.position.z);
+		writeValue(file, sample.pitchYaw.x);
+		writeValue(file, sample.pitchYaw.y);
+	}
+
+	for (const Action& action : mv_actions) {
+		writeValue(file, static_cast<uint8_t>(action.type));
+		writeValue(file, action.time);
+
+		switch (action.type)
+		{
+		case(ActionType::Spawn):
+			writeString(file, action.name);
+			writeString(file, action.modelPath);
+			writeValue(file, action.position.x);
+			writeValue(file, action.position.y);
+			writeValue(file, action.position.z);
+			break;
+
+		case(ActionType::Delete):
+			writeString(file, action.name);
+			break;
+
+		case(ActionType::StressScene):
+		{
+			const Craig::StressSceneSettings& settings = action.stressSettings;
+			writeValue(file, static_cast<uint8_t>(settings.layout));
+			writeValue(file, settings.objectCount);
+			writeValue(file, settings.seed);
+			writeValue(file, settings.spacing);
+			writeValue(file, settings.objectRadius);
+			writeValue(file, settings.clusterCount);
+			writeValue(file, static_cast<uint32_t>(settings.modelPaths.size()));
+			for (const std::string& modelPath : settings.modelPaths) {
+				writeString(file, modelPath);
+			}
+			break;
+		}
+		}
+	}
+
+	CRAIG_LOG_INFO(eReplay, "Wrote %zu camera samples and %zu scene edits to %s\n", mv_samples.size(), mv_actions.size(), path.c_str());
+	return true;
+}
+
+CraigError Craig::Replay::startPlayback(const std::string& path, const std::string& resultsPath) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	if (m_recording) {
+		CRAIG_LOG_WARN(eReplay, "Can't play a replay back while recording\n");
+		return CRAIG_FAIL;
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(eReplay, "Couldn't open replay %s\n", path.c_str());
+		return CRAIG_FILE_NOT_FOUND;
+	}
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	char magic[4] = {};
+	uint32_t version = 0;
+	uint32_t sampleCount = 0;
+	uint32_t actionCount = 0;
+	file.read(magic, sizeof(magic));
+	if (!file || memcmp(magic, kReplayMagic, sizeof(magic)) != 0 || !readValue(file, version) || version != kReplayFileVersion ||
+		!readValue(file, sampleCount) || !readValue(file, actionCount) || sampleCount == 0) {
+		CRAIG_LOG_WARN(eReplay, "%s isn't a replay this build can play\n", path.c_str());
+		return CRAIG_INVALID_FILE;
+	}
+
+	// The counts come straight out of the file, so check it's actually got that much in it before allocating for them
+	uint64_t remainingBytes = fileSize - static_cast<uint64_t>(file.tellg());
+	if (sampleCount * kSampleBytes > remainingBytes || actionCount * kMinActionBytes > remainingBytes - sampleCount * kSampleBytes) {
+		CRAIG_LOG_WARN(eReplay, "%s says it has %u camera samples and %u scene edits but is only %llu bytes\n", path.c_str(), sampleCount, actionCount,
+			static_cast<unsigned long long>(fileSize));
+		return CRAIG_INVALID_FILE;
+	}
+
+	// The frame count comes from the last sample's time, so the times have to be sane and in order and the last one
+	// can't be further in than kReplayMaxFrames
+	const float maxTime = static_cast<float>(kReplayMaxFrames - 1) * kReplayTimestep;
+	std::vector<CameraSample> samples(sampleCount);
+	bool ok = true;
+	float lastTime = 0.0f;
+	for (CameraSample& sample : samples) {
+		ok = ok && readValue(file, sample.time);
+		ok = ok && std::isfinite(sample.time) && sample.time >= lastTime && sample.time <= maxTime;
+		ok = ok && readValue(file, sample.position.x) && readValue(file, sample.position.y) && readValue(file, sample.position.z);
+		ok = ok && readValue(file, sample.pitchYaw.x) && readValue(file, sample.pitchYaw.y);
+		if (!ok) {
+			break;
+		}
+		lastTime = sample.time;
+	}
+
+	std::vector<Action> actions(actionCount);
+	for (Action& action : actions) {
+		uint8_t type = 0;
+		ok = ok && readValue(file, type) && readValue(file, action.time);
+		action.type = static_cast<ActionType>(type);
+
+		switch (action.type)
+		{
+		case(ActionType::Spawn):
+			ok = ok && readString(file, action.name) && readString(file, action.modelPath);
+			ok = ok && readValue(file, action.position.x) && readValue(file, action.position.y) && readValue(file, action.position.z);
+			break;
+
+		case(ActionType::Delete):
+			ok = ok && readString(file, action.name);
+			break;
+
+		case(ActionType::StressScene):
+		{
+			Craig::StressSceneSettings& settings = action.stressSettings;
+			uint8_t layout = 0;
+			uint32_t modelCount = 0;
+			ok = ok && readValue(file, layout) && readValue(file, settings.objectCount) && readValue(file, settings.seed);
+			ok = ok && readValue(file, settings.spacing) && readValue(file, settings.objectRadius) && readValue(file, settings.clusterCount);
+			ok = ok && readValue(file, modelCount) && modelCount < (1u << 16);
+			ok = ok && layout <= static_cast<uint8_t>(Craig::StressLayout::DeepOcclusion); // The last one
+			settings.layout = static_cast<Craig::StressLayout>(layout);
+			settings.modelPaths.resize(ok ? modelCount : 0);
+			for (std::string& modelPath : settings.modelPaths) {
+				ok = ok && readString(file, modelPath);
+			}
+			break;
+		}
+
+		default:
+			ok = false;
+			break;
+		}
+
+		if (!ok) {
+			break;
+		}
+	}
+
+	if (!ok) {
+		CRAIG_LOG_WARN(eReplay, "%s is cut short or corrupt\n", path.c_str());
+		return CRAIG_INVALID_FILE;
+	}
+
+	mv_samples = std::move(samples);
+	mv_actions = std::move(actions);
+	m_playbackPath = path;
+	m_resultsPath = resultsPath;
+	m_playbackFrame = 0;
+	m_nextSample = 0;
+	m_nextAction = 0;
+	mv_frameTimings.clear();
+	mv_frameTimings.reserve(getPlaybackFrameCount());
+	m_finished = false;
+	m_playing = true;
+
+	CRAIG_LOG_INFO(eReplay, "Playing %s, %u frames at a fixed %.2f ms step\n", path.c_str(), getPlaybackFrameCount(), kReplayTimestep * 1000.0f);
+	return ret;
+}
+
+void Craig::Replay::stopPlayback() {
+	m_playing = false;
+}
+
+uint32_t Craig::Replay::getPlaybackFrameCount() const {
+
+	if (mv_samples.empty()) {
+		return 0;
+	}
+	return static_cast<uint32_t>(mv_samples.back().time / kReplayTimestep) + 1;
+}
+
+float Craig::Replay::beginFrame(float wallDeltaTime, Craig::Renderer& renderer, Craig::Camera& camera) {
+
+	if (!m_playing) {
+		releaseCamera(camera);
+		return wallDeltaTime;
+	}
+
+	// The frame before this one's done as far as the CPU goes. The GPU time is a few frames stale by the time the
+	// renderer reads it back, but over a whole replay it's the same frames either way.
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (m_playbackFrame > 0) {
+		FrameTiming timing;
+		timing.cpuMs = std::chrono::duration<float, std::milli>(now - m_frameStart).count();
+		timing.gpuMs = renderer.getTimestampsSupported() ? renderer.getGpuProfiler().getLastMs("Frame") : 0.0f;
+		mv_frameTimings.push_back(timing);
+	}
+	m_frameStart = now;
+
+	if (m_playbackFrame >= getPlaybackFrameCount()) {
+		m_playing = false;
+		m_finished = true;
+		releaseCamera(camera);
+		CRAIG_LOG_INFO(eReplay, "Finished playing %s\n", m_playbackPath.c_str());
+
+		if (!m_resultsPath.empty()) {
+			writeResults(m_resultsPath, renderer);
+		}
+		return wallDeltaTime;
+	}
+
+	// Nobody else gets to move it until the replay's done
+	if (!m_cameraHeld) {
+		camera.setInputEnabled(false);
+		m_cameraHeld = true;
+	}
+
+	// Frame n always lands on the same recorded moment, however long the real frames take
+	float time = m_playbackFrame * kReplayTimestep;
+
+	while (m_nextAction < mv_actions.size() && mv_actions[m_nextAction].time <= time) {
+		applyAction(mv_actions[m_nextAction], renderer);
+		m_nextAction++;
+	}
+
+	while (m_nextSample + 1 < mv_samples.size() && mv_samples[m_nextSample + 1].time <= time) {
+		m_nextSample++;
+	}
+
+	const CameraSample& from = mv_samples[m_nextSample];
+	const CameraSample& to = mv_samples[std::min(m_nextSample + 1, mv_samples.size() - 1)];
+	float span = to.time - from.time;
+	float t = span > 0.0f ? std::clamp((time - from.time) / span, 0.0f, 1.0f) : 0.0f;
+
+	camera.setPosition(glm::mix(from.position, to.position, t));
+	camera.setPitchYaw(glm::mix(from.pitchYaw, to.pitchYaw, t));
+
+	m_playbackFrame++;
+	return kReplayTimestep;
+}
+
+void Craig::Replay::releaseCamera(Craig::Camera& camera) {
+
+	if (m_cameraHeld) {
+		camera.setInputEnabled(true);
+		m_cameraHeld = false;
+	}
+}
+
+void Craig::Replay::endFrame(Craig::Camera& camera) {
+
+	if (!m_recording) {
+		return;
+	}
+
+	CameraSample sample;
+	sample.time = recordTime();
+	sample.position = camera.getPosition();
+	sample.pitchYaw = camera.getRotation();
+	mv_samples.push_back(sample);
+}
+
+void Craig::Replay::recordSpawn(const std::string& name, const std::string& modelPath, const glm::vec3& position) {
+
+	if (!m_recording) {
+		return;
+	}
+
+	Action action;
+	action.time = recordTime();
+	action.type = ActionType::Spawn;
+	action.name = name;
+	action.modelPath = modelPath;
+	action.position = position;
+	mv_actions.push_back(action);
+}
+
+void Craig::Replay::recordDelete(const std::string& name) {
+
+	if (!m_recording) {
+		return;
+	}
+
+	Action action;
+	action.time = recordTime();
+	action.type = ActionType::Delete;
+	action.name = name;
+	mv_actions.push_back(action);
+}
+
+void Craig::Replay::recordStressScene(const Craig::StressSceneSettings& settings) {
+
+	if (!m_recording) {
+		return;
+	}
+
+	Action action;
+	action.time = recordTime();
+	action.type = ActionType::StressScene;
+	action.stressSettings = settings;
+	mv_actions.push_back(action);
+}
+
+void Craig::Replay::applyAction(const Action& action, Craig::Renderer& renderer) {
+
+	switch (action.type)
+	{
+	case(ActionType::Spawn):
+		if (renderer.newGameObject(action.name, action.modelPath, action.position) != CRAIG_SUCCESS) {
+			CRAIG_LOG_WARN(eReplay, "Replay couldn't spawn %s\n", action.name.c_str());
+		}
+		break;
+
+	case(ActionType::Delete):
+	{
+		Craig::GameObject* gameObject = renderer.getSceneManager()->getCurrentScene()->findObject(action.name);
+		if (gameObject != nullptr) {
+			renderer.deleteGameObject(gameObject);
+		}
+		else {
+			CRAIG_LOG_WARN(eReplay, "Replay couldn't find %s to delete\n", action.name.c_str());
+		}
+		break;
+	}
+
+	case(ActionType::StressScene):
+		if (renderer.generateStressScene(action.stressSettings) != CRAIG_SUCCESS) {
+			CRAIG_LOG_WARN(eReplay, "Replay couldn't generate its stress scene\n");
+		}
+		break;
+	}
+}
+
+bool Craig::Replay::writeResults(const std::string& path, const Craig::Renderer& renderer) const {
+
+	std::vector<float> cpuMs;
+	std::vector<float> gpuMs;
+	nlohmann::json frames = nlohmann::json::array();
+	for (const FrameTiming& timing : mv_frameTimings) {
+		cpuMs.push_back(timing.cpuMs);
+		gpuMs.push_back(timing.gpuMs);
+		frames.push_back({ timing.cpuMs, timing.gpuMs });
+	}
+
+	nlohmann::json results;
+	results["replay"] = m_playbackPath;
+	results["build"] = __DATE__ " " __TIME__;
+	results["device"] = renderer.getDeviceName();
+	results["timestepMs"] = kReplayTimestep * 1000.0f;
+	results["frameCount"] = mv_frameTimings.size();
+	results["cpuFrame"] = summarise(cpuMs);
+	if (renderer.getTimestampsSupported()) {
+		results["gpuFrame"] = summarise(gpuMs);
+	}
+	results["frames"] = frames; // [cpu ms, gpu ms] per frame
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(eReplay, "Couldn't open %s to write the replay results\n", path.c_str());
+		return false;
+	}
+
+	file << results.dump(2);
+	CRAIG_LOG_INFO(eReplay, "Wrote replay timings for %zu frames to %s\n", mv_frameTimings.size(), path.c_str());
+	return true;
+}
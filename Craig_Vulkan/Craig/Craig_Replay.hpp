@@ -0,0 +1,119 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "Craig_Constants.hpp"
+#include "Craig_StressScene.hpp"
+
+namespace Craig {
+
+	class Camera;
+	class Renderer;
+
+	// Records the camera and any editor changes to the scene, and plays them back on a fixed timestep so every
+	// replay renders exactly the same frames. Playback writes out the CPU and GPU time of every frame, so two
+	// builds can be compared by playing the same recording on each.
+	//
+	// A recording starts from whatever the scene looked like when recording began, so play it back from the same
+	// starting scene (straight after launch is easiest).
+	class Replay {
+
+	public:
+		struct FrameTiming {
+			float cpuMs = 0.0f; // Wall clock from this frame's start to the next one's
+			float gpuMs = 0.0f; // The renderer's "Frame" scope, 0 without timestamp support
+		};
+
+		static Replay& getInstance()
+		{
+			static Replay instance; // Guaranteed to be destroyed.
+			return instance;
+		}
+		Replay(Replay const&) = delete;
+		void operator=(Replay const&) = delete;
+
+		void startRecording();
+		bool stopRecording(const std::string& path); // Writes the recording out
+		bool isRecording() const { return m_recording; }
+
+		// Results go to resultsPath when it finishes, or nowhere if it's empty
+		CraigError startPlayback(const std::string& path, const std::string& resultsPath = kReplayResultsPath);
+		void stopPlayback();
+		bool isPlaying() const { return m_playing; }
+		bool hasFinished() const { return m_finished; } // Played through to the end since the last startPlayback
+
+		// Call once a frame before the scene updates. Gives back the timestep the frame should use: wallDeltaTime normally,
+		// the fixed step while playing. Also puts the camera where the recording had it and runs any recorded edits.
+		float beginFrame(float wallDeltaTime, Craig::Renderer& renderer, Craig::Camera& camera);
+
+		// Call once a frame after the renderer's done, takes down where the camera ended up
+		void endFrame(Craig::Camera& camera);
+
+		// Editor changes, the renderer passes these on when it makes them. Ignored unless recording.
+		void recordSpawn(const std::string& name, const std::string& modelPath, const glm::vec3& position);
+		void recordDelete(const std::string& name);
+		void recordStressScene(const Craig::StressSceneSettings& settings);
+
+		const std::vector<FrameTiming>& getFrameTimings() const { return mv_frameTimings; } // From the last playback
+		uint32_t getPlaybackFrame() const { return m_playbackFrame; }
+		uint32_t getPlaybackFrameCount() const;
+		size_t getRecordedSampleCount() const { return mv_samples.size(); }
+
+	private:
+		Replay() {}
+
+		enum class ActionType : uint8_t {
+			Spawn = 0,
+			Delete = 1,
+			StressScene = 2,
+		};
+
+		struct CameraSample {
+			float     time = 0.0f; // Seconds since recording started
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::vec2 pitchYaw = glm::vec2(0.0f);
+		};
+
+		struct Action {
+			float                      time = 0.0f;
+			ActionType                 type = ActionType::Spawn;
+			std::string                name;
+			std::string                modelPath;
+			glm::vec3                  position = glm::vec3(0.0f);
+			Craig::StressSceneSettings stressSettings;
+		};
+
+		void applyAction(const Action& action, Craig::Renderer& renderer);
+		bool writeResults(const std::string& path, const Craig::Renderer& renderer) const;
+		float recordTime() const;
+		void releaseCamera(Craig::Camera& camera);
+
+		bool m_recording = false;
+		bool m_playing = false;
+		bool m_finished = false;
+		bool m_cameraHeld = false; // Camera input's switched off for playback
+
+		std::chrono::steady_clock::time_point m_recordStart;
+
+		std::vector<CameraSample> mv_samples;
+		std::vector<Action>       mv_actions;
+
+		// Playback
+		std::string m_playbackPath;
+		std::string m_resultsPath;
+		uint32_t    m_playbackFrame = 0;
+		size_t      m_nextSample = 0;
+		size_t      m_nextAction = 0;
+
+		std::vector<FrameTiming>              mv_frameTimings;
+		std::chrono::steady_clock::time_point m_frameStart;
+	};
+
+}
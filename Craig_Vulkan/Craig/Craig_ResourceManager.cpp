@@ -4,8 +4,16 @@
 
 #include "Craig_ResourceManager.hpp"
 #include "Craig_Renderer.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Log.hpp"
+#include "Craig_MemoryTracker.hpp"
+#include "Craig_GameObject.hpp"
 #include "../External/tiny_gltf.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
 
 vk::VertexInputBindingDescription Craig::Vertex::getBindingDescription() {
     vk::VertexInputBindingDescription bindingDescription;
@@ -44,6 +52,29 @@ std::array<vk::VertexInputAttributeDescription, 3> Craig::Vertex::getAttributeDe
     return attributeDescriptions;
 }
 
+vk::VertexInputBindingDescription Craig::Vertex::getPositionBindingDescription() {
+    vk::VertexInputBindingDescription bindingDescription;
+
+    bindingDescription
+        .setBinding(0)
+        .setStride(static_cast<uint32_t>(kPositionStride))
+        .setInputRate(vk::VertexInputRate::eVertex);
+
+    return bindingDescription;
+}
+
+vk::VertexInputAttributeDescription Craig::Vertex::getPositionAttributeDescription() {
+    vk::VertexInputAttributeDescription attributeDescription;
+
+    attributeDescription
+        .setBinding(0)
+        .setLocation(0) //Same POSITION0 as the full vertex layout
+        .setFormat(vk::Format::eR32G32B32Sfloat)
+        .setOffset(0);
+
+    return attributeDescription;
+}
+
 CraigError Craig::ResourceManager::init(Craig::Renderer* rendererToSet) {
 
     CraigError ret = CRAIG_SUCCESS;
@@ -63,6 +94,9 @@ CraigError Craig::ResourceManager::terminate() {
 }
 
 void Craig::ResourceManager::loadModel(std::string modelPath) {
+    CRAIG_PROFILE_ZONE("ResourceManager::loadModel");
+    CRAIG_MEMORY_SCOPE(eResourceManager);
+
     // If this model has already been loaded (e.g. a second GameObject using the
     // same glb), don't re-upload it. Doing so leaks the GPU texture and SubMesh
     // pointers because unordered_map::insert silently drops the duplicate key.
@@ -70,6 +104,26 @@ void Craig::ResourceManager::loadModel(std::string modelPath) {
         return;
     }
 
+    Craig::Model tempModel;
+    bool ret = parseModel(modelPath, tempModel, [this, &modelPath](const uint8_t* pixels, int width, int height, int channels, Craig::Texture* outTexture) {
+        m_renderer->createTextureImage2(pixels, width, height, channels, outTexture, modelPath);
+    });
+
+    if (!ret) {
+        exit(CRAIG_FAIL);
+    }
+    else {
+        CRAIG_LOG_INFO(eResources, "Loaded %s", modelPath);
+    }
+
+    m_loadedModels.insert({modelPath, tempModel});
+}
+
+// Everything loadModel does on the CPU. Textures go to onTexture rather than straight to the GPU, so this can run without a renderer.
+bool Craig::ResourceManager::parseModel(const std::string& modelPath, Craig::Model& outModel, const TextureCallback& onTexture) {
+
+    CRAIG_MEMORY_SCOPE(eResourceManager);
+
     tinygltf::Model model;
     tinygltf::TinyGLTF loader;
     std::string err, warn;
@@ -78,19 +132,16 @@ void Craig::ResourceManager::loadModel(std::string modelPath) {
     // use LoadBinaryFromFile for .glb
 
     if (!warn.empty()) {
-        std::cout << warn << std::endl;
+        CRAIG_LOG_WARN(eResources, "%s: %s", modelPath, warn);
     }
     if (!err.empty()) {
-        std::cerr << err << std::endl;
+        CRAIG_LOG_ERROR(eResources, "%s: %s", modelPath, err);
     }
     if (!ret) {
-        exit(CRAIG_FAIL);
-    }
-    else {
-        printf("model found \n");
+        return false;
     }
 
-    Craig::Model tempModel;
+    Craig::Model& tempModel = outModel;
 
     int i = 0;
     // iterate all meshes / primitives, no scene graph yet
@@ -226,19 +277,172 @@ void Craig::ResourceManager::loadModel(std::string modelPath) {
                         int comp = img.component; // usually 4 (RGBA)
 
                         // createVulkanTextureFromPixels(pixels, width, height, comp);
-                        m_renderer->createTextureImage2(pixels, width, height, comp, &tempModel.m_texture);
+                        if (onTexture) {
+                            onTexture(pixels, width, height, comp, &tempModel.m_texture);
+                        }
                     }
                 }
             }
 
         }
 
+        computeSubMeshBounds(tempMesh);
         tempModel.subMeshes.push_back(tempMesh);
     }
 
     tempModel.subMeshesCount = i;
+    computeModelBounds(tempModel);
 
-    m_loadedModels.insert({modelPath, tempModel});
+    return true;
+}
+
+
+// Hands out each submesh's slot in the shared vertex buffer. Every model only gets packed once however many objects use it.
+uint32_t Craig::ResourceManager::assignVertexOffsets(const std::vector<Craig::Model*>& models) {
+
+    uint32_t totalVertexCount = 0;
+    for (Craig::Model* model : models)
+    {
+        for (size_t i = 0; i < model->subMeshesCount; i++)
+        {
+            Craig::SubMesh* submesh = model->subMeshes[i];
+            submesh->vertexOffset = totalVertexCount;
+            totalVertexCount += static_cast<uint32_t>(submesh->m_vertices.size());
+        }
+    }
+    return totalVertexCount;
+}
+
+uint32_t Craig::ResourceManager::assignIndexOffsets(const std::vector<Craig::Model*>& models) {
+
+    uint32_t totalIndexCount = 0;
+    for (Craig::Model* model : models)
+    {
+        for (size_t i = 0; i < model->subMeshesCount; ++i) {
+            Craig::SubMesh* submesh = model->subMeshes[i];
+            submesh->indexOffset = totalIndexCount;
+            totalIndexCount += static_cast<uint32_t>(submesh->m_indices.size());
+        }
+    }
+    return totalIndexCount;
+}
+
+// Copies each submesh's vertices to the offset assignVertexOffsets gave it, and its positions into the packed
+// 3 float stream the depth pre-pass reads.
+void Craig::ResourceManager::packVertices(const std::vector<Craig::Model*>& models, Craig::Vertex* dst, float* dstPositions) {
+
+    for (Craig::Model* model : models)
+    {
+        for (size_t i = 0; i < model->subMeshesCount; ++i) {
+            Craig::SubMesh* submesh = model->subMeshes[i];
+            std::vector<Craig::Vertex>& verts = submesh->m_vertices;
+            if (verts.empty()) continue;
+
+            std::memcpy(dst + submesh->vertexOffset,
+                verts.data(),
+                sizeof(Craig::Vertex) * verts.size());
+
+            float* positions = dstPositions + static_cast<size_t>(submesh->vertexOffset) * 3;
+            for (size_t v = 0; v < verts.size(); v++) {
+                positions[v * 3 + 0] = verts[v].m_pos.x;
+                positions[v * 3 + 1] = verts[v].m_pos.y;
+                positions[v * 3 + 2] = verts[v].m_pos.z;
+            }
+        }
+    }
+}
+
+// Indices are submesh-local, drawIndexed's vertexOffset parameter applies the global vertex offset at draw time.
+void Craig::ResourceManager::packIndices(const std::vector<Craig::Model*>& models, uint32_t* dst) {
+
+    for (Craig::Model* model : models)
+    {
+        for (size_t i = 0; i < model->subMeshesCount; ++i) {
+            Craig::SubMesh* submesh = model->subMeshes[i];
+            std::vector<uint32_t>& indices = submesh->m_indices;
+            if (indices.empty()) continue;
+
+            std::memcpy(dst + submesh->indexOffset,
+                indices.data(),
+                sizeof(uint32_t) * indices.size());
+        }
+    }
+}
+
+// Each model the objects use, once, in the order they first turn up
+std::vector<Craig::Model*> Craig::ResourceManager::getModelsUsedBy(const std::vector<Craig::GameObject*>& gameObjects) {
+
+    std::vector<Craig::Model*> models;
+    std::unordered_set<std::string> seenModels;
+    for (Craig::GameObject* gameObject : gameObjects)
+    {
+        const std::string& path = gameObject->getModelPath();
+        if (!seenModels.insert(path).second) continue;
+
+        models.push_back(&getModel(path));
+    }
+    return models;
+}
+
+// AABB straight from the vertex positions, then a sphere around the AABB centre.
+// Using the furthest vertex from the centre for the radius is a fair bit tighter than half the AABB diagonal.
+void Craig::ResourceManager::computeSubMeshBounds(Craig::SubMesh* subMesh) {
+
+    if (subMesh->m_vertices.empty()) {
+        subMesh->m_aabbMin = glm::vec3(0.0f);
+        subMesh->m_aabbMax = glm::vec3(0.0f);
+        subMesh->m_boundingSphere = glm::vec4(0.0f);
+        return;
+    }
+
+    glm::vec3 aabbMin = subMesh->m_vertices[0].m_pos;
+    glm::vec3 aabbMax = subMesh->m_vertices[0].m_pos;
+    for (const Craig::Vertex& v : subMesh->m_vertices) {
+        aabbMin = glm::min(aabbMin, v.m_pos);
+        aabbMax = glm::max(aabbMax, v.m_pos);
+    }
+
+    glm::vec3 centre = (aabbMin + aabbMax) * 0.5f;
+    float radiusSq = 0.0f;
+    for (const Craig::Vertex& v : subMesh->m_vertices) {
+        glm::vec3 d = v.m_pos - centre;
+        radiusSq = std::max(radiusSq, glm::dot(d, d));
+    }
+
+    subMesh->m_aabbMin = aabbMin;
+    subMesh->m_aabbMax = aabbMax;
+    subMesh->m_boundingSphere = glm::vec4(centre, std::sqrt(radiusSq));
+}
+
+// Whole model bounds, built from the submesh bounds so we don't walk the vertices again.
+void Craig::ResourceManager::computeModelBounds(Craig::Model& model) {
+
+    bool first = true;
+    for (const Craig::SubMesh* subMesh : model.subMeshes) {
+        if (subMesh->m_vertices.empty()) continue;
+
+        if (first) {
+            model.m_aabbMin = subMesh->m_aabbMin;
+            model.m_aabbMax = subMesh->m_aabbMax;
+            first = false;
+        }
+        else {
+            model.m_aabbMin = glm::min(model.m_aabbMin, subMesh->m_aabbMin);
+            model.m_aabbMax = glm::max(model.m_aabbMax, subMesh->m_aabbMax);
+        }
+    }
+
+    glm::vec3 centre = (model.m_aabbMin + model.m_aabbMax) * 0.5f;
+    float radius = 0.0f;
+    for (const Craig::SubMesh* subMesh : model.subMeshes) {
+        if (subMesh->m_vertices.empty()) continue;
+
+        // Sphere that contains the submesh sphere, measured from the model centre
+        float reach = glm::length(glm::vec3(subMesh->m_boundingSphere) - centre) + subMesh->m_boundingSphere.w;
+        radius = std::max(radius, reach);
+    }
+
+    model.m_boundingSphere = glm::vec4(centre, radius);
 }
 
 void Craig::ResourceManager::terminateModels(const vk::Device& device, const VmaAllocator& memoryAllocator) {
@@ -10,12 +10,15 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vulkan/vulkan.hpp>
 #include "../External/vk_mem_alloc.h"
+#include <functional>
 #include <unordered_map>
+#include <vector>
 
 
 namespace Craig {
 
 	class Renderer;
+	class GameObject;
 
 	//Vertex buffer
 	struct Vertex {
@@ -26,6 +29,11 @@ namespace Craig {
 		static vk::VertexInputBindingDescription getBindingDescription(); //A vertex binding describes at which rate to load data from memory throughout the vertices. It specifies the number of bytes between data entries and whether to move to the next data entry after each vertex or after each instance.
 		static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions(); //We have two attributes, position and color, so we need two attribute description structs.
 
+		// The depth pre-pass reads positions from their own tightly packed stream (3 floats per vertex) so it drags in a third of the bytes
+		static constexpr vk::DeviceSize kPositionStride = sizeof(float) * 3;
+		static vk::VertexInputBindingDescription getPositionBindingDescription();
+		static vk::VertexInputAttributeDescription getPositionAttributeDescription();
+
 	};
 
 	struct SubMesh
@@ -40,11 +48,17 @@ namespace Craig {
 		uint32_t indexCount;
 		uint32_t firstVertex;
 		int      materialIndex; // prim.material
+
+		// Model space bounds, filled in by the importer. Used for culling.
+		glm::vec3 m_aabbMin = glm::vec3(0.0f);
+		glm::vec3 m_aabbMax = glm::vec3(0.0f);
+		glm::vec4 m_boundingSphere = glm::vec4(0.0f); // xyz = centre, w = radius
 	};
 
 	struct Texture
 	{
 		uint32_t      m_VK_mipLevels = 0;
+		vk::Extent2D  m_extent;
 
 		vk::Image     m_VK_textureImage;
 		VmaAllocation m_VMA_textureImageAllocation;
@@ -59,6 +73,11 @@ namespace Craig {
 		std::string modelPath;
 		Craig::Texture m_texture;
 
+		// Bounds of every submesh combined, this is what we cull gameobjects with
+		glm::vec3 m_aabbMin = glm::vec3(0.0f);
+		glm::vec3 m_aabbMax = glm::vec3(0.0f);
+		glm::vec4 m_boundingSphere = glm::vec4(0.0f); // xyz = centre, w = radius
+
 	};
 
 	
@@ -69,11 +88,25 @@ namespace Craig {
 		CraigError init(Craig::Renderer* rendererToSet);
 		CraigError terminate();
 
+		// Called with each base colour image a model has, the renderer turns them into textures
+		using TextureCallback = std::function<void(const uint8_t* pixels, int width, int height, int channels, Craig::Texture* outTexture)>;
+
 		void loadModel(std::string modelPath);
+		static bool parseModel(const std::string& modelPath, Craig::Model& outModel, const TextureCallback& onTexture);
 		void terminateModels(const vk::Device& device, const VmaAllocator& memoryAllocator);
 
 		Craig::Model& getModel(std::string modelPath) { return m_loadedModels[modelPath]; };
 
+		static void computeSubMeshBounds(Craig::SubMesh* subMesh);
+		static void computeModelBounds(Craig::Model& model);
+
+		// Geometry packing for the shared vertex/index buffers, split out of the renderer so it can be timed without a GPU
+		std::vector<Craig::Model*> getModelsUsedBy(const std::vector<Craig::GameObject*>& gameObjects);
+		static uint32_t assignVertexOffsets(const std::vector<Craig::Model*>& models); // Gives back the total vertex count
+		static uint32_t assignIndexOffsets(const std::vector<Craig::Model*>& models);  // Gives back the total index count
+		static void packVertices(const std::vector<Craig::Model*>& models, Craig::Vertex* dst, float* dstPositions);
+		static void packIndices(const std::vector<Craig::Model*>& models, uint32_t* dst);
+
 		//===============================================================================
 		// Singleton Implementations
 		static ResourceManager& getInstance()
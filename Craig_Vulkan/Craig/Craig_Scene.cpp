@@ -1,5 +1,13 @@
 #include "Craig_Scene.hpp"
 #include "Craig_Utilities.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Counters.hpp"
+#include "Craig_Log.hpp"
+#include "Craig_MemoryTracker.hpp"
+#include "Craig_ResourceManager.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
 
 CraigError Craig::Scene::init() {
@@ -15,6 +23,8 @@ CraigError Craig::Scene::init() {
 	m_secondObject->init("fuck","data/models/Duck.glb", this);
 	m_secondObject->setScale(glm::vec3(0.01f));
 	mpv_Gameobjects.push_back(m_secondObject);
+
+	reindexGameObjects();
 	//mv_Gameobjects.push_back(m_MainObject);
 	// for (size_t i = 0; i < mv_Gameobjects.size(); i++)
 	// {
@@ -48,9 +58,11 @@ void Craig::Scene::deleteGameObject(GameObject* const pObject)
 
 	// Remove the game object from the scene objects
 	std::erase(mpv_Gameobjects, pObject);
+	std::erase(mpv_dirtyObjects, pObject);
+	std::erase(mpv_updatedObjects, pObject);
 
 	// Sort the editor game object list by alphabetical order.
-	Utilities::sortGameObjectsByName(mpv_Gameobjects);
+	sortGameObjects();
 
 	// Free the memory allocated for the game object
 	delete pObject;
@@ -61,6 +73,8 @@ CraigError Craig::Scene::newGameObject(std::string objectName, std::string model
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_MEMORY_SCOPE(eScene);
+
 	// Check to see if name has been provided.
 	if (objectName.empty())
 	{
@@ -86,26 +100,165 @@ CraigError Craig::Scene::newGameObject(std::string objectName, std::string model
 	mpv_Gameobjects.push_back(tempObject);
 
 	// Sort the editor game object list by alphabetical order.
-	Utilities::sortGameObjectsByName(mpv_Gameobjects);
+	sortGameObjects();
+
+	return ret;
+}
+
+CraigError Craig::Scene::generateStressScene(const Craig::StressSceneSettings& settings, Craig::StressSceneProfile* outProfile)
+{
+	CraigError ret = CRAIG_SUCCESS;
+
+	CRAIG_PROFILE_ZONE("Scene::generateStressScene");
+	CRAIG_MEMORY_SCOPE(eScene);
+
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	if (settings.objectCount == 0 || settings.objectCount > kStressSceneMaxObjects || settings.modelPaths.empty())
+	{
+		return CRAIG_FAIL;
+	}
+
+	for (const std::string& modelPath : settings.modelPaths)
+	{
+		if (std::filesystem::exists(modelPath) == false)
+		{
+			return CRAIG_FILE_NOT_FOUND;
+		}
+	}
+
+	clearGameObjects();
+
+	// Start the camera off the same way every time, the layouts are built in front of it
+	m_camera.setPosition(glm::vec3(0.0f));
+	m_camera.setPitchYaw(glm::vec2(0.0f));
+	m_camera.getVelocity() = glm::vec3(0.0f);
+
+	std::vector<Craig::StressPlacement> placements = Craig::StressScene::generatePlacements(settings, m_camera.m_fov);
+
+	// Models come in all sizes (the duck's about a hundred times the fish), so each one gets scaled to the same bounding sphere
+	std::vector<Craig::Model*> models;
+	for (const std::string& modelPath : settings.modelPaths)
+	{
+		Craig::ResourceManager::getInstance().loadModel(modelPath);
+		models.push_back(&Craig::ResourceManager::getInstance().getModel(modelPath));
+	}
+
+	std::vector<uint32_t> instancesPerModel(models.size(), 0);
+	uint32_t subMeshInstances = 0;
+
+	// Zero padded so sorting by name leaves them in the order they were made
+	const int nameDigits = static_cast<int>(std::to_string(placements.size()).size());
+	char name[32];
+
+	mpv_Gameobjects.reserve(placements.size());
+	for (size_t i = 0; i < placements.size(); i++)
+	{
+		const Craig::StressPlacement& placement = placements[i];
+		const Craig::Model& model = *models[placement.modelIndex];
+
+		float scale = model.m_boundingSphere.w > 0.0f ? settings.objectRadius / model.m_boundingSphere.w : 1.0f;
+
+		// The model's bounding sphere isn't always around its origin, shift it so the sphere lands on the placement
+		float yaw = glm::radians(placement.yawDegrees);
+		glm::vec3 centre = glm::vec3(model.m_boundingSphere) * scale;
+		glm::vec3 rotatedCentre = glm::vec3(
+			centre.x * std::cos(yaw) + centre.z * std::sin(yaw),
+			centre.y,
+			-centre.x * std::sin(yaw) + centre.z * std::cos(yaw));
+
+		snprintf(name, sizeof(name), "stress_%0*zu", nameDigits, i);
+
+		Craig::GameObject* gameObject = new Craig::GameObject;
+		gameObject->init(name, settings.modelPaths[placement.modelIndex], this);
+		gameObject->setPosition(placement.position - rotatedCentre);
+		gameObject->setRotation(glm::vec3(0.0f, placement.yawDegrees, 0.0f));
+		gameObject->setScale(glm::vec3(scale));
+		mpv_Gameobjects.push_back(gameObject);
+
+		instancesPerModel[placement.modelIndex]++;
+		subMeshInstances += model.subMeshesCount;
+	}
+
+	// Already in name order, so skip the sort and just hand out the indices
+	reindexGameObjects();
+
+	// The bigger layouts go well past the default far plane, pull it out so none of it gets lost to that
+	m_camera.m_farPlane = std::max(m_camera.m_farPlane, Craig::StressScene::getFurthestDistance(placements, settings.objectRadius) * 1.1f);
+
+	Craig::StressSceneProfile profile;
+	profile.instanceCount = static_cast<uint32_t>(mpv_Gameobjects.size());
+	profile.subMeshInstanceCount = subMeshInstances;
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (instancesPerModel[i] > 0)
+		{
+			profile.distinctModelCount++;
+		}
+		profile.instancesPerModel.emplace_back(settings.modelPaths[i], instancesPerModel[i]);
+	}
+	profile.generateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	CRAIG_LOG_INFO(eScene, "Stress scene (%s, seed %u): %u instances of %u distinct models, %u submesh draws, generated in %.1f ms\n",
+		Craig::StressScene::getLayoutName(settings.layout), settings.seed, profile.instanceCount, profile.distinctModelCount,
+		profile.subMeshInstanceCount, profile.generateMs);
+	for (const std::pair<std::string, uint32_t>& modelCount : profile.instancesPerModel)
+	{
+		CRAIG_LOG_INFO(eScene, "    %s: %u\n", modelCount.first.c_str(), modelCount.second);
+	}
+
+	if (outProfile != nullptr)
+	{
+		*outProfile = profile;
+	}
 
 	return ret;
 }
 
+// Only objects that were moved since last frame get updated, so a mostly static scene costs next to nothing here
 CraigError Craig::Scene::update(const float& deltaTime) {
 
 	CraigError ret = CRAIG_SUCCESS;
-	for (size_t i = 0; i < mpv_Gameobjects.size(); i++)
+
+	CRAIG_PROFILE_ZONE("Scene::update");
+
+	mpv_updatedObjects.swap(mpv_dirtyObjects);
+	mpv_dirtyObjects.clear();
+	CRAIG_COUNT(eObjectsUpdated, mpv_updatedObjects.size());
+
+	for (size_t i = 0; i < mpv_updatedObjects.size(); i++)
 	{
-		mpv_Gameobjects[i]->update();
+		mpv_updatedObjects[i]->update();
 	}
 	return ret;
 }
 
+void Craig::Scene::sortGameObjects()
+{
+	Utilities::sortGameObjectsByName(mpv_Gameobjects);
+	reindexGameObjects();
+}
+
+void Craig::Scene::reindexGameObjects()
+{
+	for (size_t i = 0; i < mpv_Gameobjects.size(); i++)
+	{
+		mpv_Gameobjects[i]->setSceneIndex(static_cast<uint32_t>(i));
+	}
+	m_structureVersion++;
+}
+
 
 CraigError Craig::Scene::terminate() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	clearGameObjects();
+	return ret;
+}
+
+void Craig::Scene::clearGameObjects()
+{
 	for (size_t i = 0; i < mpv_Gameobjects.size(); i++)
 	{
 		mpv_Gameobjects[i]->terminate();
@@ -113,7 +266,8 @@ CraigError Craig::Scene::terminate() {
 		mpv_Gameobjects[i] = nullptr;
 	}
 	mpv_Gameobjects.clear();
-	return ret;
+	mpv_dirtyObjects.clear();
+	mpv_updatedObjects.clear();
 }
 
 
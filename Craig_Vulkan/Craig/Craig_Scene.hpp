@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "Craig_Camera.hpp"
+#include "Craig_StressScene.hpp"
 
 namespace Craig {
 
@@ -21,9 +22,28 @@ namespace Craig {
 		Craig::Camera& getCamera() { return m_camera; }
 		void deleteGameObject(Craig::GameObject* gameObject);
 		CraigError newGameObject(std::string objectName, std::string modelPath, glm::vec3 position);
+
+		// Sorts the objects by name and hands out their new indices. Anything that reorders the list has to go through here.
+		void sortGameObjects();
+
+		// Throws away everything in the scene and fills it with a generated layout instead, then points the camera at it.
+		// Objects are added in one go rather than through newGameObject, which re-sorts the whole list every time.
+		CraigError generateStressScene(const Craig::StressSceneSettings& settings, Craig::StressSceneProfile* outProfile = nullptr);
+
+		// Transform dirty tracking. Objects queue themselves up when they move, update() only touches those.
+		void markTransformDirty(Craig::GameObject* gameObject) { mpv_dirtyObjects.push_back(gameObject); }
+		const std::vector<Craig::GameObject*>& getUpdatedObjects() const { return mpv_updatedObjects; } // Rebuilt during the last update()
+
+		// Bumped whenever objects are added, removed or reordered, so anything indexed by scene index knows to start over
+		uint64_t getStructureVersion() const { return m_structureVersion; }
 	private:
+		void reindexGameObjects();
+		void clearGameObjects();
 
 		std::vector<Craig::GameObject*> mpv_Gameobjects;
+		std::vector<Craig::GameObject*> mpv_dirtyObjects;
+		std::vector<Craig::GameObject*> mpv_updatedObjects;
+		uint64_t m_structureVersion = 0;
 
 		Craig::Camera m_camera = Craig::Camera(); //Virtual camera for the scene
 	};
@@ -1,10 +1,13 @@
 #include "Craig_SceneManager.hpp"
+#include "Craig_MemoryTracker.hpp"
 #include <cassert>
 
 CraigError Craig::SceneManager::init() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_MEMORY_SCOPE(eScene);
+
 	// Initialize our scene
 	mp_CurrentScene = new Craig::Scene;
 	assert(mp_CurrentScene != nullptr && "mp_CurrentScene failed to allocate memory");
@@ -18,6 +21,8 @@ CraigError Craig::SceneManager::update(const float& deltaTime) {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_MEMORY_SCOPE(eScene);
+
 	mp_CurrentScene->update(deltaTime);
 
 	return ret;
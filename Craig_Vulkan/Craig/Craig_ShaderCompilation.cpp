@@ -1,4 +1,5 @@
 #include "Craig_ShaderCompilation.hpp"
+#include "Craig_Log.hpp"
 #include <iostream>
 
 #if defined(_WIN32)
@@ -52,6 +53,9 @@ vk::ShaderModule Craig::ShaderCompilation::CompileHLSLToShaderModule(vk::Device
 		if (extension == L"frag") {
 			targetProfile = L"ps_6_4";
 		}
+		if (extension == L"comp") {
+			targetProfile = L"cs_6_4";
+		}
 		// Mapping for other file types go here (cs_x_y, lib_x_y, etc.)
 	}
 
@@ -90,7 +94,7 @@ vk::ShaderModule Craig::ShaderCompilation::CompileHLSLToShaderModule(vk::Device
 		CComPtr<IDxcBlobEncoding> errorBlob;
 		hres = result->GetErrorBuffer(&errorBlob);
 		if (SUCCEEDED(hres) && errorBlob) {
-			std::cerr << "Shader compilation failed :\n\n" << (const char*)errorBlob->GetBufferPointer();
+			CRAIG_LOG_ERROR(ePipeline, "Shader compilation failed:\n%s", (const char*)errorBlob->GetBufferPointer());
 			throw std::runtime_error("Compilation failed");
 		}
 	}
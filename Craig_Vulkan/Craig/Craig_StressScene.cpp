@@ -0,0 +1,146 @@
+#include "Craig_StressScene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+	// [0, 1) from the top 24 bits, which is all a float can hold anyway
+	float unitFloat(std::mt19937& rng) {
+		return static_cast<float>(rng() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Box-Muller, only needs the one of the pair
+	float normalFloat(std::mt19937& rng) {
+		float u1 = std::max(unitFloat(rng), 1.0e-7f);
+		float u2 = unitFloat(rng);
+		return std::sqrt(-2.0f * std::log(u1)) * std::cos(6.28318530718f * u2);
+	}
+
+	uint32_t cubeSide(uint32_t count) {
+		uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+		return std::max(side, 1u);
+	}
+
+}
+
+std::vector<Craig::StressPlacement> Craig::StressScene::generatePlacements(const StressSceneSettings& settings, float fovDegrees) {
+
+	std::vector<StressPlacement> placements(settings.objectCount);
+	if (settings.objectCount == 0 || settings.modelPaths.empty()) {
+		placements.clear();
+		return placements;
+	}
+
+	std::mt19937 rng(settings.seed);
+	const uint32_t modelCount = static_cast<uint32_t>(settings.modelPaths.size());
+
+	// Grid, random and clustered all fill the same box, so the only thing that changes between them is the arrangement
+	const uint32_t side = cubeSide(settings.objectCount);
+	const float boxSize = side * settings.spacing;
+	const glm::vec3 boxMin = glm::vec3(-0.5f * boxSize, -0.5f * boxSize, kStressSceneStartDistance);
+
+	switch (settings.layout)
+	{
+	case(StressLayout::Grid):
+		for (uint32_t i = 0; i < settings.objectCount; i++) {
+			uint32_t x = i % side;
+			uint32_t y = (i / side) % side;
+			uint32_t z = i / (side * side);
+			placements[i].position = boxMin + glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f) * settings.spacing;
+		}
+		break;
+
+	case(StressLayout::Random):
+		for (StressPlacement& placement : placements) {
+			placement.position = boxMin + glm::vec3(unitFloat(rng), unitFloat(rng), unitFloat(rng)) * boxSize;
+		}
+		break;
+
+	case(StressLayout::Clustered):
+	{
+		uint32_t clusterCount = std::clamp(settings.clusterCount, 1u, settings.objectCount);
+		std::vector<glm::vec3> centres(clusterCount);
+		for (glm::vec3& centre : centres) {
+			centre = boxMin + glm::vec3(unitFloat(rng), unitFloat(rng), unitFloat(rng)) * boxSize;
+		}
+
+		// Each clump's about a quarter of the gap between clumps across, so they stay mostly separate
+		float spread = boxSize / (4.0f * std::cbrt(static_cast<float>(clusterCount)));
+		for (StressPlacement& placement : placements) {
+			const glm::vec3& centre = centres[rng() % clusterCount];
+			placement.position = centre + glm::vec3(normalFloat(rng), normalFloat(rng), normalFloat(rng)) * spread;
+		}
+		break;
+	}
+
+	case(StressLayout::DeepOcclusion):
+	{
+		// Overlapping objects so there's no gaps to see through, and the front wall's pushed back until it just fills
+		// the view. Everything behind it fails the occlusion test, but frustum culling keeps every one of them.
+		uint32_t layers = cubeSide(settings.objectCount);
+		uint32_t perLayer = (settings.objectCount + layers - 1) / layers;
+		uint32_t wallSide = std::max(static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(perLayer)))), 1u);
+
+		float pitch = settings.objectRadius * 1.5f;
+		float halfWall = 0.5f * wallSide * pitch;
+		float frontDistance = std::max(kStressSceneStartDistance, halfWall / std::tan(glm::radians(0.5f * fovDegrees)));
+
+		for (uint32_t i = 0; i < settings.objectCount; i++) {
+			uint32_t x = i % wallSide;
+			uint32_t y = (i / wallSide) % wallSide;
+			uint32_t layer = i / (wallSide * wallSide);
+			placements[i].position = glm::vec3(
+				(x + 0.5f) * pitch - halfWall,
+				(y + 0.5f) * pitch - halfWall,
+				frontDistance + layer * settings.spacing);
+		}
+		break;
+	}
+	}
+
+	// Done last so the positions come out the same whatever the model list is
+	for (StressPlacement& placement : placements) {
+		placement.yawDegrees = unitFloat(rng) * 360.0f;
+		placement.modelIndex = rng() % modelCount;
+	}
+
+	return placements;
+}
+
+float Craig::StressScene::getFurthestDistance(const std::vector<StressPlacement>& placements, float objectRadius) {
+
+	float furthest = 0.0f;
+	for (const StressPlacement& placement : placements) {
+		furthest = std::max(furthest, glm::length(placement.position));
+	}
+	return furthest + objectRadius;
+}
+
+const char* Craig::StressScene::getLayoutName(StressLayout layout) {
+
+	switch (layout)
+	{
+	case(StressLayout::Grid):
+		return "grid";
+	case(StressLayout::Random):
+		return "random";
+	case(StressLayout::Clustered):
+		return "clustered";
+	case(StressLayout::DeepOcclusion):
+		return "deepOcclusion";
+	}
+	return "unknown";
+}
+
+bool Craig::StressScene::parseLayout(const std::string& name, StressLayout& outLayout) {
+
+	for (StressLayout layout : kLayouts) {
+		if (name == getLayoutName(layout)) {
+			outLayout = layout;
+			return true;
+		}
+	}
+	return false;
+}
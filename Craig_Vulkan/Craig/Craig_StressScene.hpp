@@ -0,0 +1,67 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <glm/glm.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Craig_Constants.hpp"
+
+namespace Craig {
+
+	enum class StressLayout {
+		Grid,          // Evenly spaced cube of objects
+		Random,        // Same volume as the grid, scattered uniformly
+		Clustered,     // Tight clumps dotted around that volume
+		DeepOcclusion, // Solid walls filling the view, stacked one behind the other, so nearly everything's hidden
+	};
+
+	struct StressSceneSettings {
+		StressLayout layout = StressLayout::Grid;
+		uint32_t     objectCount = 1000;
+		uint32_t     seed = 1;
+		float        spacing = kStressSceneDefaultSpacing;           // Distance between neighbours in the grid, the other layouts keep the same density
+		float        objectRadius = kStressSceneDefaultObjectRadius; // Every model gets scaled so its bounding sphere is this big
+		uint32_t     clusterCount = kStressSceneDefaultClusters;
+
+		std::vector<std::string> modelPaths = { "data/models/BarramundiFish.glb", "data/models/Duck.glb" };
+	};
+
+	// What actually got made, distinct models against instances is what the frame cost scales with
+	struct StressSceneProfile {
+		uint32_t instanceCount = 0;
+		uint32_t distinctModelCount = 0;
+		uint32_t subMeshInstanceCount = 0; // Draws before culling
+		float    generateMs = 0.0f;
+
+		std::vector<std::pair<std::string, uint32_t>> instancesPerModel;
+	};
+
+	// Where one generated object goes. The scene turns these into gameobjects.
+	struct StressPlacement {
+		glm::vec3 position = glm::vec3(0.0f); // Where the centre of its bounding sphere ends up
+		float     yawDegrees = 0.0f;
+		uint32_t  modelIndex = 0;             // Into StressSceneSettings::modelPaths
+	};
+
+	// Seeded object layouts for scaling tests. The same settings always give the same placements: it only uses mt19937's
+	// raw output, which the standard pins down exactly, rather than the distributions, which are up to each library.
+	// Everything is laid out in front of a camera sitting at the origin looking down +z.
+	class StressScene {
+
+	public:
+		static std::vector<StressPlacement> generatePlacements(const StressSceneSettings& settings, float fovDegrees);
+
+		// Furthest any placement's bounding sphere reaches from the origin, for fitting the camera's far plane
+		static float getFurthestDistance(const std::vector<StressPlacement>& placements, float objectRadius);
+
+		static const char* getLayoutName(StressLayout layout);
+		static bool parseLayout(const std::string& name, StressLayout& outLayout); // Takes the names getLayoutName gives back
+
+		static constexpr StressLayout kLayouts[] = { StressLayout::Grid, StressLayout::Random, StressLayout::Clustered, StressLayout::DeepOcclusion };
+	};
+
+}
@@ -12,6 +12,8 @@
 
 #include "Craig_Window.hpp"
 #include "Craig_Camera.hpp"
+#include "Craig_Profiler.hpp"
+#include "Craig_Replay.hpp"
 
 CraigError Craig::Window::init() {
 
@@ -45,48 +47,112 @@ CraigError Craig::Window::update(const float& deltaTime) {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+	CRAIG_PROFILE_ZONE("Window::update");
+
 	SDL_Event event;
 	while (SDL_PollEvent(&event)) {
-		m_currentCamera->processSDLEvent(event);
+		processEvent(event, ret);
+	}
+
+
+	return ret;
+}
+
+void Craig::Window::latchInput() {
+
+	CRAIG_PROFILE_ZONE("Window::latchInput");
+
+	// Only the keyboard and mouse range, quitting and window events can wait for the next update()
+	SDL_PumpEvents();
+
+	CraigError ret = CRAIG_SUCCESS;
+	SDL_Event event;
+	while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_KEYDOWN, SDL_MOUSEWHEEL) > 0) {
+		processEvent(event, ret);
+	}
+}
+
+std::optional<std::chrono::steady_clock::time_point> Craig::Window::takePendingInputTime() {
+
+	std::optional<std::chrono::steady_clock::time_point> inputTime = m_pendingInputTime;
+	m_pendingInputTime.reset();
+	return inputTime;
+}
+
+void Craig::Window::noteInputEvent(const SDL_Event& event) {
+
+	if (m_pendingInputTime.has_value()) {
+		return; // Already got an older one waiting
+	}
+
+	if (event.type != SDL_MOUSEMOTION && event.type != SDL_MOUSEBUTTONDOWN && event.type != SDL_MOUSEBUTTONUP &&
+		event.type != SDL_MOUSEWHEEL && event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) {
+		return;
+	}
+
+	// SDL stamps events in milliseconds when they reach its queue, so count back from now by however long it's been sitting there
+	Uint32 ageMs = SDL_GetTicks() - event.common.timestamp;
+	m_pendingInputTime = std::chrono::steady_clock::now() - std::chrono::milliseconds(ageMs);
+}
+
+void Craig::Window::processEvent(SDL_Event& event, CraigError& ret) {
+
+	noteInputEvent(event);
+
+	m_currentCamera->processSDLEvent(event);
 #if defined(IMGUI_ENABLED)
-		ImGui_ImplSDL2_ProcessEvent(&event);
+	ImGui_ImplSDL2_ProcessEvent(&event);
 #endif
 
-		switch (event.type) {
+	switch (event.type) {
 
-		case SDL_QUIT:
-			ret = CRAIG_CLOSED; // Set the return code to fail to indicate that the window should close
-			continue;
+	case SDL_QUIT:
+		ret = CRAIG_CLOSED; // Set the return code to fail to indicate that the window should close
+		return;
 
-		case SDL_WINDOWEVENT:
-			if (event.window.event == SDL_WINDOWEVENT_RESIZED || event.window.event == SDL_WINDOWEVENT_MINIMIZED) {
-				m_resizeNeeded = true;
-			}
-			continue;
-
-		case SDL_KEYUP:
-			if (event.key.keysym.sym == SDLK_TAB) {
-				m_mouseLocked = !m_mouseLocked;
-
-				if (m_mouseLocked) {
-					SDL_SetRelativeMouseMode(SDL_TRUE);
-					
-				}
-				else {
-					SDL_SetRelativeMouseMode(SDL_FALSE);
-				}
-				
-			}
-			continue;
+	case SDL_WINDOWEVENT:
+		if (event.window.event == SDL_WINDOWEVENT_RESIZED || event.window.event == SDL_WINDOWEVENT_MINIMIZED) {
+			// A drag fires loads of these, they all just set the flag and the renderer rebuilds once
+			m_resizeNeeded = true;
+			m_resizeEventsPending++;
+		}
+		return;
 
-		default:
+	case SDL_KEYUP:
+		if (event.key.keysym.sym == SDLK_TAB) {
+			m_mouseLocked = !m_mouseLocked;
 
-			continue;
+			if (m_mouseLocked) {
+				SDL_SetRelativeMouseMode(SDL_TRUE);
+				
+			}
+			else {
+				SDL_SetRelativeMouseMode(SDL_FALSE);
+			}
+			
 		}
-	}
+		else if (event.key.keysym.sym == SDLK_F5) {
+			if (Craig::Replay::getInstance().isRecording()) {
+				Craig::Replay::getInstance().stopRecording(kReplayPath);
+			}
+			else {
+				Craig::Replay::getInstance().startRecording();
+			}
+		}
+		else if (event.key.keysym.sym == SDLK_F6) {
+			Craig::Replay::getInstance().startPlayback(kReplayPath);
+		}
+#if defined(CRAIG_PROFILING_ENABLED)
+		else if (event.key.keysym.sym == SDLK_F9) {
+			Craig::Profiler::getInstance().writeChromeTrace(kCpuTracePath);
+		}
+#endif
+		return;
 
+	default:
 
-	return ret;
+		return;
+	}
 }
 
 Craig::Window::WindowExtent Craig::Window::getDrawableExtent() const {
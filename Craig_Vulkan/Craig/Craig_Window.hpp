@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <optional>
 #include <vector>
 #include <SDL2/SDL.h>
 
@@ -24,16 +26,27 @@ namespace Craig {
 		CraigError update(const float& deltaTime);
 		CraigError terminate();
 
+		// Grabs any mouse/keyboard input that's come in since update() and hands it to the camera/ImGui.
+		// The renderer calls this right before it late latches the camera.
+		void latchInput();
+
+		// When the oldest input that hasn't made it into a frame yet happened. Clears it, the caller owns that input now.
+		std::optional<std::chrono::steady_clock::time_point> takePendingInputTime();
+
 		// Getters
 		std::vector<const char*>& getExtensionsVector() { return mv_SDL_Extensions; }
 		SDL_Window* getSDLWindow() const { return mp_SDL_Window; }
 		WindowExtent getDrawableExtent() const;
 		const bool isResizeNeeded() const { return m_resizeNeeded; }
-		void finishedResize() { m_resizeNeeded = false; }
+		void finishedResize() { m_resizeNeeded = false; m_resizeEventsPending = 0; }
+		uint32_t getResizeEventsPending() const { return m_resizeEventsPending; } // How many resize events got folded into the next rebuild
 
 		//Setters
 		void setCameraRef(Camera* camera) { m_currentCamera = camera; }
 	private:
+		void processEvent(SDL_Event& event, CraigError& ret);
+		void noteInputEvent(const SDL_Event& event);
+
 		SDL_Window* mp_SDL_Window = nullptr; // SDL Window handle
 		unsigned m_SDL_ExtensionCount; // Number of elements in the extension array (Number of extensions in use?)
 		std::vector<const char*> mv_SDL_Extensions; // Array of extensions required by SDL for Vulkan
@@ -41,8 +54,11 @@ namespace Craig {
 		Camera* m_currentCamera;
 
 		bool m_resizeNeeded = false;
+		uint32_t m_resizeEventsPending = 0;
 		bool m_mouseLocked = false;
 
+		std::optional<std::chrono::steady_clock::time_point> m_pendingInputTime;
+
 
 	};
 
@@ -1,6 +1,10 @@
 #include "Craig_CommandManager.hpp"
 
 #include "Craig_Device.hpp"
+#include "Craig_GpuProfiler.hpp"
+
+#include "Craig/Craig_Profiler.hpp"
+#include "Craig/Craig_Counters.hpp"
 
 CraigError Craig::CommandManager::init(const CommandManagerInitInfo& info) {
 
@@ -44,7 +48,7 @@ void Craig::CommandManager::createCommandPool() {
 }
 
 void Craig::CommandManager::createCommandBuffers() {
-	mv_VK_commandBuffers.resize(kMaxFramesInFlight);
+	mv_VK_commandBuffers.resize(kMaxFramesInFlight); // Enough for the most frames in flight we allow, not just the current setting
 
 	vk::CommandBufferAllocateInfo allocInfo{};
 	allocInfo
@@ -62,7 +66,7 @@ void Craig::CommandManager::createCommandBuffers() {
 
 }
 
-vk::CommandBuffer Craig::CommandManager::buffer_beginSingleTimeCommands() {
+vk::CommandBuffer Craig::CommandManager::buffer_beginSingleTimeCommands(const char* profileScope) {
     //Allocate a temporary command buffer
     vk::CommandBufferAllocateInfo allocInfo{};
     allocInfo.setLevel(vk::CommandBufferLevel::ePrimary)
@@ -78,11 +82,19 @@ vk::CommandBuffer Craig::CommandManager::buffer_beginSingleTimeCommands() {
 
     commandBuffer.begin(beginInfo);
 
+    if (mp_GpuProfiler != nullptr && profileScope != nullptr) {
+        mp_GpuProfiler->beginImmediateScope(commandBuffer, profileScope, true);
+    }
+
     return commandBuffer;
 }
 
 void Craig::CommandManager::buffer_endSingleTimeCommands(vk::CommandBuffer commandBuffer) {
 
+    if (mp_GpuProfiler != nullptr) {
+        mp_GpuProfiler->endImmediateScope(commandBuffer);
+    }
+
     //Stop recording
     commandBuffer.end();
 
@@ -93,10 +105,14 @@ void Craig::CommandManager::buffer_endSingleTimeCommands(vk::CommandBuffer comma
     mp_Device->getTransferQueue().submit(submitInfo);
     mp_Device->getTransferQueue().waitIdle();
 
+    if (mp_GpuProfiler != nullptr) {
+        mp_GpuProfiler->collectImmediateScopes();
+    }
+
     mp_Device->getLogicalDevice().freeCommandBuffers(m_VK_transferCommandPool, commandBuffer);
 }
 
-vk::CommandBuffer Craig::CommandManager::buffer_beginSingleTimeCommandsGFX() {
+vk::CommandBuffer Craig::CommandManager::buffer_beginSingleTimeCommandsGFX(const char* profileScope) {
     //Allocate a temporary command buffer
     vk::CommandBufferAllocateInfo allocInfo{};
     allocInfo.setLevel(vk::CommandBufferLevel::ePrimary)
@@ -112,11 +128,19 @@ vk::CommandBuffer Craig::CommandManager::buffer_beginSingleTimeCommandsGFX() {
 
     commandBuffer.begin(beginInfo);
 
+    if (mp_GpuProfiler != nullptr && profileScope != nullptr) {
+        mp_GpuProfiler->beginImmediateScope(commandBuffer, profileScope, false);
+    }
+
     return commandBuffer;
 }
 
 void Craig::CommandManager::buffer_endSingleTimeCommandsGFX(vk::CommandBuffer commandBuffer) {
 
+    if (mp_GpuProfiler != nullptr) {
+        mp_GpuProfiler->endImmediateScope(commandBuffer);
+    }
+
     //Stop recording
     commandBuffer.end();
 
@@ -127,18 +151,28 @@ void Craig::CommandManager::buffer_endSingleTimeCommandsGFX(vk::CommandBuffer co
     mp_Device->getGraphicsQueue().submit(submitInfo);
     mp_Device->getGraphicsQueue().waitIdle();
 
+    if (mp_GpuProfiler != nullptr) {
+        mp_GpuProfiler->collectImmediateScopes();
+    }
+
     mp_Device->getLogicalDevice().freeCommandBuffers(m_VK_commandPool, commandBuffer);
 }
 
-void Craig::CommandManager::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
+void Craig::CommandManager::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset, vk::DeviceSize dstOffset) {
+
+	CRAIG_PROFILE_ZONE("CommandManager::copyBuffer");
 
 	//Begin recording to buffer
-	vk::CommandBuffer tempBuffer = buffer_beginSingleTimeCommands();
+	vk::CommandBuffer tempBuffer = buffer_beginSingleTimeCommands("Upload: buffer");
 
 	//Copy over the data
 	vk::BufferCopy copyRegion{};
-	copyRegion.setSize(size);
+	copyRegion
+		.setSrcOffset(srcOffset)
+		.setDstOffset(dstOffset)
+		.setSize(size);
 	tempBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
+	CRAIG_COUNT(eUploadBytes, size);
 
 	//End recording and submit buffer
 	buffer_endSingleTimeCommands(tempBuffer);
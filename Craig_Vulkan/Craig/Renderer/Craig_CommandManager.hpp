@@ -5,6 +5,7 @@
 
 namespace Craig {
 	class Device;
+	class GpuProfiler;
 
 	class CommandManager {
 	public:
@@ -19,13 +20,15 @@ namespace Craig {
 		CraigError init(const CommandManagerInitInfo& info);
 		CraigError terminate();
 
-		// One-off command helpers (transfer/GFX)
-		vk::CommandBuffer buffer_beginSingleTimeCommands();
+		// One-off command helpers (transfer/GFX). Give them a scope name (string literal) and the GPU profiler times them.
+		vk::CommandBuffer buffer_beginSingleTimeCommands(const char* profileScope = nullptr);
 		void buffer_endSingleTimeCommands(vk::CommandBuffer commandBuffer);
-		vk::CommandBuffer buffer_beginSingleTimeCommandsGFX();     // Uses graphics queue
+		vk::CommandBuffer buffer_beginSingleTimeCommandsGFX(const char* profileScope = nullptr);     // Uses graphics queue
 		void buffer_endSingleTimeCommandsGFX(vk::CommandBuffer commandBuffer);
 
-		void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
+		void setGpuProfiler(Craig::GpuProfiler* pGpuProfiler) { mp_GpuProfiler = pGpuProfiler; }
+
+		void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset = 0, vk::DeviceSize dstOffset = 0);
 
 		const std::vector<vk::CommandBuffer>& getCommandBuffers() { return mv_VK_commandBuffers; }
 
@@ -40,6 +43,7 @@ namespace Craig {
 		std::vector<vk::CommandBuffer> mv_VK_commandBuffers;
 
 		Craig::Device* mp_Device = nullptr;
+		Craig::GpuProfiler* mp_GpuProfiler = nullptr;
 		vk::SurfaceKHR m_CM_surface;
 
 	};
@@ -0,0 +1,547 @@
+#include "Craig_Defragmenter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Craig_DeletionQueue.hpp"
+#include "Craig_Device.hpp"
+#include "Craig_GpuMemoryStats.hpp"
+#include "Craig_ImageHelpers.hpp"
+#include "Craig/Craig_Log.hpp"
+#include "Craig/Craig_Profiler.hpp"
+
+CraigError Craig::Defragmenter::init(const DefragmenterInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+	mp_GpuMemoryStats = info.p_GpuMemoryStats;
+
+	// Same as Device::createBufferVMA and ImageHelpers::createImage, the moved copy has to match
+	Device::QueueFamilyIndices indices = Device::findQueueFamilies(mp_Device->getPhysicalDevice(), info.surface);
+	m_concurrentSharing = indices.hasDedicatedTransfer();
+	if (m_concurrentSharing) {
+		m_queueFamilies[0] = indices.graphicsFamily.value();
+		m_queueFamilies[1] = indices.transferFamily.value();
+	}
+
+	VmaAllocator allocator = mp_Device->getVmaAllocator();
+
+	// Only there to find the memory types, the sizes don't matter
+	VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.size = kDefragmentBytesPerPass;
+	bufferInfo.usage = static_cast<VkBufferUsageFlags>(info.bufferUsage);
+	bufferInfo.sharingMode = m_concurrentSharing ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = m_concurrentSharing ? 2 : 0;
+	bufferInfo.pQueueFamilyIndices = m_concurrentSharing ? m_queueFamilies : nullptr;
+
+	VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = static_cast<VkFormat>(info.imageFormat);
+	imageInfo.extent = { 256, 256, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = static_cast<VkImageUsageFlags>(info.imageUsage);
+	imageInfo.sharingMode = bufferInfo.sharingMode;
+	imageInfo.queueFamilyIndexCount = bufferInfo.queueFamilyIndexCount;
+	imageInfo.pQueueFamilyIndices = bufferInfo.pQueueFamilyIndices;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo aci{};
+	aci.usage = VMA_MEMORY_USAGE_AUTO;
+	aci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	uint32_t bufferMemoryType = 0;
+	uint32_t imageMemoryType = 0;
+	if (vmaFindMemoryTypeIndexForBufferInfo(allocator, &bufferInfo, &aci, &bufferMemoryType) != VK_SUCCESS ||
+		vmaFindMemoryTypeIndexForImageInfo(allocator, &imageInfo, &aci, &imageMemoryType) != VK_SUCCESS) {
+		// Everything just goes in the default pools and there's nothing for start() to do
+		CRAIG_LOG_WARN(eRenderer, "Couldn't find memory types for the defragmentation pools, GPU defragmentation is off\n");
+		return CRAIG_FAIL;
+	}
+
+	VmaPoolCreateInfo poolInfo{};
+	poolInfo.memoryTypeIndex = bufferMemoryType;
+	if (vmaCreatePool(allocator, &poolInfo, &m_VMA_bufferPool) != VK_SUCCESS) {
+		CRAIG_LOG_WARN(eRenderer, "Couldn't create the defragmentation buffer pool, GPU defragmentation is off\n");
+		return CRAIG_FAIL;
+	}
+	vmaSetPoolName(allocator, m_VMA_bufferPool, "Movable buffers");
+	mv_VMA_pools.push_back(m_VMA_bufferPool);
+
+	m_VMA_imagePool = m_VMA_bufferPool;
+	if (imageMemoryType != bufferMemoryType) {
+		poolInfo.memoryTypeIndex = imageMemoryType;
+		if (vmaCreatePool(allocator, &poolInfo, &m_VMA_imagePool) != VK_SUCCESS) {
+			CRAIG_LOG_WARN(eRenderer, "Couldn't create the defragmentation image pool, textures won't be moved\n");
+			m_VMA_imagePool = VK_NULL_HANDLE;
+		}
+		else {
+			vmaSetPoolName(allocator, m_VMA_imagePool, "Movable images");
+			mv_VMA_pools.push_back(m_VMA_imagePool);
+		}
+	}
+
+	return ret;
+}
+
+CraigError Craig::Defragmenter::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	cancelImmediately();
+	mMap_resources.clear();
+
+	for (VmaPool pool : mv_VMA_pools) {
+		vmaDestroyPool(mp_Device->getVmaAllocator(), pool);
+	}
+	mv_VMA_pools.clear();
+	m_VMA_bufferPool = VK_NULL_HANDLE;
+	m_VMA_imagePool = VK_NULL_HANDLE;
+
+	return ret;
+}
+
+void Craig::Defragmenter::registerBuffer(VmaAllocation allocation, vk::Buffer* p_Buffer, vk::DeviceSize size, vk::BufferUsageFlags usage) {
+
+	Resource resource;
+	resource.p_Buffer = p_Buffer;
+	resource.size = size;
+	resource.bufferUsage = usage;
+
+	mMap_resources[allocation] = resource;
+}
+
+void Craig::Defragmenter::registerImage(VmaAllocation allocation, vk::Image* p_Image, vk::ImageView* p_View, vk::Format format, vk::Extent2D extent,
+	uint32_t mipLevels, vk::ImageUsageFlags usage, vk::ImageLayout layout, std::function<void()> onMoved) {
+
+	Resource resource;
+	resource.isImage = true;
+	resource.p_Image = p_Image;
+	resource.p_View = p_View;
+	resource.format = format;
+	resource.extent = extent;
+	resource.mipLevels = mipLevels;
+	resource.imageUsage = usage;
+	resource.layout = layout;
+	resource.onMoved = std::move(onMoved);
+
+	mMap_resources[allocation] = std::move(resource);
+}
+
+void Craig::Defragmenter::unregister(VmaAllocation allocation) {
+
+	mMap_resources.erase(allocation);
+}
+
+Craig::Defragmenter::Snapshot Craig::Defragmenter::takeSnapshot() {
+
+	// Same sums as GpuMemoryStats, just over our pools rather than the heaps
+	GpuMemoryStats::HeapStats total;
+	for (VmaPool pool : mv_VMA_pools) {
+		VmaDetailedStatistics statistics{};
+		vmaCalculatePoolStatistics(mp_Device->getVmaAllocator(), pool, &statistics);
+
+		total.blockCount += statistics.statistics.blockCount;
+		total.unusedRangeCount += statistics.unusedRangeCount;
+		total.blockBytes += statistics.statistics.blockBytes;
+		total.allocationBytes += statistics.statistics.allocationBytes;
+		if (statistics.unusedRangeCount > 0) {
+			total.largestUnusedRange = std::max(total.largestUnusedRange, statistics.unusedRangeSizeMax);
+		}
+	}
+
+	Snapshot snapshot;
+	snapshot.blockCount = total.blockCount;
+	snapshot.unusedRangeCount = total.unusedRangeCount;
+	snapshot.blockBytes = total.blockBytes;
+	snapshot.allocationBytes = total.allocationBytes;
+	snapshot.largestUnusedRange = total.largestUnusedRange;
+	snapshot.fragmentation = total.getFragmentation();
+
+	return snapshot;
+}
+
+void Craig::Defragmenter::start() {
+
+	if (isRunning() || mv_VMA_pools.empty()) {
+		return;
+	}
+
+	m_report = Report{};
+	m_report.before = takeSnapshot();
+	m_poolIndex = 0;
+	m_stopRequested = false;
+
+	if (!beginPool()) {
+		return;
+	}
+
+	m_haveReport = true;
+	CRAIG_LOG_INFO(eRenderer, "Defragmenting GPU memory, %u blocks, %.1fMB free in %u ranges (%.0f%% fragmented)\n", m_report.before.blockCount,
+		static_cast<double>(m_report.before.blockBytes - m_report.before.allocationBytes) / (1024.0 * 1024.0), m_report.before.unusedRangeCount,
+		m_report.before.fragmentation * 100.0f);
+}
+
+bool Craig::Defragmenter::beginPool() {
+
+	VmaDefragmentationInfo defragmentationInfo{};
+	defragmentationInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+	defragmentationInfo.pool = mv_VMA_pools[m_poolIndex];
+	defragmentationInfo.maxBytesPerPass = kDefragmentBytesPerPass;
+	defragmentationInfo.maxAllocationsPerPass = kDefragmentAllocationsPerPass;
+
+	VkResult result = vmaBeginDefragmentation(mp_Device->getVmaAllocator(), &defragmentationInfo, &m_context);
+	if (result != VK_SUCCESS) {
+		CRAIG_LOG_WARN(eRenderer, "Couldn't start defragmenting (VkResult %d)\n", static_cast<int>(result));
+		m_context = VK_NULL_HANDLE;
+		m_framesSinceRun = 0; // Don't have auto try again every frame
+		return false;
+	}
+
+	return true;
+}
+
+void Craig::Defragmenter::endPool() {
+
+	VmaDefragmentationStats stats{};
+	vmaEndDefragmentation(mp_Device->getVmaAllocator(), m_context, &stats);
+	m_context = VK_NULL_HANDLE;
+
+	m_report.bytesMoved += stats.bytesMoved;
+	m_report.bytesFreed += stats.bytesFreed;
+	m_report.allocationsMoved += stats.allocationsMoved;
+	m_report.blocksFreed += stats.deviceMemoryBlocksFreed;
+
+	if (!m_stopRequested && ++m_poolIndex < mv_VMA_pools.size() && beginPool()) {
+		return;
+	}
+
+	finish();
+}
+
+void Craig::Defragmenter::cancel() {
+
+	if (!isRunning()) {
+		return;
+	}
+
+	m_stopRequested = true;
+
+	// Otherwise it stops when the pass in flight ends
+	if (!m_passInFlight) {
+		endPool();
+	}
+}
+
+void Craig::Defragmenter::cancelImmediately() {
+
+	if (!isRunning()) {
+		return;
+	}
+
+	m_stopRequested = true;
+
+	if (m_passInFlight) {
+		endPass(m_passId); // Its deletion queue entry won't do anything now
+	}
+	else {
+		endPool();
+	}
+}
+
+void Craig::Defragmenter::update() {
+
+	if (isRunning()) {
+		m_report.frames++;
+		return;
+	}
+
+	m_framesSinceRun++;
+
+	// Textures only ever get added, so the gaps in the pools are mostly from the scene geometry being rebuilt
+	if (!m_autoEnabled || m_framesSinceRun < kDefragmentAutoCooldownFrames || m_framesSinceRun % kGpuMemoryStatsIntervalFrames != 0) {
+		return;
+	}
+
+	Snapshot current = takeSnapshot();
+	if (current.blockBytes - current.allocationBytes < kDefragmentAutoMinFreeBytes || current.fragmentation < kDefragmentAutoFragmentation) {
+		return;
+	}
+
+	// Whatever's in the way is something we can't move, no point going again until something's changed
+	if (m_haveReport && m_report.allocationsMoved == 0 && current.blockBytes == m_report.after.blockBytes && current.allocationBytes == m_report.after.allocationBytes) {
+		return;
+	}
+
+	start();
+}
+
+void Craig::Defragmenter::recordPass(vk::CommandBuffer commandBuffer, Craig::DeletionQueue& deletionQueue) {
+
+	// One pass in flight at a time, the next one can't start until VMA's been told this one's done
+	if (!isRunning() || m_passInFlight) {
+		return;
+	}
+
+	CRAIG_PROFILE_ZONE("Defragmenter::recordPass");
+
+	std::chrono::steady_clock::time_point passStart = std::chrono::steady_clock::now();
+
+	VmaAllocator allocator = mp_Device->getVmaAllocator();
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	// A pool with nothing left worth moving is done, straight on to the next one
+	VkResult result = VK_SUCCESS;
+	while (isRunning()) {
+		result = vmaBeginDefragmentationPass(allocator, m_context, &m_pass);
+		if (result != VK_SUCCESS) {
+			break;
+		}
+		endPool();
+	}
+
+	if (!isRunning()) {
+		return;
+	}
+
+	if (result != VK_INCOMPLETE) {
+		CRAIG_LOG_WARN(eRenderer, "Defragmentation pass failed to start (VkResult %d), stopping\n", static_cast<int>(result));
+		m_stopRequested = true;
+		endPool();
+		return;
+	}
+
+	bool buffersCopied = false;
+
+	for (uint32_t i = 0; i < m_pass.moveCount; i++) {
+		VmaDefragmentationMove& vmaMove = m_pass.pMoves[i];
+
+		// Made in the pools but never registered, e.g. a texture nothing's drawn with yet
+		auto it = mMap_resources.find(vmaMove.srcAllocation);
+		if (it == mMap_resources.end()) {
+			vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			continue;
+		}
+
+		Resource& resource = it->second;
+		Retired retired;
+
+		if (resource.isImage) {
+			vk::Image newImage = createMovedImage(resource, vmaMove.dstTmpAllocation);
+			recordImageCopy(commandBuffer, resource, newImage);
+
+			retired.image = *resource.p_Image;
+			*resource.p_Image = newImage;
+			if (resource.p_View != nullptr) {
+				retired.view = *resource.p_View;
+				*resource.p_View = Craig::ImageHelpers::createImageView(device, newImage, resource.format, vk::ImageAspectFlagBits::eColor, resource.mipLevels);
+			}
+		}
+		else {
+			vk::Buffer newBuffer = createMovedBuffer(resource, vmaMove.dstTmpAllocation);
+			vk::BufferCopy region{ 0, 0, resource.size };
+			commandBuffer.copyBuffer(*resource.p_Buffer, newBuffer, region);
+
+			retired.buffer = *resource.p_Buffer;
+			*resource.p_Buffer = newBuffer;
+			buffersCopied = true;
+		}
+
+		mv_retired.push_back(retired);
+
+		if (resource.onMoved) {
+			resource.onMoved();
+		}
+	}
+
+	// The images get their own barriers in recordImageCopy, this covers the buffers for everything else in the frame
+	if (buffersCopied) {
+		vk::MemoryBarrier2 copied{};
+		copied
+			.setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+			.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+			.setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+			.setDstAccessMask(vk::AccessFlagBits2::eMemoryRead);
+
+		vk::DependencyInfo copiedDependency{};
+		copiedDependency
+			.setMemoryBarrierCount(1)
+			.setPMemoryBarriers(&copied);
+		commandBuffer.pipelineBarrier2(copiedDependency);
+	}
+
+	m_report.passes++;
+	m_report.totalMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - passStart).count();
+
+	uint32_t passId = ++m_passId;
+	m_passInFlight = true;
+
+	// Nothing we could move, so nothing to wait for either
+	if (mv_retired.empty()) {
+		endPass(passId);
+		return;
+	}
+
+	// VMA frees the old memory when the pass ends, which can't happen until the frames still reading it are done
+	deletionQueue.push([this, passId]() {
+		endPass(passId);
+	});
+}
+
+void Craig::Defragmenter::endPass(uint32_t passId) {
+
+	// Already ended by cancelImmediately
+	if (!m_passInFlight || passId != m_passId) {
+		return;
+	}
+
+	vk::Device device = mp_Device->getLogicalDevice();
+	for (const Retired& retired : mv_retired) {
+		if (retired.view) {
+			device.destroyImageView(retired.view);
+		}
+		if (retired.image) {
+			device.destroyImage(retired.image);
+		}
+		if (retired.buffer) {
+			device.destroyBuffer(retired.buffer);
+		}
+	}
+	mv_retired.clear();
+	m_passInFlight = false;
+
+	// VMA swaps the allocations over here, the registered VmaAllocation handles stay the same
+	VkResult result = vmaEndDefragmentationPass(mp_Device->getVmaAllocator(), m_context, &m_pass);
+	if (result != VK_INCOMPLETE || m_stopRequested) {
+		endPool();
+	}
+}
+
+void Craig::Defragmenter::finish() {
+
+	m_framesSinceRun = 0;
+	m_report.after = takeSnapshot();
+	mp_GpuMemoryStats->refresh();
+
+	CRAIG_LOG_INFO(eRenderer, "Defragmented in %u passes over %u frames (%.2fms recording): moved %u allocations (%.1fMB), freed %u blocks (%.1fMB). Fragmentation %.0f%% -> %.0f%%, largest free range %.1fMB -> %.1fMB\n",
+		m_report.passes, m_report.frames, m_report.totalMs, m_report.allocationsMoved, static_cast<double>(m_report.bytesMoved) / (1024.0 * 1024.0),
+		m_report.blocksFreed, static_cast<double>(m_report.bytesFreed) / (1024.0 * 1024.0), m_report.before.fragmentation * 100.0f, m_report.after.fragmentation * 100.0f,
+		static_cast<double>(m_report.before.largestUnusedRange) / (1024.0 * 1024.0), static_cast<double>(m_report.after.largestUnusedRange) / (1024.0 * 1024.0));
+}
+
+vk::Buffer Craig::Defragmenter::createMovedBuffer(const Resource& resource, VmaAllocation destination) {
+
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo
+		.setSize(resource.size)
+		.setUsage(resource.bufferUsage);
+
+	if (m_concurrentSharing) {
+		bufferInfo
+			.setSharingMode(vk::SharingMode::eConcurrent)
+			.setQueueFamilyIndexCount(2)
+			.setPQueueFamilyIndices(m_queueFamilies);
+	}
+
+	vk::Buffer buffer = mp_Device->getLogicalDevice().createBuffer(bufferInfo);
+	vmaBindBufferMemory(mp_Device->getVmaAllocator(), destination, buffer);
+
+	return buffer;
+}
+
+vk::Image Craig::Defragmenter::createMovedImage(const Resource& resource, VmaAllocation destination) {
+
+	vk::ImageCreateInfo imageInfo{};
+	imageInfo
+		.setImageType(vk::ImageType::e2D)
+		.setExtent({ resource.extent.width, resource.extent.height, 1 })
+		.setMipLevels(resource.mipLevels)
+		.setArrayLayers(1)
+		.setFormat(resource.format)
+		.setTiling(vk::ImageTiling::eOptimal)
+		.setInitialLayout(vk::ImageLayout::eUndefined)
+		.setUsage(resource.imageUsage)
+		.setSamples(vk::SampleCountFlagBits::e1);
+
+	if (m_concurrentSharing) {
+		imageInfo
+			.setSharingMode(vk::SharingMode::eConcurrent)
+			.setQueueFamilyIndexCount(2)
+			.setPQueueFamilyIndices(m_queueFamilies);
+	}
+
+	vk::Image image = mp_Device->getLogicalDevice().createImage(imageInfo);
+	vmaBindImageMemory(mp_Device->getVmaAllocator(), destination, image);
+
+	return image;
+}
+
+// Every mip level across, then the new one goes back to whatever layout the old one lives in
+void Craig::Defragmenter::recordImageCopy(vk::CommandBuffer commandBuffer, const Resource& resource, vk::Image destination) {
+
+	vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, resource.mipLevels, 0, 1 };
+
+	vk::ImageMemoryBarrier2 toCopy[2];
+	toCopy[0]
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+		.setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+		.setDstAccessMask(vk::AccessFlagBits2::eTransferRead)
+		.setOldLayout(resource.layout)
+		.setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setImage(*resource.p_Image)
+		.setSubresourceRange(range);
+	toCopy[1]
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eTopOfPipe)
+		.setSrcAccessMask(vk::AccessFlagBits2::eNone)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+		.setDstAccessMask(vk::AccessFlagBits2::eTransferWrite)
+		.setOldLayout(vk::ImageLayout::eUndefined)
+		.setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setImage(destination)
+		.setSubresourceRange(range);
+
+	vk::DependencyInfo toCopyDependency{};
+	toCopyDependency
+		.setImageMemoryBarrierCount(2)
+		.setPImageMemoryBarriers(toCopy);
+	commandBuffer.pipelineBarrier2(toCopyDependency);
+
+	std::vector<vk::ImageCopy> regions(resource.mipLevels);
+	for (uint32_t level = 0; level < resource.mipLevels; level++) {
+		vk::ImageSubresourceLayers layers{ vk::ImageAspectFlagBits::eColor, level, 0, 1 };
+		vk::Extent3D extent{ std::max(resource.extent.width >> level, 1u), std::max(resource.extent.height >> level, 1u), 1 };
+		regions[level]
+			.setSrcSubresource(layers)
+			.setDstSubresource(layers)
+			.setExtent(extent);
+	}
+	commandBuffer.copyImage(*resource.p_Image, vk::ImageLayout::eTransferSrcOptimal, destination, vk::ImageLayout::eTransferDstOptimal, regions);
+
+	vk::ImageMemoryBarrier2 toUse{};
+	toUse
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+		.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+		.setDstAccessMask(vk::AccessFlagBits2::eMemoryRead)
+		.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+		.setNewLayout(resource.layout)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setImage(destination)
+		.setSubresourceRange(range);
+
+	vk::DependencyInfo toUseDependency{};
+	toUseDependency
+		.setImageMemoryBarrierCount(1)
+		.setPImageMemoryBarriers(&toUse);
+	commandBuffer.pipelineBarrier2(toUseDependency);
+}
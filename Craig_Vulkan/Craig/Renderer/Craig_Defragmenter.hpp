@@ -0,0 +1,157 @@
+#pragma once
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "vk_mem_alloc.h"
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+	class Device;
+	class DeletionQueue;
+	class GpuMemoryStats;
+
+	// Compacts the memory the textures and scene geometry live in using VMA's defragmentation, one pass a frame with
+	// at most kDefragmentBytesPerPass/kDefragmentAllocationsPerPass in it. VMA picks where things go, we make a new
+	// buffer/image there, record the copy at the start of the frame's own command buffer and swap the handles, so
+	// everything recorded after it in that frame already uses the moved one.
+	//
+	// The old buffers/images go on the deletion queue and VMA only gets told the pass is over once they're destroyed,
+	// kMaxFramesInFlight frames later, which is when nothing in flight can still be reading them. Nothing waits on the GPU.
+	// A pass being open that long is why the movable things get their own pools (getBufferPool/getImagePool): VMA
+	// doesn't allow freeing anything it handed back in a pass until the pass ends, and the ring/readback/attachment
+	// allocations in the default pools come and go every few frames.
+	class Defragmenter {
+
+	public:
+		struct DefragmenterInitInfo
+		{
+			Craig::Device*         p_Device = nullptr;
+			Craig::GpuMemoryStats* p_GpuMemoryStats = nullptr;
+			vk::SurfaceKHR         surface; // For the queue families, moved resources get the same sharing mode as the originals
+
+			// What the registered buffers and images get made with, to pick the memory types for the pools
+			vk::BufferUsageFlags bufferUsage;
+			vk::ImageUsageFlags  imageUsage;
+			vk::Format           imageFormat = vk::Format::eUndefined;
+		};
+
+		// What the pools looked like
+		struct Snapshot
+		{
+			uint32_t blockCount = 0;
+			uint32_t unusedRangeCount = 0;
+			uint64_t blockBytes = 0;
+			uint64_t allocationBytes = 0;
+			uint64_t largestUnusedRange = 0;
+			float    fragmentation = 0.0f;
+		};
+
+		struct Report
+		{
+			Snapshot before;
+			Snapshot after;
+			uint64_t bytesMoved = 0;
+			uint64_t bytesFreed = 0;       // Whole blocks handed back to the driver
+			uint32_t allocationsMoved = 0;
+			uint32_t blocksFreed = 0;
+			uint32_t passes = 0;
+			uint32_t frames = 0;
+			float    totalMs = 0.0f;       // CPU time recording the passes, the copies themselves show up in the GPU profiler's "Defragment" scope
+		};
+
+		CraigError init(const DefragmenterInitInfo& info);
+		CraigError terminate(); // Once everything made in the pools has been freed
+
+		// Anything that should be movable has to be allocated out of these
+		VmaPool getBufferPool() const { return m_VMA_bufferPool; }
+		VmaPool getImagePool() const { return m_VMA_imagePool; }
+
+		// The owner keeps the handles, we swap them for the moved ones in place, so the pointers have to stay put for as
+		// long as they're registered. Images need to be in layout when they're not being used. onMoved gets called
+		// once the handles have been swapped, while the frame's still being recorded.
+		void registerBuffer(VmaAllocation allocation, vk::Buffer* p_Buffer, vk::DeviceSize size, vk::BufferUsageFlags usage);
+		void registerImage(VmaAllocation allocation, vk::Image* p_Image, vk::ImageView* p_View, vk::Format format, vk::Extent2D extent,
+			uint32_t mipLevels, vk::ImageUsageFlags usage, vk::ImageLayout layout, std::function<void()> onMoved = nullptr);
+		void unregister(VmaAllocation allocation); // Has to happen before the allocation's freed, and not while it's running (see cancelImmediately)
+
+		void start();             // Does nothing if it's already going
+		void cancel();            // Stops once the pass in flight has landed, whatever's moved so far stays moved
+		void cancelImmediately(); // Same but now, the GPU has to be idle. For before freeing anything registered
+
+		// Once a frame, starts a run by itself when auto is on and the pools' fragmentation has got past kDefragmentAutoFragmentation
+		void update();
+
+		// At the start of the frame's command buffer, before anything's drawn. Records the next pass if the last one's
+		// finished and fixes up the handles, the pass gets ended through the deletion queue.
+		void recordPass(vk::CommandBuffer commandBuffer, Craig::DeletionQueue& deletionQueue);
+
+		bool isRunning() const { return m_context != VK_NULL_HANDLE; }
+		bool& getAutoEnabled() { return m_autoEnabled; }
+		bool hasReport() const { return m_haveReport; }
+		const Report& getReport() const { return m_report; } // The one in progress while it's running, otherwise the last one
+
+	private:
+		struct Resource
+		{
+			bool                  isImage = false;
+			vk::Buffer*           p_Buffer = nullptr;
+			vk::DeviceSize        size = 0;
+			vk::BufferUsageFlags  bufferUsage;
+			vk::Image*            p_Image = nullptr;
+			vk::ImageView*        p_View = nullptr;
+			vk::Format            format = vk::Format::eUndefined;
+			vk::Extent2D          extent;
+			uint32_t              mipLevels = 1;
+			vk::ImageUsageFlags   imageUsage;
+			vk::ImageLayout       layout = vk::ImageLayout::eUndefined;
+			std::function<void()> onMoved;
+		};
+
+		// The old handles from the pass in flight, destroyed just before it ends
+		struct Retired
+		{
+			vk::Buffer    buffer;
+			vk::Image     image;
+			vk::ImageView view;
+		};
+
+		bool beginPool(); // Starts VMA's defragmentation on mv_VMA_pools[m_poolIndex]
+		void endPool();   // Ends it and moves on to the next pool, or finishes once they've all been done
+		void endPass(uint32_t passId);
+		void finish();
+		Snapshot takeSnapshot();
+
+		vk::Buffer createMovedBuffer(const Resource& resource, VmaAllocation destination);
+		vk::Image createMovedImage(const Resource& resource, VmaAllocation destination);
+		void recordImageCopy(vk::CommandBuffer commandBuffer, const Resource& resource, vk::Image destination);
+
+		std::unordered_map<VmaAllocation, Resource> mMap_resources;
+
+		VmaPool              m_VMA_bufferPool = VK_NULL_HANDLE;
+		VmaPool              m_VMA_imagePool = VK_NULL_HANDLE;
+		std::vector<VmaPool> mv_VMA_pools; // Just the one when buffers and images share a memory type
+
+		VmaDefragmentationContext      m_context = VK_NULL_HANDLE;
+		size_t                         m_poolIndex = 0;
+		VmaDefragmentationPassMoveInfo m_pass{};
+		bool                           m_passInFlight = false;
+		uint32_t                       m_passId = 0;
+		std::vector<Retired>           mv_retired;
+		bool                           m_stopRequested = false;
+
+		Report m_report;
+		bool   m_haveReport = false;
+
+		bool     m_autoEnabled = false;
+		uint32_t m_framesSinceRun = kDefragmentAutoCooldownFrames; // Auto can go straight away once it's turned on
+
+		uint32_t m_queueFamilies[2] = {};
+		bool     m_concurrentSharing = false;
+
+		Craig::Device*         mp_Device = nullptr;
+		Craig::GpuMemoryStats* mp_GpuMemoryStats = nullptr;
+	};
+
+}
@@ -0,0 +1,39 @@
+#include "Craig_DeletionQueue.hpp"
+
+void Craig::DeletionQueue::push(std::function<void()>&& deleter) {
+
+	PendingDeletion pending;
+	pending.deleter = std::move(deleter);
+	pending.framesLeft = kMaxFramesInFlight;
+	mv_pending.push_back(std::move(pending));
+}
+
+void Craig::DeletionQueue::beginFrame() {
+
+	// Same counting as the transient ring, kMaxFramesInFlight fence waits later nothing can still be reading it
+	for (PendingDeletion& pending : mv_pending) {
+		if (pending.framesLeft > 0) {
+			pending.framesLeft--;
+		}
+	}
+
+	std::erase_if(mv_pending, [](PendingDeletion& pending) {
+		if (pending.framesLeft == 0) {
+			pending.deleter();
+			return true;
+		}
+		return false;
+	});
+}
+
+CraigError Craig::DeletionQueue::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	for (PendingDeletion& pending : mv_pending) {
+		pending.deleter();
+	}
+	mv_pending.clear();
+
+	return ret;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+
+	// Holds on to GPU objects that have been swapped out but might still be used by a frame in flight.
+	// Anything pushed gets destroyed once every frame in flight has been waited on, so nothing needs a waitIdle
+	// just to throw something away.
+	class DeletionQueue {
+
+	public:
+		CraigError terminate(); // Device has to be idle, destroys everything straight away
+
+		void push(std::function<void()>&& deleter);
+
+		// Call once the current frame's fence has been waited on
+		void beginFrame();
+
+		size_t getPendingCount() const { return mv_pending.size(); }
+
+	private:
+		struct PendingDeletion
+		{
+			std::function<void()> deleter;
+			uint32_t              framesLeft = 0;
+		};
+
+		std::vector<PendingDeletion> mv_pending;
+	};
+
+}
@@ -1,8 +1,12 @@
 #include "Craig_Device.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <set>
 
 #include "Craig_Swapchain.hpp"
+#include "Craig/Craig_FlightRecorder.hpp"
+#include "Craig/Craig_Log.hpp"
 
 CraigError Craig::Device::init(DeviceInitInfo& initInfo) {
 
@@ -11,8 +15,10 @@ CraigError Craig::Device::init(DeviceInitInfo& initInfo) {
     m_DVC_surface = initInfo.surface;
     m_DVC_instance = initInfo.instance;
     mv_DVC_deviceExtensions = initInfo.deviceExtensionsVector;
+    mv_DVC_optionalDeviceExtensions = initInfo.optionalDeviceExtensionsVector;
 
     pickPhysicalDevice();
+    enableOptionalExtensions();
     createLogicalDevice();
     initVMA();
 
@@ -43,8 +49,8 @@ Craig::Device::QueueFamilyIndices Craig::Device::findQueueFamilies(const vk::Phy
             indices.graphicsFamily = i;
         }
 
-        //Skip if we already assigned the presentation family queue index
-        if(!indices.presentFamily && device.getSurfaceSupportKHR(i, surface)) {
+        //Skip if we already assigned the presentation family queue index (or there's nothing to present to)
+        if(!indices.presentFamily && surface && device.getSurfaceSupportKHR(i, surface)) {
             indices.presentFamily = i; // If the queue family supports presentation to the surface, set the present family
 		}
 
@@ -63,6 +69,11 @@ Craig::Device::QueueFamilyIndices Craig::Device::findQueueFamilies(const vk::Phy
         i++;
     }
 
+    // Headless, nothing ever gets presented so graphics can stand in and everything downstream still lines up
+    if (!surface && indices.graphicsFamily) {
+        indices.presentFamily = indices.graphicsFamily;
+    }
+
     // Fallback: if no dedicated transfer, use graphics (it�s implicitly transfer-capable)
     if (!indices.transferFamily && indices.graphicsFamily) {
         indices.transferFamily = indices.graphicsFamily;
@@ -88,7 +99,7 @@ void Craig::Device::pickPhysicalDevice() {
 
     if (m_VK_physicalDevice) {
         vk::PhysicalDeviceProperties props = m_VK_physicalDevice.getProperties();
-        printf("\nFound GPU: %s\n", props.deviceName.data());
+        CRAIG_LOG_INFO(eDevice, "Found GPU: %s\n", props.deviceName.data());
     }
     else {
         throw std::runtime_error("failed to find a suitable GPU!");
@@ -102,15 +113,16 @@ bool Craig::Device::isDeviceSuitable(const vk::PhysicalDevice& device) {
 
     bool extensionsSupported = checkDeviceExtensionSupport(device); //Check it supports extensions, especifically the swapchain extension
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    // Headless there's no surface to check against, offscreen images are all we need
+    bool swapChainAdequate = !m_DVC_surface;
+    if (extensionsSupported && m_DVC_surface) {
         swapChainAdequate = Swapchain::isSwapChainAdequate(device, m_DVC_surface);
     }
 
-    printf("Found graphics and presentation indices: %s\n", indices.isComplete() ? "True" : "False");
-    printf("Found dedicated transfer index: %s\n", indices.hasDedicatedTransfer() ? "True" : "False");
-    printf("Extensions (Like swapchain/double buffers) are supported: %s\n", extensionsSupported ? "True" : "False");
-    printf("The swapchain extension is adequate for our use: %s\n", swapChainAdequate ? "True" : "False");
+    CRAIG_LOG_DEBUG(eDevice, "Found graphics and presentation indices: %s\n", indices.isComplete() ? "True" : "False");
+    CRAIG_LOG_DEBUG(eDevice, "Found dedicated transfer index: %s\n", indices.hasDedicatedTransfer() ? "True" : "False");
+    CRAIG_LOG_DEBUG(eDevice, "Extensions (Like swapchain/double buffers) are supported: %s\n", extensionsSupported ? "True" : "False");
+    CRAIG_LOG_DEBUG(eDevice, "The swapchain extension is adequate for our use: %s\n", swapChainAdequate ? "True" : "False");
 
     return indices.isComplete() && extensionsSupported && swapChainAdequate;
 }
@@ -131,6 +143,29 @@ bool Craig::Device::checkDeviceExtensionSupport(const vk::PhysicalDevice& device
     return requiredExtensions.empty();
 }
 
+void Craig::Device::enableOptionalExtensions() {
+
+    std::vector<vk::ExtensionProperties> availableExtensions = m_VK_physicalDevice.enumerateDeviceExtensionProperties();
+
+    for (const char* extensionName : mv_DVC_optionalDeviceExtensions) {
+        bool found = std::any_of(availableExtensions.begin(), availableExtensions.end(), [extensionName](const vk::ExtensionProperties& extension) {
+            return std::strcmp(extension.extensionName, extensionName) == 0;
+        });
+
+        if (found) {
+            mv_DVC_deviceExtensions.push_back(extensionName);
+        }
+        CRAIG_LOG_INFO(eDevice, "Optional extension %s: %s\n", extensionName, found ? "enabled" : "not supported");
+    }
+}
+
+bool Craig::Device::isExtensionEnabled(const char* extensionName) const {
+
+    return std::any_of(mv_DVC_deviceExtensions.begin(), mv_DVC_deviceExtensions.end(), [extensionName](const char* enabled) {
+        return std::strcmp(enabled, extensionName) == 0;
+    });
+}
+
 void Craig::Device::createLogicalDevice() {
     // Query the queue families that support graphics and presentation
     Device::QueueFamilyIndices indices = Device::findQueueFamilies(m_VK_physicalDevice, m_DVC_surface);
@@ -165,6 +200,36 @@ void Craig::Device::createLogicalDevice() {
 
     timelineFeatures.setPNext(&v13);
 
+    // So query pools can be reset from the CPU, vkCmdResetQueryPool isn't allowed on transfer only queues.
+    // Has to be the separate struct rather than Vulkan12Features since the timeline one's already on the chain.
+    vk::PhysicalDeviceHostQueryResetFeatures hostQueryResetFeatures{};
+    m_hostQueryResetSupported = m_VK_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceHostQueryResetFeatures>()
+        .get<vk::PhysicalDeviceHostQueryResetFeatures>().hostQueryReset;
+    if (m_hostQueryResetSupported) {
+        hostQueryResetFeatures.setHostQueryReset(true);
+        hostQueryResetFeatures.setPNext(timelineFeatures.pNext);
+        timelineFeatures.setPNext(&hostQueryResetFeatures);
+    }
+    CRAIG_LOG_INFO(eDevice, "Host query reset: %s\n", m_hostQueryResetSupported ? "supported" : "not supported");
+
+    // Present id/wait for frame pacing. Having the extensions isn't enough, the features have to be there too
+    // (some drivers advertise them and then say no), so only chain them on if both check out.
+    vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    if (isExtensionEnabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) && isExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        auto supported = m_VK_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        m_presentWaitSupported = supported.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId
+            && supported.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+
+    if (m_presentWaitSupported) {
+        presentIdFeatures.setPresentId(true);
+        presentWaitFeatures.setPresentWait(true);
+        presentWaitFeatures.setPNext(&presentIdFeatures);
+        v13.setPNext(&presentWaitFeatures);
+    }
+    CRAIG_LOG_INFO(eDevice, "Present wait frame pacing: %s\n", m_presentWaitSupported ? "supported" : "not supported");
+
     // Fill in device creation info with queue setup and feature requirements
     vk::DeviceCreateInfo createInfo = vk::DeviceCreateInfo()
         .setQueueCreateInfos(queueCreateInfos)
@@ -198,6 +263,12 @@ void Craig::Device::initVMA() {
     vmaCreateInfo.device = m_VK_logicalDevice;
     vmaCreateInfo.vulkanApiVersion = VK_API_VERSION_1_4;
 
+    // Lets vmaGetHeapBudgets report what the driver says rather than guessing from our own allocations
+    m_memoryBudgetSupported = isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_memoryBudgetSupported) {
+        vmaCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
     VmaVulkanFunctions vmaFunctions{};
     vmaFunctions.vkGetInstanceProcAddr = &vkGetInstanceProcAddr;
     vmaFunctions.vkGetDeviceProcAddr = &vkGetDeviceProcAddr;
@@ -214,6 +285,7 @@ void Craig::Device::createBufferVMA(
     const VmaAllocationCreateInfo& aci,
     vk::Buffer& buffer,
     VmaAllocation& alloc,
+    const char* name,
     VmaAllocationInfo* outInfo)
 {
     VkBufferCreateInfo bi{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
@@ -232,6 +304,12 @@ void Craig::Device::createBufferVMA(
     VkBuffer raw{};
     vmaCreateBuffer(m_VMA_allocator, &bi, &aci, &raw, &alloc, outInfo);
     buffer = vk::Buffer(raw);
+
+    if (name != nullptr) {
+        vmaSetAllocationName(m_VMA_allocator, alloc, name);
+    }
+
+    Craig::FlightRecorder::getInstance().addEvent(Craig::FlightEvent::eBufferAllocated, "Device::createBufferVMA", size);
 }
 
 CraigError Craig::Device::terminate() {
@@ -15,9 +15,10 @@ namespace Craig {
 		//All the stuff we need to pass to the swapchain from the renderer
 		struct DeviceInitInfo
 		{
-			vk::SurfaceKHR       surface;
+			vk::SurfaceKHR       surface;             // Null when headless
 			vk::Instance        instance;
 			std::vector<const char*> deviceExtensionsVector;
+			std::vector<const char*> optionalDeviceExtensionsVector; // Turned on if the GPU has them, the device still gets picked if it doesn't
 		};
 
 		// Queue family indices (graphics/present/transfer)
@@ -44,17 +45,29 @@ namespace Craig {
 
 		const VmaAllocator getVmaAllocator() const { return m_VMA_allocator; }
 
+		bool isExtensionEnabled(const char* extensionName) const;
+		bool isPresentWaitSupported() const { return m_presentWaitSupported; }   // VK_KHR_present_id + VK_KHR_present_wait, extensions and features both
+		bool isMemoryBudgetSupported() const { return m_memoryBudgetSupported; } // VK_EXT_memory_budget, VMA's budgets are estimates without it
+		bool isHostQueryResetSupported() const { return m_hostQueryResetSupported; } // Core in 1.2 but still optional, vkResetQueryPool from the CPU
+
+		// name ends up on the allocation (VMA copies it), so the stats dumps say what every allocation was for
 		void createBufferVMA(vk::DeviceSize size,
 			vk::BufferUsageFlags usage,
 			const VmaAllocationCreateInfo& aci,
 			vk::Buffer& buffer,
 			VmaAllocation& alloc,
+			const char* name,
 			VmaAllocationInfo* outInfo = nullptr);
 
 	private:
 		vk::SurfaceKHR m_DVC_surface;
 		vk::Instance   m_DVC_instance;
 		std::vector<const char*> mv_DVC_deviceExtensions;
+		std::vector<const char*> mv_DVC_optionalDeviceExtensions;
+
+		bool m_presentWaitSupported = false;
+		bool m_memoryBudgetSupported = false;
+		bool m_hostQueryResetSupported = false;
 
 		vk::Queue m_VK_graphicsQueue;
 		vk::Queue m_VK_presentationQueue;
@@ -69,6 +82,7 @@ namespace Craig {
 		void pickPhysicalDevice(); // Choose GPU
 		bool isDeviceSuitable(const vk::PhysicalDevice& device);
 		bool checkDeviceExtensionSupport(const vk::PhysicalDevice& device);
+		void enableOptionalExtensions(); // Adds whichever optional extensions the picked GPU has onto mv_DVC_deviceExtensions
 
 		void createLogicalDevice(); // Create vk::Device + queues
 
@@ -0,0 +1,369 @@
+#include "Craig_FrameCapture.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Both get their implementations from the resource manager, along with tinygltf
+#include "../../External/stb_image.h"
+#include "../../External/stb_image_write.h"
+
+#include "Craig_Device.hpp"
+#include "Craig_ImageHelpers.hpp"
+#include "Craig/Craig_Profiler.hpp"
+#include "Craig/Craig_Log.hpp"
+
+CraigError Craig::FrameCapture::init(const FrameCaptureInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+
+	// Readback buffers get made the first time they're needed, nobody pays for them unless they capture
+	m_stopWriter = false;
+	m_writerThread = std::thread(&FrameCapture::writerLoop, this);
+
+	return ret;
+}
+
+CraigError Craig::FrameCapture::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	// Anything already queued still gets written
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		m_stopWriter = true;
+	}
+	m_writeCv.notify_all();
+	if (m_writerThread.joinable()) {
+		m_writerThread.join();
+	}
+
+	for (Readback& readback : m_readbacks) {
+		if (readback.buffer) {
+			vmaDestroyBuffer(mp_Device->getVmaAllocator(), readback.buffer, readback.allocation);
+		}
+		readback = Readback{};
+	}
+
+	m_requested = false;
+	m_pendingFrame = kNoFrame;
+	m_readyFrame = kNoFrame;
+
+	return ret;
+}
+
+bool Craig::FrameCapture::requestCapture() {
+
+	if (isBusy()) {
+		return false;
+	}
+
+	m_requested = true;
+	return true;
+}
+
+void Craig::FrameCapture::recordCopy(vk::CommandBuffer commandBuffer, uint32_t frame, vk::Image image, vk::Extent2D extent, vk::Format format) {
+
+	if (!m_requested) {
+		return;
+	}
+	m_requested = false;
+
+	bool swizzle = false;
+	switch (format)
+	{
+	case(vk::Format::eB8G8R8A8Srgb):
+	case(vk::Format::eB8G8R8A8Unorm):
+		swizzle = true;
+		break;
+	case(vk::Format::eR8G8B8A8Srgb):
+	case(vk::Format::eR8G8B8A8Unorm):
+		break;
+	default:
+		CRAIG_LOG_WARN(eCapture, "Can't capture %s frames, only 8 bit RGBA and BGRA\n", vk::to_string(format).c_str());
+		return;
+	}
+
+	CRAIG_PROFILE_ZONE("FrameCapture::recordCopy");
+
+	// This slot's been waited on, so whatever it last copied into its buffer is long done and it can go if it's too small
+	Readback& readback = m_readbacks[frame];
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(extent.width) * extent.height * 4;
+	if (readback.capacity < size) {
+		if (readback.buffer) {
+			vmaDestroyBuffer(mp_Device->getVmaAllocator(), readback.buffer, readback.allocation);
+		}
+
+		VmaAllocationCreateInfo aci{};
+		aci.usage = VMA_MEMORY_USAGE_AUTO;
+		aci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo info{};
+		mp_Device->createBufferVMA(size, vk::BufferUsageFlagBits::eTransferDst, aci, readback.buffer, readback.allocation, "Frame capture readback", &info);
+		readback.p_Mapped = info.pMappedData;
+		readback.capacity = size;
+	}
+	readback.extent = extent;
+	readback.swizzle = swizzle;
+
+	Craig::ImageHelpers::transitionSwapImage(commandBuffer, image, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal);
+
+	vk::BufferImageCopy region{};
+	region.setBufferOffset(0)
+		.setBufferRowLength(0)
+		.setBufferImageHeight(0);
+
+	region.imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor)
+		.setMipLevel(0)
+		.setBaseArrayLayer(0)
+		.setLayerCount(1);
+
+	region.setImageOffset({ 0, 0, 0 })
+		.setImageExtent({ extent.width, extent.height, 1 });
+
+	commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, readback.buffer, region);
+
+	// Makes the copy visible to the host once the fence says the frame's done
+	vk::BufferMemoryBarrier2 hostBarrier{};
+	hostBarrier
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eAllTransfer)
+		.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+		.setDstAccessMask(vk::AccessFlagBits2::eHostRead)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setBuffer(readback.buffer)
+		.setOffset(0)
+		.setSize(size);
+
+	vk::DependencyInfo dep{};
+	dep.setBufferMemoryBarrierCount(1).setPBufferMemoryBarriers(&hostBarrier);
+	commandBuffer.pipelineBarrier2(dep);
+
+	Craig::ImageHelpers::transitionSwapImage(commandBuffer, image, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eColorAttachmentOptimal);
+
+	m_pendingFrame = frame;
+}
+
+void Craig::FrameCapture::collectFrame(uint32_t frame) {
+
+	if (m_pendingFrame != frame) {
+		return;
+	}
+
+	m_readyFrame = m_pendingFrame;
+	m_pendingFrame = kNoFrame;
+}
+
+void Craig::FrameCapture::discardPendingFrames() {
+
+	// Only called after the device has gone idle, so the copy's already there
+	if (m_pendingFrame != kNoFrame) {
+		m_readyFrame = m_pendingFrame;
+		m_pendingFrame = kNoFrame;
+	}
+}
+
+bool Craig::FrameCapture::takeCapture(Image& outImage) {
+
+	if (m_readyFrame == kNoFrame) {
+		return false;
+	}
+
+	CRAIG_PROFILE_ZONE("FrameCapture::takeCapture");
+
+	convertReadback(m_readyFrame, outImage);
+	m_readyFrame = kNoFrame;
+
+	return true;
+}
+
+void Craig::FrameCapture::convertReadback(uint32_t frame, Image& outImage) {
+
+	Readback& readback = m_readbacks[frame];
+
+	size_t size = static_cast<size_t>(readback.extent.width) * readback.extent.height * 4;
+	vmaInvalidateAllocation(mp_Device->getVmaAllocator(), readback.allocation, 0, size);
+
+	outImage.width = readback.extent.width;
+	outImage.height = readback.extent.height;
+	outImage.pixels.resize(size);
+	std::memcpy(outImage.pixels.data(), readback.p_Mapped, size);
+
+	if (readback.swizzle) {
+		for (size_t i = 0; i < size; i += 4) {
+			std::swap(outImage.pixels[i], outImage.pixels[i + 2]);
+		}
+	}
+}
+
+bool Craig::FrameCapture::savePngAsync(Image&& image, const std::string& path) {
+
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		if (m_writeQueue.size() >= kFrameCaptureMaxQueuedWrites) {
+			return false;
+		}
+		m_writeQueue.push_back({ std::move(image), path });
+	}
+	m_writeCv.notify_one();
+
+	return true;
+}
+
+bool Craig::FrameCapture::saveCaptureAsync(const std::string& path) {
+
+	if (m_readyFrame == kNoFrame) {
+		return false;
+	}
+
+	// Either way the capture's done with as far as the frame's concerned, a backed up writer just means it gets dropped
+	uint32_t frame = m_readyFrame;
+	m_readyFrame = kNoFrame;
+
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		if (m_writeQueue.size() >= kFrameCaptureMaxQueuedWrites) {
+			return false;
+		}
+
+		m_writerHoldsReadback = true;
+		PendingWrite write;
+		write.path = path;
+		write.readbackFrame = frame;
+		m_writeQueue.push_back(std::move(write));
+	}
+	m_writeCv.notify_one();
+
+	return true;
+}
+
+void Craig::FrameCapture::flushWrites() {
+
+	std::unique_lock<std::mutex> lock(m_writeMutex);
+	m_writeDoneCv.wait(lock, [this] { return m_writeQueue.empty() && !m_writing; });
+}
+
+void Craig::FrameCapture::writerLoop() {
+
+	CRAIG_PROFILE_THREAD_NAME("Capture writer");
+
+	std::unique_lock<std::mutex> lock(m_writeMutex);
+	while (true) {
+		m_writeCv.wait(lock, [this] { return m_stopWriter || !m_writeQueue.empty(); });
+		if (m_writeQueue.empty()) {
+			break; // Stopping and there's nothing left
+		}
+
+		PendingWrite write = std::move(m_writeQueue.front());
+		m_writeQueue.pop_front();
+		m_writing = true;
+
+		lock.unlock();
+		if (write.readbackFrame != kNoFrame) {
+			convertReadback(write.readbackFrame, write.image);
+			m_writerHoldsReadback = false;
+		}
+		if (writePng(write.image, write.path)) {
+			CRAIG_LOG_INFO(eCapture, "Wrote capture to %s\n", write.path.c_str());
+		}
+		lock.lock();
+
+		m_writing = false;
+		m_writeDoneCv.notify_all();
+	}
+}
+
+bool Craig::FrameCapture::writePng(const Image& image, const std::string& path) {
+
+	CRAIG_PROFILE_ZONE("FrameCapture::writePng");
+
+	if (image.pixels.size() != static_cast<size_t>(image.width) * image.height * 4 || image.width == 0) {
+		CRAIG_LOG_WARN(eCapture, "Not writing %s, the image is empty\n", path.c_str());
+		return false;
+	}
+
+	if (stbi_write_png(path.c_str(), static_cast<int>(image.width), static_cast<int>(image.height), 4, image.pixels.data(), static_cast<int>(image.width * 4)) == 0) {
+		CRAIG_LOG_WARN(eCapture, "Couldn't write %s\n", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool Craig::FrameCapture::readPng(const std::string& path, Image& outImage) {
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (pixels == nullptr) {
+		return false;
+	}
+
+	outImage.width = static_cast<uint32_t>(width);
+	outImage.height = static_cast<uint32_t>(height);
+	outImage.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pixels);
+
+	return true;
+}
+
+Craig::FrameCapture::ImageDiff Craig::FrameCapture::compare(const Image& a, const Image& b, uint32_t tolerance, Image* outDiffImage) {
+
+	ImageDiff diff;
+	if (a.width != b.width || a.height != b.height || a.pixels.size() != b.pixels.size()) {
+		diff.sizeMismatch = true;
+		return diff;
+	}
+
+	if (outDiffImage != nullptr) {
+		outDiffImage->width = a.width;
+		outDiffImage->height = a.height;
+		outDiffImage->pixels.resize(a.pixels.size());
+	}
+
+	uint64_t totalDifference = 0;
+	size_t pixelCount = static_cast<size_t>(a.width) * a.height;
+	for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+		const uint8_t* pixelA = &a.pixels[pixel * 4];
+		const uint8_t* pixelB = &b.pixels[pixel * 4];
+
+		uint32_t worstChannel = 0;
+		for (size_t channel = 0; channel < 4; channel++) {
+			uint32_t difference = static_cast<uint32_t>(std::abs(pixelA[channel] - pixelB[channel]));
+			worstChannel = std::max(worstChannel, difference);
+			totalDifference += difference;
+		}
+
+		diff.maxChannelDifference = std::max(diff.maxChannelDifference, worstChannel);
+		bool differs = worstChannel > tolerance;
+		if (differs) {
+			diff.differingPixels++;
+		}
+
+		if (outDiffImage != nullptr) {
+			uint8_t* out = &outDiffImage->pixels[pixel * 4];
+			if (differs) {
+				out[0] = 255;
+				out[1] = 0;
+				out[2] = 0;
+			}
+			else {
+				// Greyscale at a quarter brightness, just enough to see where things are
+				uint8_t grey = static_cast<uint8_t>((pixelA[0] + pixelA[1] + pixelA[2]) / 12);
+				out[0] = grey;
+				out[1] = grey;
+				out[2] = grey;
+			}
+			out[3] = 255;
+		}
+	}
+
+	diff.differingPercent = pixelCount > 0 ? 100.0f * diff.differingPixels / pixelCount : 0.0f;
+	diff.meanAbsoluteError = pixelCount > 0 ? static_cast<float>(static_cast<double>(totalDifference) / (pixelCount * 4)) : 0.0f;
+	return diff;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "../../External/vk_mem_alloc.h"
+
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+	class Device;
+
+	// Copies finished frames back to the CPU without stalling anything. The copy gets recorded into the frame's own
+	// command buffer, into a persistently mapped buffer owned by that frame slot, and it's only looked at once the
+	// slot's fence has come round again, a few frames later. Writing PNGs happens on a thread of its own.
+	// One capture is in flight at a time, asking for another before the last one's been taken gets turned down.
+	class FrameCapture {
+
+	public:
+		struct FrameCaptureInitInfo
+		{
+			Craig::Device* p_Device = nullptr;
+		};
+
+		// Tightly packed RGBA8, top row first
+		struct Image
+		{
+			uint32_t             width = 0;
+			uint32_t             height = 0;
+			std::vector<uint8_t> pixels;
+		};
+
+		struct ImageDiff
+		{
+			bool     sizeMismatch = false;
+			uint32_t differingPixels = 0;      // Any channel further apart than the tolerance
+			float    differingPercent = 0.0f;
+			uint32_t maxChannelDifference = 0;
+			float    meanAbsoluteError = 0.0f; // Per channel, out of 255
+		};
+
+		CraigError init(const FrameCaptureInitInfo& info);
+		CraigError terminate();
+
+		bool requestCapture(); // The next frame recorded gets copied out. False if one's already on its way.
+		bool isBusy() const { return m_requested || m_pendingFrame != kNoFrame || m_readyFrame != kNoFrame || m_writerHoldsReadback; }
+
+		// Recorded into the frame's command buffer while the image's in colour attachment layout, leaves it in that layout.
+		// Does nothing unless a capture's been asked for.
+		void recordCopy(vk::CommandBuffer commandBuffer, uint32_t frame, vk::Image image, vk::Extent2D extent, vk::Format format);
+
+		// Once the frame's been waited on, nothing waits in here
+		void collectFrame(uint32_t frame);
+		void discardPendingFrames(); // Frame slots are about to get reused in a different order
+
+		bool hasCapture() const { return m_readyFrame != kNoFrame; }
+		bool takeCapture(Image& outImage); // Converts to RGBA, so it's the caller's choice when that cost gets paid
+
+		// PNG writing on the writer thread, so periodic captures don't cost frame time. False (and nothing written)
+		// if the writer's already got kFrameCaptureMaxQueuedWrites waiting.
+		bool savePngAsync(Image&& image, const std::string& path);
+		bool saveCaptureAsync(const std::string& path); // The capture that's landed, converted on the writer thread too
+		void flushWrites(); // Blocks until everything queued has been written
+
+		static bool writePng(const Image& image, const std::string& path);
+		static bool readPng(const std::string& path, Image& outImage);
+
+		// Per channel comparison, anything within the tolerance counts as the same. The diff image shows matching pixels
+		// as a faded copy of a, and differing ones in red.
+		static ImageDiff compare(const Image& a, const Image& b, uint32_t tolerance, Image* outDiffImage = nullptr);
+
+	private:
+		static constexpr uint32_t kNoFrame = UINT32_MAX;
+
+		struct Readback
+		{
+			vk::Buffer     buffer;
+			VmaAllocation  allocation = VK_NULL_HANDLE;
+			void*          p_Mapped = nullptr;
+			vk::DeviceSize capacity = 0;
+			vk::Extent2D   extent;
+			bool           swizzle = false; // BGRA, needs red and blue swapping
+		};
+
+		struct PendingWrite
+		{
+			Image       image;
+			std::string path;
+			uint32_t    readbackFrame = kNoFrame; // Convert this slot's readback into the image first
+		};
+
+		void writerLoop();
+		void convertReadback(uint32_t frame, Image& outImage);
+
+		bool     m_requested = false;
+		uint32_t m_pendingFrame = kNoFrame; // Slot with a copy recorded but not waited on yet
+		uint32_t m_readyFrame = kNoFrame;   // Slot whose copy has landed and hasn't been taken
+
+		std::atomic<bool> m_writerHoldsReadback = false; // A readback's queued for the writer, its slot can't be copied into yet
+
+		std::array<Readback, kMaxFramesInFlight> m_readbacks;
+
+		std::thread              m_writerThread;
+		std::mutex               m_writeMutex;
+		std::condition_variable  m_writeCv;
+		std::condition_variable  m_writeDoneCv;
+		std::deque<PendingWrite> m_writeQueue;
+		bool                     m_writing = false; // The writer's got one out of the queue
+		bool                     m_stopWriter = false;
+
+		Craig::Device* mp_Device = nullptr;
+	};
+
+}
@@ -0,0 +1,135 @@
+#include "Craig_GpuMemoryStats.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include "Craig_Device.hpp"
+#include "Craig/Craig_Log.hpp"
+#include "Craig/Craig_Profiler.hpp"
+
+float Craig::GpuMemoryStats::HeapStats::getFragmentation() const {
+
+	uint64_t freeBytes = blockBytes - allocationBytes;
+	if (freeBytes == 0 || largestUnusedRange >= freeBytes) {
+		return 0.0f;
+	}
+
+	return 1.0f - static_cast<float>(largestUnusedRange) / static_cast<float>(freeBytes);
+}
+
+CraigError Craig::GpuMemoryStats::init(const GpuMemoryStatsInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+
+	const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+	vmaGetMemoryProperties(mp_Device->getVmaAllocator(), &memoryProperties);
+
+	mv_heaps.resize(memoryProperties->memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+		mv_heaps[i].heapSize = memoryProperties->memoryHeaps[i].size;
+		mv_heaps[i].deviceLocal = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+
+	if (!isBudgetFromDriver()) {
+		CRAIG_LOG_INFO(eDevice, "VK_EXT_memory_budget isn't available, the memory budgets are VMA's estimates\n");
+	}
+
+	refresh();
+
+	return ret;
+}
+
+bool Craig::GpuMemoryStats::isBudgetFromDriver() const {
+
+	return mp_Device != nullptr && mp_Device->isMemoryBudgetSupported();
+}
+
+void Craig::GpuMemoryStats::update() {
+
+	CRAIG_PROFILE_ZONE("GpuMemoryStats::update");
+
+	vmaSetCurrentFrameIndex(mp_Device->getVmaAllocator(), ++m_frameIndex);
+
+	if (++m_framesSinceRefresh >= kGpuMemoryStatsIntervalFrames) {
+		refresh();
+		return;
+	}
+
+	// Just the budgets in between, they're already sitting in VMA
+	std::vector<VmaBudget> budgets(mv_heaps.size());
+	vmaGetHeapBudgets(mp_Device->getVmaAllocator(), budgets.data());
+
+	m_total.budgetBytes = 0;
+	m_total.usageBytes = 0;
+	for (size_t i = 0; i < mv_heaps.size(); i++) {
+		mv_heaps[i].budgetBytes = budgets[i].budget;
+		mv_heaps[i].usageBytes = budgets[i].usage;
+		m_total.budgetBytes += budgets[i].budget;
+		m_total.usageBytes += budgets[i].usage;
+	}
+}
+
+void Craig::GpuMemoryStats::refresh() {
+
+	CRAIG_PROFILE_ZONE("GpuMemoryStats::refresh");
+
+	m_framesSinceRefresh = 0;
+
+	VmaAllocator allocator = mp_Device->getVmaAllocator();
+
+	VmaTotalStatistics statistics{};
+	vmaCalculateStatistics(allocator, &statistics);
+
+	std::vector<VmaBudget> budgets(mv_heaps.size());
+	vmaGetHeapBudgets(allocator, budgets.data());
+
+	m_total = HeapStats{};
+	for (size_t i = 0; i < mv_heaps.size(); i++) {
+		const VmaDetailedStatistics& heap = statistics.memoryHeap[i];
+		HeapStats& stats = mv_heaps[i];
+
+		stats.budgetBytes = budgets[i].budget;
+		stats.usageBytes = budgets[i].usage;
+		stats.blockCount = heap.statistics.blockCount;
+		stats.allocationCount = heap.statistics.allocationCount;
+		stats.unusedRangeCount = heap.unusedRangeCount;
+		stats.blockBytes = heap.statistics.blockBytes;
+		stats.allocationBytes = heap.statistics.allocationBytes;
+		stats.largestUnusedRange = heap.unusedRangeCount > 0 ? heap.unusedRangeSizeMax : 0;
+
+		m_total.heapSize += stats.heapSize;
+		m_total.budgetBytes += stats.budgetBytes;
+		m_total.usageBytes += stats.usageBytes;
+		m_total.largestUnusedRange = std::max(m_total.largestUnusedRange, stats.largestUnusedRange);
+	}
+
+	m_total.blockCount = statistics.total.statistics.blockCount;
+	m_total.allocationCount = statistics.total.statistics.allocationCount;
+	m_total.unusedRangeCount = statistics.total.unusedRangeCount;
+	m_total.blockBytes = statistics.total.statistics.blockBytes;
+	m_total.allocationBytes = statistics.total.statistics.allocationBytes;
+}
+
+bool Craig::GpuMemoryStats::writeStatsString(const std::string& path, bool detailed) const {
+
+	VmaAllocator allocator = mp_Device->getVmaAllocator();
+
+	char* statsString = nullptr;
+	vmaBuildStatsString(allocator, &statsString, detailed ? VK_TRUE : VK_FALSE);
+
+	std::ofstream file(path, std::ios::trunc);
+	bool written = file.is_open();
+	if (written) {
+		file << statsString;
+		CRAIG_LOG_INFO(eRenderer, "Wrote VMA's stats to %s\n", path.c_str());
+	}
+	else {
+		CRAIG_LOG_WARN(eRenderer, "Couldn't open %s to write VMA's stats\n", path.c_str());
+	}
+
+	vmaFreeStatsString(allocator, statsString);
+
+	return written;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "vk_mem_alloc.h"
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+	class Device;
+
+	// What VMA's got out of each memory heap and how close that is to the budget. The budgets are cheap and get read
+	// every frame, vmaCalculateStatistics walks every block so the block/free range numbers only get redone every
+	// kGpuMemoryStatsIntervalFrames (or when asked).
+	// Every allocation gets a name when it's made (see Device::createBufferVMA), so writeStatsString can say what
+	// the memory is actually being used for.
+	class GpuMemoryStats {
+
+	public:
+		struct GpuMemoryStatsInitInfo
+		{
+			Craig::Device* p_Device = nullptr;
+		};
+
+		struct HeapStats
+		{
+			uint64_t heapSize = 0;
+			bool     deviceLocal = false;
+
+			// From the budget, usage is the whole process (other APIs and drivers included) when VK_EXT_memory_budget is on
+			uint64_t budgetBytes = 0;
+			uint64_t usageBytes = 0;
+
+			// VMA's own, as of the last full refresh
+			uint32_t blockCount = 0;         // vkDeviceMemory objects
+			uint32_t allocationCount = 0;
+			uint32_t unusedRangeCount = 0;   // Gaps between allocations inside the blocks
+			uint64_t blockBytes = 0;
+			uint64_t allocationBytes = 0;
+			uint64_t largestUnusedRange = 0; // The biggest thing that fits in the blocks we've already got
+
+			// 0 when all the free space is in one piece, towards 1 as it gets split into lots of small gaps
+			float getFragmentation() const;
+		};
+
+		CraigError init(const GpuMemoryStatsInitInfo& info);
+
+		// Once a frame, tells VMA which frame it is (which is when it re-reads the budget) and refreshes everything
+		// every kGpuMemoryStatsIntervalFrames
+		void update();
+		void refresh(); // Full refresh now
+
+		const std::vector<HeapStats>& getHeaps() const { return mv_heaps; }
+		const HeapStats& getTotal() const { return m_total; }
+		bool isBudgetFromDriver() const; // False means VMA's estimating the budget from the heap sizes
+
+		// vmaBuildStatsString's JSON, detailed includes every allocation with its name
+		bool writeStatsString(const std::string& path, bool detailed) const;
+
+	private:
+		uint32_t m_frameIndex = 0;
+		uint32_t m_framesSinceRefresh = kGpuMemoryStatsIntervalFrames; // So the first update refreshes
+
+		std::vector<HeapStats> mv_heaps;
+		HeapStats              m_total;
+
+		Craig::Device* mp_Device = nullptr;
+	};
+
+}
@@ -0,0 +1,364 @@
+#include "Craig_GpuProfiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "../../External/json.hpp"
+
+#include "Craig_Device.hpp"
+#include "Craig/Craig_Log.hpp"
+
+CraigError Craig::GpuProfiler::init(const GpuProfilerInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+
+	vk::PhysicalDevice physicalDevice = mp_Device->getPhysicalDevice();
+	vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+	std::vector<vk::QueueFamilyProperties> queueFamilies = physicalDevice.getQueueFamilyProperties();
+	Device::QueueFamilyIndices indices = Device::findQueueFamilies(physicalDevice, info.surface);
+
+	// timestampValidBits on the queue family is what actually says whether timestamps work there,
+	// timestampComputeAndGraphics is only a promise about every graphics/compute family at once
+	m_graphicsValidBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+	m_transferValidBits = queueFamilies[indices.transferFamily.value()].timestampValidBits;
+	m_timestampPeriod = properties.limits.timestampPeriod;
+	m_supported = m_graphicsValidBits > 0 && m_timestampPeriod > 0.0f;
+
+	// The one-off queries get reset from the CPU when they can be, a transfer only queue can't reset them itself
+	m_hostQueryReset = mp_Device->isHostQueryResetSupported();
+	if (!m_hostQueryReset && indices.hasDedicatedTransfer()) {
+		m_transferValidBits = 0;
+		CRAIG_LOG_INFO(eProfiling, "No host query reset, transfer queue submits won't be timed\n");
+	}
+
+	if (!m_supported) {
+		CRAIG_LOG_WARN(eProfiling, "GPU timestamps aren't supported on the graphics queue, the GPU profiler is off\n");
+		return ret;
+	}
+
+	vk::QueryPoolCreateInfo poolInfo{};
+	poolInfo
+		.setQueryType(vk::QueryType::eTimestamp)
+		.setQueryCount(kGpuProfilerMaxQueries);
+
+	for (FrameQueries& frame : m_frames) {
+		frame.pool = mp_Device->getLogicalDevice().createQueryPool(poolInfo);
+		frame.scopes.reserve(kGpuProfilerMaxQueries / 2);
+	}
+
+	poolInfo.setQueryCount(kGpuProfilerImmediateQueries);
+	m_VK_immediatePool = mp_Device->getLogicalDevice().createQueryPool(poolInfo);
+
+	CRAIG_LOG_INFO(eProfiling, "GPU profiler: %.2f ns per tick, %u valid bits on graphics, %u on transfer\n", m_timestampPeriod, m_graphicsValidBits, m_transferValidBits);
+
+	return ret;
+}
+
+uint32_t Craig::GpuProfiler::findOrAddScope(const char* name, bool perFrame) {
+
+	auto found = mMap_scopeIndices.find(name);
+	if (found != mMap_scopeIndices.end()) {
+		return found->second;
+	}
+
+	ScopeStats scope;
+	scope.name = name;
+	scope.perFrame = perFrame;
+	scope.historyMs.resize(kGpuProfilerHistoryFrames, 0.0f);
+
+	uint32_t index = static_cast<uint32_t>(mv_scopes.size());
+	mv_scopes.push_back(std::move(scope));
+	mMap_scopeIndices[name] = index;
+
+	mv_frameTotalsMs.resize(mv_scopes.size(), -1.0f);
+	mv_frameDepths.resize(mv_scopes.size(), 0);
+
+	return index;
+}
+
+void Craig::GpuProfiler::beginFrame(vk::CommandBuffer commandBuffer, uint32_t frame) {
+
+	if (!m_supported) {
+		return;
+	}
+
+	m_currentFrame = frame;
+	FrameQueries& queries = m_frames[frame];
+	queries.queryCount = 0;
+	queries.scopes.clear();
+	queries.pending = true;
+	mv_openScopes.clear();
+
+	commandBuffer.resetQueryPool(queries.pool, 0, kGpuProfilerMaxQueries);
+}
+
+void Craig::GpuProfiler::beginScope(vk::CommandBuffer commandBuffer, const char* name) {
+
+	if (!m_supported) {
+		return;
+	}
+
+	FrameQueries& queries = m_frames[m_currentFrame];
+
+	// Out of queries, the scope just doesn't get timed. Still goes on the stack so endScope matches up.
+	if (queries.queryCount + 2 > kGpuProfilerMaxQueries) {
+		mv_openScopes.push_back(UINT32_MAX);
+		return;
+	}
+
+	RecordedScope scope;
+	scope.scopeIndex = findOrAddScope(name, true);
+	scope.beginQuery = queries.queryCount++;
+	scope.endQuery = queries.queryCount++;
+	scope.depth = static_cast<uint32_t>(mv_openScopes.size());
+
+	mv_openScopes.push_back(static_cast<uint32_t>(queries.scopes.size()));
+	queries.scopes.push_back(scope);
+
+	commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, queries.pool, scope.beginQuery);
+}
+
+void Craig::GpuProfiler::endScope(vk::CommandBuffer commandBuffer) {
+
+	if (!m_supported || mv_openScopes.empty()) {
+		return;
+	}
+
+	uint32_t scopeSlot = mv_openScopes.back();
+	mv_openScopes.pop_back();
+
+	if (scopeSlot == UINT32_MAX) {
+		return;
+	}
+
+	FrameQueries& queries = m_frames[m_currentFrame];
+	commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, queries.pool, queries.scopes[scopeSlot].endQuery);
+}
+
+float Craig::GpuProfiler::ticksToMs(uint64_t begin, uint64_t end, uint32_t validBits) const {
+
+	// Only the bottom validBits of a timestamp mean anything, so the difference wraps round at that many bits
+	uint64_t mask = (validBits >= 64) ? UINT64_MAX : ((uint64_t(1) << validBits) - 1);
+	uint64_t ticks = (end - begin) & mask;
+
+	return static_cast<float>(static_cast<double>(ticks) * m_timestampPeriod / 1000000.0);
+}
+
+bool Craig::GpuProfiler::collectFrame(uint32_t frame) {
+
+	if (!m_supported) {
+		return false;
+	}
+
+	FrameQueries& queries = m_frames[frame];
+	if (!queries.pending || queries.queryCount == 0) {
+		return false;
+	}
+
+	// No wait flag. The frame's fence has already been waited on, so if they're not there something went wrong
+	// and we'd rather lose a sample than sit here.
+	std::array<uint64_t, kGpuProfilerMaxQueries> timestamps{};
+	vk::Result result = mp_Device->getLogicalDevice().getQueryPoolResults(
+		queries.pool,
+		0,
+		queries.queryCount,
+		queries.queryCount * sizeof(uint64_t),
+		timestamps.data(),
+		sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64);
+
+	if (result != vk::Result::eSuccess) {
+		return false;
+	}
+
+	queries.pending = false;
+
+	// A scope can run more than once in a frame (both occlusion phases for example), those get added together
+	std::fill(mv_frameTotalsMs.begin(), mv_frameTotalsMs.end(), -1.0f);
+
+	for (const RecordedScope& scope : queries.scopes) {
+		float ms = ticksToMs(timestamps[scope.beginQuery], timestamps[scope.endQuery], m_graphicsValidBits);
+		float& total = mv_frameTotalsMs[scope.scopeIndex];
+		total = (total < 0.0f) ? ms : total + ms;
+		mv_frameDepths[scope.scopeIndex] = scope.depth;
+	}
+
+	for (uint32_t scopeIndex = 0; scopeIndex < mv_frameTotalsMs.size(); scopeIndex++) {
+		if (mv_frameTotalsMs[scopeIndex] >= 0.0f) {
+			addSample(scopeIndex, mv_frameTotalsMs[scopeIndex], mv_frameDepths[scopeIndex]);
+		}
+	}
+
+	return true;
+}
+
+void Craig::GpuProfiler::discardPendingFrames() {
+
+	for (FrameQueries& queries : m_frames) {
+		queries.pending = false;
+	}
+}
+
+void Craig::GpuProfiler::beginImmediateScope(vk::CommandBuffer commandBuffer, const char* name, bool transferQueue) {
+
+	uint32_t validBits = transferQueue ? m_transferValidBits : m_graphicsValidBits;
+	if (!m_supported || validBits == 0 || m_immediateQueryHead + 2 > kGpuProfilerImmediateQueries) {
+		return;
+	}
+
+	ImmediateScope scope;
+	scope.commandBuffer = commandBuffer;
+	scope.scopeIndex = findOrAddScope(name, false);
+	scope.beginQuery = m_immediateQueryHead;
+	scope.transferQueue = transferQueue;
+	m_immediateQueryHead += 2;
+
+	// Nothing's still using these, collectImmediateScopes waited on them before the head went back to 0
+	if (m_hostQueryReset) {
+		mp_Device->getLogicalDevice().resetQueryPool(m_VK_immediatePool, scope.beginQuery, 2);
+	}
+	else {
+		commandBuffer.resetQueryPool(m_VK_immediatePool, scope.beginQuery, 2);
+	}
+	commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, m_VK_immediatePool, scope.beginQuery);
+
+	mv_immediateScopes.push_back(scope);
+}
+
+void Craig::GpuProfiler::endImmediateScope(vk::CommandBuffer commandBuffer) {
+
+	for (auto it = mv_immediateScopes.rbegin(); it != mv_immediateScopes.rend(); ++it) {
+		if (it->commandBuffer == static_cast<VkCommandBuffer>(commandBuffer) && !it->ended) {
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, m_VK_immediatePool, it->beginQuery + 1);
+			it->ended = true;
+			return;
+		}
+	}
+}
+
+void Craig::GpuProfiler::collectImmediateScopes() {
+
+	if (!m_supported) {
+		return;
+	}
+
+	for (const ImmediateScope& scope : mv_immediateScopes) {
+		if (!scope.ended) {
+			continue;
+		}
+
+		// The one-off submits wait for the queue to go idle, so these are already there and the wait is free
+		std::array<uint64_t, 2> timestamps{};
+		vk::Result result = mp_Device->getLogicalDevice().getQueryPoolResults(
+			m_VK_immediatePool,
+			scope.beginQuery,
+			2,
+			sizeof(timestamps),
+			timestamps.data(),
+			sizeof(uint64_t),
+			vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+		if (result == vk::Result::eSuccess) {
+			addSample(scope.scopeIndex, ticksToMs(timestamps[0], timestamps[1], scope.transferQueue ? m_transferValidBits : m_graphicsValidBits), 0);
+		}
+	}
+
+	std::erase_if(mv_immediateScopes, [](const ImmediateScope& scope) { return scope.ended; });
+
+	if (mv_immediateScopes.empty()) {
+		m_immediateQueryHead = 0;
+	}
+}
+
+void Craig::GpuProfiler::addSample(uint32_t scopeIndex, float ms, uint32_t depth) {
+
+	ScopeStats& scope = mv_scopes[scopeIndex];
+
+	scope.historyMs[scope.historyHead] = ms;
+	scope.historyHead = (scope.historyHead + 1) % scope.historyMs.size();
+	scope.samples++;
+	scope.lastMs = ms;
+	scope.depth = depth;
+
+	size_t count = std::min<size_t>(scope.samples, scope.historyMs.size());
+	mv_sortScratch.assign(scope.historyMs.begin(), scope.historyMs.begin() + count);
+	std::sort(mv_sortScratch.begin(), mv_sortScratch.end());
+
+	float total = 0.0f;
+	for (float sample : mv_sortScratch) {
+		total += sample;
+	}
+
+	scope.minMs = mv_sortScratch.front();
+	scope.avgMs = total / count;
+	scope.p99Ms = mv_sortScratch[std::min(count - 1, static_cast<size_t>(0.99f * count))];
+}
+
+float Craig::GpuProfiler::getLastMs(const char* name) const {
+
+	auto found = mMap_scopeIndices.find(name);
+	return (found != mMap_scopeIndices.end()) ? mv_scopes[found->second].lastMs : 0.0f;
+}
+
+bool Craig::GpuProfiler::exportJson(const std::string& path) const {
+
+	nlohmann::json root;
+	root["timestampPeriodNs"] = m_timestampPeriod;
+	root["historyFrames"] = kGpuProfilerHistoryFrames;
+	root["scopes"] = nlohmann::json::array();
+
+	for (const ScopeStats& scope : mv_scopes) {
+		// Oldest first
+		std::vector<float> history;
+		size_t count = std::min<size_t>(scope.samples, scope.historyMs.size());
+		size_t start = (scope.samples > scope.historyMs.size()) ? scope.historyHead : 0;
+		for (size_t i = 0; i < count; i++) {
+			history.push_back(scope.historyMs[(start + i) % scope.historyMs.size()]);
+		}
+
+		nlohmann::json scopeJson;
+		scopeJson["name"] = scope.name;
+		scopeJson["depth"] = scope.depth;
+		scopeJson["perFrame"] = scope.perFrame;
+		scopeJson["samples"] = scope.samples;
+		scopeJson["lastMs"] = scope.lastMs;
+		scopeJson["minMs"] = scope.minMs;
+		scopeJson["avgMs"] = scope.avgMs;
+		scopeJson["p99Ms"] = scope.p99Ms;
+		scopeJson["historyMs"] = history;
+		root["scopes"].push_back(scopeJson);
+	}
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(eProfiling, "Couldn't open %s to export the GPU profile\n", path.c_str());
+		return false;
+	}
+
+	file << root.dump(2);
+	CRAIG_LOG_INFO(eProfiling, "Exported GPU profile to %s\n", path.c_str());
+
+	return true;
+}
+
+CraigError Craig::GpuProfiler::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	if (!m_supported) {
+		return ret;
+	}
+
+	for (FrameQueries& frame : m_frames) {
+		mp_Device->getLogicalDevice().destroyQueryPool(frame.pool);
+		frame.pool = nullptr;
+	}
+
+	mp_Device->getLogicalDevice().destroyQueryPool(m_VK_immediatePool);
+	m_VK_immediatePool = nullptr;
+
+	return ret;
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+	class Device;
+
+	// Timestamps around chunks of GPU work. Every frame in flight has its own query pool, which only gets read back
+	// once that frame's been waited on, so asking for the results never stalls. One-off command buffers (uploads,
+	// mip generation) write into their own pool and get read straight after the submit's been waited on.
+	// Scope names have to be string literals, they're used as keys without being copied.
+	class GpuProfiler {
+
+	public:
+		struct GpuProfilerInitInfo
+		{
+			Craig::Device* p_Device = nullptr;
+			vk::SurfaceKHR surface;
+		};
+
+		struct ScopeStats
+		{
+			std::string        name;
+			uint32_t           depth = 0;       // How far it was nested last time it ran, for indenting
+			bool               perFrame = true; // False for one-off work like uploads, those only get a sample when they happen
+			std::vector<float> historyMs;       // Ring of the last kGpuProfilerHistoryFrames samples
+			size_t             historyHead = 0; // Where the next sample goes, also the oldest one once the ring's full
+			uint32_t           samples = 0;
+			float              lastMs = 0.0f;
+			float              minMs = 0.0f;
+			float              avgMs = 0.0f;
+			float              p99Ms = 0.0f;
+		};
+
+		CraigError init(const GpuProfilerInitInfo& info);
+		CraigError terminate();
+
+		// Recorded into the frame's command buffer. beginFrame has to go before any scopes, outside of rendering.
+		void beginFrame(vk::CommandBuffer commandBuffer, uint32_t frame);
+		void beginScope(vk::CommandBuffer commandBuffer, const char* name);
+		void endScope(vk::CommandBuffer commandBuffer);
+
+		// Once the frame's been waited on. False if it never got recorded or the results weren't there.
+		bool collectFrame(uint32_t frame);
+		void discardPendingFrames(); // Frame slots are about to get reused in a different order
+
+		// Scopes in one-off command buffers. Collected once the submit's been waited on.
+		void beginImmediateScope(vk::CommandBuffer commandBuffer, const char* name, bool transferQueue);
+		void endImmediateScope(vk::CommandBuffer commandBuffer);
+		void collectImmediateScopes();
+
+		bool isSupported() const { return m_supported; }
+		const std::vector<ScopeStats>& getScopes() const { return mv_scopes; }
+		float getLastMs(const char* name) const; // 0 if the scope's never run
+		const std::vector<float>& getLastFrameMs() const { return mv_frameTotalsMs; } // Per scope from the last collectFrame, negative if it didn't run
+
+		bool exportJson(const std::string& path) const;
+
+	private:
+		struct RecordedScope
+		{
+			uint32_t scopeIndex = 0;
+			uint32_t beginQuery = 0;
+			uint32_t endQuery = UINT32_MAX; // Still open
+			uint32_t depth = 0;
+		};
+
+		struct FrameQueries
+		{
+			vk::QueryPool              pool;
+			uint32_t                   queryCount = 0;
+			std::vector<RecordedScope> scopes;
+			bool                       pending = false;
+		};
+
+		struct ImmediateScope
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			uint32_t        scopeIndex = 0;
+			uint32_t        beginQuery = 0;
+			bool            transferQueue = false;
+			bool            ended = false;
+		};
+
+		uint32_t findOrAddScope(const char* name, bool perFrame);
+		void addSample(uint32_t scopeIndex, float ms, uint32_t depth);
+		float ticksToMs(uint64_t begin, uint64_t end, uint32_t validBits) const;
+
+		bool     m_supported = false;
+		float    m_timestampPeriod = 0.0f; // Nanoseconds per tick
+		uint32_t m_graphicsValidBits = 0;
+		uint32_t m_transferValidBits = 0;  // 0 if the transfer queue can't do timestamps, or can't have them reset
+		bool     m_hostQueryReset = false; // The immediate pool gets reset from the CPU rather than in the command buffer
+
+		std::array<FrameQueries, kMaxFramesInFlight> m_frames;
+		uint32_t              m_currentFrame = 0;
+		std::vector<uint32_t> mv_openScopes; // Indices into the current frame's scopes, UINT32_MAX if it didn't fit
+
+		vk::QueryPool               m_VK_immediatePool;
+		uint32_t                    m_immediateQueryHead = 0;
+		std::vector<ImmediateScope> mv_immediateScopes;
+
+		// Scratch so collecting doesn't allocate every frame
+		std::vector<float>    mv_frameTotalsMs; // Per scope, negative if it didn't run that frame
+		std::vector<uint32_t> mv_frameDepths;
+		std::vector<float>    mv_sortScratch;
+
+		std::vector<ScopeStats>                         mv_scopes;
+		std::unordered_map<std::string_view, uint32_t> mMap_scopeIndices;
+
+		Craig::Device* mp_Device = nullptr;
+	};
+
+	// Begins a GPU scope now and ends it when it goes out of scope
+	class GpuScope {
+
+	public:
+		GpuScope(GpuProfiler& profiler, vk::CommandBuffer commandBuffer, const char* name)
+			: m_profiler(profiler), m_commandBuffer(commandBuffer) {
+			m_profiler.beginScope(m_commandBuffer, name);
+		}
+		~GpuScope() { m_profiler.endScope(m_commandBuffer); }
+
+		GpuScope(const GpuScope&) = delete;
+		GpuScope& operator=(const GpuScope&) = delete;
+
+	private:
+		GpuProfiler&      m_profiler;
+		vk::CommandBuffer m_commandBuffer;
+	};
+
+}
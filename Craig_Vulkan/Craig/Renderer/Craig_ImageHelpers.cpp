@@ -2,6 +2,10 @@
 #include "Craig_Device.hpp"
 #include "Craig_CommandManager.hpp"
 
+#include "Craig/Craig_Profiler.hpp"
+#include "Craig/Craig_Counters.hpp"
+#include "Craig/Craig_FlightRecorder.hpp"
+
 vk::ImageView Craig::ImageHelpers::createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels) {
 	vk::ImageViewCreateInfo createInfo{};
 	createInfo
@@ -33,7 +37,7 @@ vk::ImageView Craig::ImageHelpers::createImageView(vk::Device device, vk::Image
 	return imageView;
 }
 
-vk::Image Craig::ImageHelpers::createImage(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, const VmaAllocator& allocator, VmaAllocation& allocation) {
+vk::Image Craig::ImageHelpers::createImage(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, const VmaAllocator& allocator, VmaAllocation& allocation, const char* name, VmaPool pool) {
 
     vk::ImageCreateInfo imageInfo;
     imageInfo.setImageType(vk::ImageType::e2D);
@@ -71,12 +75,22 @@ vk::Image Craig::ImageHelpers::createImage(vk::PhysicalDevice physicalDevice, vk
     if (properties & vk::MemoryPropertyFlagBits::eHostVisible)
         aci.requiredFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 
+    // The memory type comes from the pool when there is one
+    aci.pool = pool;
+
     VkImage tempImage;
     VkResult result = vmaCreateImage(allocator, imageInfo, &aci, &tempImage, &allocation, nullptr);
 
     if (result != VK_SUCCESS)
         throw std::runtime_error("vmaCreateImage failed");
 
+    // Copied by VMA, so a temporary's fine
+    if (name != nullptr) {
+        vmaSetAllocationName(allocator, allocation, name);
+    }
+
+    Craig::FlightRecorder::getInstance().addEvent(Craig::FlightEvent::eImageAllocated, "ImageHelpers::createImage", (static_cast<uint64_t>(width) << 32) | height);
+
     return tempImage;
 
 }
@@ -180,6 +194,26 @@ void Craig::ImageHelpers::transitionSwapImage(vk::CommandBuffer cmd, vk::Image i
             .setDstStageMask(vk::PipelineStageFlagBits2::eBottomOfPipe)
             .setDstAccessMask(vk::AccessFlagBits2::eNone);
     }
+    else if (oldLayout == vk::ImageLayout::eColorAttachmentOptimal &&
+        newLayout == vk::ImageLayout::eTransferSrcOptimal)
+    {
+        // Headless, the finished frame's there to be copied out instead of presented
+        barrier
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+            .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eAllTransfer)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferRead);
+    }
+    else if (oldLayout == vk::ImageLayout::eTransferSrcOptimal &&
+        newLayout == vk::ImageLayout::eColorAttachmentOptimal)
+    {
+        // Back from a frame capture's copy, whatever comes after (ImGui, the final transition) carries on as normal
+        barrier
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eAllTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferRead)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+            .setDstAccessMask(vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite);
+    }
     else
     {
         throw std::runtime_error("unsupported swapchain layout transition");
@@ -191,7 +225,9 @@ void Craig::ImageHelpers::transitionSwapImage(vk::CommandBuffer cmd, vk::Image i
 }
 
 void Craig::ImageHelpers::copyBufferToImage(Craig::CommandManager& commandManager, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height) {
-    vk::CommandBuffer tempBuffer = commandManager.buffer_beginSingleTimeCommands();
+    CRAIG_PROFILE_ZONE("ImageHelpers::copyBufferToImage");
+
+    vk::CommandBuffer tempBuffer = commandManager.buffer_beginSingleTimeCommands("Upload: texture");
 
     vk::BufferImageCopy region{};
     region.setBufferOffset(0)
@@ -211,6 +247,7 @@ void Craig::ImageHelpers::copyBufferToImage(Craig::CommandManager& commandManage
             });
 
     tempBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
+    CRAIG_COUNT(eUploadBytes, static_cast<uint64_t>(width) * height * 4); // Textures always get staged as RGBA8
 
 
     commandManager.buffer_endSingleTimeCommands(tempBuffer);
@@ -218,12 +255,13 @@ void Craig::ImageHelpers::copyBufferToImage(Craig::CommandManager& commandManage
 
 void Craig::ImageHelpers::generateMipMaps(Craig::CommandManager& commandManager, vk::FormatProperties formatProperties, vk::Image image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, bool useTransferQueue) {
 
+    CRAIG_PROFILE_ZONE("ImageHelpers::generateMipMaps");
 
     if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
        assert("texture image format does not support linear blitting!");
     }
 
-    vk::CommandBuffer tempBuffer = useTransferQueue ? commandManager.buffer_beginSingleTimeCommands() : commandManager.buffer_beginSingleTimeCommandsGFX();
+    vk::CommandBuffer tempBuffer = useTransferQueue ? commandManager.buffer_beginSingleTimeCommands("Mip generation") : commandManager.buffer_beginSingleTimeCommandsGFX("Mip generation");
 
     //This means we're changing an image from x state to y state, and we gotta sync the access types
     vk::ImageMemoryBarrier2 barrier{};
@@ -2,9 +2,7 @@
 
 #include "Craig_Instance.hpp"
 #include "../Craig_Window.hpp"
-
-#include <iostream>
-#include <ostream>
+#include "Craig/Craig_Log.hpp"
 
 CraigError Craig::Instance::init(const InstanceInitInfo& info) {
 
@@ -13,6 +11,11 @@ CraigError Craig::Instance::init(const InstanceInitInfo& info) {
 	mv_ITNC_Layers = info.validationLayerVector;
 	mp_CurrentWindow = info.p_Window;
 
+	std::vector<const char*> extensions = info.extensionsVector;
+	if (mp_CurrentWindow != nullptr) {
+		extensions.insert(extensions.end(), mp_CurrentWindow->getExtensionsVector().begin(), mp_CurrentWindow->getExtensionsVector().end());
+	}
+
 
 	// vk::ApplicationInfo allows the programmer to specifiy some basic information about the
 	// program, which can be useful for layers and tools to provide more debug information.
@@ -32,8 +35,8 @@ CraigError Craig::Instance::init(const InstanceInitInfo& info) {
 		.setFlags(vk::InstanceCreateFlagBits::eEnumeratePortabilityKHR)
 #endif
 		.setPApplicationInfo(&m_VK_appInfo)
-		.setEnabledExtensionCount(static_cast<uint32_t>(mp_CurrentWindow->getExtensionsVector().size()))
-		.setPpEnabledExtensionNames(mp_CurrentWindow->getExtensionsVector().data())
+		.setEnabledExtensionCount(static_cast<uint32_t>(extensions.size()))
+		.setPpEnabledExtensionNames(extensions.data())
 		.setEnabledLayerCount(static_cast<uint32_t>(mv_ITNC_Layers.size()))
 		.setPpEnabledLayerNames(mv_ITNC_Layers.data());
 
@@ -45,12 +48,14 @@ CraigError Craig::Instance::init(const InstanceInitInfo& info) {
 
 	m_VK_instance = vk::createInstance(m_VK_instInfo); //Now that we have the instance created, we can initialize Vulkan
 
-	// Create a Vulkan surface for rendering
-	VkSurfaceKHR cSurface; // Vulkan surface for rendering
-	bool sdlRetBool = SDL_Vulkan_CreateSurface(mp_CurrentWindow->getSDLWindow(), static_cast<VkInstance>(m_VK_instance), &cSurface);
-	assert(sdlRetBool && "Could not create a Vulkan surface.");
+	// Create a Vulkan surface for rendering, headless has nothing to make one from
+	if (mp_CurrentWindow != nullptr) {
+		VkSurfaceKHR cSurface; // Vulkan surface for rendering
+		bool sdlRetBool = SDL_Vulkan_CreateSurface(mp_CurrentWindow->getSDLWindow(), static_cast<VkInstance>(m_VK_instance), &cSurface);
+		assert(sdlRetBool && "Could not create a Vulkan surface.");
 
-	m_VK_surface = vk::SurfaceKHR(cSurface);
+		m_VK_surface = vk::SurfaceKHR(cSurface);
+	}
 
 #if defined(_DEBUG)
 	setupDebugMessenger();
@@ -59,13 +64,23 @@ CraigError Craig::Instance::init(const InstanceInitInfo& info) {
 }
 
 // This function is called by Vulkan to report debug messages.
-// TODO: Maybe switch this to a logger later on, avoiding std::cerr
 VKAPI_ATTR VkBool32 VKAPI_CALL Craig::Instance::debugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT severity,
 	VkDebugUtilsMessageTypeFlagsEXT type,
 	const VkDebugUtilsMessengerCallbackDataEXT* callbackData,
 	void* userData) {
-	std::cerr << "Validation layer: " << callbackData->pMessage << std::endl;
+	if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+		CRAIG_LOG_ERROR(eDevice, "Validation layer: %s", callbackData->pMessage);
+	}
+	else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+		CRAIG_LOG_WARN(eDevice, "Validation layer: %s", callbackData->pMessage);
+	}
+	else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+		CRAIG_LOG_INFO(eDevice, "Validation layer: %s", callbackData->pMessage);
+	}
+	else {
+		CRAIG_LOG_DEBUG(eDevice, "Validation layer: %s", callbackData->pMessage);
+	}
 	return VK_FALSE;
 }
 
@@ -112,7 +127,9 @@ CraigError Craig::Instance::terminate() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
-	m_VK_instance.destroySurfaceKHR(m_VK_surface);
+	if (m_VK_surface) {
+		m_VK_instance.destroySurfaceKHR(m_VK_surface);
+	}
 
 	//Destroy the messenger/debugger
 	//Needs to be done before destroying the instance
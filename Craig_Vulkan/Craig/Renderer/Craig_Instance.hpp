@@ -14,14 +14,15 @@ namespace Craig {
 		struct InstanceInitInfo
 		{
 			std::vector<const char*> validationLayerVector;
-			Window* p_Window = nullptr;
+			std::vector<const char*> extensionsVector; // On top of whatever the window needs
+			Window* p_Window = nullptr;                // Null when headless, there's no surface then either
 		};
 
 		CraigError init(const InstanceInitInfo& info);
 		CraigError terminate();
 
 		const vk::Instance getVkInstance() const { return m_VK_instance; }
-		const vk::SurfaceKHR getVkSurface() const { return m_VK_surface; }
+		const vk::SurfaceKHR getVkSurface() const { return m_VK_surface; } // Null when headless
 
 	private:
 
@@ -0,0 +1,708 @@
+#include "Craig_OcclusionCulling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Craig_Device.hpp"
+#include "Craig_CommandManager.hpp"
+#include "Craig_ImageHelpers.hpp"
+#include "Craig_ShaderCompilation.hpp"
+
+#include "Craig/Craig_Counters.hpp"
+#include "Craig/Craig_Log.hpp"
+
+// Biggest power of two that's <= value, so every pyramid level is exactly half the one above it
+static uint32_t previousPowerOfTwo(uint32_t value) {
+	uint32_t result = 1;
+	while (result * 2 <= value) {
+		result *= 2;
+	}
+	return result;
+}
+
+static bool hasStencilComponent(vk::Format format) {
+	return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
+}
+
+CraigError Craig::OcclusionCulling::init(const OcclusionCullingInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+	mp_CommandManager = info.p_CommandManager;
+	m_OC_surface = info.surface;
+	m_OC_depthFormat = info.depthFormat;
+	m_OC_pipelineCache = info.pipelineCache;
+
+	// The reduction and cull passes run on the graphics queue, so that family has to do compute as well.
+	// Practically every GPU does, but we'd rather fall back to frustum culling than crash.
+	Craig::Device::QueueFamilyIndices indices = Craig::Device::findQueueFamilies(mp_Device->getPhysicalDevice(), m_OC_surface);
+	std::vector<vk::QueueFamilyProperties> queueFamilies = mp_Device->getPhysicalDevice().getQueueFamilyProperties();
+	bool computeOnGraphics = indices.graphicsFamily.has_value() && (queueFamilies[indices.graphicsFamily.value()].queueFlags & vk::QueueFlagBits::eCompute);
+
+	m_supported = info.depthSamplingSupported && computeOnGraphics;
+
+	if (!m_supported) {
+		CRAIG_LOG_WARN(eRenderer, "Occlusion culling isn't supported on this device, falling back to frustum culling only\n");
+		return ret;
+	}
+
+	createDescriptorSetLayouts();
+	createPipelines();
+	createDescriptorPool();
+	createFrameBuffers(kOcclusionInitialCapacity, kOcclusionInitialCapacity);
+	updateCullDescriptorSets();
+
+	return ret;
+}
+
+void Craig::OcclusionCulling::createDescriptorSetLayouts() {
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	// Pyramid reduction: read the level above (or the depth buffer), write this level
+	std::array<vk::DescriptorSetLayoutBinding, 2> pyramidBindings{};
+	pyramidBindings[0]
+		.setBinding(0)
+		.setDescriptorType(vk::DescriptorType::eSampledImage)
+		.setDescriptorCount(1)
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pyramidBindings[1]
+		.setBinding(1)
+		.setDescriptorType(vk::DescriptorType::eStorageImage)
+		.setDescriptorCount(1)
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	vk::DescriptorSetLayoutCreateInfo pyramidLayoutInfo{};
+	pyramidLayoutInfo.setBindings(pyramidBindings);
+	m_VK_pyramidSetLayout = device.createDescriptorSetLayout(pyramidLayoutInfo);
+
+	// Cull pass: objects, history, both draw buffers, results and the pyramid itself
+	std::array<vk::DescriptorSetLayoutBinding, 6> cullBindings{};
+	for (uint32_t i = 0; i < 5; i++) {
+		cullBindings[i]
+			.setBinding(i)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setDescriptorCount(1)
+			.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+	cullBindings[5]
+		.setBinding(5)
+		.setDescriptorType(vk::DescriptorType::eSampledImage)
+		.setDescriptorCount(1)
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	vk::DescriptorSetLayoutCreateInfo cullLayoutInfo{};
+	cullLayoutInfo.setBindings(cullBindings);
+	m_VK_cullSetLayout = device.createDescriptorSetLayout(cullLayoutInfo);
+}
+
+void Craig::OcclusionCulling::createPipelines() {
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+#if defined(_WIN32)
+	vk::ShaderModule pyramidShader = Craig::ShaderCompilation::CompileHLSLToShaderModule(device, L"data/shaders/DepthPyramid.comp");
+	vk::ShaderModule cullShader = Craig::ShaderCompilation::CompileHLSLToShaderModule(device, L"data/shaders/OcclusionCull.comp");
+#elif defined(__APPLE__) || defined(__linux__)
+	vk::ShaderModule pyramidShader = Craig::ShaderCompilation::CompileHLSLToShaderModule(device, L"data/shaders/depthPyramid.spv");
+	vk::ShaderModule cullShader = Craig::ShaderCompilation::CompileHLSLToShaderModule(device, L"data/shaders/occlusionCull.spv");
+#endif
+
+	vk::PushConstantRange pyramidPushRange{};
+	pyramidPushRange
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+		.setOffset(0)
+		.setSize(sizeof(PyramidPushConstants));
+
+	vk::PipelineLayoutCreateInfo pyramidLayoutInfo{};
+	pyramidLayoutInfo
+		.setSetLayouts(m_VK_pyramidSetLayout)
+		.setPushConstantRanges(pyramidPushRange);
+	m_VK_pyramidPipelineLayout = device.createPipelineLayout(pyramidLayoutInfo);
+
+	vk::PushConstantRange cullPushRange{};
+	cullPushRange
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+		.setOffset(0)
+		.setSize(sizeof(CullPushConstants));
+
+	vk::PipelineLayoutCreateInfo cullLayoutInfo{};
+	cullLayoutInfo
+		.setSetLayouts(m_VK_cullSetLayout)
+		.setPushConstantRanges(cullPushRange);
+	m_VK_cullPipelineLayout = device.createPipelineLayout(cullLayoutInfo);
+
+	vk::ComputePipelineCreateInfo pyramidPipelineInfo{};
+	pyramidPipelineInfo
+		.setStage(vk::PipelineShaderStageCreateInfo{}.setStage(vk::ShaderStageFlagBits::eCompute).setModule(pyramidShader).setPName("main"))
+		.setLayout(m_VK_pyramidPipelineLayout);
+
+	vk::ComputePipelineCreateInfo cullPipelineInfo{};
+	cullPipelineInfo
+		.setStage(vk::PipelineShaderStageCreateInfo{}.setStage(vk::ShaderStageFlagBits::eCompute).setModule(cullShader).setPName("main"))
+		.setLayout(m_VK_cullPipelineLayout);
+
+	auto pyramidResult = device.createComputePipeline(m_OC_pipelineCache, pyramidPipelineInfo);
+	auto cullResult = device.createComputePipeline(m_OC_pipelineCache, cullPipelineInfo);
+
+	if (pyramidResult.result != vk::Result::eSuccess || cullResult.result != vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to create occlusion culling pipelines!");
+	}
+	m_VK_pyramidPipeline = pyramidResult.value;
+	m_VK_cullPipeline = cullResult.value;
+
+	// Compute pipelines don't need the modules once they're baked
+	device.destroyShaderModule(pyramidShader);
+	device.destroyShaderModule(cullShader);
+}
+
+void Craig::OcclusionCulling::createDescriptorPool() {
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	std::array<vk::DescriptorPoolSize, 3> poolSizes;
+	poolSizes[0]
+		.setType(vk::DescriptorType::eSampledImage)
+		.setDescriptorCount((kMaxDepthPyramidLevels + 1) * kMaxFramesInFlight);
+	poolSizes[1]
+		.setType(vk::DescriptorType::eStorageImage)
+		.setDescriptorCount(kMaxDepthPyramidLevels * kMaxFramesInFlight);
+	poolSizes[2]
+		.setType(vk::DescriptorType::eStorageBuffer)
+		.setDescriptorCount(5 * kMaxFramesInFlight);
+
+	vk::DescriptorPoolCreateInfo poolInfo{};
+	poolInfo
+		.setPoolSizes(poolSizes)
+		.setMaxSets((kMaxDepthPyramidLevels + 1) * kMaxFramesInFlight);
+
+	m_VK_descriptorPool = device.createDescriptorPool(poolInfo);
+
+	// The sets never change shape, only what they point at, so allocate them all up front and just rewrite them
+	std::vector<vk::DescriptorSetLayout> pyramidLayouts(kMaxDepthPyramidLevels * kMaxFramesInFlight, m_VK_pyramidSetLayout);
+	vk::DescriptorSetAllocateInfo pyramidAllocInfo{};
+	pyramidAllocInfo
+		.setDescriptorPool(m_VK_descriptorPool)
+		.setSetLayouts(pyramidLayouts);
+	mv_VK_pyramidDescriptorSets = device.allocateDescriptorSets(pyramidAllocInfo);
+
+	std::vector<vk::DescriptorSetLayout> cullLayouts(kMaxFramesInFlight, m_VK_cullSetLayout);
+	vk::DescriptorSetAllocateInfo cullAllocInfo{};
+	cullAllocInfo
+		.setDescriptorPool(m_VK_descriptorPool)
+		.setSetLayouts(cullLayouts);
+	mv_VK_cullDescriptorSets = device.allocateDescriptorSets(cullAllocInfo);
+}
+
+void Craig::OcclusionCulling::createFrameBuffers(size_t objectCapacity, size_t drawCapacity) {
+
+	m_objectCapacity = objectCapacity;
+	m_drawCapacity = drawCapacity;
+
+	// Written by the CPU every frame
+	VmaAllocationCreateInfo writeAci{};
+	writeAci.usage = VMA_MEMORY_USAGE_AUTO;
+	writeAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	writeAci.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	// Read back by the CPU a couple of frames later
+	VmaAllocationCreateInfo readAci{};
+	readAci.usage = VMA_MEMORY_USAGE_AUTO;
+	readAci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	readAci.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	mv_VK_objectBuffers.resize(kMaxFramesInFlight);
+	mv_VMA_objectAllocations.resize(kMaxFramesInFlight);
+	mv_objectBuffersMapped.resize(kMaxFramesInFlight);
+	mv_VK_phaseOneDrawBuffers.resize(kMaxFramesInFlight);
+	mv_VMA_phaseOneDrawAllocations.resize(kMaxFramesInFlight);
+	mv_phaseOneDrawBuffersMapped.resize(kMaxFramesInFlight);
+	mv_VK_phaseTwoDrawBuffers.resize(kMaxFramesInFlight);
+	mv_VMA_phaseTwoDrawAllocations.resize(kMaxFramesInFlight);
+	mv_phaseTwoDrawBuffersMapped.resize(kMaxFramesInFlight);
+	mv_VK_resultsBuffers.resize(kMaxFramesInFlight);
+	mv_VMA_resultsAllocations.resize(kMaxFramesInFlight);
+	mv_resultsBuffersMapped.resize(kMaxFramesInFlight);
+
+	vk::DeviceSize objectBufferSize = sizeof(ObjectCullData) * objectCapacity;
+	vk::DeviceSize drawBufferSize = sizeof(vk::DrawIndexedIndirectCommand) * drawCapacity;
+	vk::DeviceSize resultsBufferSize = sizeof(uint32_t) * (kResultsHeaderSize + objectCapacity);
+
+	for (size_t i = 0; i < kMaxFramesInFlight; i++) {
+		VmaAllocationInfo info{};
+
+		mp_Device->createBufferVMA(objectBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, writeAci, mv_VK_objectBuffers[i], mv_VMA_objectAllocations[i], "Occlusion object bounds", &info);
+		mv_objectBuffersMapped[i] = info.pMappedData;
+
+		mp_Device->createBufferVMA(drawBufferSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, writeAci, mv_VK_phaseOneDrawBuffers[i], mv_VMA_phaseOneDrawAllocations[i], "Occlusion phase one draws", &info);
+		mv_phaseOneDrawBuffersMapped[i] = info.pMappedData;
+
+		mp_Device->createBufferVMA(drawBufferSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, writeAci, mv_VK_phaseTwoDrawBuffers[i], mv_VMA_phaseTwoDrawAllocations[i], "Occlusion phase two draws", &info);
+		mv_phaseTwoDrawBuffersMapped[i] = info.pMappedData;
+
+		mp_Device->createBufferVMA(resultsBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, readAci, mv_VK_resultsBuffers[i], mv_VMA_resultsAllocations[i], "Occlusion results readback", &info);
+		mv_resultsBuffersMapped[i] = info.pMappedData;
+		memset(mv_resultsBuffersMapped[i], 0, resultsBufferSize);
+	}
+
+	// History starts out as "nothing was visible", so the first frame just draws everything in phase two
+	VmaAllocationCreateInfo gpuAci{};
+	gpuAci.usage = VMA_MEMORY_USAGE_AUTO;
+	gpuAci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	vk::DeviceSize historyBufferSize = sizeof(uint32_t) * objectCapacity;
+	mp_Device->createBufferVMA(historyBufferSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, gpuAci, m_VK_historyBuffer, m_VMA_historyAllocation, "Occlusion visibility history");
+
+	vk::CommandBuffer tempBuffer = mp_CommandManager->buffer_beginSingleTimeCommandsGFX();
+	tempBuffer.fillBuffer(m_VK_historyBuffer, 0, historyBufferSize, 0);
+	mp_CommandManager->buffer_endSingleTimeCommandsGFX(tempBuffer);
+
+	m_frameSubmitted.fill(false);
+}
+
+void Craig::OcclusionCulling::cleanupFrameBuffers() {
+
+	VmaAllocator allocator = mp_Device->getVmaAllocator();
+
+	for (size_t i = 0; i < mv_VK_objectBuffers.size(); i++) {
+		vmaDestroyBuffer(allocator, mv_VK_objectBuffers[i], mv_VMA_objectAllocations[i]);
+		vmaDestroyBuffer(allocator, mv_VK_phaseOneDrawBuffers[i], mv_VMA_phaseOneDrawAllocations[i]);
+		vmaDestroyBuffer(allocator, mv_VK_phaseTwoDrawBuffers[i], mv_VMA_phaseTwoDrawAllocations[i]);
+		vmaDestroyBuffer(allocator, mv_VK_resultsBuffers[i], mv_VMA_resultsAllocations[i]);
+	}
+
+	vmaDestroyBuffer(allocator, m_VK_historyBuffer, m_VMA_historyAllocation);
+}
+
+void Craig::OcclusionCulling::updateCullDescriptorSets() {
+
+	for (size_t frame = 0; frame < kMaxFramesInFlight; frame++) {
+
+		std::array<vk::DescriptorBufferInfo, 5> bufferInfos;
+		bufferInfos[0].setBuffer(mv_VK_objectBuffers[frame]).setOffset(0).setRange(vk::WholeSize);
+		bufferInfos[1].setBuffer(m_VK_historyBuffer).setOffset(0).setRange(vk::WholeSize);
+		bufferInfos[2].setBuffer(mv_VK_phaseOneDrawBuffers[frame]).setOffset(0).setRange(vk::WholeSize);
+		bufferInfos[3].setBuffer(mv_VK_phaseTwoDrawBuffers[frame]).setOffset(0).setRange(vk::WholeSize);
+		bufferInfos[4].setBuffer(mv_VK_resultsBuffers[frame]).setOffset(0).setRange(vk::WholeSize);
+
+		std::vector<vk::WriteDescriptorSet> writes;
+		for (uint32_t binding = 0; binding < bufferInfos.size(); binding++) {
+			writes.push_back(vk::WriteDescriptorSet{}
+				.setDstSet(mv_VK_cullDescriptorSets[frame])
+				.setDstBinding(binding)
+				.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+				.setDescriptorCount(1)
+				.setPBufferInfo(&bufferInfos[binding]));
+		}
+
+		// The pyramid binding is written per frame in writeFramePyramidSets, it changes whenever the swapchain does
+		mp_Device->getLogicalDevice().updateDescriptorSets(writes, nullptr);
+	}
+}
+
+void Craig::OcclusionCulling::createDepthPyramid(vk::Extent2D extent, vk::ImageView depthView) {
+
+	if (!m_supported) {
+		return;
+	}
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	m_depthExtent = extent;
+	m_pyramidExtent = vk::Extent2D{ previousPowerOfTwo(extent.width), previousPowerOfTwo(extent.height) };
+	m_pyramidLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_pyramidExtent.width, m_pyramidExtent.height)))) + 1;
+	m_pyramidLevels = std::min(m_pyramidLevels, kMaxDepthPyramidLevels);
+
+	m_VK_pyramidImage = ImageHelpers::createImage(mp_Device->getPhysicalDevice(), m_OC_surface, m_pyramidExtent.width, m_pyramidExtent.height, m_pyramidLevels, vk::SampleCountFlagBits::e1, vk::Format::eR32Sfloat, vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		mp_Device->getVmaAllocator(),
+		m_VMA_pyramidAllocation,
+		"Depth pyramid");
+
+	m_VK_pyramidView = ImageHelpers::createImageView(device, m_VK_pyramidImage, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, m_pyramidLevels);
+
+	// The reduction writes one level at a time, so each one needs its own view
+	mv_VK_pyramidMipViews.resize(m_pyramidLevels);
+	for (uint32_t level = 0; level < m_pyramidLevels; level++) {
+		vk::ImageViewCreateInfo viewInfo{};
+		viewInfo
+			.setImage(m_VK_pyramidImage)
+			.setViewType(vk::ImageViewType::e2D)
+			.setFormat(vk::Format::eR32Sfloat)
+			.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 });
+
+		mv_VK_pyramidMipViews[level] = device.createImageView(viewInfo);
+	}
+
+	// Frames in flight might still be using their sets, so each frame rewrites its own in beginFrame
+	m_VK_depthSourceView = depthView;
+	m_pyramidGeneration++;
+}
+
+// Points one frame's sets at the current pyramid and depth image. Only safe once that frame's GPU work is done.
+void Craig::OcclusionCulling::writeFramePyramidSets(uint32_t frame) {
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	for (uint32_t level = 0; level < m_pyramidLevels; level++) {
+		vk::DescriptorSet levelSet = mv_VK_pyramidDescriptorSets[frame * kMaxDepthPyramidLevels + level];
+
+		// Level 0 reads the depth attachment, every other level reads the one above it
+		vk::DescriptorImageInfo inputInfo{};
+		if (level == 0) {
+			inputInfo
+				.setImageView(m_VK_depthSourceView)
+				.setImageLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+		}
+		else {
+			inputInfo
+				.setImageView(mv_VK_pyramidMipViews[level - 1])
+				.setImageLayout(vk::ImageLayout::eGeneral);
+		}
+
+		vk::DescriptorImageInfo outputInfo{};
+		outputInfo
+			.setImageView(mv_VK_pyramidMipViews[level])
+			.setImageLayout(vk::ImageLayout::eGeneral);
+
+		std::array<vk::WriteDescriptorSet, 2> writes;
+		writes[0]
+			.setDstSet(levelSet)
+			.setDstBinding(0)
+			.setDescriptorType(vk::DescriptorType::eSampledImage)
+			.setDescriptorCount(1)
+			.setImageInfo(inputInfo);
+		writes[1]
+			.setDstSet(levelSet)
+			.setDstBinding(1)
+			.setDescriptorType(vk::DescriptorType::eStorageImage)
+			.setDescriptorCount(1)
+			.setImageInfo(outputInfo);
+
+		device.updateDescriptorSets(writes, nullptr);
+	}
+
+	vk::DescriptorImageInfo pyramidInfo{};
+	pyramidInfo
+		.setImageView(m_VK_pyramidView)
+		.setImageLayout(vk::ImageLayout::eGeneral);
+
+	vk::WriteDescriptorSet pyramidWrite{};
+	pyramidWrite
+		.setDstSet(mv_VK_cullDescriptorSets[frame])
+		.setDstBinding(5)
+		.setDescriptorType(vk::DescriptorType::eSampledImage)
+		.setDescriptorCount(1)
+		.setImageInfo(pyramidInfo);
+
+	device.updateDescriptorSets(pyramidWrite, nullptr);
+
+	m_framePyramidGeneration[frame] = m_pyramidGeneration;
+}
+
+void Craig::OcclusionCulling::setDepthSource(vk::ImageView depthView) {
+
+	// The other frames might still be reading their sets, each one picks the new view up in its own beginFrame
+	m_VK_depthSourceView = depthView;
+	m_pyramidGeneration++;
+}
+
+void Craig::OcclusionCulling::cleanupDepthPyramid() {
+
+	if (!m_supported || !m_VK_pyramidImage) {
+		return;
+	}
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	for (vk::ImageView view : mv_VK_pyramidMipViews) {
+		device.destroyImageView(view);
+	}
+	mv_VK_pyramidMipViews.clear();
+
+	device.destroyImageView(m_VK_pyramidView);
+	vmaDestroyImage(mp_Device->getVmaAllocator(), m_VK_pyramidImage, m_VMA_pyramidAllocation);
+
+	m_VK_pyramidView = nullptr;
+	m_VK_pyramidImage = nullptr;
+}
+
+void Craig::OcclusionCulling::retireDepthPyramid(Craig::DeletionQueue& deletionQueue) {
+
+	if (!m_supported || !m_VK_pyramidImage) {
+		return;
+	}
+
+	vk::Device device = mp_Device->getLogicalDevice();
+	VmaAllocator allocator = mp_Device->getVmaAllocator();
+
+	std::vector<vk::ImageView> mipViews = std::move(mv_VK_pyramidMipViews);
+	vk::ImageView pyramidView = m_VK_pyramidView;
+	vk::Image pyramidImage = m_VK_pyramidImage;
+	VmaAllocation pyramidAllocation = m_VMA_pyramidAllocation;
+
+	deletionQueue.push([=]() {
+		for (vk::ImageView view : mipViews) {
+			device.destroyImageView(view);
+		}
+		device.destroyImageView(pyramidView);
+		vmaDestroyImage(allocator, pyramidImage, pyramidAllocation);
+	});
+
+	mv_VK_pyramidMipViews.clear();
+	m_VK_pyramidView = nullptr;
+	m_VK_pyramidImage = nullptr;
+}
+
+void Craig::OcclusionCulling::readResults(uint32_t frame) {
+
+	if (!m_frameSubmitted[frame]) {
+		return;
+	}
+
+	// The timeline wait in SyncManager already made sure this frame's GPU work is done
+	const uint32_t* results = static_cast<const uint32_t*>(mv_resultsBuffersMapped[frame]);
+	m_stats.numTested = results[0];
+	m_stats.numDrawnPhaseOne = results[1];
+	m_stats.numDrawnPhaseTwo = results[2];
+	m_stats.numOccluded = results[3];
+
+	if (m_frameWritesVisibility[frame]) {
+		mv_objectVisibility.assign(results + kResultsHeaderSize, results + kResultsHeaderSize + m_frameObjectCount[frame]);
+	}
+	else {
+		mv_objectVisibility.clear();
+	}
+}
+
+void Craig::OcclusionCulling::beginFrame(uint32_t frame, size_t numObjects, size_t numDraws) {
+
+	if (!m_supported) {
+		return;
+	}
+
+	readResults(frame);
+
+	m_frameWritesVisibility[frame] = m_objectVisibilityRequested;
+	m_objectVisibilityRequested = false;
+
+	if (m_VK_pyramidImage && m_framePyramidGeneration[frame] != m_pyramidGeneration) {
+		writeFramePyramidSets(frame);
+	}
+
+	// Out of room, the other frame might still be using the old buffers so we have to wait it out
+	if (numObjects > m_objectCapacity || numDraws > m_drawCapacity) {
+		mp_Device->getLogicalDevice().waitIdle();
+
+		size_t objectCapacity = std::max<size_t>(m_objectCapacity, 1);
+		while (objectCapacity < numObjects) {
+			objectCapacity *= 2;
+		}
+		size_t drawCapacity = std::max<size_t>(m_drawCapacity, 1);
+		while (drawCapacity < numDraws) {
+			drawCapacity *= 2;
+		}
+
+		cleanupFrameBuffers();
+		createFrameBuffers(objectCapacity, drawCapacity);
+		updateCullDescriptorSets();
+	}
+
+	mv_firstDraw.resize(numObjects);
+	m_frameObjectCount[frame] = static_cast<uint32_t>(numObjects);
+
+	memset(mv_resultsBuffersMapped[frame], 0, sizeof(uint32_t) * kResultsHeaderSize);
+}
+
+void Craig::OcclusionCulling::setObject(uint32_t frame, size_t objectIndex, const glm::vec4& sphere, uint32_t firstDraw, uint32_t drawCount, bool frustumVisible) {
+
+	ObjectCullData* objects = static_cast<ObjectCullData*>(mv_objectBuffersMapped[frame]);
+	objects[objectIndex].sphere = sphere;
+	objects[objectIndex].firstDraw = firstDraw;
+	objects[objectIndex].drawCount = drawCount;
+	objects[objectIndex].frustumVisible = frustumVisible ? 1 : 0;
+	objects[objectIndex].pad = 0;
+
+	mv_firstDraw[objectIndex] = firstDraw;
+}
+
+void Craig::OcclusionCulling::setDraw(uint32_t frame, size_t drawIndex, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset) {
+
+	// instanceCount starts at 0, the cull passes set it to 1 for anything that should be drawn
+	vk::DrawIndexedIndirectCommand command{ indexCount, 0, firstIndex, vertexOffset, 0 };
+
+	static_cast<vk::DrawIndexedIndirectCommand*>(mv_phaseOneDrawBuffersMapped[frame])[drawIndex] = command;
+	static_cast<vk::DrawIndexedIndirectCommand*>(mv_phaseTwoDrawBuffersMapped[frame])[drawIndex] = command;
+}
+
+void Craig::OcclusionCulling::recordCull(vk::CommandBuffer commandBuffer, uint32_t frame, CullPhase phase, const glm::mat4& view, const glm::mat4& proj, float zNear) {
+
+	if (phase == CullPhase::eEarly) {
+		// Last frame's late pass wrote the history we're about to read
+		vk::MemoryBarrier2 historyBarrier{};
+		historyBarrier
+			.setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+			.setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+			.setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+			.setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(historyBarrier));
+	}
+
+	CullPushConstants push{};
+	push.view = view;
+	push.P00 = proj[0][0];
+	push.P11 = proj[1][1];
+	push.P22 = proj[2][2];
+	push.P32 = proj[3][2];
+	push.zNear = zNear;
+	push.objectCount = m_frameObjectCount[frame];
+	push.pyramidWidth = m_pyramidExtent.width;
+	push.pyramidHeight = m_pyramidExtent.height;
+	push.pyramidLevels = m_pyramidLevels;
+	push.phase = static_cast<uint32_t>(phase);
+	push.writeObjectVisibility = m_frameWritesVisibility[frame] ? 1 : 0;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_VK_cullPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_VK_cullPipelineLayout, 0, mv_VK_cullDescriptorSets[frame], nullptr);
+	commandBuffer.pushConstants(m_VK_cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants), &push);
+
+	if (push.objectCount > 0) {
+		commandBuffer.dispatch((push.objectCount + 63) / 64, 1, 1);
+		CRAIG_COUNT(eDispatches, 1);
+	}
+	CRAIG_COUNT(ePipelineBinds, 1);
+	CRAIG_COUNT(eDescriptorSetBinds, 1);
+	CRAIG_COUNT(ePushConstants, 1);
+	CRAIG_COUNT(ePushConstantBytes, sizeof(CullPushConstants));
+
+	// The draws read the instance counts we just wrote, and the late pass results get read back on the CPU
+	vk::MemoryBarrier2 drawBarrier{};
+	drawBarrier
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+		.setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eHost)
+		.setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eHostRead);
+
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(drawBarrier));
+
+	if (phase == CullPhase::eLate) {
+		m_frameSubmitted[frame] = true;
+	}
+}
+
+void Craig::OcclusionCulling::recordDepthPyramid(vk::CommandBuffer commandBuffer, uint32_t frame, vk::Image depthImage) {
+
+	vk::ImageAspectFlags depthAspect = hasStencilComponent(m_OC_depthFormat)
+		? (vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil)
+		: vk::ImageAspectFlagBits::eDepth;
+
+	// Depth from phase one (or its single sample resolve when MSAA is on) becomes readable.
+	// The pyramid itself gets thrown away and rebuilt, we just have to wait for last frame's cull to finish reading it.
+	std::array<vk::ImageMemoryBarrier2, 2> startBarriers;
+	startBarriers[0]
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+		.setSrcAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentWrite)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+		.setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
+		.setOldLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+		.setNewLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setImage(depthImage)
+		.setSubresourceRange({ depthAspect, 0, 1, 0, 1 });
+	startBarriers[1]
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+		.setSrcAccessMask(vk::AccessFlagBits2::eNone)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+		.setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+		.setOldLayout(vk::ImageLayout::eUndefined)
+		.setNewLayout(vk::ImageLayout::eGeneral)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setImage(m_VK_pyramidImage)
+		.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, m_pyramidLevels, 0, 1 });
+
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(startBarriers));
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_VK_pyramidPipeline);
+	CRAIG_COUNT(ePipelineBinds, 1);
+	CRAIG_COUNT(eDescriptorSetBinds, m_pyramidLevels);
+	CRAIG_COUNT(ePushConstants, m_pyramidLevels);
+	CRAIG_COUNT(ePushConstantBytes, m_pyramidLevels * sizeof(PyramidPushConstants));
+	CRAIG_COUNT(eDispatches, m_pyramidLevels);
+
+	vk::Extent2D inputExtent = m_depthExtent;
+	for (uint32_t level = 0; level < m_pyramidLevels; level++) {
+		vk::Extent2D outputExtent{ std::max(m_pyramidExtent.width >> level, 1u), std::max(m_pyramidExtent.height >> level, 1u) };
+
+		PyramidPushConstants push{ inputExtent.width, inputExtent.height, outputExtent.width, outputExtent.height };
+
+		vk::DescriptorSet levelSet = mv_VK_pyramidDescriptorSets[frame * kMaxDepthPyramidLevels + level];
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_VK_pyramidPipelineLayout, 0, levelSet, nullptr);
+		commandBuffer.pushConstants(m_VK_pyramidPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PyramidPushConstants), &push);
+		commandBuffer.dispatch((outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+		// Next level (and eventually the cull pass) reads what we just wrote
+		vk::ImageMemoryBarrier2 levelBarrier{};
+		levelBarrier
+			.setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+			.setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+			.setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+			.setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
+			.setOldLayout(vk::ImageLayout::eGeneral)
+			.setNewLayout(vk::ImageLayout::eGeneral)
+			.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+			.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+			.setImage(m_VK_pyramidImage)
+			.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 });
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(levelBarrier));
+
+		inputExtent = outputExtent;
+	}
+
+	// Back to an attachment so phase two can keep depth testing against it
+	vk::ImageMemoryBarrier2 endBarrier{};
+	endBarrier
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+		.setSrcAccessMask(vk::AccessFlagBits2::eNone)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests)
+		.setDstAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
+		.setOldLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+		.setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+		.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+		.setImage(depthImage)
+		.setSubresourceRange({ depthAspect, 0, 1, 0, 1 });
+
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(endBarrier));
+}
+
+CraigError Craig::OcclusionCulling::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	if (!m_supported) {
+		return ret;
+	}
+
+	vk::Device device = mp_Device->getLogicalDevice();
+
+	cleanupDepthPyramid();
+	cleanupFrameBuffers();
+
+	device.destroyDescriptorPool(m_VK_descriptorPool);
+
+	device.destroyPipeline(m_VK_pyramidPipeline);
+	device.destroyPipeline(m_VK_cullPipeline);
+	device.destroyPipelineLayout(m_VK_pyramidPipelineLayout);
+	device.destroyPipelineLayout(m_VK_cullPipelineLayout);
+	device.destroyDescriptorSetLayout(m_VK_pyramidSetLayout);
+	device.destroyDescriptorSetLayout(m_VK_cullSetLayout);
+
+	return ret;
+}
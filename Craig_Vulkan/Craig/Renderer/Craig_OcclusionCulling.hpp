@@ -0,0 +1,206 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+
+#include <array>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include "../../External/vk_mem_alloc.h"
+
+#include "Craig/Craig_Constants.hpp"
+#include "Craig_DeletionQueue.hpp"
+
+namespace Craig {
+	class Device;
+	class CommandManager;
+
+	// Two phase hierarchical-Z occlusion culling.
+	// Phase one draws whatever was visible last frame, we then build a depth pyramid out of that depth buffer
+	// and test everything against it on the GPU. Anything that turned out visible but wasn't drawn in phase one
+	// gets drawn straight after in phase two, so nothing pops in a frame late.
+	// The draws themselves are still recorded on the CPU (per object texture sets), the compute passes just
+	// flip the instanceCount of each indirect draw between 0 and 1.
+	class OcclusionCulling {
+
+	public:
+		struct OcclusionCullingInitInfo
+		{
+			Craig::Device*         p_Device = nullptr;
+			Craig::CommandManager* p_CommandManager = nullptr;
+			vk::SurfaceKHR         surface;
+			vk::Format             depthFormat;
+			bool                   depthSamplingSupported = false;
+			vk::PipelineCache      pipelineCache;
+		};
+
+		enum class CullPhase : uint32_t {
+			eEarly = 0, // Fills the phase one draws from last frame's visibility
+			eLate = 1,  // Tests against the depth pyramid, fills the phase two draws and updates the history
+		};
+
+		// What the late pass decided for each object, only written and read back while the editor's asking for it
+		enum ObjectVisibility : uint32_t {
+			eOccluded = 0,
+			eVisible = 1,
+			eFrustumCulled = 2,
+		};
+
+		struct OcclusionStats
+		{
+			uint32_t numTested = 0;        // Made it through the CPU frustum cull
+			uint32_t numDrawnPhaseOne = 0; // Visible last frame
+			uint32_t numDrawnPhaseTwo = 0; // Newly visible this frame
+			uint32_t numOccluded = 0;
+		};
+
+		CraigError init(const OcclusionCullingInitInfo& info);
+		CraigError terminate();
+
+		bool isSupported() const { return m_supported; }
+
+		// The pyramid follows the swapchain size, so this gets called whenever the depth attachment is recreated
+		void createDepthPyramid(vk::Extent2D extent, vk::ImageView depthView);
+		void cleanupDepthPyramid();
+		void retireDepthPyramid(Craig::DeletionQueue& deletionQueue); // Same as cleanup, but leaves it alive for the frames in flight
+
+		// Swaps the depth image level 0 of the pyramid reads from without waiting on the GPU (MSAA changes swap it out)
+		void setDepthSource(vk::ImageView depthView);
+
+		// CPU side per frame setup. Call after the GPU has finished with this frame's buffers.
+		void beginFrame(uint32_t frame, size_t numObjects, size_t numDraws);
+		void setObject(uint32_t frame, size_t objectIndex, const glm::vec4& sphere, uint32_t firstDraw, uint32_t drawCount, bool frustumVisible);
+		void setDraw(uint32_t frame, size_t drawIndex, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset);
+
+		void recordCull(vk::CommandBuffer commandBuffer, uint32_t frame, CullPhase phase, const glm::mat4& view, const glm::mat4& proj, float zNear);
+		void recordDepthPyramid(vk::CommandBuffer commandBuffer, uint32_t frame, vk::Image depthImage);
+
+		vk::Buffer getDrawBuffer(uint32_t frame, CullPhase phase) const { return phase == CullPhase::eEarly ? mv_VK_phaseOneDrawBuffers[frame] : mv_VK_phaseTwoDrawBuffers[frame]; }
+		uint32_t getFirstDraw(size_t objectIndex) const { return mv_firstDraw[objectIndex]; }
+
+		const OcclusionStats& getStats() const { return m_stats; }
+		// Has to be asked for every frame it's wanted, it turns up kMaxFramesInFlight frames later. Frames nobody asked
+		// for skip the per-object writes to the readback buffer and leave getObjectVisibility empty.
+		void requestObjectVisibility() { m_objectVisibilityRequested = true; }
+		const std::vector<uint32_t>& getObjectVisibility() const { return mv_objectVisibility; } // ObjectVisibility per object
+		vk::Extent2D getPyramidExtent() const { return m_pyramidExtent; }
+		uint32_t getPyramidLevels() const { return m_pyramidLevels; }
+
+	private:
+		// Matches ObjectCullData in OcclusionCull.comp
+		struct ObjectCullData
+		{
+			glm::vec4 sphere; // World space, xyz = centre, w = radius
+			uint32_t  firstDraw;
+			uint32_t  drawCount;
+			uint32_t  frustumVisible;
+			uint32_t  pad;
+		};
+
+		struct CullPushConstants
+		{
+			glm::mat4 view;
+			float     P00;
+			float     P11;
+			float     P22;
+			float     P32;
+			float     zNear;
+			uint32_t  objectCount;
+			uint32_t  pyramidWidth;
+			uint32_t  pyramidHeight;
+			uint32_t  pyramidLevels;
+			uint32_t  phase;
+			uint32_t  writeObjectVisibility;
+		};
+
+		struct PyramidPushConstants
+		{
+			uint32_t inputWidth;
+			uint32_t inputHeight;
+			uint32_t outputWidth;
+			uint32_t outputHeight;
+		};
+
+		// Stats live at the front of the results buffer, then one ObjectVisibility per object
+		static constexpr uint32_t kResultsHeaderSize = 4;
+
+		void createDescriptorSetLayouts();
+		void createPipelines();
+		void createDescriptorPool();
+		void createFrameBuffers(size_t objectCapacity, size_t drawCapacity);
+		void cleanupFrameBuffers();
+		void updateCullDescriptorSets();
+		void writeFramePyramidSets(uint32_t frame);
+		void readResults(uint32_t frame);
+
+		bool m_supported = false;
+
+		// Pipelines
+		vk::DescriptorSetLayout m_VK_pyramidSetLayout;
+		vk::PipelineLayout      m_VK_pyramidPipelineLayout;
+		vk::Pipeline            m_VK_pyramidPipeline;
+
+		vk::DescriptorSetLayout m_VK_cullSetLayout;
+		vk::PipelineLayout      m_VK_cullPipelineLayout;
+		vk::Pipeline            m_VK_cullPipeline;
+
+		vk::DescriptorPool             m_VK_descriptorPool;
+		std::vector<vk::DescriptorSet> mv_VK_pyramidDescriptorSets; // One per mip per frame in flight, each reads the level above it
+		std::vector<vk::DescriptorSet> mv_VK_cullDescriptorSets;    // One per frame in flight
+
+		// Depth pyramid, R32 float with conservative (furthest) depth in every texel
+		vk::Image                  m_VK_pyramidImage;
+		VmaAllocation              m_VMA_pyramidAllocation = VK_NULL_HANDLE;
+		vk::ImageView              m_VK_pyramidView;       // Every mip, for the cull pass
+		std::vector<vk::ImageView> mv_VK_pyramidMipViews; // Single mips, for the reduction
+		vk::Extent2D               m_pyramidExtent{ 0, 0 };
+		vk::Extent2D               m_depthExtent{ 0, 0 };
+		uint32_t                   m_pyramidLevels = 0;
+
+		// The pyramid and depth source change under frames in flight (resizes, MSAA), so every change bumps the
+		// generation and each frame rewrites its own sets once it's free
+		vk::ImageView                            m_VK_depthSourceView;
+		uint32_t                                 m_pyramidGeneration = 0;
+		std::array<uint32_t, kMaxFramesInFlight> m_framePyramidGeneration{};
+
+		// Per frame buffers (the CPU rewrites them every frame)
+		std::vector<vk::Buffer>    mv_VK_objectBuffers;
+		std::vector<VmaAllocation> mv_VMA_objectAllocations;
+		std::vector<void*>         mv_objectBuffersMapped;
+
+		std::vector<vk::Buffer>    mv_VK_phaseOneDrawBuffers;
+		std::vector<VmaAllocation> mv_VMA_phaseOneDrawAllocations;
+		std::vector<void*>         mv_phaseOneDrawBuffersMapped;
+
+		std::vector<vk::Buffer>    mv_VK_phaseTwoDrawBuffers;
+		std::vector<VmaAllocation> mv_VMA_phaseTwoDrawAllocations;
+		std::vector<void*>         mv_phaseTwoDrawBuffersMapped;
+
+		std::vector<vk::Buffer>    mv_VK_resultsBuffers;
+		std::vector<VmaAllocation> mv_VMA_resultsAllocations;
+		std::vector<void*>         mv_resultsBuffersMapped;
+
+		// Last frame's visibility, only ever touched by the GPU so there's just the one
+		vk::Buffer    m_VK_historyBuffer;
+		VmaAllocation m_VMA_historyAllocation = VK_NULL_HANDLE;
+
+		size_t m_objectCapacity = 0;
+		size_t m_drawCapacity = 0;
+
+		std::array<uint32_t, kMaxFramesInFlight> m_frameObjectCount{};
+		std::array<bool, kMaxFramesInFlight>     m_frameSubmitted{};
+		std::array<bool, kMaxFramesInFlight>     m_frameWritesVisibility{};
+		bool                                     m_objectVisibilityRequested = false;
+
+		std::vector<uint32_t> mv_firstDraw;
+		std::vector<uint32_t> mv_objectVisibility;
+		OcclusionStats        m_stats{};
+
+		Craig::Device*         mp_Device = nullptr;
+		Craig::CommandManager* mp_CommandManager = nullptr;
+		vk::SurfaceKHR         m_OC_surface;
+		vk::Format             m_OC_depthFormat;
+		vk::PipelineCache      m_OC_pipelineCache;
+	};
+
+}
@@ -1,5 +1,27 @@
 #include "Craig_Pipeline.hpp"
 
+#include <chrono>
+#include <cstdio>
+
+#include "Craig/Craig_Profiler.hpp"
+#include "Craig/Craig_Log.hpp"
+
+size_t Craig::PipelineVariantKeyHash::operator()(const PipelineVariantKey& key) const {
+
+    size_t hash = 0;
+    auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    };
+
+    combine(static_cast<size_t>(key.samples));
+    combine(static_cast<size_t>(key.colourFormat));
+    combine(static_cast<size_t>(key.depthFormat));
+    combine(static_cast<size_t>(static_cast<VkCullModeFlags>(key.cullMode)));
+    combine(static_cast<size_t>(key.blendEnabled));
+
+    return hash;
+}
+
 CraigError Craig::Pipeline::init(const PipelineInitInfo& info) {
 
 	CraigError ret = CRAIG_SUCCESS;
@@ -7,27 +29,75 @@ CraigError Craig::Pipeline::init(const PipelineInitInfo& info) {
     mPipe_device = info.device;
     mPipe_colorFormat = info.colorFormat;
     mPipe_depthFormat = info.depthFormat;
-    mPipe_msaaSamples = info.msaaSamples;
+    mPipe_pipelineCache = info.pipelineCache;
 
     createDescriptorSetLayout();
-    createGraphicsPipeline();
+    createShaderModules();
+    createPipelineLayout();
+
+    // The first variant gets built right here, we can't draw anything without it
+    m_activeVariantKey = makeVariantKey(info.msaaSamples);
+    createVariant(m_activeVariantKey, m_activeVariant);
+    mMap_variants[m_activeVariantKey] = m_activeVariant;
+
+    m_compileThread = std::thread(&Craig::Pipeline::compileThreadMain, this);
 
 	return ret;
 }
 
-void Craig::Pipeline::createGraphicsPipeline() {
+void Craig::Pipeline::createShaderModules() {
 
     // Compile HLSL shaders to SPIR-V shader modules
 #if defined(_WIN32)
     m_VK_vertShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/VertexShader.vert");
     m_VK_fragShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/FragmentShader.frag");
+    m_VK_depthPrePassShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/DepthPrePass.vert");
+    m_VK_overdrawShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/Overdraw.frag");
 #elif defined(__APPLE__) || defined(__linux__)
 
     m_VK_vertShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/vert.spv");
     m_VK_fragShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/frag.spv");
+    m_VK_depthPrePassShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/depthPrePass.spv");
+    m_VK_overdrawShaderModule = Craig::ShaderCompilation::CompileHLSLToShaderModule(mPipe_device, L"data/shaders/overdraw.spv");
 #endif
 
+}
+
+void Craig::Pipeline::createPipelineLayout() {
+
+    vk::PushConstantRange pushRange{};
+    pushRange
+        .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+        .setOffset(0)
+        .setSize(sizeof(uint32_t));
+
+    std::array setLayouts = { m_VK_perFrameSetLayout, m_VK_perObjectSetLayout };
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo
+        .setSetLayouts(setLayouts)
+        .setPushConstantRanges(pushRange);
+
+    try {
+        m_VK_pipelineLayout = mPipe_device.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch (const vk::SystemError& err) {
+        throw std::runtime_error("failed to createPipelineLayout!");
+    }
+}
+
+Craig::PipelineVariantKey Craig::Pipeline::makeVariantKey(vk::SampleCountFlagBits samples) const {
+
+    PipelineVariantKey key;
+    key.samples = samples;
+    key.colourFormat = mPipe_colorFormat;
+    key.depthFormat = mPipe_depthFormat;
+    return key;
+}
 
+// Doesn't touch any members apart from the shader modules and layout, which never change after init,
+// so the compile thread can run this while the main thread carries on rendering.
+// Fills the variant in as it goes, so if one of the pipelines throws, whatever got built before it is still in there to destroy.
+void Craig::Pipeline::createVariant(const PipelineVariantKey& key, PipelineVariant& variant) const {
 
     // Set up shader stages for the pipeline
     vk::PipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -71,16 +141,15 @@ void Craig::Pipeline::createGraphicsPipeline() {
         .setDepthClampEnable(vk::False)
         .setPolygonMode(vk::PolygonMode::eFill)
         .setLineWidth(1.0f)
-        .setCullMode(vk::CullModeFlagBits::eBack)
+        .setCullMode(key.cullMode)
         .setFrontFace(vk::FrontFace::eCounterClockwise)
         .setDepthBiasEnable(false);
 
     //Multisampling/Anti-Aliasing
-    //Keeping it disabled for now but will follow up later in the tutorial
     vk::PipelineMultisampleStateCreateInfo multisampling{};
     multisampling
         .setSampleShadingEnable(vk::False)
-        .setRasterizationSamples(*mPipe_msaaSamples);
+        .setRasterizationSamples(key.samples);
 
     vk::PipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil
@@ -97,7 +166,13 @@ void Craig::Pipeline::createGraphicsPipeline() {
         vk::ColorComponentFlagBits::eG |
         vk::ColorComponentFlagBits::eB |
         vk::ColorComponentFlagBits::eA)
-        .setBlendEnable(vk::False);
+        .setBlendEnable(key.blendEnabled)
+        .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+        .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+        .setColorBlendOp(vk::BlendOp::eAdd)
+        .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+        .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
+        .setAlphaBlendOp(vk::BlendOp::eAdd);
 
     vk::PipelineColorBlendStateCreateInfo colourBlending{};
     colourBlending
@@ -117,32 +192,8 @@ void Craig::Pipeline::createGraphicsPipeline() {
         .setDynamicStateCount(static_cast<uint32_t>(dynamicStates.size()))
         .setPDynamicStates(dynamicStates.data());
 
-
-    vk::PushConstantRange pushRange{};
-    pushRange
-        .setStageFlags(vk::ShaderStageFlagBits::eVertex)
-        .setOffset(0)
-        .setSize(sizeof(uint32_t));
-
-    std::array setLayouts = { m_VK_perFrameSetLayout, m_VK_perObjectSetLayout };
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo
-        .setSetLayouts(setLayouts)
-        .setPushConstantRanges(pushRange);
-
-    
-
-
-
-    try {
-        m_VK_pipelineLayout = mPipe_device.createPipelineLayout(pipelineLayoutInfo);
-    }
-    catch (const vk::SystemError& err) {
-        throw std::runtime_error("failed to createPipelineLayout!");
-    }
-
-    vk::Format colorFormat = mPipe_colorFormat;
-    vk::Format depthFormat = mPipe_depthFormat;
+    vk::Format colorFormat = key.colourFormat;
+    vk::Format depthFormat = key.depthFormat;
 
     vk::PipelineRenderingCreateInfo renderingInfo{};
     renderingInfo
@@ -168,22 +219,238 @@ void Craig::Pipeline::createGraphicsPipeline() {
         .setRenderPass(VK_NULL_HANDLE); //Needs to be null as we're using a dynamic renderer
 
 
-    auto result = mPipe_device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineInfo);
+    auto result = mPipe_device.createGraphicsPipeline(mPipe_pipelineCache, pipelineInfo);
 
     if (result.result != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to create graphics pipeline!");
     }
-    m_VK_graphicsPipeline = result.value;
+    variant.graphics = result.value;
 
+    // Colour pass that runs after the depth pre-pass. Depth is already final so only the exact surface passes
+    // and every pixel gets shaded once.
+    depthStencil
+        .setDepthWriteEnable(false)
+        .setDepthCompareOp(vk::CompareOp::eEqual);
+
+    result = mPipe_device.createGraphicsPipeline(mPipe_pipelineCache, pipelineInfo);
+
+    if (result.result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create depth equal pipeline!");
+    }
+    variant.depthEqual = result.value;
+
+    // Overdraw view. Same vertex shader, but every fragment adds a fixed amount to the colour whether it's hidden or not,
+    // so what ends up on screen is how many times each pixel got covered.
+    vk::PipelineShaderStageCreateInfo overdrawStageInfo{};
+    overdrawStageInfo
+        .setStage(vk::ShaderStageFlagBits::eFragment)
+        .setModule(m_VK_overdrawShaderModule)
+        .setPName("main");
+
+    vk::PipelineShaderStageCreateInfo overdrawStages[] = { vertShaderStageInfo, overdrawStageInfo };
+
+    depthStencil
+        .setDepthTestEnable(false)
+        .setDepthWriteEnable(false);
+
+    vk::PipelineColorBlendAttachmentState additiveBlendAttachment = colourBlendAttachment;
+    additiveBlendAttachment
+        .setBlendEnable(true)
+        .setSrcColorBlendFactor(vk::BlendFactor::eOne)
+        .setDstColorBlendFactor(vk::BlendFactor::eOne)
+        .setColorBlendOp(vk::BlendOp::eAdd)
+        .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+        .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
+        .setAlphaBlendOp(vk::BlendOp::eAdd);
+
+    vk::PipelineColorBlendStateCreateInfo additiveBlending = colourBlending;
+    additiveBlending.setPAttachments(&additiveBlendAttachment);
+
+    pipelineInfo
+        .setPStages(overdrawStages)
+        .setPColorBlendState(&additiveBlending);
 
+    result = mPipe_device.createGraphicsPipeline(mPipe_pipelineCache, pipelineInfo);
+
+    if (result.result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create overdraw pipeline!");
+    }
+    variant.overdraw = result.value;
+
+    depthStencil.setDepthTestEnable(true);
+
+    // Depth pre-pass. Vertex shader only, positions come from the packed stream and there's no colour attachment at all.
+    vk::PipelineShaderStageCreateInfo depthPrePassStageInfo{};
+    depthPrePassStageInfo
+        .setStage(vk::ShaderStageFlagBits::eVertex)
+        .setModule(m_VK_depthPrePassShaderModule)
+        .setPName("main");
+
+    vk::VertexInputBindingDescription   positionBindingDescription = Vertex::getPositionBindingDescription();
+    vk::VertexInputAttributeDescription positionAttributeDescription = Vertex::getPositionAttributeDescription();
+
+    vk::PipelineVertexInputStateCreateInfo positionInputInfo{};
+    positionInputInfo
+        .setVertexBindingDescriptionCount(1)
+        .setPVertexBindingDescriptions(&positionBindingDescription)
+        .setVertexAttributeDescriptionCount(1)
+        .setPVertexAttributeDescriptions(&positionAttributeDescription);
+
+    depthStencil
+        .setDepthWriteEnable(true)
+        .setDepthCompareOp(vk::CompareOp::eLess);
+
+    vk::PipelineColorBlendStateCreateInfo noColourBlending{};
+    noColourBlending
+        .setLogicOpEnable(vk::False)
+        .setAttachmentCount(0);
+
+    vk::PipelineRenderingCreateInfo depthOnlyRenderingInfo{};
+    depthOnlyRenderingInfo
+        .setColorAttachmentCount(0)
+        .setDepthAttachmentFormat(depthFormat);
+
+    pipelineInfo
+        .setPNext(&depthOnlyRenderingInfo)
+        .setStageCount(1)
+        .setPStages(&depthPrePassStageInfo)
+        .setPVertexInputState(&positionInputInfo)
+        .setPColorBlendState(&noColourBlending);
+
+    result = mPipe_device.createGraphicsPipeline(mPipe_pipelineCache, pipelineInfo);
+
+    if (result.result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create depth pre-pass pipeline!");
+    }
+    variant.depthPrePass = result.value;
+}
+
+void Craig::Pipeline::destroyVariant(const PipelineVariant& variant) const {
+
+    if (variant.graphics) {
+        mPipe_device.destroyPipeline(variant.graphics);
+    }
+
+    if (variant.depthEqual) {
+        mPipe_device.destroyPipeline(variant.depthEqual);
+    }
+
+    if (variant.depthPrePass) {
+        mPipe_device.destroyPipeline(variant.depthPrePass);
+    }
+
+    if (variant.overdraw) {
+        mPipe_device.destroyPipeline(variant.overdraw);
+    }
+}
+
+void Craig::Pipeline::requestVariant(const PipelineVariantKey& key) {
+
+    {
+        std::lock_guard<std::mutex> lock(m_variantMutex);
+
+        if (mMap_variants.contains(key) || mSet_queuedVariants.contains(key) || mSet_failedVariants.contains(key)) {
+            return;
+        }
+
+        mSet_queuedVariants.insert(key);
+        m_compileQueue.push_back(key);
+    }
+
+    m_compileCondition.notify_one();
+}
+
+bool Craig::Pipeline::isVariantReady(const PipelineVariantKey& key) {
+
+    std::lock_guard<std::mutex> lock(m_variantMutex);
+    return mMap_variants.contains(key);
+}
+
+bool Craig::Pipeline::isVariantFailed(const PipelineVariantKey& key) {
+
+    std::lock_guard<std::mutex> lock(m_variantMutex);
+    return mSet_failedVariants.contains(key);
+}
+
+bool Craig::Pipeline::setActiveVariant(const PipelineVariantKey& key) {
+
+    std::lock_guard<std::mutex> lock(m_variantMutex);
+
+    auto variant = mMap_variants.find(key);
+    if (variant == mMap_variants.end()) {
+        return false;
+    }
+
+    m_activeVariant = variant->second;
+    m_activeVariantKey = key;
+    return true;
+}
+
+size_t Craig::Pipeline::getCompiledVariantCount() {
+
+    std::lock_guard<std::mutex> lock(m_variantMutex);
+    return mMap_variants.size();
+}
+
+// Builds whatever gets queued, one variant at a time. The pipeline cache is internally synchronised so it's
+// fine to share with the main thread.
+void Craig::Pipeline::compileThreadMain() {
+
+    CRAIG_PROFILE_THREAD_NAME("Pipeline compile");
+
+    while (true) {
+        PipelineVariantKey key;
+        {
+            std::unique_lock<std::mutex> lock(m_variantMutex);
+            m_compileCondition.wait(lock, [this]() { return m_stopCompiling || !m_compileQueue.empty(); });
+
+            if (m_stopCompiling) {
+                return;
+            }
+
+            key = m_compileQueue.front();
+            m_compileQueue.pop_front();
+        }
+
+        CRAIG_PROFILE_ZONE("Pipeline::createVariant");
+        auto start = std::chrono::steady_clock::now();
+        PipelineVariant variant;
+        try {
+            createVariant(key, variant);
+        }
+        catch (const std::runtime_error& err) {
+            // Whatever's active keeps getting used, and it won't get queued again
+            destroyVariant(variant);
+            {
+                std::lock_guard<std::mutex> lock(m_variantMutex);
+                mSet_failedVariants.insert(key);
+                mSet_queuedVariants.erase(key);
+            }
+            CRAIG_LOG_ERROR(ePipeline, "Couldn't compile the pipeline variant with %ux MSAA: %s\n", static_cast<uint32_t>(key.samples), err.what());
+            continue;
+        }
+        float compileMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_variantMutex);
+            mMap_variants[key] = variant;
+            mSet_queuedVariants.erase(key);
+        }
+
+        CRAIG_LOG_INFO(ePipeline, "Compiled pipeline variant with %ux MSAA in the background (%.1f ms)\n", static_cast<uint32_t>(key.samples), compileMs);
+    }
 }
 
 void Craig::Pipeline::cleanupGraphicsPipeline() {
 
-    if (m_VK_graphicsPipeline) {
-        mPipe_device.destroyPipeline(m_VK_graphicsPipeline);
-        m_VK_graphicsPipeline = nullptr;
+    for (auto& [key, variant] : mMap_variants) {
+        destroyVariant(variant);
     }
+    mMap_variants.clear();
+    mSet_queuedVariants.clear();
+    mSet_failedVariants.clear();
+    m_compileQueue.clear();
+    m_activeVariant = PipelineVariant{};
 
     if (m_VK_pipelineLayout) {
         mPipe_device.destroyPipelineLayout(m_VK_pipelineLayout);
@@ -200,6 +467,16 @@ void Craig::Pipeline::cleanupGraphicsPipeline() {
         m_VK_fragShaderModule = nullptr;
     }
 
+    if (m_VK_depthPrePassShaderModule) {
+        mPipe_device.destroyShaderModule(m_VK_depthPrePassShaderModule);
+        m_VK_depthPrePassShaderModule = nullptr;
+    }
+
+    if (m_VK_overdrawShaderModule) {
+        mPipe_device.destroyShaderModule(m_VK_overdrawShaderModule);
+        m_VK_overdrawShaderModule = nullptr;
+    }
+
 }
 
 
@@ -210,10 +487,11 @@ void Craig::Pipeline::cleanupGraphicsPipeline() {
 void Craig::Pipeline::createDescriptorSetLayout() {
 
 
+    // Dynamic so the camera data can sit anywhere in the transient ring
     vk::DescriptorSetLayoutBinding cameraLayoutBinding{};
     cameraLayoutBinding
         .setBinding(0)
-        .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+        .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
         .setDescriptorCount(1)
         .setStageFlags(vk::ShaderStageFlagBits::eVertex);
 
@@ -257,17 +535,19 @@ CraigError Craig::Pipeline::terminate() {
 
 	CraigError ret = CRAIG_SUCCESS;
 
+    // Let the compile thread finish whatever it's in the middle of before pulling everything out from under it
+    {
+        std::lock_guard<std::mutex> lock(m_variantMutex);
+        m_stopCompiling = true;
+    }
+    m_compileCondition.notify_one();
+    if (m_compileThread.joinable()) {
+        m_compileThread.join();
+    }
+
     cleanupGraphicsPipeline();
     mPipe_device.destroyDescriptorSetLayout(m_VK_perFrameSetLayout);
     mPipe_device.destroyDescriptorSetLayout(m_VK_perObjectSetLayout);
 
 	return ret;
 }
-
-void Craig::Pipeline::recreate()
-{
-    cleanupGraphicsPipeline();
-    createGraphicsPipeline();
-}
-
-
@@ -1,4 +1,10 @@
 #pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vulkan/vulkan.hpp>
 
 
@@ -9,6 +15,23 @@
 
 namespace Craig {
 
+	// Everything baked into a scene pipeline that we might want to change at runtime
+	struct PipelineVariantKey
+	{
+		vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+		vk::Format              colourFormat = vk::Format::eUndefined;
+		vk::Format              depthFormat = vk::Format::eUndefined;
+		vk::CullModeFlags       cullMode = vk::CullModeFlagBits::eBack;
+		bool                    blendEnabled = false;
+
+		bool operator==(const PipelineVariantKey& other) const = default;
+	};
+
+	struct PipelineVariantKeyHash
+	{
+		size_t operator()(const PipelineVariantKey& key) const;
+	};
+
 	class Pipeline {
 	public:
 		//All the stuff we need to pass to the RenderingAttachments from the renderer
@@ -17,16 +40,40 @@ namespace Craig {
 			vk::Device     device;
 			vk::Format		colorFormat;
 			vk::Format		depthFormat;
-			vk::SampleCountFlagBits* msaaSamples;
+			vk::SampleCountFlagBits msaaSamples;
+			vk::PipelineCache pipelineCache;
+
+		};
 
+		// The scene pipelines for one set of state
+		struct PipelineVariant
+		{
+			vk::Pipeline graphics;
+			vk::Pipeline depthEqual;
+			vk::Pipeline depthPrePass;
+			vk::Pipeline overdraw;
 		};
 
 		CraigError init(const PipelineInitInfo& info);
 		CraigError terminate();
 
-		void recreate();
+		// Same formats as the current variant, just a different sample count
+		PipelineVariantKey makeVariantKey(vk::SampleCountFlagBits samples) const;
+
+		// Queues the variant up on the compile thread if it isn't built or already on the way
+		void requestVariant(const PipelineVariantKey& key);
+		bool isVariantReady(const PipelineVariantKey& key);
+		bool isVariantFailed(const PipelineVariantKey& key); // Threw while compiling, it won't be tried again
 
-		const vk::Pipeline getGraphicsPipeline() const { return m_VK_graphicsPipeline; }
+		// Only switches if the variant has finished compiling, otherwise we keep drawing with the current one
+		bool setActiveVariant(const PipelineVariantKey& key);
+		const PipelineVariantKey& getActiveVariantKey() const { return m_activeVariantKey; }
+		size_t getCompiledVariantCount();
+
+		const vk::Pipeline getGraphicsPipeline() const { return m_activeVariant.graphics; }
+		const vk::Pipeline getDepthPrePassPipeline() const { return m_activeVariant.depthPrePass; }   // Position stream only, no colour attachment
+		const vk::Pipeline getDepthEqualPipeline() const { return m_activeVariant.depthEqual; }       // Colour pass after a pre-pass, eEqual and no depth writes
+		const vk::Pipeline getOverdrawPipeline() const { return m_activeVariant.overdraw; }           // Debug view, adds up every fragment with no depth test
 		const vk::DescriptorSetLayout getPerFrameDescriptorSetLayout() const { return m_VK_perFrameSetLayout; }
 		const vk::DescriptorSetLayout getPerObjectDescriptorSetLayout() const { return m_VK_perObjectSetLayout; }
 		const vk::PipelineLayout getPipelineLayout() const { return m_VK_pipelineLayout; }
@@ -35,23 +82,41 @@ namespace Craig {
 		// Shaders / pipeline
 		vk::ShaderModule       m_VK_vertShaderModule;
 		vk::ShaderModule       m_VK_fragShaderModule;
+		vk::ShaderModule       m_VK_depthPrePassShaderModule;
+		vk::ShaderModule       m_VK_overdrawShaderModule;
 
 		vk::DescriptorSetLayout m_VK_perFrameSetLayout;
 		vk::DescriptorSetLayout m_VK_perObjectSetLayout;
 		vk::PipelineLayout      m_VK_pipelineLayout;
-		vk::Pipeline            m_VK_graphicsPipeline;
+
+		PipelineVariant    m_activeVariant;
+		PipelineVariantKey m_activeVariantKey;
+
+		// Every variant we've built, they stick around until shutdown so switching back is free
+		std::unordered_map<PipelineVariantKey, PipelineVariant, PipelineVariantKeyHash> mMap_variants;
+		std::unordered_set<PipelineVariantKey, PipelineVariantKeyHash>                  mSet_queuedVariants;
+		std::unordered_set<PipelineVariantKey, PipelineVariantKeyHash>                  mSet_failedVariants;
+		std::deque<PipelineVariantKey> m_compileQueue;
+		std::mutex                     m_variantMutex;
+		std::condition_variable        m_compileCondition;
+		std::thread                    m_compileThread;
+		bool                           m_stopCompiling = false;
 
 		vk::Device		mPipe_device;
 		vk::Format		mPipe_colorFormat;
 		vk::Format		mPipe_depthFormat;
-		vk::SampleCountFlagBits* mPipe_msaaSamples;
+		vk::PipelineCache mPipe_pipelineCache;
 
-		void createGraphicsPipeline();
+		void createShaderModules();
+		void createPipelineLayout();
+		void createVariant(const PipelineVariantKey& key, PipelineVariant& variant) const;
+		void destroyVariant(const PipelineVariant& variant) const;
 		void cleanupGraphicsPipeline();
 		void createDescriptorSetLayout();
+		void compileThreadMain();
 
 	};
 
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,128 @@
+#include "Craig_PipelineCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "Craig/Craig_Log.hpp"
+
+CraigError Craig::PipelineCache::init(const PipelineCacheInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	m_PC_device = info.device;
+	m_PC_physicalDevice = info.physicalDevice;
+	m_PC_path = info.path;
+
+	std::vector<char> data;
+	std::ifstream file(m_PC_path, std::ios::binary | std::ios::ate);
+	if (file.is_open()) {
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		file.close();
+	}
+
+	// A cache from a different GPU or driver is useless at best, so anything that doesn't match just gets thrown away
+	if (!data.empty() && !isHeaderValid(data)) {
+		CRAIG_LOG_WARN(ePipeline, "Pipeline cache at %s was made by a different device or driver, starting from scratch\n", m_PC_path.c_str());
+		data.clear();
+	}
+
+	vk::PipelineCacheCreateInfo cacheInfo{};
+	cacheInfo
+		.setInitialDataSize(data.size())
+		.setPInitialData(data.empty() ? nullptr : data.data());
+
+	try {
+		m_VK_pipelineCache = m_PC_device.createPipelineCache(cacheInfo);
+	}
+	catch (const vk::SystemError& err) {
+		// Drivers are allowed to reject the data even when the header checks out, so try again empty
+		CRAIG_LOG_WARN(ePipeline, "Driver rejected the pipeline cache at %s, starting from scratch\n", m_PC_path.c_str());
+		data.clear();
+		m_VK_pipelineCache = m_PC_device.createPipelineCache(vk::PipelineCacheCreateInfo{});
+	}
+
+	m_loadedFromDisk = !data.empty();
+	m_lastSavedSize = data.size();
+
+	CRAIG_LOG_INFO(ePipeline, "Pipeline cache: %s (%zu bytes)\n", m_loadedFromDisk ? "warm, loaded from disk" : "cold", data.size());
+
+	return ret;
+}
+
+// Header layout is VkPipelineCacheHeaderVersionOne: size, version, vendor ID, device ID, then the cache UUID
+bool Craig::PipelineCache::isHeaderValid(const std::vector<char>& data) const {
+
+	if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+		return false;
+	}
+
+	VkPipelineCacheHeaderVersionOne header{};
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	vk::PhysicalDeviceProperties properties = m_PC_physicalDevice.getProperties();
+
+	return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne)
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == properties.vendorID
+		&& header.deviceID == properties.deviceID
+		&& std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+void Craig::PipelineCache::update(const float& deltaTime) {
+
+	m_timeSinceSave += deltaTime;
+
+	if (m_timeSinceSave < kPipelineCacheSaveInterval) {
+		return;
+	}
+
+	m_timeSinceSave = 0.0f;
+	save();
+}
+
+void Craig::PipelineCache::save() {
+
+	std::vector<uint8_t> data = m_PC_device.getPipelineCacheData(m_VK_pipelineCache);
+
+	// Nothing new got compiled since last time
+	if (data.empty() || data.size() == m_lastSavedSize) {
+		return;
+	}
+
+	// Write somewhere else first and swap it in, so a crash halfway through doesn't leave a broken cache behind
+	std::string tempPath = m_PC_path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		CRAIG_LOG_WARN(ePipeline, "Couldn't open %s to save the pipeline cache\n", tempPath.c_str());
+		return;
+	}
+
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	file.close();
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_PC_path, error);
+	if (error) {
+		CRAIG_LOG_WARN(ePipeline, "Couldn't save the pipeline cache to %s: %s\n", m_PC_path.c_str(), error.message().c_str());
+		return;
+	}
+
+	m_lastSavedSize = data.size();
+}
+
+CraigError Craig::PipelineCache::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	save();
+
+	m_PC_device.destroyPipelineCache(m_VK_pipelineCache);
+	m_VK_pipelineCache = nullptr;
+
+	return ret;
+}
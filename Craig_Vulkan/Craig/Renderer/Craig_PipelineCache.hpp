@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vulkan/vulkan.hpp>
+
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+
+	// VkPipelineCache that survives between runs. Loaded from disk at startup (as long as it was made by the same
+	// driver on the same GPU), handed to every pipeline we create, and written back out at shutdown and every so often.
+	class PipelineCache {
+
+	public:
+		struct PipelineCacheInitInfo
+		{
+			vk::Device         device;
+			vk::PhysicalDevice physicalDevice;
+			std::string        path = kPipelineCachePath;
+		};
+
+		CraigError init(const PipelineCacheInitInfo& info);
+		CraigError terminate();
+
+		// Saves every kPipelineCacheSaveInterval seconds, but only if the cache picked up anything new
+		void update(const float& deltaTime);
+		void save();
+
+		vk::PipelineCache getCache() const { return m_VK_pipelineCache; }
+		bool wasLoadedFromDisk() const { return m_loadedFromDisk; }
+
+	private:
+		bool isHeaderValid(const std::vector<char>& data) const;
+
+		vk::PipelineCache m_VK_pipelineCache;
+		bool              m_loadedFromDisk = false;
+		size_t            m_lastSavedSize = 0;
+		float             m_timeSinceSave = 0.0f;
+
+		vk::Device         m_PC_device;
+		vk::PhysicalDevice m_PC_physicalDevice;
+		std::string        m_PC_path;
+	};
+
+}
@@ -0,0 +1,161 @@
+#include "Craig_PipelineStatistics.hpp"
+
+#include <cstdio>
+
+#include "Craig_Device.hpp"
+#include "Craig/Craig_Log.hpp"
+
+// Has to match the enum, which has to match the order of the flag bits
+static const vk::QueryPipelineStatisticFlags kStatisticFlags =
+	vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+	vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+	vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+	vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+	vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+	vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+	vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+
+static const char* const kStatisticNames[] = {
+	"Input vertices",
+	"Input primitives",
+	"Vertex shader invocations",
+	"Clipping invocations",
+	"Clipping primitives",
+	"Fragment shader invocations",
+	"Compute shader invocations",
+};
+static_assert(sizeof(kStatisticNames) / sizeof(kStatisticNames[0]) == Craig::PipelineStatistics::kNumStatistics, "Every statistic needs a name");
+
+CraigError Craig::PipelineStatistics::init(const PipelineStatisticsInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+
+	// The device gets made with every feature the GPU has switched on, so it's just whether it's there at all
+	m_supported = mp_Device->getPhysicalDevice().getFeatures().pipelineStatisticsQuery == vk::True;
+	if (!m_supported) {
+		CRAIG_LOG_WARN(eProfiling, "Pipeline statistics queries aren't supported on this device\n");
+		return ret;
+	}
+
+	vk::QueryPoolCreateInfo poolInfo{};
+	poolInfo
+		.setQueryType(vk::QueryType::ePipelineStatistics)
+		.setQueryCount(kMaxFramesInFlight)
+		.setPipelineStatistics(kStatisticFlags);
+
+	m_VK_queryPool = mp_Device->getLogicalDevice().createQueryPool(poolInfo);
+
+	return ret;
+}
+
+const char* Craig::PipelineStatistics::getName(Statistic statistic) {
+
+	uint32_t index = static_cast<uint32_t>(statistic);
+	return index < kNumStatistics ? kStatisticNames[index] : "Unknown";
+}
+
+void Craig::PipelineStatistics::beginFrame(vk::CommandBuffer commandBuffer, uint32_t frame) {
+
+	if (!m_supported) {
+		return;
+	}
+
+	m_currentFrame = frame;
+	m_frames[frame] = FrameQuery{};
+
+	commandBuffer.resetQueryPool(m_VK_queryPool, frame, 1);
+}
+
+void Craig::PipelineStatistics::begin(vk::CommandBuffer commandBuffer, vk::Extent2D extent) {
+
+	if (!m_supported) {
+		return;
+	}
+
+	FrameQuery& query = m_frames[m_currentFrame];
+	query.pixelCount = static_cast<uint64_t>(extent.width) * extent.height;
+	query.pending = true;
+
+	commandBuffer.beginQuery(m_VK_queryPool, m_currentFrame, vk::QueryControlFlags{});
+}
+
+void Craig::PipelineStatistics::end(vk::CommandBuffer commandBuffer) {
+
+	if (!m_supported || !m_frames[m_currentFrame].pending) {
+		return;
+	}
+
+	commandBuffer.endQuery(m_VK_queryPool, m_currentFrame);
+	m_frames[m_currentFrame].recorded = true;
+}
+
+bool Craig::PipelineStatistics::collectFrame(uint32_t frame) {
+
+	if (!m_supported) {
+		return false;
+	}
+
+	FrameQuery& query = m_frames[frame];
+	if (!query.pending || !query.recorded) {
+		return false;
+	}
+
+	// No wait flag, the fence has already been waited on. If they're not there we'd rather lose a sample than sit here.
+	Values values{};
+	vk::Result result = mp_Device->getLogicalDevice().getQueryPoolResults(
+		m_VK_queryPool,
+		frame,
+		1,
+		sizeof(values),
+		values.data(),
+		sizeof(values),
+		vk::QueryResultFlagBits::e64);
+
+	if (result != vk::Result::eSuccess) {
+		return false;
+	}
+
+	query.pending = false;
+
+	m_last = values;
+	m_lastPixelCount = query.pixelCount;
+	for (uint32_t i = 0; i < kNumStatistics; i++) {
+		double value = static_cast<double>(values[i]);
+		m_average[i] = m_haveAverage ? m_average[i] + (value - m_average[i]) * kGpuTimeSmoothing : value;
+	}
+	m_haveAverage = true;
+
+	return true;
+}
+
+void Craig::PipelineStatistics::discardPendingFrames() {
+
+	for (FrameQuery& query : m_frames) {
+		query.pending = false;
+	}
+}
+
+double Craig::PipelineStatistics::getFragmentsPerPixel() const {
+
+	if (m_lastPixelCount == 0) {
+		return 0.0;
+	}
+
+	return static_cast<double>(m_last[static_cast<uint32_t>(Statistic::eFragmentInvocations)]) / static_cast<double>(m_lastPixelCount);
+}
+
+CraigError Craig::PipelineStatistics::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	if (!m_supported) {
+		return ret;
+	}
+
+	mp_Device->getLogicalDevice().destroyQueryPool(m_VK_queryPool);
+	m_VK_queryPool = nullptr;
+
+	return ret;
+}
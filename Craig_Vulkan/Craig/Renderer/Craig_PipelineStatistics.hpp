@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <vulkan/vulkan.hpp>
+
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+	class Device;
+
+	// VK_QUERY_TYPE_PIPELINE_STATISTICS around the scene, so we can see what the GPU was actually asked to do rather
+	// than just how long it took. Same deal as the GPU profiler, one query per frame in flight and it's only read back
+	// once that frame's fence has been waited on, so nothing ever stalls on it.
+	// Needs the pipelineStatisticsQuery feature, without it everything here does nothing.
+	class PipelineStatistics {
+
+	public:
+		struct PipelineStatisticsInitInfo
+		{
+			Craig::Device* p_Device = nullptr;
+		};
+
+		// Same order the results come back in, which is lowest flag bit first
+		enum class Statistic : uint32_t {
+			eInputVertices = 0,
+			eInputPrimitives,
+			eVertexInvocations,
+			eClippingInvocations,
+			eClippingPrimitives,   // What's left after clipping, roughly the triangles that made it to the rasteriser
+			eFragmentInvocations,
+			eComputeInvocations,   // Occlusion cull and depth pyramid
+
+			eCount
+		};
+
+		static constexpr uint32_t kNumStatistics = static_cast<uint32_t>(Statistic::eCount);
+		using Values = std::array<uint64_t, kNumStatistics>;
+
+		CraigError init(const PipelineStatisticsInitInfo& info);
+		CraigError terminate();
+
+		// Recorded into the frame's command buffer. beginFrame resets the frame's query so it has to go outside of rendering,
+		// and so do begin and end, they can cover more than one rendering pass.
+		void beginFrame(vk::CommandBuffer commandBuffer, uint32_t frame);
+		void begin(vk::CommandBuffer commandBuffer, vk::Extent2D extent);
+		void end(vk::CommandBuffer commandBuffer);
+
+		// Once the frame's been waited on. False if it never got recorded or the results weren't there.
+		bool collectFrame(uint32_t frame);
+		void discardPendingFrames(); // Frame slots are about to get reused in a different order
+
+		bool isSupported() const { return m_supported; }
+		const Values& getLast() const { return m_last; }
+		const std::array<double, kNumStatistics>& getAverage() const { return m_average; } // Smoothed by kGpuTimeSmoothing
+		uint64_t getLastPixelCount() const { return m_lastPixelCount; } // Render area of the last frame collected
+
+		// Fragment shader invocations per pixel on screen. Anything much over 1 is overdraw (or MSAA sample shading).
+		double getFragmentsPerPixel() const;
+
+		static const char* getName(Statistic statistic);
+
+	private:
+		struct FrameQuery
+		{
+			uint64_t pixelCount = 0;
+			bool     recorded = false; // begin and end both made it in
+			bool     pending = false;
+		};
+
+		bool m_supported = false;
+
+		vk::QueryPool                              m_VK_queryPool; // One query per frame in flight
+		std::array<FrameQuery, kMaxFramesInFlight> m_frames;
+		uint32_t                                   m_currentFrame = 0;
+
+		Values                             m_last{};
+		std::array<double, kNumStatistics> m_average{};
+		uint64_t                           m_lastPixelCount = 0;
+		bool                               m_haveAverage = false;
+
+		Craig::Device* mp_Device = nullptr;
+	};
+
+}
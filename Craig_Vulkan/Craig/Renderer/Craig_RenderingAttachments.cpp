@@ -12,16 +12,21 @@ CraigError Craig::RenderingAttachments::init(const RenderingAttachmentsInitInfo&
 
 	m_VK_msaaSamples = getMaxUsableSampleCount();
 
+	vk::FormatProperties depthProperties = mRA_physicalDevice.getFormatProperties(findDepthFormat());
+	m_depthSamplingSupported = static_cast<bool>(depthProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+
 	return ret;
 }
 
 void Craig::RenderingAttachments::createColourResources(vk::Extent2D extent, vk::Format colourFormat) {
 
+	// Not transient anymore, with occlusion culling on the scene is drawn in two passes and the second one loads what the first stored
 	m_VK_colourImage = ImageHelpers::createImage(mRA_physicalDevice, mRA_surface, extent.width, extent.height, 1, m_VK_msaaSamples, colourFormat, vk::ImageTiling::eOptimal,
-		vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment,
+		vk::ImageUsageFlagBits::eColorAttachment,
 		vk::MemoryPropertyFlagBits::eDeviceLocal,
 		mRA_memoryAllocator,
-		m_VMA_colourImageAllocation);
+		m_VMA_colourImageAllocation,
+		"MSAA colour attachment");
 
 	m_VK_colourImageView = Craig::ImageHelpers::createImageView(mRA_device, m_VK_colourImage, colourFormat, vk::ImageAspectFlagBits::eColor, 1);
 
@@ -61,10 +66,22 @@ void Craig::RenderingAttachments::createDepthResources(vk::Extent2D extent) {
 
 	vk::Format depthFormat = findDepthFormat();
 
-	m_VK_depthImage = ImageHelpers::createImage(mRA_physicalDevice, mRA_surface, extent.width, extent.height, 1, m_VK_msaaSamples, depthFormat, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, mRA_memoryAllocator,m_VMA_depthImageAllocation);
+	vk::ImageUsageFlags depthUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+	if (m_depthSamplingSupported) {
+		depthUsage |= vk::ImageUsageFlagBits::eSampled;
+	}
+
+	m_VK_depthImage = ImageHelpers::createImage(mRA_physicalDevice, mRA_surface, extent.width, extent.height, 1, m_VK_msaaSamples, depthFormat, vk::ImageTiling::eOptimal, depthUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, mRA_memoryAllocator, m_VMA_depthImageAllocation, "Depth attachment");
 
 	m_VK_depthImageView = Craig::ImageHelpers::createImageView(mRA_device,m_VK_depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
 
+	// Can't read a multisampled depth image in the pyramid shader, so resolve sample 0 into a single sample one
+	if (m_VK_msaaSamples != vk::SampleCountFlagBits::e1 && m_depthSamplingSupported) {
+		m_VK_depthResolveImage = ImageHelpers::createImage(mRA_physicalDevice, mRA_surface, extent.width, extent.height, 1, vk::SampleCountFlagBits::e1, depthFormat, vk::ImageTiling::eOptimal, depthUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, mRA_memoryAllocator, m_VMA_depthResolveImageAllocation, "Depth resolve");
+
+		m_VK_depthResolveImageView = Craig::ImageHelpers::createImageView(mRA_device, m_VK_depthResolveImage, depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
+	}
+
 }
 
 vk::SampleCountFlagBits Craig::RenderingAttachments::getMaxUsableSampleCount() {
@@ -103,6 +120,52 @@ void Craig::RenderingAttachments::cleanupColourAndDepthImageViews() {
 	mRA_device.destroyImageView(m_VK_depthImageView);
 	vmaDestroyImage(mRA_memoryAllocator, m_VK_depthImage, m_VMA_depthImageAllocation);
 
+	if (m_VK_depthResolveImage) {
+		mRA_device.destroyImageView(m_VK_depthResolveImageView);
+		vmaDestroyImage(mRA_memoryAllocator, m_VK_depthResolveImage, m_VMA_depthResolveImageAllocation);
+		m_VK_depthResolveImage = nullptr;
+		m_VK_depthResolveImageView = nullptr;
+	}
+
+}
+
+void Craig::RenderingAttachments::retireColourAndDepthImages(Craig::DeletionQueue& deletionQueue) {
+
+	vk::Device device = mRA_device;
+	VmaAllocator allocator = mRA_memoryAllocator;
+
+	vk::Image colourImage = m_VK_colourImage;
+	vk::ImageView colourView = m_VK_colourImageView;
+	VmaAllocation colourAllocation = m_VMA_colourImageAllocation;
+	deletionQueue.push([=]() {
+		device.destroyImageView(colourView);
+		vmaDestroyImage(allocator, colourImage, colourAllocation);
+	});
+
+	vk::Image depthImage = m_VK_depthImage;
+	vk::ImageView depthView = m_VK_depthImageView;
+	VmaAllocation depthAllocation = m_VMA_depthImageAllocation;
+	deletionQueue.push([=]() {
+		device.destroyImageView(depthView);
+		vmaDestroyImage(allocator, depthImage, depthAllocation);
+	});
+
+	if (m_VK_depthResolveImage) {
+		vk::Image resolveImage = m_VK_depthResolveImage;
+		vk::ImageView resolveView = m_VK_depthResolveImageView;
+		VmaAllocation resolveAllocation = m_VMA_depthResolveImageAllocation;
+		deletionQueue.push([=]() {
+			device.destroyImageView(resolveView);
+			vmaDestroyImage(allocator, resolveImage, resolveAllocation);
+		});
+	}
+
+	m_VK_colourImage = nullptr;
+	m_VK_colourImageView = nullptr;
+	m_VK_depthImage = nullptr;
+	m_VK_depthImageView = nullptr;
+	m_VK_depthResolveImage = nullptr;
+	m_VK_depthResolveImageView = nullptr;
 }
 
 CraigError Craig::RenderingAttachments::terminate() {
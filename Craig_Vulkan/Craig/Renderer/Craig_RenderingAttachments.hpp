@@ -4,6 +4,7 @@
 
 #include "Craig/Craig_Constants.hpp"
 #include "Craig_Swapchain.hpp"
+#include "Craig_DeletionQueue.hpp"
 
 namespace Craig {
 
@@ -22,6 +23,9 @@ namespace Craig {
 		// MSAA / colour / depth
 		vk::SampleCountFlagBits m_VK_msaaSamples = vk::SampleCountFlagBits::e1;
 
+		// Whether we can read depth back in a shader (needed for the occlusion culling depth pyramid)
+		bool m_depthSamplingSupported = false;
+
 		CraigError init(const RenderingAttachmentsInitInfo& info);
 		CraigError terminate();
 
@@ -30,6 +34,8 @@ namespace Craig {
 
 		//Cleanup functions
 		void cleanupColourAndDepthImageViews();
+		// Hands the current images over to the deletion queue instead of destroying them, for when frames in flight might still use them
+		void retireColourAndDepthImages(Craig::DeletionQueue& deletionQueue);
 
 		//Utility functions
 		vk::Format findDepthFormat();
@@ -42,6 +48,12 @@ namespace Craig {
 
 		const vk::Image      getDepthImage() const { return m_VK_depthImage; };
 		const vk::ImageView  getDepthImageView() const {return m_VK_depthImageView; };
+
+		// Single sample copy of depth to read from in shaders. With MSAA on it's the resolve target, otherwise it's just the depth image.
+		const vk::Image      getDepthResolveImage() const { return m_VK_depthResolveImage; };
+		const vk::ImageView  getDepthResolveImageView() const { return m_VK_depthResolveImageView; };
+		const vk::Image      getSampledDepthImage() const { return m_VK_depthResolveImage ? m_VK_depthResolveImage : m_VK_depthImage; };
+		const vk::ImageView  getSampledDepthImageView() const { return m_VK_depthResolveImage ? m_VK_depthResolveImageView : m_VK_depthImageView; };
 	private:
 		vk::Image      m_VK_colourImage;
 		vk::ImageView  m_VK_colourImageView;
@@ -51,6 +63,10 @@ namespace Craig {
 		vk::ImageView  m_VK_depthImageView;
 		VmaAllocation  m_VMA_depthImageAllocation;
 
+		vk::Image      m_VK_depthResolveImage;
+		vk::ImageView  m_VK_depthResolveImageView;
+		VmaAllocation  m_VMA_depthResolveImageAllocation;
+
 		vk::Format findSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
 		vk::SampleCountFlagBits getMaxUsableSampleCount();
 
@@ -0,0 +1,144 @@
+#include "Craig_RingAllocator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Craig_Device.hpp"
+
+#include "Craig/Craig_Counters.hpp"
+#include "Craig/Craig_FlightRecorder.hpp"
+#include "Craig/Craig_Log.hpp"
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+CraigError Craig::RingAllocator::init(const RingAllocatorInitInfo& info) {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	mp_Device = info.p_Device;
+	m_RA_usage = info.usage;
+
+	createBuffer(info.initialSize);
+
+	return ret;
+}
+
+void Craig::RingAllocator::createBuffer(vk::DeviceSize size) {
+
+	// Host visible + mapped for the lifetime of the buffer, the CPU writes straight into it
+	VmaAllocationCreateInfo aci{};
+	aci.usage = VMA_MEMORY_USAGE_AUTO;
+	aci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	aci.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	VmaAllocationInfo info{};
+	mp_Device->createBufferVMA(size, m_RA_usage, aci, m_VK_buffer, m_VMA_allocation, "Transient ring", &info);
+
+	mp_mapped = static_cast<uint8_t*>(info.pMappedData);
+	m_capacity = size;
+}
+
+void Craig::RingAllocator::beginFrame(uint32_t frame) {
+
+	m_currentFrame = frame;
+
+	// This frame slot's last lot of allocations are done with
+	m_bytesInFlight -= m_frameBytes[frame];
+	m_frameBytes[frame] = 0;
+
+	// Anything retired kMaxFramesInFlight frames ago can't be referenced by the GPU any more
+	for (RetiredBuffer& retired : mv_retiredBuffers) {
+		if (retired.framesLeft > 0) {
+			retired.framesLeft--;
+		}
+	}
+
+	std::erase_if(mv_retiredBuffers, [this](const RetiredBuffer& retired) {
+		if (retired.framesLeft == 0) {
+			vmaDestroyBuffer(mp_Device->getVmaAllocator(), retired.buffer, retired.allocation);
+			return true;
+		}
+		return false;
+	});
+}
+
+void Craig::RingAllocator::releaseAllFrames() {
+
+	m_bytesInFlight = 0;
+	m_frameBytes.fill(0);
+}
+
+Craig::RingAllocator::Allocation Craig::RingAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+
+	alignment = std::max<vk::DeviceSize>(alignment, 1);
+
+	vk::DeviceSize offset = alignUp(m_head, alignment);
+	vk::DeviceSize consumed = offset - m_head + size;
+
+	// Doesn't fit before the end, so skip the tail and wrap round to the start. The skipped bytes count as used
+	// until this frame comes back round, same as the allocation itself.
+	if (offset + size > m_capacity) {
+		offset = 0;
+		consumed = (m_capacity - m_head) + size;
+	}
+
+	if (m_bytesInFlight + consumed > m_capacity) {
+		grow(size + alignment);
+		offset = 0;
+		consumed = size;
+	}
+
+	m_head = offset + size;
+	m_bytesInFlight += consumed;
+	m_frameBytes[m_currentFrame] += consumed;
+	CRAIG_COUNT(eTransientBytes, size);
+
+	Allocation allocation;
+	allocation.buffer = m_VK_buffer;
+	allocation.offset = offset;
+	allocation.p_Mapped = mp_mapped + offset;
+
+	return allocation;
+}
+
+// Swaps to a bigger buffer instead of waiting for the GPU to hand space back. Whatever's in flight keeps reading
+// the old one, which hangs around until every frame in flight has been waited on once.
+void Craig::RingAllocator::grow(vk::DeviceSize minimumSize) {
+
+	RetiredBuffer retired;
+	retired.buffer = m_VK_buffer;
+	retired.allocation = m_VMA_allocation;
+	retired.framesLeft = kMaxFramesInFlight;
+	mv_retiredBuffers.push_back(retired);
+
+	vk::DeviceSize newSize = std::max(m_capacity * 2, minimumSize * 2);
+	CRAIG_LOG_WARN(eRenderer, "Transient ring buffer ran out of space, growing from %llu to %llu bytes\n", (unsigned long long)m_capacity, (unsigned long long)newSize);
+
+	createBuffer(newSize);
+	Craig::FlightRecorder::getInstance().addEvent(Craig::FlightEvent::eTransientRingGrown, "RingAllocator::grow", newSize);
+
+	// Everything that was in flight lives in the old buffer, the new one starts empty
+	m_head = 0;
+	m_bytesInFlight = 0;
+	m_frameBytes.fill(0);
+	m_generation++;
+}
+
+CraigError Craig::RingAllocator::terminate() {
+
+	CraigError ret = CRAIG_SUCCESS;
+
+	for (RetiredBuffer& retired : mv_retiredBuffers) {
+		vmaDestroyBuffer(mp_Device->getVmaAllocator(), retired.buffer, retired.allocation);
+	}
+	mv_retiredBuffers.clear();
+
+	vmaDestroyBuffer(mp_Device->getVmaAllocator(), m_VK_buffer, m_VMA_allocation);
+	m_VK_buffer = nullptr;
+	m_VMA_allocation = VK_NULL_HANDLE;
+	mp_mapped = nullptr;
+
+	return ret;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "../../External/vk_mem_alloc.h"
+
+#include "Craig/Craig_Constants.hpp"
+
+namespace Craig {
+	class Device;
+
+	// Persistently mapped ring buffer for data that only lives for one frame (camera data, per-draw bits).
+	// Every frame just keeps writing after the last one, and space comes back once the frame that used it
+	// has been waited on. If a frame wants more than is free we don't wait for the GPU, we swap to a buffer
+	// twice the size and let the old one die once nothing in flight can be reading it any more.
+	class RingAllocator {
+
+	public:
+		struct RingAllocatorInitInfo
+		{
+			Craig::Device*       p_Device = nullptr;
+			vk::BufferUsageFlags usage;
+			vk::DeviceSize       initialSize = kTransientRingInitialSize;
+		};
+
+		struct Allocation
+		{
+			vk::Buffer     buffer;
+			vk::DeviceSize offset = 0;
+			void*          p_Mapped = nullptr; // Already offset, just write into it
+		};
+
+		CraigError init(const RingAllocatorInitInfo& info);
+		CraigError terminate();
+
+		// Call once this frame's fence has been waited on, hands back whatever it used last time round
+		void beginFrame(uint32_t frame);
+
+		Allocation allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+		// Hands everything back at once. Only once the GPU's done with every frame (frames in flight changing).
+		void releaseAllFrames();
+
+		// Changes every time the ring grows into a new buffer, so descriptors pointing at the old one know to be rewritten
+		uint32_t getGeneration() const { return m_generation; }
+		vk::Buffer getBuffer() const { return m_VK_buffer; }
+		vk::DeviceSize getCapacity() const { return m_capacity; }
+		vk::DeviceSize getBytesInFlight() const { return m_bytesInFlight; }
+
+	private:
+		struct RetiredBuffer
+		{
+			vk::Buffer    buffer;
+			VmaAllocation allocation = VK_NULL_HANDLE;
+			uint32_t      framesLeft = 0;
+		};
+
+		void createBuffer(vk::DeviceSize size);
+		void grow(vk::DeviceSize minimumSize);
+
+		vk::Buffer     m_VK_buffer;
+		VmaAllocation  m_VMA_allocation = VK_NULL_HANDLE;
+		uint8_t*       mp_mapped = nullptr;
+		vk::DeviceSize m_capacity = 0;
+
+		vk::DeviceSize m_head = 0;          // Where the next allocation goes
+		vk::DeviceSize m_bytesInFlight = 0; // Everything the frames in flight are still holding on to, padding included
+		std::array<vk::DeviceSize, kMaxFramesInFlight> m_frameBytes{};
+
+		uint32_t m_currentFrame = 0;
+		uint32_t m_generation = 0;
+
+		std::vector<RetiredBuffer> mv_retiredBuffers;
+
+		Craig::Device*       mp_Device = nullptr;
+		vk::BufferUsageFlags m_RA_usage;
+	};
+
+}
@@ -1,5 +1,8 @@
 #include "Craig_Swapchain.hpp"
 #include <SDL_vulkan.h>
+#include <algorithm>
+
+#include "Craig/Craig_Log.hpp"
 
 CraigError Craig::Swapchain::init(const SwapchainInitInfo& info) {
 
@@ -8,11 +11,12 @@ CraigError Craig::Swapchain::init(const SwapchainInitInfo& info) {
     mSC_surface = info.surface;
     mSC_physicalDevice = info.physicalDevice;
     mSC_device = info.device;
-    if (info.pWindow != nullptr)
-    {
-        mp_Window = info.pWindow;
-    }
-    else
+    m_headless = info.headless;
+    m_headlessExtent = info.headlessExtent;
+    mSC_memoryAllocator = info.memoryAllocator;
+    mp_Window = info.pWindow;
+
+    if (mp_Window == nullptr && !m_headless)
     {
         throw std::runtime_error("pWindow in swapchain is nullptr");
     }
@@ -23,26 +27,34 @@ CraigError Craig::Swapchain::init(const SwapchainInitInfo& info) {
     return ret;
 }
 
-void Craig::Swapchain::createSwapChain() {
+void Craig::Swapchain::createSwapChain(vk::SwapchainKHR oldSwapChain) {
+
+    if (m_headless) {
+        createOffscreenImages();
+        return;
+    }
+
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(mSC_physicalDevice, mSC_surface);
 
     vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+    mv_VK_supportedPresentModes = swapChainSupport.presentModes;
+    m_VK_presentMode = presentMode;
     m_VK_swapChainExtent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    if (swapChainSupport.capabilities.minImageCount > kMaxFramesInFlight) {
-        assert("too many frames in flight for this system!");
-    }
+    // Nothing to do with frames in flight any more, that's the SyncManager's business
+    uint32_t imageCount = chooseImageCount(swapChainSupport.capabilities, presentMode);
 
-    uint32_t imageCount = kMaxFramesInFlight;
+    CRAIG_LOG_INFO(eSwapchain, "Creating draw buffer/swap chain with %i images (%s)\n", imageCount, vk::to_string(presentMode).c_str());
+    CRAIG_LOG_INFO(eSwapchain, "Current extent size = %i x %i\n", m_VK_swapChainExtent.width, m_VK_swapChainExtent.height);
 
-    if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
+    // Frame captures copy straight out of the swap image. Pretty much every surface allows it, but it's not a given.
+    vk::ImageUsageFlags imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    m_captureSupported = static_cast<bool>(swapChainSupport.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+    if (m_captureSupported) {
+        imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
     }
 
-    printf("Creating draw buffer/swap chain with %i images\n", imageCount);
-    printf("Current extent size = %i x %i\n", m_VK_swapChainExtent.width, m_VK_swapChainExtent.height);
-
     vk::SwapchainCreateInfoKHR createInfo{};
     createInfo
         .setSurface(mSC_surface)
@@ -51,7 +63,7 @@ void Craig::Swapchain::createSwapChain() {
         .setImageColorSpace(surfaceFormat.colorSpace)
         .setImageExtent(m_VK_swapChainExtent)
         .setImageArrayLayers(1) //"always 1 unless you are developing a stereoscopic 3D application"
-        .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment);
+        .setImageUsage(imageUsage);
 
     Craig::Device::QueueFamilyIndices indices = Craig::Device::findQueueFamilies(mSC_physicalDevice, mSC_surface);
 
@@ -79,7 +91,7 @@ void Craig::Swapchain::createSwapChain() {
         .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque) //Blending with other windows in the window system (will mostly always be opaque)
         .setPresentMode(presentMode)
         .setClipped(VK_TRUE) //The GPU won't render pixels that are obscured (by other windows, for example)  it also means we can't trust the data in the pixels since they might've not rendered.
-        .setOldSwapchain(VK_NULL_HANDLE);
+        .setOldSwapchain(oldSwapChain); //Lets the driver reuse what it can from the old one, which stays valid for anything already presenting
 
 
     try {
@@ -95,6 +107,29 @@ void Craig::Swapchain::createSwapChain() {
 
 }
 
+void Craig::Swapchain::createOffscreenImages() {
+
+    // Same format we'd pick for a window, so the pipelines and anything comparing images don't care which one they got
+    m_VK_swapChainImageFormat = vk::Format::eB8G8R8A8Srgb;
+    m_VK_swapChainExtent = m_headlessExtent;
+    m_captureSupported = true;
+
+    const uint32_t imageCount = static_cast<uint32_t>(kMaxFramesInFlight);
+
+    CRAIG_LOG_INFO(eSwapchain, "Creating %u offscreen images (headless)\n", imageCount);
+    CRAIG_LOG_INFO(eSwapchain, "Current extent size = %i x %i\n", m_VK_swapChainExtent.width, m_VK_swapChainExtent.height);
+
+    mv_VK_swapChainImages.resize(imageCount);
+    mv_VMA_offscreenAllocations.resize(imageCount);
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        mv_VK_swapChainImages[i] = ImageHelpers::createImage(mSC_physicalDevice, mSC_surface, m_VK_swapChainExtent.width, m_VK_swapChainExtent.height, 1,
+            vk::SampleCountFlagBits::e1, m_VK_swapChainImageFormat, vk::ImageTiling::eOptimal,
+            vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, mSC_memoryAllocator, mv_VMA_offscreenAllocations[i], "Headless swapchain image");
+    }
+}
+
 Craig::Swapchain::SwapChainSupportDetails Craig::Swapchain::querySwapChainSupport(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface) {
     Swapchain::SwapChainSupportDetails details;
 
@@ -126,17 +161,31 @@ vk::PresentModeKHR Craig::Swapchain::chooseSwapPresentMode(const std::vector<vk:
     //VK_PRESENT_MODE_FIFO_RELAXED_KHR : This mode only differs from the previous one if the application is late and the queue was empty at the last vertical blank.Instead of waiting for the next vertical blank, the image is transferred right away when it finally arrives.This may result in visible tearing.
     //VK_PRESENT_MODE_MAILBOX_KHR : This is another variation of the second mode.Instead of blocking the application when the queue is full, the images that are already queued are simply replaced with the newer ones.This mode can be used to render frames as fast as possible while still avoiding tearing, resulting in fewer latency issues than standard vertical sync.This is commonly known as "triple buffering", although the existence of three buffers alone does not necessarily mean that the framerate is unlocked.
 
-    for (const auto& availablePresentMode : availablePresentModes) {
-        vk::PresentModeKHR modeToUse = m_vsyncEnabled ? vk::PresentModeKHR::eFifo : vk::PresentModeKHR::eImmediate;
-        if (availablePresentMode == modeToUse) {
-            return availablePresentMode;
-        }
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), m_requestedPresentMode) != availablePresentModes.end()) {
+        return m_requestedPresentMode;
     }
 
-
+    // FIFO is the only one the spec guarantees
+    CRAIG_LOG_WARN(eSwapchain, "Present mode %s isn't supported here, falling back to FIFO\n", vk::to_string(m_requestedPresentMode).c_str());
     return vk::PresentModeKHR::eFifo;
 }
 
+uint32_t Craig::Swapchain::chooseImageCount(const vk::SurfaceCapabilitiesKHR& capabilities, vk::PresentModeKHR presentMode) {
+
+    // One more than the minimum so we're not stuck waiting on the driver to give an image back.
+    // Mailbox wants at least three, one on screen, one queued up to replace it and one being drawn into.
+    uint32_t imageCount = capabilities.minImageCount + 1;
+    if (presentMode == vk::PresentModeKHR::eMailbox) {
+        imageCount = std::max(imageCount, 3u);
+    }
+
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+        imageCount = capabilities.maxImageCount;
+    }
+
+    return imageCount;
+}
+
 vk::Extent2D Craig::Swapchain::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities) {
 
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
@@ -156,8 +205,23 @@ vk::Extent2D Craig::Swapchain::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR
 
 }
 
+vk::Extent2D Craig::Swapchain::querySurfaceExtent() {
+
+    if (m_headless) {
+        return m_headlessExtent;
+    }
+
+    vk::SurfaceCapabilitiesKHR capabilities = mSC_physicalDevice.getSurfaceCapabilitiesKHR(mSC_surface);
+    return chooseSwapExtent(capabilities);
+}
+
 void Craig::Swapchain::setSwapExtent() {
 
+    if (m_headless) {
+        m_VK_swapChainExtent = m_headlessExtent;
+        return;
+    }
+
     Swapchain::SwapChainSupportDetails swapChainSupport = querySwapChainSupport(mSC_physicalDevice, mSC_surface);
     m_VK_swapChainExtent = chooseSwapExtent(swapChainSupport.capabilities);
 }
@@ -182,13 +246,56 @@ void Craig::Swapchain::createSwapImageViews() {
 
 }
 
+void Craig::Swapchain::recreateSwapChain(Craig::DeletionQueue& deletionQueue) {
+
+    vk::Device device = mSC_device;
+    vk::SwapchainKHR oldSwapChain = m_VK_swapChain;
+    std::vector<vk::ImageView> oldImageViews = mv_VK_swapChainImageViews;
+
+    if (m_headless) {
+        VmaAllocator allocator = mSC_memoryAllocator;
+        std::vector<vk::Image> oldImages = mv_VK_swapChainImages;
+        std::vector<VmaAllocation> oldAllocations = mv_VMA_offscreenAllocations;
+
+        createSwapChain();
+        createSwapImageViews();
+
+        deletionQueue.push([=]() {
+            for (size_t i = 0; i < oldImages.size(); i++) {
+                device.destroyImageView(oldImageViews[i]);
+                vmaDestroyImage(allocator, oldImages[i], oldAllocations[i]);
+            }
+        });
+        return;
+    }
+
+    createSwapChain(oldSwapChain);
+    createSwapImageViews();
+
+    // There's no fence on a present, so the best we've got is waiting until every frame in flight has been waited on
+    deletionQueue.push([=]() {
+        for (auto imageView : oldImageViews) {
+            device.destroyImageView(imageView);
+        }
+        device.destroySwapchainKHR(oldSwapChain);
+    });
+}
+
 void Craig::Swapchain::cleanupSwapChain() {
 
     for (auto imageView : mv_VK_swapChainImageViews) {
         mSC_device.destroyImageView(imageView);
     }
 
-    mSC_device.destroySwapchainKHR(m_VK_swapChain);
+    for (size_t i = 0; i < mv_VMA_offscreenAllocations.size(); i++) {
+        vmaDestroyImage(mSC_memoryAllocator, mv_VK_swapChainImages[i], mv_VMA_offscreenAllocations[i]);
+    }
+    mv_VMA_offscreenAllocations.clear();
+
+    if (m_VK_swapChain)
+    {
+        mSC_device.destroySwapchainKHR(m_VK_swapChain);
+    }
 }
 
 CraigError Craig::Swapchain::terminate() {
@@ -199,6 +306,10 @@ CraigError Craig::Swapchain::terminate() {
         mSC_device.destroyImageView(imageView);
     }
 
+    for (size_t i = 0; i < mv_VMA_offscreenAllocations.size(); i++) {
+        vmaDestroyImage(mSC_memoryAllocator, mv_VK_swapChainImages[i], mv_VMA_offscreenAllocations[i]);
+    }
+
     if (m_VK_swapChain)
     {
         mSC_device.destroySwapchainKHR(m_VK_swapChain);
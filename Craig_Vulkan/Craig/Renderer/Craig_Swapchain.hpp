@@ -6,6 +6,7 @@
 #include "Craig/Craig_Constants.hpp"
 #include "Renderer/Craig_Device.hpp"
 #include "Renderer/Craig_ImageHelpers.hpp"
+#include "Renderer/Craig_DeletionQueue.hpp"
 
 namespace Craig {
 
@@ -19,6 +20,11 @@ namespace Craig {
             vk::PhysicalDevice   physicalDevice;
             vk::Device           device;
             Window*              pWindow;
+
+            // Headless renders into plain images instead, no window or surface needed
+            bool                 headless = false;
+            vk::Extent2D         headlessExtent;
+            VmaAllocator         memoryAllocator = VK_NULL_HANDLE; // Only used headless
         };
         // Swapchain support query results
         struct SwapChainSupportDetails {
@@ -31,13 +37,18 @@ namespace Craig {
         CraigError terminate();
 
         void setSwapExtent();
+        vk::Extent2D querySurfaceExtent();   // What the extent would be if we recreated now, doesn't change anything
 
         static const bool isSwapChainAdequate(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface);
 
-        void createSwapChain();            // Create swapchain images
+        void createSwapChain(vk::SwapchainKHR oldSwapChain = VK_NULL_HANDLE);  // Create swapchain images
         void createSwapImageViews();           // Create swapchain image views
         void cleanupSwapChain();
 
+        // Builds the new swapchain off the old one and hands the old one (and its views) to the deletion queue,
+        // so the frames in flight can finish presenting without a waitIdle
+        void recreateSwapChain(Craig::DeletionQueue& deletionQueue);
+
         //Getters
         const vk::SwapchainKHR&           getSwapChain() const { return m_VK_swapChain; };
         const std::vector<vk::Image>&     getImages() const { return mv_VK_swapChainImages; };
@@ -45,7 +56,17 @@ namespace Craig {
         const vk::Format&                 getImageFormat() const { return m_VK_swapChainImageFormat; };
         const vk::Extent2D&               getExtent() const { return m_VK_swapChainExtent; };
 
-        bool    m_vsyncEnabled = true;
+        // The mode we'd like, only takes effect on the next recreate. Falls back to FIFO if the surface can't do it.
+        void                                   setRequestedPresentMode(vk::PresentModeKHR presentMode) { m_requestedPresentMode = presentMode; };
+        vk::PresentModeKHR                     getRequestedPresentMode() const { return m_requestedPresentMode; };
+        vk::PresentModeKHR                     getPresentMode() const { return m_VK_presentMode; };  // What the swapchain actually got
+        const std::vector<vk::PresentModeKHR>& getSupportedPresentModes() const { return mv_VK_supportedPresentModes; };
+
+        // Headless the images are there to be copied out rather than presented, so that's the layout a frame leaves them in
+        bool                                   isHeadless() const { return m_headless; };
+        vk::ImageLayout                        getFinalLayout() const { return m_headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR; };
+        void                                   setHeadlessExtent(vk::Extent2D extent) { m_headlessExtent = extent; };  // Takes effect on the next recreate
+        bool                                   isCaptureSupported() const { return m_captureSupported; };  // The images can be copied from
 
     private:
 
@@ -54,18 +75,30 @@ namespace Craig {
         std::vector<vk::ImageView> mv_VK_swapChainImageViews;
         vk::Format                 m_VK_swapChainImageFormat;
         vk::Extent2D               m_VK_swapChainExtent;
+        vk::PresentModeKHR         m_VK_presentMode = vk::PresentModeKHR::eFifo;
+        vk::PresentModeKHR         m_requestedPresentMode = vk::PresentModeKHR::eFifo;
+        std::vector<vk::PresentModeKHR> mv_VK_supportedPresentModes;
+        bool                       m_captureSupported = false;
 
         vk::SurfaceKHR             mSC_surface;
         vk::PhysicalDevice         mSC_physicalDevice;
         vk::Device                 mSC_device;
         Window*                    mp_Window;
 
+        // Headless, one image per frame slot so waiting on the slot is enough to know its image is free
+        bool                       m_headless = false;
+        vk::Extent2D               m_headlessExtent;
+        VmaAllocator               mSC_memoryAllocator = VK_NULL_HANDLE;
+        std::vector<VmaAllocation> mv_VMA_offscreenAllocations;
+
+        void createOffscreenImages();
 
 
         static SwapChainSupportDetails querySwapChainSupport(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface);
         vk::Extent2D         chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
         vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
         vk::PresentModeKHR   chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes);
+        uint32_t             chooseImageCount(const vk::SurfaceCapabilitiesKHR& capabilities, vk::PresentModeKHR presentMode);
 
     };
 
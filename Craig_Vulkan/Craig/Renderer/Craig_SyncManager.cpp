@@ -1,5 +1,7 @@
 #include "Craig_SyncManager.hpp"
 
+#include <algorithm>
+
 #include "Craig_Device.hpp"
 
 CraigError Craig::SyncManager::init(const SyncManagerInitInfo& info) {
@@ -8,6 +10,8 @@ CraigError Craig::SyncManager::init(const SyncManagerInitInfo& info) {
 
 	m_SM_logicalDevice = info.logicalDevice;
 	m_SM_swapChainImageCount = info.swapChainImageCount;
+	m_headless = info.headless;
+	m_framesInFlight = std::clamp<uint32_t>(info.framesInFlight, 1, kMaxFramesInFlight);
 
 	createSyncObjects();
 
@@ -42,10 +46,30 @@ void Craig::SyncManager::createSyncObjects() {
 
 }
 
+void Craig::SyncManager::recreateRenderFinishedSemaphores(uint32_t swapChainImageCount, Craig::DeletionQueue& deletionQueue) {
+
+	vk::Device device = m_SM_logicalDevice;
+	std::vector<vk::Semaphore> oldSemaphores = std::move(mv_VK_renderFinishedSemaphores);
+
+	deletionQueue.push([=]() {
+		for (vk::Semaphore semaphore : oldSemaphores) {
+			device.destroySemaphore(semaphore);
+		}
+	});
+
+	m_SM_swapChainImageCount = swapChainImageCount;
+	mv_VK_renderFinishedSemaphores.resize(m_SM_swapChainImageCount);
+
+	vk::SemaphoreCreateInfo semaphoreInfo{};
+	for (size_t i = 0; i < m_SM_swapChainImageCount; i++) {
+		mv_VK_renderFinishedSemaphores[i] = m_SM_logicalDevice.createSemaphore(semaphoreInfo);
+	}
+}
+
 void Craig::SyncManager::waitForGpu()
 {
-	if (m_sempaphoreTimelineValue >= kMaxFramesInFlight) {
-		uint64_t waitValue = m_sempaphoreTimelineValue - (kMaxFramesInFlight - 1);
+	if (m_sempaphoreTimelineValue >= m_framesInFlight) {
+		uint64_t waitValue = m_sempaphoreTimelineValue - (m_framesInFlight - 1);
 
 		vk::SemaphoreWaitInfo waitInfo{};
 		waitInfo.setSemaphores(m_VK_timelineSemaphore);
@@ -58,7 +82,25 @@ void Craig::SyncManager::waitForGpu()
 
 void Craig::SyncManager::nextFrame()
 {
-	m_currentFrame = (m_currentFrame + 1) % kMaxFramesInFlight;
+	m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+}
+
+void Craig::SyncManager::setFramesInFlight(uint32_t framesInFlight) {
+
+	framesInFlight = std::clamp<uint32_t>(framesInFlight, 1, kMaxFramesInFlight);
+	if (framesInFlight == m_framesInFlight) {
+		return;
+	}
+
+	// Only waits on our own frames rather than the whole device, and only when the setting actually changes.
+	// After this no slot is in use, so starting again from slot 0 can't land on anything still in flight.
+	vk::SemaphoreWaitInfo waitInfo{};
+	waitInfo.setSemaphores(m_VK_timelineSemaphore);
+	waitInfo.setValues(m_sempaphoreTimelineValue);
+	m_SM_logicalDevice.waitSemaphores(waitInfo, UINT64_MAX);
+
+	m_framesInFlight = framesInFlight;
+	m_currentFrame = 0;
 }
 
 void Craig::SyncManager::submitFrame(const std::vector<vk::CommandBuffer>& cmdBuffers, uint32_t& imageIndex, vk::Queue graphicsQueue)
@@ -72,18 +114,22 @@ void Craig::SyncManager::submitFrame(const std::vector<vk::CommandBuffer>& cmdBu
 	uint64_t signalValue = ++m_sempaphoreTimelineValue;
 	uint64_t signalValues[] = { signalValue, 0 };
 
+	// Headless nothing got acquired and nothing's going to be presented, so only the timeline's left
+	uint32_t waitCount = m_headless ? 0 : 1;
+	uint32_t signalCount = m_headless ? 1 : 2;
+
 	vk::TimelineSemaphoreSubmitInfo timelineSubmit;
 	timelineSubmit
-		.setSignalSemaphoreValueCount(2)
-		.setSignalSemaphoreValues(signalValues);
+		.setSignalSemaphoreValueCount(signalCount)
+		.setPSignalSemaphoreValues(signalValues);
 
 	vk::SubmitInfo submitInfo;
 	submitInfo
 		.setPNext(&timelineSubmit)
-		.setWaitSemaphoreCount(1)
+		.setWaitSemaphoreCount(waitCount)
 		.setPWaitSemaphores(waitSemaphores)
 		.setPWaitDstStageMask(waitStages)
-		.setSignalSemaphoreCount(2)
+		.setSignalSemaphoreCount(signalCount)
 		.setPSignalSemaphores(signalSemaphores)
 		.setCommandBufferCount(1)
 		.setPCommandBuffers(&cmdBuffers[m_currentFrame]);
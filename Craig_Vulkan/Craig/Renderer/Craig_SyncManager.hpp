@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include "Craig/Craig_Constants.hpp"
+#include "Craig_DeletionQueue.hpp"
 
 namespace Craig {
 	class Device;
@@ -12,6 +13,8 @@ namespace Craig {
 		{
 			vk::Device logicalDevice;
 			uint32_t swapChainImageCount;
+			uint32_t framesInFlight = kDefaultFramesInFlight;
+			bool headless = false; // No acquire to wait on and no present to signal, just the timeline
 
 		};
 
@@ -21,6 +24,14 @@ namespace Craig {
 		void waitForGpu();
 		void nextFrame();
 
+		// Waits for everything we've submitted to finish first, so every frame slot is free when the count changes
+		void setFramesInFlight(uint32_t framesInFlight);
+		uint32_t getFramesInFlight() const { return m_framesInFlight; }
+
+		// The render finished semaphores are per swapchain image, so they follow the swapchain around. The old ones
+		// might still be waited on by a present, so they go through the deletion queue.
+		void recreateRenderFinishedSemaphores(uint32_t swapChainImageCount, Craig::DeletionQueue& deletionQueue);
+
 		void submitFrame(const std::vector<vk::CommandBuffer>& cmdBuffers, uint32_t& imageIndex, vk::Queue graphicsQueue);
 
 		const uint32_t getCurrentFrame() const { return m_currentFrame; }
@@ -32,6 +43,7 @@ namespace Craig {
 
 		// Sync
 		uint32_t m_currentFrame = 0;
+		uint32_t m_framesInFlight = kDefaultFramesInFlight; // Somewhere between 1 and kMaxFramesInFlight
 
 		std::vector<vk::Semaphore> mv_VK_imageAvailableSemaphores;
 		std::vector<vk::Semaphore> mv_VK_renderFinishedSemaphores;
@@ -42,6 +54,7 @@ namespace Craig {
 
 		vk::Device m_SM_logicalDevice;
 		uint32_t m_SM_swapChainImageCount;
+		bool m_headless = false;
 
 	};
 
@@ -0,0 +1,57 @@
+// Depth only version of VertexShader.vert for the depth pre-pass.
+// Reads from the packed position stream instead of the interleaved vertex buffer, no fragment shader.
+// The maths has to match VertexShader.vert exactly, otherwise the colour pass' eEqual depth test starts dropping pixels.
+
+// Set 0, binding 0 - per-frame camera data (view + proj). Same for every object this frame.
+[[vk::binding(0, 0)]]
+cbuffer CameraData
+{
+    float4x4 view;
+    float4x4 proj;
+};
+
+// Set 0, binding 1 - big array of per-object transforms. We index into it using the push constant.
+struct PerObjectData
+{
+    float4x4 model;
+};
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<PerObjectData> transforms;
+
+// Push constant, tells the shader which slot of the transforms array to read for this draw.
+struct PushConstants
+{
+    uint objectIndex;
+};
+[[vk::push_constant]] PushConstants pc;
+
+struct VSInput
+{
+    float3 pos : POSITION0; // Only thing in the position stream
+};
+
+struct VSOutput
+{
+    float4 pos : SV_Position;
+};
+
+
+VSOutput main(VSInput input)
+{
+    VSOutput output;
+
+    // precise stops the compiler fusing these differently to the colour pass
+    precise float4 worldPos = float4(input.pos, 1.0);
+
+    float4x4 model = transforms[pc.objectIndex].model;
+
+    //Apply MVP
+    worldPos = mul(model, worldPos); //Apply model matrix
+    worldPos = mul(view, worldPos); //Apply view matrix
+    worldPos = mul(proj, worldPos); //Apply projection matrix
+
+    output.pos = worldPos;
+
+    return output;
+}
@@ -0,0 +1,16 @@
+// Overdraw view. Every fragment adds the same amount on top of whatever's already there (additive blending, no depth
+// test), so the colour ends up counting how many times the pixel got covered.
+// Red fills up first, then green, then blue, so it reads as a heatmap without needing another pass:
+// dark red = 1, red = 4, yellow = 16, white = 64 or more.
+
+struct PSInput
+{
+    float4 pos : SV_Position;
+    float3 color : COLOR0;
+    float2 texCoord : TEXCOORD1;
+};
+
+float4 main(PSInput input) : SV_Target
+{
+    return float4(1.0 / 4.0, 1.0 / 16.0, 1.0 / 64.0, 1.0);
+}
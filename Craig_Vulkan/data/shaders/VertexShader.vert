@@ -42,7 +42,8 @@ VSOutput main(VSInput input)
 {
     VSOutput output;
 
-    float4 worldPos = float4(input.pos, 1.0);
+    // precise so this lines up bit for bit with DepthPrePass.vert, the colour pass depth tests with eEqual after a pre-pass
+    precise float4 worldPos = float4(input.pos, 1.0);
 
     // Grab this object's model matrix from the SSBO using the push-constant index.
     float4x4 model = transforms[pc.objectIndex].model;